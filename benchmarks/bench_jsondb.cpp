@@ -0,0 +1,941 @@
+#include <database/json_driver.h>
+#include <database/json_predicate.h>
+#include <database/json_simd_parser.h>
+#include <json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+struct BenchOptions
+{
+    std::size_t rows = 500000;
+    int iterations = 3;
+    std::string only;
+};
+
+double MeasureSeconds(const std::function<void()>& work)
+{
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void Report(const std::string& name, std::size_t rows, double seconds)
+{
+    std::cout << name << ": " << seconds * 1000.0 << " ms, "
+              << static_cast<double>(rows) / seconds / 1e6 << " Mrows/s\n";
+}
+
+std::vector<nlohmann::json> MakeRows(std::size_t count)
+{
+    std::vector<nlohmann::json> rows;
+    rows.reserve(count);
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        rows.push_back(
+            {{"id", static_cast<long long>(index)},
+             {"name", "user" + std::to_string(index)},
+             {"age", static_cast<long long>(index % 90)},
+             {"is_active", index % 2 == 0}});
+    }
+    return rows;
+}
+
+void WriteTable(const fs::path& dbPath, const std::string& tableName, const std::vector<nlohmann::json>& rows)
+{
+    std::ofstream tableFile(dbPath / (tableName + ".json"));
+    tableFile << nlohmann::json(rows);
+    std::ofstream schemaFile(dbPath / (tableName + ".schema.json"));
+    schemaFile << nlohmann::json::array({"id", "name", "age", "is_active"});
+}
+
+void BenchPredicateScan(const BenchOptions& options)
+{
+    const std::vector<nlohmann::json> rows = MakeRows(options.rows);
+    const std::string whereClause = "id = 5 AND age >= 0";
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        std::size_t matches = 0;
+        const double perRow = MeasureSeconds([&]() {
+            for (const auto& row : rows)
+            {
+                matches += sql::jsondb::Predicate::compile(whereClause).matches(row) ? 1 : 0;
+            }
+        });
+        Report("predicate/compile-per-row", rows.size(), perRow);
+
+        const double compiled = MeasureSeconds([&]() {
+            const auto predicate = sql::jsondb::Predicate::compile(whereClause);
+            for (const auto& row : rows)
+            {
+                matches += predicate.matches(row) ? 1 : 0;
+            }
+        });
+        Report("predicate/compiled-once", rows.size(), compiled);
+
+        if (matches != 2)
+        {
+            std::cerr << "unexpected match count: " << matches << '\n';
+        }
+    }
+}
+
+void BenchSelectScan(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_select";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    WriteTable(dbPath, "users", MakeRows(options.rows));
+    auto statement = connection->createStatement();
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() {
+            auto resultSet = statement->executeQuery("SELECT id, name FROM users WHERE id = 5;");
+            (void)resultSet;
+        });
+        Report("select/where-id-eq", options.rows, seconds);
+    }
+
+    // With no cache budget the table is either parsed whole per query or streamed.
+    connection->setTableCacheBudget(0);
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() {
+            const auto rows = sql::jsondb::ReadJsonArrayFile(connection->getTableFilePath("users"));
+            (void)rows;
+        });
+        Report("select/uncached-dom-load", options.rows, seconds);
+    }
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() {
+            auto resultSet = statement->executeQuery("SELECT name FROM users WHERE age = 33;");
+            (void)resultSet;
+        });
+        Report("select/uncached-streamed", options.rows, seconds);
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchSingleRowInserts(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_insert";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kInserts = 200;
+
+    for (const auto mode : {sql::jsondb::InsertMode::REWRITE, sql::jsondb::InsertMode::APPEND})
+    {
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->setInsertMode(mode);
+        connection->setDeltaCompactionBytes(std::numeric_limits<std::uint64_t>::max());
+        auto statement = connection->createStatement();
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kInserts; ++index)
+            {
+                statement->executeUpdate(
+                    "INSERT INTO users VALUES (" + std::to_string(options.rows + index) + ", 'new', 30, true);");
+            }
+        });
+        std::cout << (mode == sql::jsondb::InsertMode::APPEND ? "insert/append" : "insert/rewrite") << ": "
+                  << seconds * 1e6 / kInserts << " us/insert\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchTransactionBatch(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_txn";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kStatements = 50;
+
+    for (const bool autoCommit : {true, false})
+    {
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->setAutoCommit(autoCommit);
+        auto statement = connection->createStatement();
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kStatements; ++index)
+            {
+                statement->executeUpdate("UPDATE users SET age = " + std::to_string(index) + " WHERE id = " + std::to_string(index) + ";");
+            }
+            connection->commit();
+        });
+        std::cout << (autoCommit ? "txn/autocommit" : "txn/batched") << ": "
+                  << seconds * 1e3 / kStatements << " ms/statement\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchConcurrentWriters(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_writers";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kInsertsPerWriter = 50;
+
+    for (const auto mode : {sql::jsondb::JournalMode::DIRECT, sql::jsondb::JournalMode::WAL})
+    {
+        for (const int writerCount : {1, 2, 4, 8})
+        {
+            fs::remove_all(dbPath);
+            auto observer = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+            WriteTable(dbPath, "users", seedRows);
+
+            const double seconds = MeasureSeconds([&]() {
+                std::vector<std::thread> writers;
+                for (int writer = 0; writer < writerCount; ++writer)
+                {
+                    writers.emplace_back([&, writer]() {
+                        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+                        connection->setJournalMode(mode);
+                        auto statement = connection->createStatement();
+                        for (int index = 0; index < kInsertsPerWriter; ++index)
+                        {
+                            const std::size_t id = options.rows + static_cast<std::size_t>(writer * kInsertsPerWriter + index);
+                            statement->executeUpdate("INSERT INTO users VALUES (" + std::to_string(id) + ", 'new', 30, true);");
+                        }
+                    });
+                }
+                for (auto& writer : writers)
+                {
+                    writer.join();
+                }
+            });
+
+            const auto stats = observer->getWalStats();
+            std::cout << (mode == sql::jsondb::JournalMode::WAL ? "writers/wal-" : "writers/direct-") << writerCount << ": "
+                      << static_cast<double>(writerCount * kInsertsPerWriter) / seconds << " commits/s, "
+                      << stats.averageGroupSize() << " avg group, " << stats.maxGroupSize << " max group\n";
+            observer->close();
+        }
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchIndexLookup(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_index";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    WriteTable(dbPath, "users", MakeRows(options.rows));
+    auto statement = connection->createStatement();
+    constexpr int kLookups = 100;
+
+    for (const bool indexed : {false, true})
+    {
+        if (indexed)
+        {
+            const double build = MeasureSeconds([&]() {
+                statement->executeCreate("CREATE INDEX idx_users_name ON users (name);");
+                statement->executeQuery("SELECT id FROM users WHERE name = 'user0';");
+            });
+            std::cout << "index/build: " << build * 1e3 << " ms\n";
+        }
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kLookups; ++index)
+            {
+                const std::size_t id = static_cast<std::size_t>(index) * 7919 % options.rows;
+                statement->executeQuery("SELECT id FROM users WHERE name = 'user" + std::to_string(id) + "';");
+            }
+        });
+        std::cout << (indexed ? "index/hash-lookup" : "index/full-scan") << ": "
+                  << seconds * 1e6 / kLookups << " us/lookup\n";
+    }
+
+    for (const bool indexed : {false, true})
+    {
+        if (indexed)
+        {
+            const double build = MeasureSeconds([&]() {
+                statement->executeCreate("CREATE INDEX idx_users_id ON users (id) USING BTREE;");
+                statement->executeQuery("SELECT id FROM users WHERE id < 0;");
+            });
+            std::cout << "index/btree-build: " << build * 1e3 << " ms\n";
+        }
+
+        const double range = MeasureSeconds([&]() {
+            for (int index = 0; index < kLookups; ++index)
+            {
+                const std::size_t low = static_cast<std::size_t>(index) * 7919 % options.rows;
+                statement->executeQuery(
+                    "SELECT id FROM users WHERE id >= " + std::to_string(low) + " AND id < " + std::to_string(low + 100) + ";");
+            }
+        });
+        const double topN = MeasureSeconds([&]() {
+            statement->executeQuery("SELECT id, name FROM users ORDER BY id DESC LIMIT 10;");
+        });
+        std::cout << (indexed ? "index/btree-range-100: " : "index/scan-range-100: ") << range * 1e6 / kLookups << " us/query\n"
+                  << (indexed ? "index/btree-order-limit: " : "index/sort-order-limit: ") << topN * 1e3 << " ms\n";
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchPrimaryKey(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_pk";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    WriteTable(dbPath, "users", MakeRows(options.rows));
+    sql::jsondb::WriteTableSchema(
+        sql::jsondb::SchemaFilePath(dbPath.string(), "users"),
+        {.columns = {"id", "name", "age", "is_active"}, .primaryKey = {"id"}});
+    auto statement = connection->createStatement();
+    constexpr int kOperations = 1000;
+
+    statement->executeQuery("SELECT id FROM users WHERE id = 0;");
+    const double lookups = MeasureSeconds([&]() {
+        for (int index = 0; index < kOperations; ++index)
+        {
+            const std::size_t id = static_cast<std::size_t>(index) * 7919 % options.rows;
+            statement->executeQuery("SELECT name FROM users WHERE id = " + std::to_string(id) + ";");
+        }
+    });
+    std::cout << "pk/select: " << lookups * 1e6 / kOperations << " us/lookup\n";
+
+    // A new connection on an NDJSON table reads keys from the key map sidecar
+    // rather than parsing the rows.
+    const sql::jsondb::TableSchema keyedSchema{.columns = {"id", "name", "age", "is_active"}, .primaryKey = {"id"}};
+    sql::jsondb::WriteTableSchema(sql::jsondb::SchemaFilePath(dbPath.string(), "keyed"), keyedSchema);
+    sql::jsondb::WriteTableFile(dbPath.string(), "keyed", MakeRows(options.rows), sql::jsondb::TableFormat::NDJSON, sql::jsondb::SyncMode::NONE);
+    auto cold = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    auto coldStatement = cold->createStatement();
+    const double coldLookup = MeasureSeconds([&]() { coldStatement->executeQuery("SELECT name FROM keyed WHERE id = 1;"); });
+    std::cout << "pk/ndjson-cold-select: " << coldLookup * 1e3 << " ms\n";
+    const double inserts = MeasureSeconds([&]() {
+        for (int index = 0; index < kOperations; ++index)
+        {
+            coldStatement->executeUpdate("INSERT INTO keyed VALUES (" + std::to_string(options.rows + static_cast<std::size_t>(index)) + ", 'kv', 1, true);");
+        }
+    });
+    std::cout << "pk/ndjson-insert: " << inserts * 1e6 / kOperations << " us/insert\n";
+    cold->close();
+
+    connection->setJournalMode(sql::jsondb::JournalMode::WAL);
+    connection->setAutoCommit(false);
+    const double upserts = MeasureSeconds([&]() {
+        for (int index = 0; index < kOperations; ++index)
+        {
+            const std::size_t id = static_cast<std::size_t>(index) * 7919 % (options.rows * 2);
+            statement->executeUpdate("REPLACE INTO users VALUES (" + std::to_string(id) + ", 'kv', 1, true);");
+        }
+        connection->commit();
+    });
+    std::cout << "pk/replace-batched: " << upserts * 1e6 / kOperations << " us/upsert\n";
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchWideProjection(const BenchOptions& options)
+{
+    constexpr int kColumns = 50;
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_wide";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    std::vector<nlohmann::json> rows;
+    rows.reserve(options.rows);
+    for (std::size_t index = 0; index < options.rows; ++index)
+    {
+        nlohmann::json row = nlohmann::json::object();
+        for (int column = 0; column < kColumns; ++column)
+        {
+            const std::string name = "c" + std::to_string(column);
+            if (column % 2 == 0)
+            {
+                row[name] = static_cast<long long>(index * kColumns + column);
+            }
+            else
+            {
+                row[name] = "value-" + std::to_string(index) + "-" + std::to_string(column);
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+    WriteTable(dbPath, "wide", rows);
+    rows.clear();
+    connection->setTableCacheBudget(0);
+    auto statement = connection->createStatement();
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        std::size_t matched = 0;
+        const double seconds = MeasureSeconds([&]() {
+            connection->streamTable("wide", [&](nlohmann::json& row) {
+                matched += row.at("c2").get<long long>() % 10 == 2 ? 1 : 0;
+                return true;
+            });
+        });
+        Report("wide/all-columns-parse", options.rows, seconds);
+        (void)matched;
+    }
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() {
+            auto resultSet = statement->executeQuery("SELECT c0, c1 FROM wide WHERE c2 < 1000;");
+            (void)resultSet;
+        });
+        Report("wide/select-two-columns", options.rows, seconds);
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchColumnarScan(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_columnar";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    WriteTable(dbPath, "users", MakeRows(options.rows));
+    auto statement = connection->createStatement();
+    const std::string query = "SELECT id FROM users WHERE age > 80 AND id < 1000;";
+
+    statement->executeQuery(query);
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() { statement->executeQuery(query); });
+        Report("columnar/json-scan", options.rows, seconds);
+    }
+
+    connection->convertTable("users", sql::jsondb::TableFormat::COLUMNAR);
+    std::cout << "columnar/file-bytes: " << fs::file_size(connection->getTableFilePath("users")) << '\n';
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() { statement->executeQuery(query); });
+        Report("columnar/typed-scan", options.rows, seconds);
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchNdjsonTable(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_ndjson";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    const std::string page = "SELECT * FROM users LIMIT 10 OFFSET " + std::to_string(options.rows - 10) + ";";
+    constexpr int kInserts = 200;
+
+    for (const auto format : {sql::jsondb::TableFormat::JSON, sql::jsondb::TableFormat::NDJSON})
+    {
+        const std::string label = format == sql::jsondb::TableFormat::NDJSON ? "ndjson" : "json";
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->convertTable("users", format);
+        auto statement = connection->createStatement();
+
+        const double insertSeconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kInserts; ++index)
+            {
+                statement->executeUpdate(
+                    "INSERT INTO users VALUES (" + std::to_string(options.rows + index) + ", 'new', 30, true);");
+            }
+        });
+        std::cout << "ndjson/" << label << "-insert: " << insertSeconds * 1e6 / kInserts << " us/insert\n";
+
+        // A fresh connection has no snapshot, as after a restart.
+        connection->close();
+        connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        connection->setTableCacheBudget(0);
+        statement = connection->createStatement();
+        for (int iteration = 0; iteration < options.iterations; ++iteration)
+        {
+            const double seconds = MeasureSeconds([&]() { statement->executeQuery(page); });
+            Report("ndjson/" + label + "-last-page", options.rows, seconds);
+        }
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchParallelScan(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_threads";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    WriteTable(dbPath, "users", MakeRows(options.rows));
+    auto statement = connection->createStatement();
+    const std::string query = "SELECT id, name FROM users WHERE age > 45 AND is_active = true;";
+    statement->executeQuery(query);
+
+    const std::size_t maxThreads = std::max<std::size_t>(4, std::thread::hardware_concurrency());
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        connection->setScanThreads(threads);
+        for (int iteration = 0; iteration < options.iterations; ++iteration)
+        {
+            const double seconds = MeasureSeconds([&]() { statement->executeQuery(query); });
+            Report("threads/" + std::to_string(threads) + "-filter", options.rows, seconds);
+        }
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchParallelLoad(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_load";
+    fs::remove_all(dbPath);
+    auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+    const std::vector<nlohmann::json> rows = MakeRows(options.rows);
+    WriteTable(dbPath, "users", rows);
+    sql::jsondb::WriteTableFile(dbPath.string(), "lines", rows, sql::jsondb::TableFormat::NDJSON, sql::jsondb::SyncMode::NONE);
+    connection->setTableCacheBudget(0);
+
+    const std::size_t maxThreads = std::max<std::size_t>(4, std::thread::hardware_concurrency());
+    for (const std::string table : {"users", "lines"})
+    {
+        for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            connection->setScanThreads(threads);
+            for (int iteration = 0; iteration < options.iterations; ++iteration)
+            {
+                const double seconds = MeasureSeconds([&]() { connection->getTableData(table); });
+                Report("load/" + table + "-" + std::to_string(threads) + "-threads", options.rows, seconds);
+            }
+        }
+    }
+
+    connection->close();
+    fs::remove_all(dbPath);
+}
+
+void BenchJsonParse(const BenchOptions& options)
+{
+    const std::string text = nlohmann::json(MakeRows(options.rows)).dump(4);
+    // Each parse is checked so the work cannot be optimized away.
+    std::size_t parsedRows = 0;
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() { parsedRows = nlohmann::json::parse(text).size(); });
+        Report("parse/nlohmann", options.rows, seconds);
+    }
+
+    const char* kernelNames[] = {"scalar", "sse2", "avx2"};
+    for (const sql::jsondb::JsonKernel kernel : sql::jsondb::AvailableJsonKernels())
+    {
+        for (int iteration = 0; iteration < options.iterations; ++iteration)
+        {
+            const double seconds = MeasureSeconds([&]() {
+                const std::optional<nlohmann::json> parsed = sql::jsondb::FastParseJson(text, kernel);
+                parsedRows = parsed.has_value() ? parsed->size() : 0;
+            });
+            Report(std::string("parse/") + kernelNames[static_cast<int>(kernel)], options.rows, seconds);
+        }
+    }
+    if (parsedRows != options.rows)
+    {
+        std::cerr << "parse: expected " << options.rows << " rows, got " << parsedRows << "\n";
+    }
+}
+
+void BenchTableWrite(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_write";
+    fs::remove_all(dbPath);
+    fs::create_directories(dbPath);
+    const std::vector<nlohmann::json> rows = MakeRows(options.rows);
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration)
+    {
+        const double seconds = MeasureSeconds([&]() {
+            std::ofstream tableFile(dbPath / "users.json");
+            tableFile << std::setw(2) << nlohmann::json(rows);
+        });
+        Report("write/ostream-setw2", options.rows, seconds);
+    }
+
+    for (const auto layout : {sql::jsondb::JsonLayout::PRETTY, sql::jsondb::JsonLayout::COMPACT})
+    {
+        const std::string name = layout == sql::jsondb::JsonLayout::PRETTY ? "pretty" : "compact";
+        for (int iteration = 0; iteration < options.iterations; ++iteration)
+        {
+            const double seconds = MeasureSeconds([&]() {
+                sql::jsondb::WriteTableFile(dbPath.string(), "users", rows, sql::jsondb::TableFormat::JSON, sql::jsondb::SyncMode::NONE, layout);
+            });
+            Report("write/" + name + " (" + std::to_string(fs::file_size(dbPath / "users.json") >> 20) + " MiB)", options.rows, seconds);
+        }
+    }
+
+    fs::remove_all(dbPath);
+}
+
+void BenchSyncModes(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_sync";
+    const std::size_t statements = std::max<std::size_t>(1, std::min<std::size_t>(options.rows, 200));
+    const std::pair<sql::jsondb::SyncMode, std::string> modes[] = {
+        {sql::jsondb::SyncMode::NONE, "none"},
+        {sql::jsondb::SyncMode::COMMIT, "commit"},
+        {sql::jsondb::SyncMode::ALWAYS, "always"}};
+
+    for (const auto& [mode, name] : modes)
+    {
+        for (const std::string engine : {"JSON", "NDJSON"})
+        {
+            fs::remove_all(dbPath);
+            auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+            connection->setSyncMode(mode);
+            auto statement = connection->createStatement();
+            statement->executeCreate("CREATE TABLE users (id INT, name TEXT) ENGINE = " + engine + ";");
+
+            for (int iteration = 0; iteration < options.iterations; ++iteration)
+            {
+                const double seconds = MeasureSeconds([&]() {
+                    for (std::size_t index = 0; index < statements; ++index)
+                    {
+                        statement->executeUpdate("INSERT INTO users (id, name) VALUES (" + std::to_string(index) + ", 'user');");
+                    }
+                });
+                Report("sync/" + name + "-" + engine + "-inserts", statements, seconds);
+            }
+            connection->close();
+        }
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchTombstoneDeletes(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_queue";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kDeletes = 50;
+
+    // A ratio of 0 compacts on every delete, i.e. the old full rewrite.
+    for (const double ratio : {0.0, 0.25})
+    {
+        const std::string label = ratio == 0.0 ? "rewrite" : "tombstones";
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->setTombstoneCompactionRatio(ratio);
+        auto statement = connection->createStatement();
+        connection->getTableSnapshot("users");
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kDeletes; ++index)
+            {
+                statement->executeUpdate("DELETE FROM users WHERE id = " + std::to_string(index) + ";");
+            }
+        });
+        std::cout << "queue/" << label << "-delete-head: " << seconds * 1e3 / kDeletes << " ms/delete\n";
+
+        const double vacuumSeconds = MeasureSeconds([&]() { statement->execute("VACUUM users;"); });
+        Report("queue/" + label + "-vacuum", options.rows, vacuumSeconds);
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchInPlaceUpdate(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_patch";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kUpdates = 50;
+
+    // All tables are columnar. Strings force a rewrite; a counter that climbs
+    // past the block max widens it by rewriting only the footer.
+    for (const std::string label : {"rewrite", "in-place", "counter"})
+    {
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->convertTable("users", sql::jsondb::TableFormat::COLUMNAR);
+        auto statement = connection->createStatement();
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kUpdates; ++index)
+            {
+                std::string assignment = "age = " + std::to_string(index % 90);
+                if (label == "rewrite")
+                {
+                    assignment = "name = 'renamed" + std::to_string(index) + "'";
+                }
+                else if (label == "counter")
+                {
+                    assignment = "age = " + std::to_string(1000 + index);
+                }
+                statement->executeUpdate("UPDATE users SET " + assignment + " WHERE id = " + std::to_string(index * 7) + ";");
+            }
+        });
+        std::cout << "patch/" << label << "-update: " << seconds * 1e3 / kUpdates << " ms/update\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchLsmTable(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_lsm";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kInserts = 200;
+    constexpr int kLookups = 1000;
+
+    for (const auto format : {sql::jsondb::TableFormat::JSON, sql::jsondb::TableFormat::LSM})
+    {
+        const std::string label = format == sql::jsondb::TableFormat::LSM ? "lsm" : "json";
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        sql::jsondb::WriteTableSchema(
+            sql::jsondb::SchemaFilePath(dbPath.string(), "users"), {.columns = {"id", "name", "age", "is_active"}, .primaryKey = {"id"}});
+        connection->convertTable("users", format);
+        auto statement = connection->createStatement();
+
+        // Keys land all over the existing key range, not just at its end.
+        const double insertSeconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kInserts; ++index)
+            {
+                const std::size_t id = options.rows + (static_cast<std::size_t>(index) * 7919) % options.rows;
+                statement->executeUpdate("INSERT INTO users VALUES (" + std::to_string(id) + ", 'new', 30, true);");
+            }
+        });
+        std::cout << "lsm/" << label << "-insert: " << insertSeconds * 1e6 / kInserts << " us/insert\n";
+
+        connection->close();
+        connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        statement = connection->createStatement();
+        const double lookupSeconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kLookups; ++index)
+            {
+                const std::size_t id = static_cast<std::size_t>(index) * 104729 % (options.rows * 2);
+                statement->executeQuery("SELECT name FROM users WHERE id = " + std::to_string(id) + ";");
+            }
+        });
+        std::cout << "lsm/" << label << "-cold-lookup: " << lookupSeconds * 1e6 / kLookups << " us/lookup\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchPagedTable(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_paged";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    constexpr int kWrites = 50;
+
+    for (const auto format : {sql::jsondb::TableFormat::JSON, sql::jsondb::TableFormat::PAGED})
+    {
+        const std::string label = format == sql::jsondb::TableFormat::PAGED ? "paged" : "json";
+        fs::remove_all(dbPath);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        WriteTable(dbPath, "users", seedRows);
+        connection->convertTable("users", format);
+        auto statement = connection->createStatement();
+
+        const double updateSeconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kWrites; ++index)
+            {
+                statement->executeUpdate("UPDATE users SET name = 'renamed' WHERE id = " + std::to_string(index * 7) + ";");
+            }
+        });
+        std::cout << "paged/" << label << "-update: " << updateSeconds * 1e3 / kWrites << " ms/update\n";
+
+        const double insertSeconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kWrites; ++index)
+            {
+                const std::size_t id = options.rows + static_cast<std::size_t>(index);
+                statement->executeUpdate("INSERT INTO users VALUES (" + std::to_string(id) + ", 'new', 30, true);");
+            }
+        });
+        std::cout << "paged/" << label << "-insert: " << insertSeconds * 1e3 / kWrites << " ms/insert\n";
+
+        // Without a table cache, scans of the paged table run through a 1 MiB pool.
+        connection->setTableCacheBudget(0);
+        connection->setBufferPoolPages(128);
+        const double scanSeconds = MeasureSeconds([&]() {
+            for (int iteration = 0; iteration < options.iterations; ++iteration)
+            {
+                statement->executeQuery("SELECT id FROM users WHERE age > 200;");
+            }
+        });
+        Report("paged/" + label + "-scan", options.rows * options.iterations, scanSeconds);
+        if (format == sql::jsondb::TableFormat::PAGED)
+        {
+            const sql::jsondb::BufferPoolStats stats = connection->getBufferPoolStats();
+            std::cout << "paged/pool: " << stats.misses << " misses, " << stats.evictions << " evictions, "
+                      << stats.residentPages << "/" << stats.capacityPages << " pages resident\n";
+        }
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchZoneMaps(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_zones";
+    const std::vector<nlohmann::json> seedRows = MakeRows(options.rows);
+    const std::string sql = "SELECT id FROM users WHERE id >= " + std::to_string(options.rows / 2) + " AND id < " +
+                            std::to_string(options.rows / 2 + 100) + ";";
+
+    // Both scans stream the table; only the first reads its zone map.
+    for (const bool zones : {true, false})
+    {
+        const std::string label = zones ? "zone-map" : "full";
+        fs::remove_all(dbPath);
+        fs::create_directories(dbPath);
+        sql::jsondb::WriteTableFile(dbPath.string(), "users", seedRows, sql::jsondb::TableFormat::JSON, sql::jsondb::SyncMode::NONE);
+        if (!zones)
+        {
+            fs::remove(sql::jsondb::ZoneMapFilePath(dbPath.string(), "users"));
+        }
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        connection->setTableCacheBudget(0);
+        auto statement = connection->createStatement();
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int iteration = 0; iteration < options.iterations; ++iteration)
+            {
+                statement->executeQuery(sql);
+            }
+        });
+        const sql::jsondb::ScanStats stats = statement->getLastScanStats();
+        std::cout << "zones/" << label << "-range: " << seconds * 1e3 / options.iterations << " ms/query, "
+                  << stats.blocksSkipped << " blocks skipped\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+void BenchBloomFilters(const BenchOptions& options)
+{
+    const fs::path dbPath = fs::temp_directory_path() / "bench_jsondb_bloom";
+    constexpr int kLookups = 20;
+    // Scrambled emails give every block about the same min/max, so zone ranges
+    // alone skip nothing.
+    std::vector<nlohmann::json> seedRows;
+    seedRows.reserve(options.rows);
+    for (std::size_t index = 0; index < options.rows; ++index)
+    {
+        seedRows.push_back(
+            {{"id", static_cast<long long>(index)}, {"email", "user" + std::to_string(index * 7919 % options.rows) + "@example.com"}});
+    }
+
+    for (const bool bloom : {false, true})
+    {
+        const std::string label = bloom ? "bloom" : "zones-only";
+        fs::remove_all(dbPath);
+        fs::create_directories(dbPath);
+        sql::jsondb::WriteTableSchema(sql::jsondb::SchemaFilePath(dbPath.string(), "users"), {.columns = {"id", "email"}});
+        sql::jsondb::WriteTableFile(dbPath.string(), "users", seedRows, sql::jsondb::TableFormat::JSON, sql::jsondb::SyncMode::NONE);
+        auto connection = sql::jsondb::Driver::getInstance().connect(dbPath.string());
+        if (bloom)
+        {
+            connection->setBloomColumns("users", {"email"});
+        }
+        connection->setTableCacheBudget(0);
+        auto statement = connection->createStatement();
+
+        const double seconds = MeasureSeconds([&]() {
+            for (int index = 0; index < kLookups; ++index)
+            {
+                statement->executeQuery("SELECT id FROM users WHERE email = 'user" + std::to_string(index) + "@example.org';");
+            }
+        });
+        std::cout << "bloom/" << label << "-negative-lookup: " << kLookups / seconds << " lookups/s, "
+                  << statement->getLastScanStats().blocksSkipped << " blocks skipped\n";
+        connection->close();
+    }
+    fs::remove_all(dbPath);
+}
+
+bool ParseArgs(int argc, char** argv, BenchOptions& options)
+{
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string arg = argv[index];
+        if (arg == "--rows" && index + 1 < argc)
+        {
+            options.rows = std::stoull(argv[++index]);
+        }
+        else if (arg == "--iterations" && index + 1 < argc)
+        {
+            options.iterations = std::stoi(argv[++index]);
+        }
+        else if (arg == "--only" && index + 1 < argc)
+        {
+            options.only = argv[++index];
+        }
+        else
+        {
+            std::cerr << "Usage: bench_jsondb [--rows <n>] [--iterations <n>] [--only <name>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!ParseArgs(argc, argv, options))
+    {
+        return 1;
+    }
+
+    const std::vector<std::pair<std::string, std::function<void(const BenchOptions&)>>> benches = {
+        {"predicate", BenchPredicateScan},
+        {"select", BenchSelectScan},
+        {"insert", BenchSingleRowInserts},
+        {"txn", BenchTransactionBatch},
+        {"writers", BenchConcurrentWriters},
+        {"index", BenchIndexLookup},
+        {"pk", BenchPrimaryKey},
+        {"wide", BenchWideProjection},
+        {"columnar", BenchColumnarScan},
+        {"ndjson", BenchNdjsonTable},
+        {"threads", BenchParallelScan},
+        {"load", BenchParallelLoad},
+        {"parse", BenchJsonParse},
+        {"write", BenchTableWrite},
+        {"sync", BenchSyncModes},
+        {"queue", BenchTombstoneDeletes},
+        {"patch", BenchInPlaceUpdate},
+        {"lsm", BenchLsmTable},
+        {"paged", BenchPagedTable},
+        {"zones", BenchZoneMaps},
+        {"bloom", BenchBloomFilters},
+    };
+
+    for (const auto& [name, bench] : benches)
+    {
+        if (options.only.empty() || options.only == name)
+        {
+            std::cout << "== " << name << " (" << options.rows << " rows)\n";
+            bench(options);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <core/sql_lexer.h>
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+enum class SqlType
+{
+    SELECT,
+    INSERT,
+    UPDATE,
+    DELETE,
+    CREATE,
+    DROP,
+    ALTER,
+    VACUUM,
+    UNKNOWN
+};
+
+struct SqlValue
+{
+    enum class Kind
+    {
+        NULL_VALUE,
+        BOOLEAN,
+        INTEGER,
+        FLOAT,
+        STRING
+    };
+
+    Kind kind = Kind::NULL_VALUE;
+    bool boolValue = false;
+    long long intValue = 0;
+    double floatValue = 0.0;
+    std::string stringValue;
+};
+
+enum class SqlCompareOp
+{
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE
+};
+
+struct SqlExpression
+{
+    enum class Kind
+    {
+        AND,
+        OR,
+        NOT,
+        COMPARE
+    };
+
+    Kind kind = Kind::COMPARE;
+    std::vector<std::shared_ptr<const SqlExpression>> children;
+
+    std::string column;
+    SqlCompareOp op = SqlCompareOp::EQ;
+    SqlValue value;
+};
+
+using SqlExpressionPtr = std::shared_ptr<const SqlExpression>;
+
+struct SqlTableRef
+{
+    std::string database;
+    std::string table;
+};
+
+struct SqlOrderItem
+{
+    std::string column;
+    bool descending = false;
+};
+
+struct SqlAssignment
+{
+    std::string column;
+    SqlValue value;
+};
+
+struct SqlColumnDefinition
+{
+    std::string name;
+    std::string typeName;
+    bool primaryKey = false;
+};
+
+struct SqlSelectStatement
+{
+    SqlTableRef table;
+    std::vector<std::string> columns;
+    SqlExpressionPtr where;
+    std::vector<SqlOrderItem> orderBy;
+    std::optional<std::size_t> limit;
+    std::size_t offset = 0;
+
+    bool selectsAllColumns() const { return columns.size() == 1 && columns.front() == "*"; }
+};
+
+struct SqlInsertStatement
+{
+    SqlTableRef table;
+    std::vector<std::string> columns;
+    std::vector<std::vector<SqlValue>> rows;
+    bool replace = false;
+};
+
+struct SqlUpdateStatement
+{
+    SqlTableRef table;
+    std::vector<SqlAssignment> assignments;
+    SqlExpressionPtr where;
+};
+
+struct SqlDeleteStatement
+{
+    SqlTableRef table;
+    SqlExpressionPtr where;
+};
+
+struct SqlCreateTableStatement
+{
+    SqlTableRef table;
+    std::vector<SqlColumnDefinition> columns;
+    std::vector<std::string> primaryKey;
+    std::string engine;
+};
+
+struct SqlAlterTableStatement
+{
+    SqlTableRef table;
+    std::string engine;
+};
+
+// An empty table name vacuums every table.
+struct SqlVacuumStatement
+{
+    SqlTableRef table;
+};
+
+enum class SqlIndexMethod
+{
+    HASH,
+    BTREE
+};
+
+struct SqlCreateIndexStatement
+{
+    std::string name;
+    SqlTableRef table;
+    std::vector<std::string> columns;
+    SqlIndexMethod method = SqlIndexMethod::HASH;
+};
+
+// Token positions [begin, end) of a clause body in the lexed statement.
+struct SqlTokenRange
+{
+    std::size_t begin = 0;
+    std::size_t end = 0;
+};
+
+// Where the clause bodies sit in the source, for callers that want their
+// text as well as the tree. Absent clauses stay empty.
+struct SqlClauseRanges
+{
+    SqlTokenRange where;
+    SqlTokenRange orderBy;
+    SqlTokenRange limit;
+};
+
+struct SqlStatement
+{
+    SqlType type = SqlType::UNKNOWN;
+    std::variant<
+        std::monostate,
+        SqlSelectStatement,
+        SqlInsertStatement,
+        SqlUpdateStatement,
+        SqlDeleteStatement,
+        SqlCreateTableStatement,
+        SqlCreateIndexStatement,
+        SqlAlterTableStatement,
+        SqlVacuumStatement>
+        node;
+
+    template <typename Node>
+    bool is() const
+    {
+        return std::holds_alternative<Node>(node);
+    }
+
+    template <typename Node>
+    const Node& as() const
+    {
+        return std::get<Node>(node);
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class SqlSyntaxError : public std::runtime_error
+{
+public:
+    explicit SqlSyntaxError(const std::string& message) : std::runtime_error(message) {}
+};
+
+enum class SqlTokenType
+{
+    KEYWORD,
+    IDENTIFIER,
+    NUMBER,
+    STRING,
+    OPERATOR,
+    PUNCTUATION
+};
+
+enum class SqlKeyword
+{
+    NONE,
+    ALTER,
+    AND,
+    AS,
+    ASC,
+    BY,
+    CREATE,
+    DELETE,
+    DESC,
+    DROP,
+    FALSE_LITERAL,
+    FROM,
+    GROUP,
+    HAVING,
+    INDEX,
+    INSERT,
+    INTO,
+    KEY,
+    LIMIT,
+    NOT,
+    NULL_LITERAL,
+    OFFSET,
+    ON,
+    OR,
+    ORDER,
+    PRIMARY,
+    REPLACE,
+    SELECT,
+    SET,
+    TABLE,
+    TRUE_LITERAL,
+    UPDATE,
+    USING,
+    VACUUM,
+    VALUES,
+    WHERE
+};
+
+struct SqlToken
+{
+    SqlTokenType type = SqlTokenType::IDENTIFIER;
+    SqlKeyword keyword = SqlKeyword::NONE;
+    std::string text;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+
+    bool is(SqlKeyword kw) const { return type == SqlTokenType::KEYWORD && keyword == kw; }
+    bool isSymbol(std::string_view symbol) const
+    {
+        return (type == SqlTokenType::PUNCTUATION || type == SqlTokenType::OPERATOR) && text == symbol;
+    }
+};
+
+SqlKeyword LookupSqlKeyword(std::string_view word);
+// Reserved keywords can never stand for a name; the rest can.
+bool IsReservedSqlKeyword(SqlKeyword keyword);
+
+class SqlLexer
+{
+private:
+    std::string normalized;
+    std::string normalizedUpper;
+    std::vector<SqlToken> tokens;
+
+    void tokenize(std::string_view sql);
+
+public:
+    explicit SqlLexer(std::string_view sql) { tokenize(sql); }
+
+    const std::string& getNormalizedSql() const { return normalized; }
+    const std::string& getNormalizedUpperSql() const { return normalizedUpper; }
+    const std::vector<SqlToken>& getTokens() const { return tokens; }
+
+    std::string sliceUpper(std::size_t firstToken, std::size_t endToken) const;
+};
@@ -5,19 +5,10 @@
 #include <unordered_map>
 #include <vector>
 
+#include <core/sql_ast.h>
+#include <core/sql_lexer.h>
 #include <input/inputdata.h>
 
-enum class SqlType
-{
-    SELECT,
-    INSERT,
-    UPDATE,
-    DELETE,
-    CREATE,
-    DROP,
-    UNKNOWN
-};
-
 class SqlParseResult
 {
 protected:
@@ -50,7 +41,9 @@ private:
     std::vector<std::string> groupByColumns;
     std::string havingClause;
     std::string rawQuery;
+    std::string syntaxError;
     SqlType operationType = SqlType::UNKNOWN;
+    std::shared_ptr<const SqlStatement> statement;
 
 public:
     SqlParseResultQuery() = default;
@@ -61,7 +54,9 @@ public:
     void setGroupByColumns(const std::vector<std::string>& group) { groupByColumns = group; }
     void setHavingClause(const std::string& having) { havingClause = having; }
     void setRawQuery(const std::string& raw) { rawQuery = raw; }
+    void setSyntaxError(const std::string& error) { syntaxError = error; }
     void setOperationType(SqlType op) { operationType = op; }
+    void setStatement(std::shared_ptr<const SqlStatement> ast) { statement = std::move(ast); }
 
     std::string getWhereClause() const { return whereClause; }
     std::string getOrderByClause() const { return orderByClause; }
@@ -69,7 +64,10 @@ public:
     std::vector<std::string> getGroupByColumns() const { return groupByColumns; }
     std::string getHavingClause() const { return havingClause; }
     std::string getRawQuery() const { return rawQuery; }
+    // Why the statement has no AST; its fields then come from token scans.
+    std::string getSyntaxError() const { return syntaxError; }
     SqlType getOperationType() const { return operationType; }
+    std::shared_ptr<const SqlStatement> getStatement() const { return statement; }
 };
 
 class SqlParseResultImport : public SqlParseResult
@@ -91,16 +89,26 @@ public:
 class QuerySqlParser : public ISqlParser
 {
 private:
-    std::string preprocessSql(const std::string& sql);
-    std::string extractSqlType(const std::string& processedSql);
-    std::vector<std::string> extractColumns(const std::string& processedSql);
-    void extractTableAndDatabase(const std::string& processedSql, std::string& table, std::string& database);
-    std::string extractWhereClause(const std::string& processedSql);
-    std::vector<std::string> extractGroupByColumns(const std::string& processedSql);
-    std::string extractHavingClause(const std::string& processedSql);
-    std::string extractOrderByClause(const std::string& processedSql);
-    std::string extractLimitClause(const std::string& processedSql);
+    std::string extractSqlType(const SqlLexer& lexer);
+    std::vector<std::string> extractColumns(const SqlLexer& lexer);
+    void extractTableAndDatabase(const SqlLexer& lexer, std::string& table, std::string& database);
+    std::string extractWhereClause(const SqlLexer& lexer);
+    std::vector<std::string> extractGroupByColumns(const SqlLexer& lexer);
+    std::string extractHavingClause(const SqlLexer& lexer);
+    std::string extractOrderByClause(const SqlLexer& lexer);
+    std::string extractLimitClause(const SqlLexer& lexer);
+    void extractFromTokens(const SqlLexer& lexer, SqlParseResultQuery& result);
+    void extractFromStatement(const SqlLexer& lexer, const SqlStatement& statement, const SqlClauseRanges& clauses, SqlParseResultQuery& result);
 
 public:
     std::shared_ptr<SqlParseResult> parse(InputData& input) override;
 };
+
+class SqlAstParser
+{
+public:
+    SqlStatement parse(const std::string& sql) const;
+    SqlStatement parse(const SqlLexer& lexer) const;
+    SqlStatement parse(const SqlLexer& lexer, SqlClauseRanges& clauses) const;
+    SqlExpressionPtr parseExpression(const std::string& text) const;
+};
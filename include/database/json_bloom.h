@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // Bit array probed at k positions per key, derived from two halves of a
+        // stable 64-bit hash so serialized filters stay valid across builds. Keys
+        // are IndexKey strings, so a filter answers for WHERE equality.
+        class BloomFilter
+        {
+        private:
+            std::vector<std::uint64_t> words;
+            std::uint32_t probes = 0;
+
+        public:
+            static constexpr double kDefaultBitsPerKey = 10.0;
+
+            BloomFilter() = default;
+            explicit BloomFilter(std::size_t keys, double bitsPerKey = kDefaultBitsPerKey);
+
+            // The bits per key that give about this false positive rate.
+            static double bitsPerKeyFor(double falsePositiveRate);
+
+            bool empty() const { return words.empty(); }
+            std::size_t bitCount() const { return words.size() * 64; }
+
+            void add(std::string_view key);
+            // False only when the key was never added; an empty filter answers
+            // true for everything.
+            bool mayContain(std::string_view key) const;
+
+            std::string serialize() const;
+            // Nothing for data that is not a serialized filter.
+            static std::optional<BloomFilter> parse(std::string_view data);
+        };
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <database/json_table_cache.h>
+#include <json.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        constexpr std::size_t kBTreePageSize = 4096;
+        constexpr std::uint32_t kNoBTreePage = 0xFFFFFFFFU;
+        constexpr std::uint32_t kNoBTreeText = 0xFFFFFFFFU;
+
+        // Entries are ordered by value and then by row position, so every key is
+        // unique and rows with equal values come back in table order. Numbers sort
+        // before strings, as they do in ORDER BY; a string key holds the id of its
+        // text in the index rather than the text itself.
+        struct BTreeKey
+        {
+            double value = 0.0;
+            std::uint64_t position = 0;
+            std::uint32_t text = kNoBTreeText;
+        };
+
+        struct BTreePageHeader
+        {
+            std::uint32_t leaf = 1;
+            std::uint32_t count = 0;
+            std::uint32_t prev = kNoBTreePage;
+            std::uint32_t next = kNoBTreePage;
+        };
+
+        constexpr std::size_t kBTreeLeafCapacity = (kBTreePageSize - sizeof(BTreePageHeader)) / sizeof(BTreeKey);
+        constexpr std::size_t kBTreeInnerCapacity =
+            (kBTreePageSize - sizeof(BTreePageHeader) - sizeof(std::uint32_t)) / (sizeof(BTreeKey) + sizeof(std::uint32_t));
+
+        struct BTreeLeafPage
+        {
+            BTreePageHeader header;
+            BTreeKey keys[kBTreeLeafCapacity];
+        };
+
+        struct BTreeInnerPage
+        {
+            BTreePageHeader header;
+            BTreeKey keys[kBTreeInnerCapacity];
+            std::uint32_t children[kBTreeInnerCapacity + 1];
+        };
+
+        // Pages are fixed-size blocks addressed by index in one vector, which
+        // keeps a node's keys in a single cache-friendly block. The tree lives
+        // only in memory and is rebuilt from the rows, like the hash indexes.
+        union BTreePage
+        {
+            BTreeLeafPage leaf;
+            BTreeInnerPage inner;
+
+            BTreePage() : leaf() {}
+
+            BTreePageHeader& header() { return leaf.header; }
+            const BTreePageHeader& header() const { return leaf.header; }
+        };
+
+        static_assert(sizeof(BTreePage) == kBTreePageSize, "B+-tree pages must be exactly one page.");
+
+        // A number or a string.
+        struct BTreeBound
+        {
+            nlohmann::json value = 0.0;
+            bool inclusive = true;
+        };
+
+        // Orders two numbers or strings the way the index does: -1, 0 or 1.
+        int CompareBTreeValues(const nlohmann::json& left, const nlohmann::json& right);
+
+        // Ordered index over the numbers and strings of one column, so ISO-8601
+        // datetimes range-scan too. Rows whose value is missing, null or of another
+        // type are left out, matching how range predicates treat them.
+        class BTreeIndex
+        {
+        private:
+            struct Split
+            {
+                BTreeKey separator;
+                std::uint32_t page = kNoBTreePage;
+            };
+
+            struct Probe;
+
+            std::string column;
+            std::vector<BTreePage> pages;
+            std::uint32_t root = 0;
+            std::size_t entries = 0;
+            // Separators may still name a text after its last row is gone, so
+            // texts stay until the index is rebuilt.
+            std::deque<std::string> texts;
+            std::unordered_map<std::string_view, std::uint32_t> textIds;
+
+            static Probe probe(const nlohmann::json& value, std::uint64_t position);
+            Probe probe(const BTreeKey& key) const;
+            std::uint32_t lowerSlot(const BTreeKey* keys, std::uint32_t count, const Probe& key) const;
+            std::uint32_t upperSlot(const BTreeKey* keys, std::uint32_t count, const Probe& key) const;
+            std::optional<BTreeKey> keyFor(const nlohmann::json& row, std::size_t position, bool intern);
+            std::uint32_t newPage(bool leaf);
+            std::uint32_t findLeaf(const Probe& key) const;
+            std::optional<Split> insertInto(std::uint32_t pageId, const BTreeKey& key);
+            void insert(const BTreeKey& key);
+            void erase(const BTreeKey& key);
+
+        public:
+            BTreeIndex(std::string indexedColumn, const TableRows& rows);
+
+            const std::string& getColumn() const { return column; }
+            std::size_t size() const { return entries; }
+            std::size_t getPageCount() const { return pages.size(); }
+            std::size_t getHeight() const;
+
+            // Visits positions in key order until visit returns false.
+            void scan(
+                const std::optional<BTreeBound>& lower,
+                const std::optional<BTreeBound>& upper,
+                bool descending,
+                const std::function<bool(std::size_t)>& visit) const;
+
+            void add(const nlohmann::json& row, std::size_t position);
+            void remove(const nlohmann::json& row, std::size_t position);
+            void removePositions(const std::vector<std::size_t>& deleted);
+        };
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <database/json_predicate.h>
+#include <database/json_storage.h>
+#include <database/json_table_cache.h>
+#include <database/json_zonemap.h>
+#include <json.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        constexpr char kColumnarMagic[8] = {'J', 'D', 'B', 'C', 'O', 'L', '0', '1'};
+        constexpr std::size_t kColumnarBlockRows = 65536;
+
+        // INT64, DOUBLE and BOOL are fixed-width vectors; STRING and JSON (dumped
+        // text, for nested or mixed-type columns) are offset arrays over one
+        // byte blob per block.
+        enum class ColumnType : std::uint8_t
+        {
+            INT64,
+            DOUBLE,
+            BOOL,
+            STRING,
+            JSON
+        };
+
+        struct ColumnChunk
+        {
+            std::uint64_t offset = 0;
+            std::uint64_t length = 0;
+            std::uint32_t nullCount = 0;
+            std::optional<double> min;
+            std::optional<double> max;
+        };
+
+        struct ColumnarBlock
+        {
+            std::uint32_t rows = 0;
+            std::vector<ColumnChunk> chunks;
+        };
+
+        struct ColumnarColumn
+        {
+            std::string name;
+            ColumnType type = ColumnType::JSON;
+        };
+
+        // Layout: magic, then each block's column chunks (8-byte aligned), then a
+        // JSON footer with the column list and per-block directory, then the
+        // footer offset, its length and the magic again. A chunk holds a
+        // presence bitmap, a non-null bitmap and the values, so rows round-trip
+        // exactly, including missing keys and nulls.
+        // The byte patches of an in-place UPDATE. blocks is a copy of the
+        // table's directory, made when a value first falls outside a block's
+        // min/max, with those ranges widened.
+        struct ColumnarUpdatePlan
+        {
+            std::vector<FilePatch> patches;
+            std::vector<ColumnarBlock> blocks;
+        };
+
+        std::string SerializeColumnarTable(const TableRows& rows, std::size_t blockRows = kColumnarBlockRows);
+        bool IsColumnarFile(const std::string& path);
+
+        class ColumnarTable
+        {
+        private:
+            std::string path;
+            const char* data = nullptr;
+            std::size_t size = 0;
+            std::string buffer;
+            std::uint64_t rowCount = 0;
+            std::uint64_t footerOffset = 0;
+            std::uint64_t footerLength = 0;
+            std::size_t blockRows = kColumnarBlockRows;
+            std::vector<ColumnarColumn> columns;
+            std::vector<ColumnarBlock> blocks;
+            std::vector<Zone> zones;
+
+            void buildZones();
+            void unmap();
+            std::optional<std::size_t> findColumn(const std::string& name) const;
+            bool isPresent(std::size_t block, std::size_t column, std::size_t offset) const;
+            nlohmann::json readValue(std::size_t block, std::size_t column, std::size_t offset) const;
+            bool evaluateBlock(const PredicateNode& node, std::size_t block, std::vector<std::uint8_t>& selected) const;
+
+        public:
+            explicit ColumnarTable(std::string filePath);
+            ~ColumnarTable();
+            ColumnarTable(const ColumnarTable&) = delete;
+            ColumnarTable& operator=(const ColumnarTable&) = delete;
+
+            std::size_t getRowCount() const { return static_cast<std::size_t>(rowCount); }
+            const std::vector<ColumnarColumn>& getColumns() const { return columns; }
+            const std::vector<ColumnarBlock>& getBlocks() const { return blocks; }
+
+            // Visits the positions of rows matching the predicate, in order, until
+            // visit returns false, and returns how many blocks it read and how
+            // many the chunk min/max ruled out unread before it stopped.
+            // Comparisons run over the typed column vectors of each block; blocks
+            // where a referenced column is missing or not typed fall back to
+            // evaluating materialized rows.
+            ScanStats scan(const Predicate& predicate, const std::function<bool(std::size_t)>& visit) const;
+            // The same over blocks [firstBlock, endBlock), so callers can split a
+            // scan across threads.
+            ScanStats scan(
+                const Predicate& predicate,
+                const std::function<bool(std::size_t)>& visit,
+                std::size_t firstBlock,
+                std::size_t endBlock) const;
+
+            // An empty column list reads every column.
+            nlohmann::json readRow(std::size_t position, const std::vector<std::string>& wanted = {}) const;
+            TableRows readRows() const;
+
+            // Adds the byte patches that turn row position from before into after
+            // to plan and returns true, or returns false if the change cannot be
+            // made in place: only non-null INT64, DOUBLE and BOOL values may
+            // change, to values of the same type.
+            bool planUpdate(
+                std::size_t position,
+                const nlohmann::json& before,
+                const nlohmann::json& after,
+                ColumnarUpdatePlan& plan) const;
+            // The patches to write, ending with a rewrite of the footer alone when
+            // the plan widened a block's min/max.
+            std::vector<FilePatch> finishUpdate(ColumnarUpdatePlan plan) const;
+        };
+    }
+}
@@ -1,9 +1,22 @@
 #pragma once
 
+#include <core/sql_ast.h>
+#include <database/json_columnar.h>
+#include <database/json_index.h>
+#include <database/json_lsm.h>
+#include <database/json_pager.h>
+#include <database/json_planner.h>
+#include <database/json_storage.h>
+#include <database/json_table_cache.h>
+#include <database/json_thread_pool.h>
+#include <database/json_wal.h>
+#include <database/json_zonemap.h>
 #include <json.hpp>
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -51,12 +64,88 @@ namespace sql
                 std::string passwd = "");
         };
 
+        enum class InsertMode
+        {
+            REWRITE,
+            APPEND
+        };
+
+        enum class JournalMode
+        {
+            DIRECT,
+            WAL
+        };
+
         class Connection : public std::enable_shared_from_this<Connection>
         {
         private:
+            struct IndexedSnapshot
+            {
+                std::weak_ptr<const TableRows> rows;
+                std::shared_ptr<TableIndexes> indexes;
+            };
+
+            struct IndexDefinitionCache
+            {
+                std::optional<FileStamp> stamp;
+                std::vector<IndexDefinition> definitions;
+            };
+
+            struct SchemaCache
+            {
+                std::optional<FileStamp> stamp;
+                std::optional<TableSchema> schema;
+            };
+
+            struct ColumnarCache
+            {
+                std::optional<FileStamp> stamp;
+                std::shared_ptr<const ColumnarTable> table;
+            };
+
+            struct LsmCache
+            {
+                std::optional<FileStamp> stamp;
+                std::shared_ptr<LsmTree> tree;
+            };
+
+            struct PagedCache
+            {
+                std::optional<FileStamp> stamp;
+                std::shared_ptr<PagedTable> table;
+            };
+
             std::string dbPath;
             bool closed = false;
             bool autoCommit = true;
+            InsertMode insertMode = InsertMode::REWRITE;
+            JournalMode journalMode = JournalMode::DIRECT;
+            std::uint64_t deltaCompactionBytes = 4U * 1024U * 1024U;
+            std::size_t scanThreads = 1;
+            JsonLayout tableLayout = JsonLayout::COMPACT;
+            SyncMode syncMode = SyncMode::NONE;
+            double tombstoneCompactionRatio = 0.25;
+            std::uint64_t lsmMemtableBytes = LsmTree::kDefaultMemtableBytes;
+            mutable std::shared_ptr<ThreadPool> scanPool;
+            mutable TableCache tableCache;
+            std::shared_ptr<WriteAheadLog> wal;
+            Transaction transaction;
+            mutable std::map<std::string, IndexDefinitionCache> indexDefinitions;
+            mutable std::map<std::string, SchemaCache> schemas;
+            mutable std::map<std::string, IndexedSnapshot> indexCache;
+            mutable std::map<std::string, ColumnarCache> columnarTables;
+            mutable std::map<std::string, LsmCache> lsmTrees;
+            // Declared before the tables that hold pages in it.
+            mutable BufferPool bufferPool;
+            mutable std::map<std::string, PagedCache> pagedTables;
+            mutable std::map<std::string, std::shared_ptr<KeyMap>> keyMaps;
+
+            std::shared_ptr<TableIndexes> takeTableIndexes(const std::string& tableName, const TableRows& before) const;
+            void rewriteTable(const std::string& tableName, TableFormat format);
+            std::shared_ptr<const TableRows> applyToSnapshot(
+                const std::string& tableName,
+                std::shared_ptr<const TableRows> snapshot,
+                const TableChange& change);
 
         public:
             Connection(const std::string& dbPath, std::string user, std::string passwd);
@@ -66,51 +155,183 @@ namespace sql
             bool isClosed() const { return closed; }
             std::shared_ptr<Statement> createStatement();
             std::shared_ptr<PreparedStatement> prepareStatement(const std::string& sql);
-            void setAutoCommit(bool enabled) { autoCommit = enabled; }
+            void setAutoCommit(bool enabled);
             bool getAutoCommit() const { return autoCommit; }
             void commit();
             void rollback();
+            void checkpoint();
+            WalStats getWalStats() const;
+            std::string getWalFilePath() const;
             bool authenticate(std::string user, std::string passwd);
             bool validateConnection() const;
             bool tableExists(const std::string& tableName) const;
             std::vector<std::string> getColumnNames(const std::string& tableName) const;
+            std::optional<TableSchema> getTableSchema(const std::string& tableName) const;
+            std::vector<std::string> getPrimaryKey(const std::string& tableName) const;
             std::string getTableFilePath(const std::string& tableName) const;
+            std::string getDeltaFilePath(const std::string& tableName) const;
             std::string getDbPath() const { return dbPath; }
             std::vector<nlohmann::json> getTableData(const std::string& tableName) const;
+            std::shared_ptr<const TableRows> getTableSnapshot(const std::string& tableName) const;
+            std::shared_ptr<const TableRows> updateTableSnapshot(const std::string& tableName, TableRows rows);
+            bool shouldStreamTable(const std::string& tableName) const;
+            // True when the table cache holds the table's current rows.
+            bool hasCachedSnapshot(const std::string& tableName) const;
+            std::shared_ptr<const ColumnarTable> getColumnarTable(const std::string& tableName) const;
+            void convertTable(const std::string& tableName, TableFormat format);
+            // Records the columns whose zone map blocks get Bloom filters in the
+            // table's schema and rewrites the table so they are built; every
+            // later rewrite, compactions included, rebuilds them.
+            void setBloomColumns(const std::string& tableName, const std::vector<std::string>& columns, double falsePositiveRate = 0.01);
+            // Rewrites the table without its dead rows and folds in its delta;
+            // returns how many dead rows were dropped.
+            std::uint64_t vacuumTable(const std::string& tableName);
+            // Records a DELETE as tombstones instead of rewriting the table. The
+            // caller holds the direct-write lock and passes its only snapshot.
+            std::shared_ptr<const TableRows> deleteTableRows(
+                const std::string& tableName,
+                std::shared_ptr<const TableRows> snapshot,
+                const TableChange& change);
+            // Writes an UPDATE of fixed-width columnar values over the old bytes
+            // instead of rewriting the table, consuming snapshot; false, leaving
+            // snapshot alone, if any row needs a rewrite.
+            bool patchTableRows(const std::string& tableName, std::shared_ptr<const TableRows>& snapshot, const TableChange& change);
+            // The tree behind an LSM table; null for tables in any other format.
+            std::shared_ptr<LsmTree> getLsmTree(const std::string& tableName) const;
+            // Hands a change to an LSM table's memtable, consuming snapshot, the
+            // rows its positions refer to (null for an INSERT).
+            void applyLsmChange(
+                const std::string& tableName,
+                LsmTree& lsm,
+                std::shared_ptr<const TableRows> snapshot,
+                const TableChange& change);
+            // The open paged table; null for tables in any other format.
+            std::shared_ptr<PagedTable> getPagedTable(const std::string& tableName) const;
+            // Writes a change to the pages it touches instead of rewriting the
+            // table, consuming snapshot (null for an INSERT); false, leaving
+            // snapshot alone, when the table is not paged or a row outgrew its page.
+            bool writePagedRows(const std::string& tableName, std::shared_ptr<const TableRows>& snapshot, const TableChange& change);
+            bool hasUnwrittenChanges(const std::string& tableName) const;
+            // The primary key map of an NDJSON table, kept current by appends
+            // through AppendTableRows; null for tables in any other format or
+            // without a primary key, and while pending changes, a delta or
+            // tombstones move rows away from their positions in the file.
+            std::shared_ptr<KeyMap> getKeyMap(const std::string& tableName) const;
+            // Rows [first, first + count) of an NDJSON table read through its row
+            // offsets; empty when the table has another format or pending changes.
+            std::optional<TableRows> readRowRange(
+                const std::string& tableName,
+                std::size_t first,
+                std::size_t count,
+                const std::vector<std::string>& columns = {}) const;
+            // Rows still reach visit unfiltered; predicate only lets blocks whose
+            // zone map rules it out go unread, counted in stats.
+            bool streamTable(
+                const std::string& tableName,
+                const RowVisitor& visit,
+                const std::vector<std::string>& columns = {},
+                const Predicate& predicate = Predicate(),
+                ScanStats* stats = nullptr) const;
+            std::string getIndexFilePath(const std::string& tableName) const;
+            std::vector<IndexDefinition> getIndexDefinitions(const std::string& tableName) const;
+            std::shared_ptr<const TableIndexes> getTableIndexes(
+                const std::string& tableName,
+                const std::shared_ptr<const TableRows>& rows) const;
+            void deriveTableIndexes(
+                const std::string& tableName,
+                const TableRows& before,
+                const std::shared_ptr<const TableRows>& after,
+                const TableChange& change);
+            void extendTableIndexes(
+                const std::string& tableName,
+                const TableRows& before,
+                const std::shared_ptr<const TableRows>& after) const;
+            size_t stageMutation(const std::string& tableName, const TableMutation& mutation);
+            size_t commitMutation(const std::string& tableName, const TableMutation& mutation);
+            std::unique_lock<std::mutex> lockForDirectWrite(const std::string& tableName);
+            void setTableCacheBudget(std::size_t bytes) { tableCache.setBudget(bytes); }
+            std::size_t getTableCacheBudget() const { return tableCache.getBudget(); }
+            TableCacheStats getTableCacheStats() const { return tableCache.getStats(); }
+            void setInsertMode(InsertMode mode) { insertMode = mode; }
+            InsertMode getInsertMode() const { return insertMode; }
+            void setDeltaCompactionBytes(std::uint64_t bytes) { deltaCompactionBytes = bytes; }
+            std::uint64_t getDeltaCompactionBytes() const { return deltaCompactionBytes; }
+            void setJournalMode(JournalMode mode) { journalMode = mode; }
+            JournalMode getJournalMode() const { return journalMode; }
+            void setTableLayout(JsonLayout layout) { tableLayout = layout; }
+            JsonLayout getTableLayout() const { return tableLayout; }
+            // Durability of direct writes; WAL commits always fsync the log.
+            void setSyncMode(SyncMode mode) { syncMode = mode; }
+            SyncMode getSyncMode() const { return syncMode; }
+            // A table whose tombstones cover more than this fraction of its rows
+            // is rewritten by the delete that crossed it.
+            void setTombstoneCompactionRatio(double ratio) { tombstoneCompactionRatio = ratio; }
+            double getTombstoneCompactionRatio() const { return tombstoneCompactionRatio; }
+            // Memtable log bytes after which an LSM table flushes a level-0 run.
+            void setLsmMemtableBytes(std::uint64_t bytes);
+            std::uint64_t getLsmMemtableBytes() const { return lsmMemtableBytes; }
+            // Page frames shared by this connection's paged tables.
+            void setBufferPoolPages(std::size_t pages) { bufferPool.setCapacity(pages); }
+            BufferPoolStats getBufferPoolStats() const { return bufferPool.getStats(); }
+            // Full scans are split by row range across this many threads; 0 uses
+            // every hardware thread and 1 keeps scans on the calling thread.
+            void setScanThreads(std::size_t threads);
+            std::size_t getScanThreads() const { return scanThreads; }
+            ThreadPool* getScanPool() const;
         };
 
         class Statement
         {
         private:
             std::shared_ptr<Connection> connection;
+            AccessPath lastAccessPath = AccessPath::FULL_SCAN;
+            ScanStats lastScanStats;
 
-            size_t executeUpdateImpl(const std::string& table, const std::string& setClause, const std::string& whereClause);
-            size_t executeDeleteImpl(const std::string& table, const std::string& whereClause);
-            size_t executeInsertWithColumns(const std::string& table, const std::string& columns, const std::string& values);
-            size_t executeInsertWithoutColumns(const std::string& table, const std::string& values);
+            size_t executeUpdateImpl(const ScanPlan& plan, const std::vector<SqlAssignment>& assignments);
+            size_t executeDeleteImpl(const ScanPlan& plan);
+            size_t executeInsertWithColumns(
+                const std::string& table,
+                const std::vector<std::string>& columns,
+                const std::vector<std::vector<SqlValue>>& rows,
+                bool replace);
+            size_t executeInsertWithoutColumns(
+                const std::string& table,
+                const std::vector<std::vector<SqlValue>>& rows,
+                bool replace);
 
-            std::map<std::string, std::string> parseSetClause(const std::string& setClause);
-            std::vector<std::string> parseList(const std::string& list);
             nlohmann::json createRowFromValues(
                 const std::vector<std::string>& colNames,
-                const std::vector<std::string>& colValues);
-            nlohmann::json readTableData(const std::string& tablePath);
-            void writeTableData(const std::string& tablePath, const nlohmann::json& tableData);
-            bool evaluateCondition(const nlohmann::json& row, const std::string& condition);
-            std::vector<std::string> splitValueGroups(const std::string& valuesStr);
-            std::vector<std::string> splitValueGroup(const std::string& valueGroup);
-            nlohmann::json parseValue(const std::string& valueStr);
-            std::string trim(const std::string& s);
-            std::vector<std::string> split(const std::string& s, char delimiter);
-            std::string extractTableName(const std::string& tableSpec);
+                const std::vector<SqlValue>& colValues);
+            TableRows readTableData(const std::string& table);
+            std::shared_ptr<const TableRows> writeTableData(const std::string& table, TableRows tableData);
+            void appendTableData(const std::string& table, const TableRows& rows);
+            size_t applyMutation(const std::string& table, const TableMutation& mutation);
+            // An autocommit UPDATE or DELETE of a paged table whose rows are not
+            // cached, matched by a scan that pins one page at a time; empty when
+            // the change has to go through the table's snapshot instead.
+            std::optional<size_t> applyPagedMutation(
+                const ScanPlan& plan,
+                TableChange::Kind kind,
+                const std::map<std::string, nlohmann::json>& updates = {});
+            size_t applyInsert(const std::string& table, TableRows rows, bool replace);
 
         public:
             explicit Statement(std::shared_ptr<Connection> conn) : connection(std::move(conn)) {}
 
             std::shared_ptr<ResultSet> executeQuery(const std::string& sql);
+            std::shared_ptr<ResultSet> executeQuery(const SqlSelectStatement& select);
             size_t executeUpdate(const std::string& sql);
+            size_t executeUpdate(const SqlStatement& statement);
             bool executeCreate(const std::string& sql);
+            bool executeCreate(const SqlCreateTableStatement& create);
+            bool executeCreateIndex(const SqlCreateIndexStatement& create);
+            bool executeAlter(const SqlAlterTableStatement& alter);
+            size_t executeVacuum(const SqlVacuumStatement& vacuum);
             bool execute(const std::string& sql);
+            bool execute(const SqlStatement& statement);
+            AccessPath getLastAccessPath() const { return lastAccessPath; }
+            // Blocks the last query read and skipped by their zone maps.
+            ScanStats getLastScanStats() const { return lastScanStats; }
         };
 
         class PreparedStatement
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <database/json_btree.h>
+#include <database/json_table_cache.h>
+#include <database/json_wal.h>
+#include <json.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        enum class IndexType
+        {
+            HASH,
+            BTREE
+        };
+
+        struct IndexDefinition
+        {
+            std::string name;
+            std::string column;
+            IndexType type = IndexType::HASH;
+
+            bool operator==(const IndexDefinition& other) const
+            {
+                return name == other.name && column == other.column && type == other.type;
+            }
+        };
+
+        std::string IndexFilePath(const std::string& dbPath, const std::string& tableName);
+        std::vector<IndexDefinition> ReadIndexDefinitions(const std::string& path);
+        void WriteIndexDefinitions(const std::string& path, const std::vector<IndexDefinition>& definitions, bool sync = false);
+
+        std::string IndexKey(const nlohmann::json& value);
+
+        class HashIndex
+        {
+        private:
+            IndexDefinition definition;
+            std::unordered_map<std::string, std::vector<std::size_t>> buckets;
+
+        public:
+            explicit HashIndex(IndexDefinition def) : definition(std::move(def)) {}
+
+            const IndexDefinition& getDefinition() const { return definition; }
+            const std::vector<std::size_t>* lookup(const nlohmann::json& value) const;
+
+            void add(const nlohmann::json& row, std::size_t position);
+            void remove(const nlohmann::json& row, std::size_t position);
+            void removePositions(const std::vector<std::size_t>& deleted);
+        };
+
+        // Unique map from primary key to row position. Keys are built with
+        // IndexKey, so they compare the way WHERE equality does.
+        class PrimaryKeyIndex
+        {
+        private:
+            std::vector<std::string> columns;
+            std::unordered_map<std::string, std::size_t> positions;
+
+        public:
+            PrimaryKeyIndex(std::vector<std::string> keyColumns, const TableRows& rows);
+
+            const std::vector<std::string>& getColumns() const { return columns; }
+            std::size_t size() const { return positions.size(); }
+            std::optional<std::string> keyOf(const nlohmann::json& row) const;
+            std::optional<std::size_t> lookup(const std::string& key) const;
+
+            void add(const nlohmann::json& row, std::size_t position);
+            void remove(const nlohmann::json& row, std::size_t position);
+            void removePositions(const std::vector<std::size_t>& deleted);
+        };
+
+        class TableIndexes
+        {
+        private:
+            std::vector<IndexDefinition> definitions;
+            std::vector<std::string> primaryKeyColumns;
+            std::optional<PrimaryKeyIndex> primaryKey;
+            std::vector<HashIndex> indexes;
+            std::vector<BTreeIndex> orderedIndexes;
+
+        public:
+            TableIndexes(const std::vector<IndexDefinition>& defs, const std::vector<std::string>& keyColumns, const TableRows& rows);
+
+            bool empty() const { return !primaryKey.has_value() && indexes.empty() && orderedIndexes.empty(); }
+            bool hasDefinitions(const std::vector<IndexDefinition>& defs, const std::vector<std::string>& keyColumns) const
+            {
+                return definitions == defs && primaryKeyColumns == keyColumns;
+            }
+            const PrimaryKeyIndex* getPrimaryKey() const { return primaryKey.has_value() ? &*primaryKey : nullptr; }
+            const HashIndex* find(const std::string& column) const;
+            const BTreeIndex* findOrdered(const std::string& column) const;
+            void apply(const TableRows& before, const TableChange& change);
+            void extend(const TableRows& rows, std::size_t from);
+        };
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <database/json_bloom.h>
+#include <database/json_index.h>
+#include <database/json_table_cache.h>
+#include <database/json_wal.h>
+#include <json.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        constexpr char kLsmMagic[8] = {'J', 'D', 'B', 'L', 'S', 'M', '0', '1'};
+
+        // <table>.lsm, the directory holding the runs and memtable logs of the
+        // LSM table at tablePath.
+        std::string LsmDirectoryPath(const std::string& tablePath);
+        bool IsLsmManifest(const std::string& path);
+
+        // An immutable sorted run: NDJSON records {"k": key, "v": row}, or just
+        // {"k": key} for a delete, in key order, with a Bloom filter over its
+        // keys in a .bloom sidecar. The files go when the last holder of an
+        // obsolete run lets go, so readers mid-merge keep them.
+        struct LsmRun
+        {
+            std::uint64_t id = 0;
+            std::uint64_t rows = 0;
+            std::uint64_t bytes = 0;
+            std::string minKey;
+            std::string maxKey;
+            std::string path;
+            BloomFilter bloom;
+            bool obsolete = false;
+
+            ~LsmRun();
+        };
+
+        struct LsmStats
+        {
+            std::uint64_t flushes = 0;
+            std::uint64_t compactions = 0;
+            std::uint64_t lookups = 0;
+            std::uint64_t runReads = 0;
+            std::uint64_t bloomSkips = 0;
+            std::size_t memtableRows = 0;
+            std::vector<std::size_t> runsPerLevel;
+        };
+
+        // Log-structured table. The table file is a manifest (the magic, then
+        // JSON naming the key columns, the runs of each level and the current
+        // memtable log). Writes append key/row records to that log and a sorted
+        // in-memory memtable; once the log passes the memtable budget the
+        // memtable is written out as a level-0 run and a new log started. A
+        // background thread merges level 0 into level 1 once it holds
+        // kLevel0Runs runs, and level n into n + 1 once it outgrows
+        // kLevelFanout^n memtables, dropping deletes at the bottom level.
+        //
+        // Rows are keyed by their primary key when the schema has one, else by
+        // insertion order, and read back in the order of those encoded keys. One
+        // tree per table file is shared by every connection in the process.
+        class LsmTree
+        {
+        private:
+            using Memtable = std::map<std::string, std::optional<nlohmann::json>>;
+
+            std::string tablePath;
+            std::string directory;
+
+            mutable std::mutex mutex;
+            std::condition_variable wakeup;
+            std::thread compactor;
+            bool stopping = false;
+            bool compacting = false;
+
+            std::optional<FileStamp> manifestStamp;
+            std::optional<FileStamp> logStamp;
+            std::uint64_t epoch = 0;
+            std::vector<std::string> keyColumns;
+            std::optional<PrimaryKeyIndex> keyIndex;
+            std::uint64_t nextSeq = 0;
+            std::uint64_t nextRunId = 1;
+            std::uint64_t logId = 0;
+            Memtable memtable;
+            std::uint64_t memtableBudget = kDefaultMemtableBytes;
+            bool syncWrites = false;
+            std::vector<std::vector<std::shared_ptr<LsmRun>>> levels;
+
+            // Rows in key order, built on first read and kept current by writes.
+            std::shared_ptr<const TableRows> view;
+            std::vector<std::string> viewKeys;
+            LsmStats stats;
+
+            explicit LsmTree(std::string path);
+
+            std::string logPath() const;
+            std::string keyOf(const nlohmann::json& row);
+            void refresh();
+            void load();
+            void writeManifest(bool sync);
+            void flushMemtable();
+            void applyToView(const Memtable& edits);
+            void buildView();
+            bool compactionDue() const;
+            bool compactOnce(std::unique_lock<std::mutex>& lock);
+            void compactionLoop();
+
+        public:
+            static constexpr std::uint64_t kDefaultMemtableBytes = 4U * 1024U * 1024U;
+            static constexpr std::size_t kLevel0Runs = 4;
+            static constexpr std::uint64_t kLevelFanout = 10;
+
+            static std::shared_ptr<LsmTree> open(const std::string& tablePath);
+            // Called before an LSM table file is replaced by another format: stops
+            // compactions from installing runs and removes the run directory.
+            static void retire(const std::string& tablePath);
+            ~LsmTree();
+
+            LsmTree(const LsmTree&) = delete;
+            LsmTree& operator=(const LsmTree&) = delete;
+
+            void setMemtableBytes(std::uint64_t bytes);
+
+            // Replaces the whole table with rows, as a single bottom-level run.
+            void reset(const TableRows& rows, const std::vector<std::string>& primaryKey, bool sync);
+            std::shared_ptr<const TableRows> snapshot();
+            // The snapshot if one has been built, without building it.
+            std::shared_ptr<const TableRows> peekSnapshot();
+            // Positions in change refer to snapshot(). The records reach the log
+            // before the memtable and snapshot see them.
+            void apply(const TableChange& change, bool sync);
+
+            // Point lookups by IndexKey-built primary key; without a snapshot
+            // they probe the memtable, then runs from newest to oldest, skipping
+            // those whose key range or Bloom filter rules the key out.
+            std::optional<nlohmann::json> get(const std::string& key);
+
+            // Merges until no level is over its budget.
+            void compact();
+            LsmStats getStats() const;
+        };
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <database/json_storage.h>
+#include <database/json_wal.h>
+#include <json.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        constexpr char kPagedMagic[8] = {'J', 'D', 'B', 'P', 'A', 'G', 'E', '1'};
+        constexpr std::uint32_t kDefaultPageBytes = 8192;
+
+        bool IsPagedFile(const std::string& path);
+        // Page 0 is the file header; rows fill the slotted pages after it in
+        // order. Rows longer than a page's payload cannot be stored and throw.
+        std::string SerializePagedTable(const TableRows& rows, std::uint32_t pageBytes = kDefaultPageBytes);
+
+        struct BufferPoolStats
+        {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+            std::size_t residentPages = 0;
+            std::size_t capacityPages = 0;
+        };
+
+        // Fixed number of page frames shared by every paged table of a
+        // connection, replaced by the clock (second chance) policy. Pinned and
+        // dirty frames are never evicted; a statement that dirties more pages
+        // than fit grows the pool until its pages are written, after which it
+        // shrinks back.
+        class BufferPool
+        {
+        private:
+            struct Frame
+            {
+                std::uint64_t file = 0;
+                std::uint64_t page = 0;
+                std::string data;
+                std::uint32_t pins = 0;
+                bool dirty = false;
+                bool referenced = false;
+            };
+
+            mutable std::mutex mutex;
+            std::size_t capacity;
+            std::vector<std::unique_ptr<Frame>> frames;
+            std::map<std::pair<std::uint64_t, std::uint64_t>, Frame*> resident;
+            std::size_t hand = 0;
+            BufferPoolStats stats;
+
+            Frame* victim();
+            void trim();
+
+        public:
+            // 32 MiB of 8 KiB pages.
+            static constexpr std::size_t kDefaultPages = 4096;
+
+            class PageRef
+            {
+            private:
+                BufferPool* pool = nullptr;
+                Frame* frame = nullptr;
+
+            public:
+                PageRef(BufferPool* owner, Frame* pinned) : pool(owner), frame(pinned) {}
+                PageRef(PageRef&& other) noexcept;
+                PageRef& operator=(PageRef&& other) noexcept;
+                PageRef(const PageRef&) = delete;
+                PageRef& operator=(const PageRef&) = delete;
+                ~PageRef();
+
+                const std::string& data() const { return frame->data; }
+                // Marks the page dirty; it stays in the pool until written.
+                std::string& mutableData();
+            };
+
+            explicit BufferPool(std::size_t pages = kDefaultPages);
+
+            void setCapacity(std::size_t pages);
+            // Pins the page, reading it with load on a miss.
+            PageRef fetch(std::uint64_t file, std::uint64_t page, std::size_t pageBytes, const std::function<void(std::string&)>& load);
+            // The dirty pages of file in page order, now clean.
+            std::vector<std::pair<std::uint64_t, std::string>> takeDirty(std::uint64_t file);
+            // Drops every page of file, dirty or not.
+            void discard(std::uint64_t file);
+            BufferPoolStats getStats() const;
+        };
+
+        // A paged table file read and written a page at a time through a buffer
+        // pool. Data pages hold a slot array growing up from an 8-byte header and
+        // row records, compact JSON, growing down from the end; deleting a row
+        // empties its slot so later rows keep their order. Changes reach the file
+        // through the patch journal, so a crash leaves the old pages or the new.
+        class PagedTable
+        {
+        private:
+            std::string path;
+            std::uint64_t fileId;
+            BufferPool& pool;
+            std::uint64_t inode = 0;
+            std::uint32_t pageBytes = kDefaultPageBytes;
+            std::uint64_t pageCount = 1;
+            std::uint64_t rowCount = 0;
+            std::vector<FilePatch> journal;
+            std::mutex fileMutex;
+            std::ifstream file;
+            // Live rows per data page, read from the page headers on first use.
+            std::optional<std::vector<std::uint64_t>> directory;
+
+            void readBytes(std::uint64_t offset, char* out, std::size_t length);
+            BufferPool::PageRef fetchPage(std::uint64_t page);
+            void loadDirectory();
+            bool applyChange(const TableChange& change);
+
+        public:
+            PagedTable(std::string filePath, BufferPool& bufferPool);
+            ~PagedTable();
+
+            PagedTable(const PagedTable&) = delete;
+            PagedTable& operator=(const PagedTable&) = delete;
+
+            std::uint32_t getPageBytes() const { return pageBytes; }
+            std::uint64_t getPageCount() const { return pageCount; }
+            std::uint64_t getRowCount() const { return rowCount; }
+
+            // Rows in order, one pinned page at a time; false when visit stopped.
+            bool scan(const RowVisitor& visit, const std::vector<std::string>& columns = {});
+            TableRows readRows();
+            // Rewrites only the pages the change touches. False, with nothing
+            // written, when a row no longer fits in its page.
+            bool apply(const TableChange& change, bool sync);
+        };
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <core/sql_ast.h>
+#include <database/json_btree.h>
+#include <database/json_predicate.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        class Connection;
+
+        enum class AccessPath
+        {
+            FULL_SCAN,
+            PRIMARY_KEY,
+            HASH_INDEX,
+            BTREE_RANGE
+        };
+
+        struct ScanPlan
+        {
+            std::string table;
+            AccessPath accessPath = AccessPath::FULL_SCAN;
+            Predicate predicate;
+            std::string indexColumn;
+            nlohmann::json indexKey;
+            std::optional<BTreeBound> lowerBound;
+            std::optional<BTreeBound> upperBound;
+        };
+
+        struct QueryPlan
+        {
+            ScanPlan scan;
+            std::vector<std::string> projection;
+            std::vector<SqlOrderItem> orderBy;
+            std::optional<std::size_t> limit;
+            std::size_t offset = 0;
+            bool orderedByIndex = false;
+        };
+
+        class Planner
+        {
+        private:
+            std::shared_ptr<Connection> connection;
+
+        public:
+            explicit Planner(std::shared_ptr<Connection> conn) : connection(std::move(conn)) {}
+
+            ScanPlan planScan(const SqlTableRef& table, const SqlExpressionPtr& where) const;
+            QueryPlan planSelect(const SqlSelectStatement& select) const;
+        };
+    }
+}
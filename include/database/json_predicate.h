@@ -0,0 +1,58 @@
+#pragma once
+
+#include <core/sql_ast.h>
+#include <json.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        using CompareOp = SqlCompareOp;
+
+        struct PredicateNode
+        {
+            enum class Kind
+            {
+                AND,
+                OR,
+                NOT,
+                COMPARE
+            };
+
+            Kind kind = Kind::COMPARE;
+            std::vector<std::unique_ptr<PredicateNode>> children;
+
+            std::string column;
+            CompareOp op = CompareOp::EQ;
+            nlohmann::json literal;
+            double numericLiteral = 0.0;
+        };
+
+        class Predicate
+        {
+        private:
+            std::shared_ptr<const PredicateNode> root;
+
+            static bool evaluate(const PredicateNode& node, const nlohmann::json& row);
+
+        public:
+            Predicate() = default;
+            explicit Predicate(std::shared_ptr<const PredicateNode> node) : root(std::move(node)) {}
+
+            static Predicate compile(const std::string& whereClause);
+            static Predicate compile(const SqlExpressionPtr& expression);
+
+            bool empty() const { return root == nullptr; }
+            bool matches(const nlohmann::json& row) const { return root == nullptr || evaluate(*root, row); }
+            const PredicateNode* getRoot() const { return root.get(); }
+            std::vector<std::string> getReferencedColumns() const;
+        };
+
+        nlohmann::json SqlValueToJson(const SqlValue& value);
+        bool CompareJsonValues(const nlohmann::json& left, CompareOp op, const nlohmann::json& right);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <json.hpp>
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // Stage one classifies 64-byte blocks into quote, backslash, operator and
+        // whitespace bitmaps with the widest instructions the CPU has; AVX2 is
+        // only built with GCC and Clang, so MSVC builds stop at SSE2.
+        enum class JsonKernel
+        {
+            SCALAR,
+            SSE2,
+            AVX2
+        };
+
+        JsonKernel BestJsonKernel();
+        std::vector<JsonKernel> AvailableJsonKernels();
+
+        // Two-stage parse: a bitmap pass finds every structural character and
+        // scalar start outside strings, then values are built by walking those
+        // positions. Accepts exactly what nlohmann::json::parse accepts and builds
+        // the same values, but returns nothing instead of throwing, and also for
+        // the rare inputs it leaves to nlohmann (numbers that underflow, nesting
+        // deeper than 512), so callers rerun nlohmann on failure.
+        std::optional<nlohmann::json> FastParseJson(std::string_view text, JsonKernel kernel = BestJsonKernel());
+    }
+}
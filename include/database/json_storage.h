@@ -0,0 +1,225 @@
+#pragma once
+
+#include <database/json_table_cache.h>
+#include <database/json_thread_pool.h>
+#include <json.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::string TableFilePath(const std::string& dbPath, const std::string& tableName);
+        std::string DeltaFilePath(const std::string& dbPath, const std::string& tableName);
+        std::string SchemaFilePath(const std::string& dbPath, const std::string& tableName);
+        std::string RowOffsetsFilePath(const std::string& dbPath, const std::string& tableName);
+        std::string TombstoneFilePath(const std::string& dbPath, const std::string& tableName);
+        // <table>.keys, the primary key map of an NDJSON table; see KeyMap.
+        std::string KeyMapFilePath(const std::string& dbPath, const std::string& tableName);
+        // <table>.zones, the per-block column statistics; see ZoneMap.
+        std::string ZoneMapFilePath(const std::string& dbPath, const std::string& tableName);
+        // <table>.patch, next to the table file at tablePath.
+        std::string PatchJournalFilePath(const std::string& tablePath);
+
+        // NDJSON tables hold one row per line, like delta segments, so appends
+        // never rewrite earlier rows. LSM tables are a manifest over sorted runs
+        // in a <table>.lsm directory; see LsmTree. PAGED tables are slotted pages
+        // read and written through a buffer pool; see PagedTable.
+        enum class TableFormat
+        {
+            JSON,
+            COLUMNAR,
+            NDJSON,
+            LSM,
+            PAGED
+        };
+
+        // Layout of JSON array table files. Compact puts each row on one line;
+        // pretty indents rows for people reading the files.
+        enum class JsonLayout
+        {
+            COMPACT,
+            PRETTY
+        };
+
+        // When writes reach the disk. NONE leaves flushing to the OS. COMMIT
+        // fsyncs every table file and definition sidecar a statement changes,
+        // and their directory, before the statement returns. ALWAYS also fsyncs
+        // derived files, such as row offsets, that are otherwise rebuilt after a
+        // crash.
+        enum class SyncMode
+        {
+            NONE,
+            COMMIT,
+            ALWAYS
+        };
+
+        struct TableSchema
+        {
+            std::vector<std::string> columns{};
+            std::vector<std::string> primaryKey{};
+            // Columns whose values every zone map block keeps in a Bloom filter
+            // sized for this false positive rate.
+            std::vector<std::string> bloomColumns{};
+            double bloomFalsePositiveRate = 0.01;
+        };
+
+        // Schema sidecars are {"columns": [...], "primaryKey": [...]}, plus
+        // "bloomColumns" and "bloomFalsePositiveRate" for tables that opted in;
+        // the older plain column array is still accepted.
+        TableSchema ReadTableSchema(const std::string& path);
+        void WriteTableSchema(const std::string& path, const TableSchema& schema, bool sync = false);
+
+        using RowVisitor = std::function<bool(nlohmann::json& row)>;
+
+        // A table file's format is recognized from its contents, so a table keeps
+        // its path whichever format it is stored in.
+        TableFormat DetectTableFormat(const std::string& path);
+        // With a pool, large JSON and NDJSON files are parsed in chunks of rows
+        // on its threads; rows come back in file order either way.
+        TableRows ReadTableFile(const std::string& path, ThreadPool* pool = nullptr);
+        std::string SerializeTable(const TableRows& rows, TableFormat format, JsonLayout layout = JsonLayout::COMPACT);
+        // Every format is written to a temp file and renamed over the table, so
+        // readers see the old file or the new one, never a partial write. JSON
+        // array tables are streamed through one reusable buffer rather than
+        // serialized whole first. Compact JSON array and NDJSON tables get a
+        // fresh zone map; other formats lose theirs.
+        void WriteTableFile(
+            const std::string& dbPath,
+            const std::string& tableName,
+            const TableRows& rows,
+            TableFormat format,
+            SyncMode sync,
+            JsonLayout layout = JsonLayout::COMPACT);
+
+        // Where each row of an NDJSON table starts, plus the end of the last
+        // complete row. The sidecar is derived data: it records the stamp of the
+        // table file it describes and is rebuilt whenever that no longer matches.
+        struct RowOffsets
+        {
+            FileStamp stamp;
+            std::uint64_t end = 0;
+            std::vector<std::uint64_t> starts;
+        };
+
+        // The primary key of each row of an NDJSON table, built the way
+        // PrimaryKeyIndex builds it, mapped to the row's position in the file.
+        // Like RowOffsets, the sidecar records the stamp of the table file it
+        // describes: rewrites replace it, appends extend it in place and any
+        // other change makes the next load rebuild it from the key columns.
+        struct KeyMap
+        {
+            FileStamp stamp;
+            std::vector<std::string> columns;
+            std::uint64_t rows = 0;
+            std::unordered_map<std::string, std::uint64_t> positions;
+        };
+
+        // Rows deleted without rewriting the table, as a bitmap over row ids: the
+        // rows of the table file in order, then those of its delta. The sidecar
+        // names the inode of the table file it belongs to, so it stops applying
+        // once that file is replaced; full rewrites also remove it.
+        struct Tombstones
+        {
+            std::uint64_t inode = 0;
+            std::uint64_t deadRows = 0;
+            std::vector<std::uint64_t> bits;
+
+            bool isDead(std::uint64_t row) const;
+            // Marks the rows at these ascending positions among the live rows.
+            void markLiveRows(const std::vector<std::size_t>& positions);
+            // Drops the dead rows from rows read from the table and delta files.
+            void removeDeadRows(TableRows& rows) const;
+        };
+
+        // Empty when the table has no sidecar or it belongs to an older file.
+        Tombstones LoadTombstones(const std::string& dbPath, const std::string& tableName);
+        void WriteTombstones(const std::string& dbPath, const std::string& tableName, const Tombstones& tombstones, bool sync);
+
+        // Bytes overwritten in place at a file offset.
+        struct FilePatch
+        {
+            std::uint64_t offset = 0;
+            std::string bytes;
+        };
+
+        // In-place updates are logged to a journal naming the table file's inode
+        // before they touch the file, and the journal is removed once they have
+        // been written. A journal left behind by a crash is applied on top of the
+        // file by readers and folded into it by the next patch; a rewrite of the
+        // table makes it stale.
+        std::vector<FilePatch> LoadPatchJournal(const std::string& tablePath);
+        void PatchFileInPlace(const std::string& tablePath, std::uint64_t inode, std::vector<FilePatch> patches, bool sync);
+
+        RowOffsets LoadRowOffsets(const std::string& dbPath, const std::string& tableName);
+        // Byte range holding rows [first, first + count) of an NDJSON table. Only
+        // the two entries needed are read from a current sidecar.
+        std::pair<std::uint64_t, std::uint64_t> FindRowRange(
+            const std::string& dbPath,
+            const std::string& tableName,
+            std::uint64_t first,
+            std::uint64_t count);
+        void WriteRowOffsets(const std::string& path, const RowOffsets& offsets, bool sync = false);
+        KeyMap BuildKeyMap(const TableRows& rows, const std::vector<std::string>& columns, const FileStamp& stamp);
+        KeyMap LoadKeyMap(const std::string& dbPath, const std::string& tableName, const std::vector<std::string>& columns);
+        void WriteKeyMap(const std::string& path, const KeyMap& keyMap, bool sync = false);
+        // The row offsets and key map sidecars, and keyMap when it described the
+        // file before the append, take in the new rows too.
+        void AppendTableRows(
+            const std::string& dbPath,
+            const std::string& tableName,
+            const TableRows& rows,
+            SyncMode sync = SyncMode::NONE,
+            KeyMap* keyMap = nullptr);
+
+        TableRows ReadJsonArrayFile(const std::string& path);
+        // Finds the top-level elements with a structural pre-pass, then parses
+        // them in chunks on the pool. A file that is not one well-formed array
+        // is handed to ReadJsonArrayFile so it fails the same way.
+        TableRows ReadJsonArrayFileParallel(const std::string& path, ThreadPool& pool);
+        // Parses a table file one row at a time; returns false when visit stopped
+        // the scan early. A non-empty column list limits rows to those fields.
+        bool StreamJsonArrayFile(const std::string& path, const RowVisitor& visit, const std::vector<std::string>& columns = {});
+        // The rows in bytes [begin, end) of a compact JSON array table, which
+        // holds one row per line; the range must start and end between rows.
+        bool StreamJsonArrayRows(
+            const std::string& path,
+            std::uint64_t begin,
+            std::uint64_t end,
+            const RowVisitor& visit,
+            const std::vector<std::string>& columns = {});
+        TableRows LoadTableRows(const std::string& dbPath, const std::string& tableName);
+
+        // Line-delimited rows, used by delta segments and NDJSON tables. Reads
+        // return the offset after the last complete line consumed.
+        std::uint64_t ReadJsonLines(const std::string& path, std::uint64_t offset, TableRows& rows);
+        std::uint64_t StreamJsonLines(
+            const std::string& path,
+            std::uint64_t offset,
+            const RowVisitor& visit,
+            const std::vector<std::string>& columns = {},
+            std::optional<std::uint64_t> end = std::nullopt);
+        // One row of JSON text held in memory, such as a page record; path only
+        // names the source in errors. False when visit stopped.
+        bool VisitJsonRow(std::string_view text, const std::string& path, const RowVisitor& visit, const std::vector<std::string>& columns = {});
+        std::string SerializeJsonLines(const TableRows& rows, std::uint64_t base = 0, std::vector<std::uint64_t>* starts = nullptr);
+        std::uint64_t AppendJsonLines(
+            const std::string& path,
+            const TableRows& rows,
+            std::vector<std::uint64_t>* starts = nullptr,
+            bool sync = false);
+        std::string SerializeTableRows(const TableRows& rows, JsonLayout layout = JsonLayout::COMPACT);
+
+        void AppendToFile(const std::string& path, const std::string& data, bool sync);
+        void WriteFileAtomically(const std::string& path, const std::string& data, bool sync);
+        void SyncDirectory(const std::string& path);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <json.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        using TableRows = std::vector<nlohmann::json>;
+
+        struct FileStamp
+        {
+            std::int64_t mtimeNs = 0;
+            std::uint64_t size = 0;
+            std::uint64_t inode = 0;
+
+            bool operator==(const FileStamp& other) const
+            {
+                return mtimeNs == other.mtimeNs && size == other.size && inode == other.inode;
+            }
+            bool operator!=(const FileStamp& other) const { return !(*this == other); }
+        };
+
+        struct TableStamp
+        {
+            FileStamp data;
+            std::optional<FileStamp> delta;
+            std::optional<FileStamp> tombstones;
+
+            bool operator==(const TableStamp& other) const
+            {
+                return data == other.data && delta == other.delta && tombstones == other.tombstones;
+            }
+            bool operator!=(const TableStamp& other) const { return !(*this == other); }
+        };
+
+        struct CachedTable
+        {
+            TableStamp stamp;
+            std::shared_ptr<const TableRows> rows;
+            std::uint64_t deltaOffset = 0;
+        };
+
+        std::optional<FileStamp> StatFile(const std::string& path);
+        std::size_t EstimateJsonBytes(const nlohmann::json& value);
+
+        struct TableCacheStats
+        {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+            std::size_t entries = 0;
+            std::size_t bytes = 0;
+        };
+
+        class TableCache
+        {
+        private:
+            struct Entry
+            {
+                CachedTable table;
+                std::size_t bytes = 0;
+                std::list<std::string>::iterator lruPosition;
+            };
+
+            mutable std::mutex mutex;
+            std::size_t budgetBytes;
+            std::size_t usedBytes = 0;
+            std::list<std::string> lru;
+            std::unordered_map<std::string, Entry> entries;
+            TableCacheStats stats;
+
+            void eraseLocked(std::unordered_map<std::string, Entry>::iterator it);
+            void evictLocked();
+
+        public:
+            static constexpr std::size_t kDefaultBudgetBytes = 256U * 1024U * 1024U;
+
+            explicit TableCache(std::size_t budget = kDefaultBudgetBytes) : budgetBytes(budget) {}
+
+            std::shared_ptr<const TableRows> lookup(const std::string& path, const TableStamp& stamp);
+            std::optional<CachedTable> peek(const std::string& path) const;
+            void store(const std::string& path, CachedTable table);
+            void invalidate(const std::string& path);
+            void clear();
+
+            void setBudget(std::size_t budget);
+            std::size_t getBudget() const;
+            TableCacheStats getStats() const;
+        };
+    }
+}
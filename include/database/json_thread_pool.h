@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // 0 asks for one thread per hardware thread.
+        std::size_t ResolveThreadCount(std::size_t requested);
+
+        // Fixed set of workers that a query splits its scan across. The calling
+        // thread takes tasks too, so a pool of N threads starts N - 1 workers.
+        class ThreadPool
+        {
+        private:
+            std::vector<std::thread> workers;
+            std::mutex runMutex;
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable done;
+            const std::function<void(std::size_t)>* task = nullptr;
+            std::size_t taskCount = 0;
+            std::size_t nextTask = 0;
+            std::size_t finishedTasks = 0;
+            std::exception_ptr failure;
+            bool stopping = false;
+
+            void workerLoop();
+            void drain(std::unique_lock<std::mutex>& lock);
+
+        public:
+            explicit ThreadPool(std::size_t threads);
+            ~ThreadPool();
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            std::size_t size() const { return workers.size() + 1; }
+
+            // Runs work(0) .. work(count - 1) and returns once all of them have
+            // finished, rethrowing the first exception any of them threw.
+            void run(std::size_t count, const std::function<void(std::size_t)>& work);
+        };
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <database/json_table_cache.h>
+#include <json.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // UPSERT overwrites the rows at positions with the leading entries of rows
+        // and appends whatever is left.
+        struct TableChange
+        {
+            enum class Kind
+            {
+                INSERT,
+                UPDATE,
+                DELETE,
+                UPSERT
+            };
+
+            Kind kind = Kind::INSERT;
+            std::string table;
+            std::vector<std::size_t> positions;
+            TableRows rows;
+        };
+
+        class TableIndexes;
+
+        void ApplyTableChange(TableRows& rows, const TableChange& change);
+        std::size_t CountAffectedRows(const TableChange& change);
+
+        using TableMutation = std::function<TableChange(const TableRows&, const TableIndexes*)>;
+        using TableLoader = std::function<std::shared_ptr<const TableRows>(const std::string&)>;
+
+        struct Transaction
+        {
+            std::map<std::string, std::shared_ptr<TableRows>> tables;
+            std::map<std::string, std::uint64_t> baseVersions;
+            std::vector<TableChange> changes;
+
+            bool empty() const { return changes.empty(); }
+        };
+
+        struct WalStats
+        {
+            std::uint64_t commits = 0;
+            std::uint64_t syncs = 0;
+            std::uint64_t checkpoints = 0;
+            std::uint64_t logBytes = 0;
+            std::size_t pendingTables = 0;
+            // Commits waiting behind the current leader.
+            std::size_t queuedCommits = 0;
+            std::size_t maxGroupSize = 0;
+            double commitsPerSecond = 0.0;
+
+            double averageGroupSize() const { return syncs == 0 ? 0.0 : static_cast<double>(commits) / static_cast<double>(syncs); }
+        };
+
+        // One log per database directory, shared by every connection in the process.
+        // Commits queue up behind whichever writer is currently syncing; that leader
+        // then writes the whole group with one append and one fsync. Committed tables
+        // are visible to readers immediately and folded into the table files by a
+        // background checkpoint.
+        class WriteAheadLog
+        {
+        private:
+            struct CommitRequest
+            {
+                Transaction* transaction = nullptr;
+                std::string table;
+                const TableMutation* mutation = nullptr;
+                const TableLoader* load = nullptr;
+                std::size_t affectedRows = 0;
+                std::exception_ptr error;
+                bool done = false;
+            };
+
+            struct CheckpointedTable
+            {
+                FileStamp stamp;
+                std::shared_ptr<const TableRows> rows;
+            };
+
+            std::string dbPath;
+            std::string logPath;
+            std::string markerPath;
+
+            // Lock order: writeMutex, then mutex. Nothing else is taken while queueMutex is held.
+            std::mutex writeMutex;
+            mutable std::mutex mutex;
+            mutable std::mutex queueMutex;
+            std::condition_variable wakeup;
+            std::condition_variable groupFinished;
+            std::thread checkpointer;
+            bool stopping = false;
+
+            std::deque<CommitRequest*> queue;
+            bool leaderActive = false;
+
+            std::uint64_t lastLsn = 0;
+            std::map<std::string, std::shared_ptr<const TableRows>> pending;
+            std::map<std::string, CheckpointedTable> checkpointed;
+            std::map<std::string, std::uint64_t> versions;
+            WalStats stats;
+            std::chrono::steady_clock::time_point firstCommit;
+
+            explicit WriteAheadLog(std::string path);
+
+            void recover();
+            void checkpointTables();
+            void checkpointLoop();
+            void submit(CommitRequest& request);
+            void commitGroup(const std::vector<CommitRequest*>& group);
+            std::uint64_t getVersionLocked(const std::string& table) const;
+
+        public:
+            static constexpr std::chrono::milliseconds kCheckpointDelay{50};
+            static constexpr std::uint64_t kCheckpointLogBytes = 4U * 1024U * 1024U;
+
+            static std::shared_ptr<WriteAheadLog> open(const std::string& dbPath);
+            ~WriteAheadLog();
+
+            WriteAheadLog(const WriteAheadLog&) = delete;
+            WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+            std::string getLogPath() const { return logPath; }
+            std::uint64_t getTableVersion(const std::string& table) const;
+            std::shared_ptr<const TableRows> getCommittedTable(const std::string& table) const;
+            std::shared_ptr<const TableRows> getCheckpointedTable(const std::string& table, const TableStamp& stamp) const;
+
+            void commit(Transaction& transaction);
+            std::size_t apply(const std::string& table, const TableMutation& mutation, const TableLoader& load);
+            std::unique_lock<std::mutex> lockForDirectWrite(const std::string& table);
+            void checkpoint();
+            WalStats getStats() const;
+        };
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <json.hpp>
+
+#include <string>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // Appends value as compact JSON, formatting numbers with std::to_chars
+        // instead of an ostream. Strings are escaped like dump() does, and a
+        // string that is not valid UTF-8 throws the same nlohmann error.
+        void AppendJson(std::string& out, const nlohmann::json& value);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <database/json_bloom.h>
+#include <database/json_predicate.h>
+#include <database/json_storage.h>
+#include <json.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        constexpr std::size_t kZoneBlockRows = 4096;
+        // Longer strings leave a block's text range unknown rather than bloat
+        // the sidecar.
+        constexpr std::size_t kZoneTextBytes = 64;
+
+        // One column over a block of rows. A comparison only holds for values
+        // of the literal's kind, so numbers and strings keep separate ranges.
+        // Columns the schema names in bloomColumns also get a filter over the
+        // IndexKey of each non-null value, which rules out equality probes the
+        // range cannot.
+        struct ColumnZone
+        {
+            std::uint64_t present = 0;
+            std::uint64_t nullCount = 0;
+            std::uint64_t numbers = 0;
+            std::optional<double> min;
+            std::optional<double> max;
+            std::uint64_t strings = 0;
+            std::optional<std::string> minText;
+            std::optional<std::string> maxText;
+            std::optional<BloomFilter> bloom;
+        };
+
+        // A block of consecutive rows and, for row formats, the bytes of the
+        // table file holding them. Columns missing from the map are unknown.
+        struct Zone
+        {
+            std::uint64_t rows = 0;
+            std::uint64_t begin = 0;
+            std::uint64_t end = 0;
+            std::map<std::string, ColumnZone> columns;
+        };
+
+        // Zones over the rows of a compact JSON array or NDJSON table file, up
+        // to byte end. The sidecar, a line of JSON followed by the serialized
+        // filters it points into, names the inode of the file it describes and
+        // is removed before that file is replaced, so it never outlives it;
+        // rows appended after end are simply not covered.
+        struct ZoneMap
+        {
+            std::uint64_t inode = 0;
+            std::uint64_t end = 0;
+            std::vector<Zone> zones;
+        };
+
+        struct ScanStats
+        {
+            std::uint64_t blocksScanned = 0;
+            std::uint64_t blocksSkipped = 0;
+        };
+
+        // offsets holds where each row starts and where the last one ends;
+        // schema names the columns that get Bloom filters.
+        ZoneMap BuildZoneMap(
+            const TableRows& rows,
+            const RowOffsets& offsets,
+            const TableSchema& schema = {},
+            std::size_t blockRows = kZoneBlockRows);
+        void WriteZoneMap(const std::string& path, const ZoneMap& zoneMap, bool sync);
+        // Empty when the table has no sidecar or it belongs to another file.
+        std::optional<ZoneMap> LoadZoneMap(const std::string& dbPath, const std::string& tableName);
+
+        // False only when no row of the block can satisfy node. Comparisons
+        // on a column some row lacks stay possible, since evaluating them on
+        // that row throws.
+        bool ZoneMayMatch(const PredicateNode& node, const Zone& zone);
+    }
+}
@@ -0,0 +1,697 @@
+#include <core/sql_parser.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <string_view>
+
+namespace
+{
+std::string UnquoteString(const std::string& text)
+{
+    const char quote = text.empty() ? '\0' : text.front();
+    if (text.size() < 2 || text.back() != quote)
+    {
+        throw SqlSyntaxError("Unterminated quoted text near '" + text + "'.");
+    }
+
+    std::string value;
+    value.reserve(text.size() - 2);
+    for (std::size_t index = 1; index + 1 < text.size(); ++index)
+    {
+        value += text[index];
+        if (text[index] == quote && text[index + 1] == quote)
+        {
+            ++index;
+        }
+    }
+    return value;
+}
+
+class TokenCursor
+{
+private:
+    const std::vector<SqlToken>& tokens;
+    std::size_t pos = 0;
+
+public:
+    explicit TokenCursor(const std::vector<SqlToken>& source) : tokens(source) {}
+
+    bool atEnd() const { return pos >= tokens.size(); }
+    std::size_t position() const { return pos; }
+
+    const SqlToken* peek(std::size_t ahead = 0) const
+    {
+        return pos + ahead < tokens.size() ? &tokens[pos + ahead] : nullptr;
+    }
+
+    const SqlToken& next()
+    {
+        if (atEnd())
+        {
+            fail("Unexpected end of statement");
+        }
+        return tokens[pos++];
+    }
+
+    bool accept(SqlKeyword keyword)
+    {
+        const SqlToken* token = peek();
+        if (token != nullptr && token->is(keyword))
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool acceptSymbol(std::string_view symbol)
+    {
+        const SqlToken* token = peek();
+        if (token != nullptr && token->isSymbol(symbol))
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    // Matches a word that is not a reserved keyword, such as ENGINE.
+    bool acceptWord(std::string_view word)
+    {
+        const SqlToken* token = peek();
+        if (token == nullptr || token->type != SqlTokenType::IDENTIFIER || token->text.size() != word.size() ||
+            !std::equal(word.begin(), word.end(), token->text.begin(), [](char expected, char actual) {
+                return expected == std::toupper(static_cast<unsigned char>(actual));
+            }))
+        {
+            return false;
+        }
+        ++pos;
+        return true;
+    }
+
+    void expect(SqlKeyword keyword, const std::string& what)
+    {
+        if (!accept(keyword))
+        {
+            fail("Expected " + what);
+        }
+    }
+
+    void expectSymbol(std::string_view symbol)
+    {
+        if (!acceptSymbol(symbol))
+        {
+            fail("Expected '" + std::string(symbol) + "'");
+        }
+    }
+
+    // Non-reserved keywords such as OFFSET or ORDER are names here, and
+    // backticks make any word one.
+    std::string expectIdentifier(const std::string& what)
+    {
+        const SqlToken* token = peek();
+        if (token == nullptr ||
+            !(token->type == SqlTokenType::IDENTIFIER ||
+              (token->type == SqlTokenType::KEYWORD && !IsReservedSqlKeyword(token->keyword))))
+        {
+            fail("Expected " + what);
+        }
+        ++pos;
+        return token->text.front() == '`' ? UnquoteString(token->text) : token->text;
+    }
+
+    void expectEnd()
+    {
+        if (!atEnd())
+        {
+            fail("Unexpected token");
+        }
+    }
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        if (atEnd())
+        {
+            throw SqlSyntaxError(message + " at end of statement.");
+        }
+        throw SqlSyntaxError(message + " near '" + tokens[pos].text + "'.");
+    }
+};
+
+// The whole token must be a number: the lexer lets through shapes such as
+// 1.2.3 or 1e that only start like one.
+SqlValue ParseNumber(const std::string& text, bool negative)
+{
+    SqlValue value;
+    const char* const first = text.data();
+    const char* const last = text.data() + text.size();
+    const bool isFloat = text.find_first_of(".eE") != std::string::npos;
+    if (!isFloat)
+    {
+        value.kind = SqlValue::Kind::INTEGER;
+        const auto result = std::from_chars(first, last, value.intValue);
+        if (result.ec == std::errc() && result.ptr == last)
+        {
+            if (negative)
+            {
+                value.intValue = -value.intValue;
+            }
+            return value;
+        }
+    }
+
+    value.kind = SqlValue::Kind::FLOAT;
+    const auto result = std::from_chars(first, last, value.floatValue);
+    if (result.ec != std::errc() || result.ptr != last)
+    {
+        throw SqlSyntaxError("Invalid numeric literal '" + text + "'.");
+    }
+    if (negative)
+    {
+        value.floatValue = -value.floatValue;
+    }
+    return value;
+}
+
+SqlValue ParseValue(TokenCursor& cursor)
+{
+    bool negative = false;
+    const SqlToken* sign = cursor.peek();
+    const SqlToken* afterSign = cursor.peek(1);
+    if (sign != nullptr && (sign->isSymbol("-") || sign->isSymbol("+")) && afterSign != nullptr &&
+        afterSign->type == SqlTokenType::NUMBER)
+    {
+        negative = sign->isSymbol("-");
+        cursor.next();
+    }
+
+    const SqlToken& token = cursor.next();
+    SqlValue value;
+    switch (token.type)
+    {
+    case SqlTokenType::NUMBER:
+        return ParseNumber(token.text, negative);
+    case SqlTokenType::STRING:
+        value.kind = SqlValue::Kind::STRING;
+        value.stringValue = UnquoteString(token.text);
+        return value;
+    case SqlTokenType::IDENTIFIER:
+        // A bare word is read as a string, but one that starts with a digit is
+        // a number with trailing junk such as 12abc.
+        if (std::isdigit(static_cast<unsigned char>(token.text.front())) != 0)
+        {
+            throw SqlSyntaxError("Invalid numeric literal '" + token.text + "'.");
+        }
+        value.kind = SqlValue::Kind::STRING;
+        value.stringValue = token.text;
+        return value;
+    case SqlTokenType::KEYWORD:
+        if (token.keyword == SqlKeyword::TRUE_LITERAL || token.keyword == SqlKeyword::FALSE_LITERAL)
+        {
+            value.kind = SqlValue::Kind::BOOLEAN;
+            value.boolValue = token.keyword == SqlKeyword::TRUE_LITERAL;
+            return value;
+        }
+        if (token.keyword == SqlKeyword::NULL_LITERAL)
+        {
+            return value;
+        }
+        break;
+    default:
+        break;
+    }
+    throw SqlSyntaxError("Expected a literal value near '" + token.text + "'.");
+}
+
+SqlCompareOp ParseCompareOp(TokenCursor& cursor)
+{
+    const SqlToken* token = cursor.peek();
+    if (token != nullptr && token->type == SqlTokenType::OPERATOR)
+    {
+        const std::string& text = token->text;
+        SqlCompareOp op = SqlCompareOp::EQ;
+        bool recognized = true;
+        if (text == "=")
+        {
+            op = SqlCompareOp::EQ;
+        }
+        else if (text == "!=" || text == "<>")
+        {
+            op = SqlCompareOp::NE;
+        }
+        else if (text == "<")
+        {
+            op = SqlCompareOp::LT;
+        }
+        else if (text == "<=")
+        {
+            op = SqlCompareOp::LE;
+        }
+        else if (text == ">")
+        {
+            op = SqlCompareOp::GT;
+        }
+        else if (text == ">=")
+        {
+            op = SqlCompareOp::GE;
+        }
+        else
+        {
+            recognized = false;
+        }
+
+        if (recognized)
+        {
+            cursor.next();
+            return op;
+        }
+    }
+    cursor.fail("Expected a comparison operator");
+}
+
+SqlExpressionPtr ParseOr(TokenCursor& cursor);
+
+SqlExpressionPtr ParsePrimary(TokenCursor& cursor)
+{
+    if (cursor.acceptSymbol("("))
+    {
+        SqlExpressionPtr inner = ParseOr(cursor);
+        cursor.expectSymbol(")");
+        return inner;
+    }
+
+    auto comparison = std::make_shared<SqlExpression>();
+    comparison->kind = SqlExpression::Kind::COMPARE;
+    comparison->column = cursor.expectIdentifier("a column name");
+    comparison->op = ParseCompareOp(cursor);
+    comparison->value = ParseValue(cursor);
+    return comparison;
+}
+
+SqlExpressionPtr ParseNot(TokenCursor& cursor)
+{
+    if (cursor.accept(SqlKeyword::NOT))
+    {
+        auto negation = std::make_shared<SqlExpression>();
+        negation->kind = SqlExpression::Kind::NOT;
+        negation->children.push_back(ParseNot(cursor));
+        return negation;
+    }
+    return ParsePrimary(cursor);
+}
+
+SqlExpressionPtr ParseAnd(TokenCursor& cursor)
+{
+    SqlExpressionPtr first = ParseNot(cursor);
+    if (!cursor.accept(SqlKeyword::AND))
+    {
+        return first;
+    }
+
+    auto conjunction = std::make_shared<SqlExpression>();
+    conjunction->kind = SqlExpression::Kind::AND;
+    conjunction->children.push_back(std::move(first));
+    do
+    {
+        conjunction->children.push_back(ParseNot(cursor));
+    } while (cursor.accept(SqlKeyword::AND));
+    return conjunction;
+}
+
+SqlExpressionPtr ParseOr(TokenCursor& cursor)
+{
+    SqlExpressionPtr first = ParseAnd(cursor);
+    if (!cursor.accept(SqlKeyword::OR))
+    {
+        return first;
+    }
+
+    auto disjunction = std::make_shared<SqlExpression>();
+    disjunction->kind = SqlExpression::Kind::OR;
+    disjunction->children.push_back(std::move(first));
+    do
+    {
+        disjunction->children.push_back(ParseAnd(cursor));
+    } while (cursor.accept(SqlKeyword::OR));
+    return disjunction;
+}
+
+SqlTableRef ParseTableRef(TokenCursor& cursor)
+{
+    SqlTableRef ref;
+    ref.table = cursor.expectIdentifier("a table name");
+    if (cursor.acceptSymbol("."))
+    {
+        ref.database = ref.table;
+        ref.table = cursor.expectIdentifier("a table name");
+    }
+    return ref;
+}
+
+std::vector<std::string> ParseIdentifierList(TokenCursor& cursor, const std::string& what)
+{
+    std::vector<std::string> names;
+    do
+    {
+        names.push_back(cursor.expectIdentifier(what));
+    } while (cursor.acceptSymbol(","));
+    return names;
+}
+
+std::size_t ParseCount(TokenCursor& cursor, const std::string& what)
+{
+    const SqlToken& token = cursor.next();
+    if (token.type != SqlTokenType::NUMBER || token.text.find_first_not_of("0123456789") != std::string::npos)
+    {
+        throw SqlSyntaxError("Expected a non-negative integer for " + what + " near '" + token.text + "'.");
+    }
+    return static_cast<std::size_t>(std::stoull(token.text));
+}
+
+SqlSelectStatement ParseSelect(TokenCursor& cursor, SqlClauseRanges& clauses)
+{
+    SqlSelectStatement select;
+    if (cursor.acceptSymbol("*"))
+    {
+        select.columns.push_back("*");
+    }
+    else
+    {
+        select.columns = ParseIdentifierList(cursor, "a column name");
+    }
+
+    cursor.expect(SqlKeyword::FROM, "FROM");
+    select.table = ParseTableRef(cursor);
+    if (cursor.accept(SqlKeyword::WHERE))
+    {
+        clauses.where.begin = cursor.position();
+        select.where = ParseOr(cursor);
+        clauses.where.end = cursor.position();
+    }
+
+    if (cursor.accept(SqlKeyword::ORDER))
+    {
+        cursor.expect(SqlKeyword::BY, "BY");
+        clauses.orderBy.begin = cursor.position();
+        do
+        {
+            SqlOrderItem item;
+            item.column = cursor.expectIdentifier("an ORDER BY column");
+            if (cursor.accept(SqlKeyword::DESC))
+            {
+                item.descending = true;
+            }
+            else
+            {
+                cursor.accept(SqlKeyword::ASC);
+            }
+            select.orderBy.push_back(std::move(item));
+        } while (cursor.acceptSymbol(","));
+        clauses.orderBy.end = cursor.position();
+    }
+
+    if (cursor.accept(SqlKeyword::LIMIT))
+    {
+        clauses.limit.begin = cursor.position();
+        select.limit = ParseCount(cursor, "LIMIT");
+        if (cursor.accept(SqlKeyword::OFFSET))
+        {
+            select.offset = ParseCount(cursor, "OFFSET");
+        }
+        clauses.limit.end = cursor.position();
+    }
+    return select;
+}
+
+SqlInsertStatement ParseInsert(TokenCursor& cursor)
+{
+    SqlInsertStatement insert;
+    cursor.expect(SqlKeyword::INTO, "INTO");
+    insert.table = ParseTableRef(cursor);
+    if (cursor.acceptSymbol("("))
+    {
+        insert.columns = ParseIdentifierList(cursor, "a column name");
+        cursor.expectSymbol(")");
+    }
+
+    cursor.expect(SqlKeyword::VALUES, "VALUES");
+    do
+    {
+        cursor.expectSymbol("(");
+        std::vector<SqlValue> row;
+        do
+        {
+            row.push_back(ParseValue(cursor));
+        } while (cursor.acceptSymbol(","));
+        cursor.expectSymbol(")");
+        insert.rows.push_back(std::move(row));
+
+        cursor.acceptSymbol(",");
+    } while (!cursor.atEnd() && cursor.peek()->isSymbol("("));
+    return insert;
+}
+
+SqlUpdateStatement ParseUpdate(TokenCursor& cursor, SqlClauseRanges& clauses)
+{
+    SqlUpdateStatement update;
+    update.table = ParseTableRef(cursor);
+    cursor.expect(SqlKeyword::SET, "SET");
+    do
+    {
+        SqlAssignment assignment;
+        assignment.column = cursor.expectIdentifier("a column name");
+        cursor.expectSymbol("=");
+        assignment.value = ParseValue(cursor);
+        update.assignments.push_back(std::move(assignment));
+    } while (cursor.acceptSymbol(","));
+
+    if (cursor.accept(SqlKeyword::WHERE))
+    {
+        clauses.where.begin = cursor.position();
+        update.where = ParseOr(cursor);
+        clauses.where.end = cursor.position();
+    }
+    return update;
+}
+
+SqlDeleteStatement ParseDelete(TokenCursor& cursor, SqlClauseRanges& clauses)
+{
+    SqlDeleteStatement remove;
+    cursor.expect(SqlKeyword::FROM, "FROM");
+    remove.table = ParseTableRef(cursor);
+    if (cursor.accept(SqlKeyword::WHERE))
+    {
+        clauses.where.begin = cursor.position();
+        remove.where = ParseOr(cursor);
+        clauses.where.end = cursor.position();
+    }
+    return remove;
+}
+
+std::string ToUpperCopy(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+    return value;
+}
+
+std::string ParseEngineOption(TokenCursor& cursor)
+{
+    cursor.acceptSymbol("=");
+    return ToUpperCopy(cursor.expectIdentifier("a table engine"));
+}
+
+SqlCreateIndexStatement ParseCreateIndex(TokenCursor& cursor)
+{
+    SqlCreateIndexStatement create;
+    create.name = cursor.expectIdentifier("an index name");
+    cursor.expect(SqlKeyword::ON, "ON");
+    create.table = ParseTableRef(cursor);
+    cursor.expectSymbol("(");
+    create.columns = ParseIdentifierList(cursor, "an index column");
+    cursor.expectSymbol(")");
+    if (cursor.accept(SqlKeyword::USING))
+    {
+        const std::string method = ToUpperCopy(cursor.expectIdentifier("an index type"));
+        if (method == "BTREE")
+        {
+            create.method = SqlIndexMethod::BTREE;
+        }
+        else if (method != "HASH")
+        {
+            throw SqlSyntaxError("Unsupported index type: " + method);
+        }
+    }
+    return create;
+}
+
+SqlCreateTableStatement ParseCreateTable(TokenCursor& cursor)
+{
+    SqlCreateTableStatement create;
+    cursor.expect(SqlKeyword::TABLE, "TABLE");
+    create.table = ParseTableRef(cursor);
+    cursor.expectSymbol("(");
+
+    do
+    {
+        if (cursor.accept(SqlKeyword::PRIMARY))
+        {
+            cursor.expect(SqlKeyword::KEY, "KEY");
+            cursor.expectSymbol("(");
+            for (const auto& column : ParseIdentifierList(cursor, "a primary key column"))
+            {
+                create.primaryKey.push_back(column);
+            }
+            cursor.expectSymbol(")");
+            continue;
+        }
+
+        SqlColumnDefinition definition;
+        definition.name = cursor.expectIdentifier("a column name");
+        int depth = 0;
+        while (!cursor.atEnd())
+        {
+            const SqlToken* token = cursor.peek();
+            if (depth == 0 && (token->isSymbol(",") || token->isSymbol(")")))
+            {
+                break;
+            }
+
+            if (token->isSymbol("("))
+            {
+                ++depth;
+            }
+            else if (token->isSymbol(")"))
+            {
+                --depth;
+            }
+            else if (token->is(SqlKeyword::PRIMARY) && cursor.peek(1) != nullptr && cursor.peek(1)->is(SqlKeyword::KEY))
+            {
+                definition.primaryKey = true;
+                create.primaryKey.push_back(definition.name);
+                cursor.next();
+            }
+            else if (definition.typeName.empty())
+            {
+                definition.typeName = token->text;
+            }
+            cursor.next();
+        }
+        create.columns.push_back(std::move(definition));
+    } while (cursor.acceptSymbol(","));
+
+    cursor.expectSymbol(")");
+    if (cursor.acceptWord("ENGINE"))
+    {
+        create.engine = ParseEngineOption(cursor);
+    }
+    return create;
+}
+
+SqlAlterTableStatement ParseAlterTable(TokenCursor& cursor)
+{
+    SqlAlterTableStatement alter;
+    cursor.expect(SqlKeyword::TABLE, "TABLE");
+    alter.table = ParseTableRef(cursor);
+    if (!cursor.acceptWord("ENGINE"))
+    {
+        cursor.fail("Expected ENGINE");
+    }
+    alter.engine = ParseEngineOption(cursor);
+    return alter;
+}
+
+SqlVacuumStatement ParseVacuum(TokenCursor& cursor)
+{
+    SqlVacuumStatement vacuum;
+    if (!cursor.atEnd())
+    {
+        vacuum.table = ParseTableRef(cursor);
+    }
+    return vacuum;
+}
+}
+
+SqlStatement SqlAstParser::parse(const std::string& sql) const
+{
+    return parse(SqlLexer(sql));
+}
+
+SqlStatement SqlAstParser::parse(const SqlLexer& lexer) const
+{
+    SqlClauseRanges clauses;
+    return parse(lexer, clauses);
+}
+
+SqlStatement SqlAstParser::parse(const SqlLexer& lexer, SqlClauseRanges& clauses) const
+{
+    TokenCursor cursor(lexer.getTokens());
+    if (cursor.atEnd())
+    {
+        throw SqlSyntaxError("SQL statement is empty.");
+    }
+
+    SqlStatement statement;
+    const SqlToken& first = cursor.next();
+    switch (first.keyword)
+    {
+    case SqlKeyword::SELECT:
+        statement.type = SqlType::SELECT;
+        statement.node = ParseSelect(cursor, clauses);
+        break;
+    case SqlKeyword::INSERT:
+        statement.type = SqlType::INSERT;
+        statement.node = ParseInsert(cursor);
+        break;
+    case SqlKeyword::REPLACE:
+    {
+        statement.type = SqlType::INSERT;
+        SqlInsertStatement replace = ParseInsert(cursor);
+        replace.replace = true;
+        statement.node = std::move(replace);
+        break;
+    }
+    case SqlKeyword::UPDATE:
+        statement.type = SqlType::UPDATE;
+        statement.node = ParseUpdate(cursor, clauses);
+        break;
+    case SqlKeyword::DELETE:
+        statement.type = SqlType::DELETE;
+        statement.node = ParseDelete(cursor, clauses);
+        break;
+    case SqlKeyword::CREATE:
+        statement.type = SqlType::CREATE;
+        if (cursor.accept(SqlKeyword::INDEX))
+        {
+            statement.node = ParseCreateIndex(cursor);
+        }
+        else
+        {
+            statement.node = ParseCreateTable(cursor);
+        }
+        break;
+    case SqlKeyword::ALTER:
+        statement.type = SqlType::ALTER;
+        statement.node = ParseAlterTable(cursor);
+        break;
+    case SqlKeyword::VACUUM:
+        statement.type = SqlType::VACUUM;
+        statement.node = ParseVacuum(cursor);
+        break;
+    default:
+        throw SqlSyntaxError("Unsupported SQL statement near '" + first.text + "'.");
+    }
+
+    cursor.expectEnd();
+    return statement;
+}
+
+SqlExpressionPtr SqlAstParser::parseExpression(const std::string& text) const
+{
+    const SqlLexer lexer(text);
+    TokenCursor cursor(lexer.getTokens());
+    SqlExpressionPtr expression = ParseOr(cursor);
+    cursor.expectEnd();
+    return expression;
+}
@@ -0,0 +1,271 @@
+#include <core/sql_lexer.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace
+{
+// Keywords that are not reserved may also name tables and columns, since
+// the grammar only looks for them where no name is expected.
+struct KeywordEntry
+{
+    std::string_view text;
+    SqlKeyword keyword;
+    bool reserved;
+};
+
+constexpr std::array<KeywordEntry, 35> kKeywords{{
+    {"ALTER", SqlKeyword::ALTER, false},
+    {"AND", SqlKeyword::AND, true},
+    {"AS", SqlKeyword::AS, true},
+    {"ASC", SqlKeyword::ASC, false},
+    {"BY", SqlKeyword::BY, false},
+    {"CREATE", SqlKeyword::CREATE, true},
+    {"DELETE", SqlKeyword::DELETE, true},
+    {"DESC", SqlKeyword::DESC, false},
+    {"DROP", SqlKeyword::DROP, false},
+    {"FALSE", SqlKeyword::FALSE_LITERAL, true},
+    {"FROM", SqlKeyword::FROM, true},
+    {"GROUP", SqlKeyword::GROUP, false},
+    {"HAVING", SqlKeyword::HAVING, false},
+    {"INDEX", SqlKeyword::INDEX, false},
+    {"INSERT", SqlKeyword::INSERT, true},
+    {"INTO", SqlKeyword::INTO, true},
+    {"KEY", SqlKeyword::KEY, false},
+    {"LIMIT", SqlKeyword::LIMIT, false},
+    {"NOT", SqlKeyword::NOT, true},
+    {"NULL", SqlKeyword::NULL_LITERAL, true},
+    {"OFFSET", SqlKeyword::OFFSET, false},
+    {"ON", SqlKeyword::ON, false},
+    {"OR", SqlKeyword::OR, true},
+    {"ORDER", SqlKeyword::ORDER, false},
+    {"PRIMARY", SqlKeyword::PRIMARY, true},
+    {"REPLACE", SqlKeyword::REPLACE, false},
+    {"SELECT", SqlKeyword::SELECT, true},
+    {"SET", SqlKeyword::SET, false},
+    {"TABLE", SqlKeyword::TABLE, false},
+    {"TRUE", SqlKeyword::TRUE_LITERAL, true},
+    {"UPDATE", SqlKeyword::UPDATE, true},
+    {"USING", SqlKeyword::USING, false},
+    {"VACUUM", SqlKeyword::VACUUM, false},
+    {"VALUES", SqlKeyword::VALUES, false},
+    {"WHERE", SqlKeyword::WHERE, true},
+}};
+
+constexpr bool KeywordsAreSorted()
+{
+    for (std::size_t index = 1; index < kKeywords.size(); ++index)
+    {
+        if (!(kKeywords[index - 1].text < kKeywords[index].text))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(KeywordsAreSorted(), "SQL keyword table must stay sorted for binary search.");
+
+constexpr std::size_t kMaxKeywordLength = 7;
+
+bool IsWordChar(char ch)
+{
+    return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_';
+}
+
+bool IsSpace(char ch)
+{
+    return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+}
+
+SqlKeyword LookupSqlKeyword(std::string_view word)
+{
+    if (word.empty() || word.size() > kMaxKeywordLength)
+    {
+        return SqlKeyword::NONE;
+    }
+
+    std::array<char, kMaxKeywordLength> buffer{};
+    for (std::size_t index = 0; index < word.size(); ++index)
+    {
+        buffer[index] = static_cast<char>(std::toupper(static_cast<unsigned char>(word[index])));
+    }
+    const std::string_view upper(buffer.data(), word.size());
+
+    const auto it = std::lower_bound(
+        kKeywords.begin(),
+        kKeywords.end(),
+        upper,
+        [](const KeywordEntry& entry, std::string_view value) { return entry.text < value; });
+    if (it != kKeywords.end() && it->text == upper)
+    {
+        return it->keyword;
+    }
+    return SqlKeyword::NONE;
+}
+
+bool IsReservedSqlKeyword(SqlKeyword keyword)
+{
+    return std::any_of(kKeywords.begin(), kKeywords.end(), [&](const KeywordEntry& entry) {
+        return entry.keyword == keyword && entry.reserved;
+    });
+}
+
+void SqlLexer::tokenize(std::string_view sql)
+{
+    normalized.reserve(sql.size());
+    bool pendingSpace = false;
+    std::size_t pos = 0;
+
+    while (pos < sql.size())
+    {
+        const char ch = sql[pos];
+        if (IsSpace(ch))
+        {
+            pendingSpace = true;
+            ++pos;
+            continue;
+        }
+
+        if (ch == '-' && pos + 1 < sql.size() && sql[pos + 1] == '-')
+        {
+            while (pos < sql.size() && sql[pos] != '\n' && sql[pos] != '\r')
+            {
+                ++pos;
+            }
+            pendingSpace = true;
+            continue;
+        }
+
+        if (ch == '/' && pos + 1 < sql.size() && sql[pos + 1] == '*')
+        {
+            const std::size_t close = sql.find("*/", pos + 2);
+            pos = close == std::string_view::npos ? sql.size() : close + 2;
+            pendingSpace = true;
+            continue;
+        }
+
+        if (pendingSpace && !normalized.empty())
+        {
+            normalized += ' ';
+        }
+        pendingSpace = false;
+
+        SqlToken token;
+        const std::size_t start = pos;
+        if (ch == '\'' || ch == '"' || ch == '`')
+        {
+            token.type = ch == '`' ? SqlTokenType::IDENTIFIER : SqlTokenType::STRING;
+            ++pos;
+            bool closed = false;
+            while (pos < sql.size() && !closed)
+            {
+                if (sql[pos] == ch && pos + 1 < sql.size() && sql[pos + 1] == ch)
+                {
+                    pos += 2;
+                    continue;
+                }
+                closed = sql[pos] == ch;
+                ++pos;
+            }
+            if (!closed)
+            {
+                throw SqlSyntaxError(std::string(ch == '`' ? "Unterminated quoted identifier" : "Unterminated string literal") +
+                                     " near '" + std::string(sql.substr(start)) + "'.");
+            }
+        }
+        else if (IsWordChar(ch))
+        {
+            bool numeric = std::isdigit(static_cast<unsigned char>(ch)) != 0;
+            while (pos < sql.size())
+            {
+                const char current = sql[pos];
+                if (IsWordChar(current))
+                {
+                    if (numeric && !std::isdigit(static_cast<unsigned char>(current)) && current != 'e' && current != 'E')
+                    {
+                        numeric = false;
+                    }
+                    ++pos;
+                }
+                else if (numeric && current == '.')
+                {
+                    ++pos;
+                }
+                else if (numeric && (current == '+' || current == '-') && (sql[pos - 1] == 'e' || sql[pos - 1] == 'E'))
+                {
+                    ++pos;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            if (numeric)
+            {
+                token.type = SqlTokenType::NUMBER;
+            }
+            else
+            {
+                token.keyword = LookupSqlKeyword(sql.substr(start, pos - start));
+                token.type = token.keyword == SqlKeyword::NONE ? SqlTokenType::IDENTIFIER : SqlTokenType::KEYWORD;
+            }
+        }
+        else if (ch == '(' || ch == ')' || ch == ',' || ch == '.' || ch == ';')
+        {
+            token.type = SqlTokenType::PUNCTUATION;
+            ++pos;
+        }
+        else
+        {
+            token.type = SqlTokenType::OPERATOR;
+            ++pos;
+            if (pos < sql.size())
+            {
+                const char next = sql[pos];
+                if ((ch == '!' && next == '=') || (ch == '<' && (next == '=' || next == '>')) || (ch == '>' && next == '='))
+                {
+                    ++pos;
+                }
+            }
+        }
+
+        token.text = std::string(sql.substr(start, pos - start));
+        token.begin = normalized.size();
+        normalized += token.text;
+        token.end = normalized.size();
+        tokens.push_back(std::move(token));
+    }
+
+    if (!tokens.empty() && tokens.back().isSymbol(";"))
+    {
+        normalized.resize(tokens.back().begin);
+        while (!normalized.empty() && normalized.back() == ' ')
+        {
+            normalized.pop_back();
+        }
+        tokens.pop_back();
+    }
+
+    normalizedUpper = normalized;
+    std::transform(
+        normalizedUpper.begin(),
+        normalizedUpper.end(),
+        normalizedUpper.begin(),
+        [](unsigned char value) { return static_cast<char>(std::toupper(value)); });
+}
+
+std::string SqlLexer::sliceUpper(std::size_t firstToken, std::size_t endToken) const
+{
+    if (firstToken >= endToken || firstToken >= tokens.size())
+    {
+        return "";
+    }
+
+    endToken = std::min(endToken, tokens.size());
+    const std::size_t begin = tokens[firstToken].begin;
+    return normalizedUpper.substr(begin, tokens[endToken - 1].end - begin);
+}
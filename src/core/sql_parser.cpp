@@ -2,86 +2,317 @@
 
 #include <algorithm>
 #include <cctype>
-#include <regex>
-#include <sstream>
+#include <functional>
+#include <optional>
 
 namespace
 {
-std::string Trim(const std::string& value)
+enum class Clause
 {
-    const std::string whitespace = " \t\r\n";
-    const std::size_t start = value.find_first_not_of(whitespace);
-    if (start == std::string::npos)
+    WHERE,
+    GROUP_BY,
+    HAVING,
+    ORDER_BY,
+    LIMIT
+};
+
+constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+std::size_t ClauseKeywordLength(const std::vector<SqlToken>& tokens, std::size_t index, Clause clause)
+{
+    const SqlToken& token = tokens[index];
+    const bool followedByBy = index + 1 < tokens.size() && tokens[index + 1].is(SqlKeyword::BY);
+    switch (clause)
+    {
+    case Clause::WHERE:
+        return token.is(SqlKeyword::WHERE) ? 1 : 0;
+    case Clause::GROUP_BY:
+        return token.is(SqlKeyword::GROUP) && followedByBy ? 2 : 0;
+    case Clause::HAVING:
+        return token.is(SqlKeyword::HAVING) ? 1 : 0;
+    case Clause::ORDER_BY:
+        return token.is(SqlKeyword::ORDER) && followedByBy ? 2 : 0;
+    case Clause::LIMIT:
+        return token.is(SqlKeyword::LIMIT) ? 1 : 0;
+    }
+    return 0;
+}
+
+std::size_t FindTopLevel(
+    const std::vector<SqlToken>& tokens,
+    std::size_t from,
+    const std::function<bool(std::size_t)>& matches)
+{
+    int depth = 0;
+    for (std::size_t index = from; index < tokens.size(); ++index)
+    {
+        if (tokens[index].isSymbol("("))
+        {
+            ++depth;
+        }
+        else if (tokens[index].isSymbol(")"))
+        {
+            --depth;
+        }
+        else if (depth == 0 && matches(index))
+        {
+            return index;
+        }
+    }
+    return kNotFound;
+}
+
+std::size_t FindClause(const std::vector<SqlToken>& tokens, std::size_t from, Clause clause)
+{
+    return FindTopLevel(tokens, from, [&](std::size_t index) { return ClauseKeywordLength(tokens, index, clause) > 0; });
+}
+
+std::string ExtractClauseBody(const SqlLexer& lexer, Clause clause, std::initializer_list<Clause> terminators)
+{
+    const std::vector<SqlToken>& tokens = lexer.getTokens();
+    const std::size_t start = FindClause(tokens, 0, clause);
+    if (start == kNotFound)
     {
         return "";
     }
 
-    const std::size_t end = value.find_last_not_of(whitespace);
-    return value.substr(start, end - start + 1);
+    const std::size_t bodyBegin = start + ClauseKeywordLength(tokens, start, clause);
+    std::size_t bodyEnd = tokens.size();
+    for (const Clause terminator : terminators)
+    {
+        bodyEnd = std::min(bodyEnd, FindClause(tokens, bodyBegin, terminator));
+    }
+    return lexer.sliceUpper(bodyBegin, bodyEnd);
 }
 
-std::vector<std::string> SplitCommaSeparated(const std::string& input)
+std::vector<std::pair<std::size_t, std::size_t>> SplitTopLevelCommas(
+    const std::vector<SqlToken>& tokens,
+    std::size_t begin,
+    std::size_t end)
 {
-    std::vector<std::string> parts;
-    std::stringstream stream(input);
-    std::string item;
-    while (std::getline(stream, item, ','))
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    if (begin >= end)
     {
-        parts.push_back(Trim(item));
+        return ranges;
     }
-    return parts;
+
+    std::size_t itemBegin = begin;
+    while (itemBegin <= end)
+    {
+        std::size_t comma = FindTopLevel(tokens, itemBegin, [&](std::size_t index) { return tokens[index].isSymbol(","); });
+        if (comma == kNotFound || comma > end)
+        {
+            comma = end;
+        }
+        ranges.emplace_back(itemBegin, comma);
+        itemBegin = comma + 1;
+    }
+    return ranges;
 }
+
+std::vector<std::string> SliceItems(const SqlLexer& lexer, std::size_t begin, std::size_t end)
+{
+    std::vector<std::string> items;
+    for (const auto& [itemBegin, itemEnd] : SplitTopLevelCommas(lexer.getTokens(), begin, end))
+    {
+        items.push_back(lexer.sliceUpper(itemBegin, itemEnd));
+    }
+    return items;
 }
 
-std::string QuerySqlParser::preprocessSql(const std::string& sql)
+bool IsNameToken(const SqlToken& token)
 {
-    std::string processed = sql;
-    processed = std::regex_replace(processed, std::regex(R"(/\*[\s\S]*?\*/)"), " ");
-    processed = std::regex_replace(processed, std::regex(R"(--[^\r\n]*)"), " ");
-    processed = std::regex_replace(processed, std::regex(R"(\s+)"), " ");
-    processed = Trim(processed);
-    processed = std::regex_replace(processed, std::regex(R"(;\s*$)"), "");
-    std::transform(
-        processed.begin(),
-        processed.end(),
-        processed.begin(),
-        [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
-    return processed;
+    return token.type == SqlTokenType::IDENTIFIER || token.type == SqlTokenType::KEYWORD ||
+           token.type == SqlTokenType::NUMBER;
 }
 
-std::string QuerySqlParser::extractSqlType(const std::string& processedSql)
+std::size_t SkipTableName(const std::vector<SqlToken>& tokens, std::size_t index)
 {
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(^(SELECT|INSERT|UPDATE|DELETE|CREATE|DROP)\b)")))
+    if (index >= tokens.size() || !IsNameToken(tokens[index]))
     {
-        return match[1].str();
+        return kNotFound;
+    }
+    if (index + 2 < tokens.size() && tokens[index + 1].isSymbol(".") && IsNameToken(tokens[index + 2]))
+    {
+        return index + 3;
+    }
+    return index + 1;
+}
+
+std::string ToUpperCopy(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+    return value;
+}
+
+std::vector<std::string> ToUpperCopies(const std::vector<std::string>& values)
+{
+    std::vector<std::string> upper;
+    upper.reserve(values.size());
+    for (const auto& value : values)
+    {
+        upper.push_back(ToUpperCopy(value));
+    }
+    return upper;
+}
+
+const char* SqlTypeName(SqlType type)
+{
+    switch (type)
+    {
+    case SqlType::SELECT:
+        return "SELECT";
+    case SqlType::INSERT:
+        return "INSERT";
+    case SqlType::UPDATE:
+        return "UPDATE";
+    case SqlType::DELETE:
+        return "DELETE";
+    case SqlType::CREATE:
+        return "CREATE";
+    case SqlType::DROP:
+        return "DROP";
+    case SqlType::ALTER:
+        return "ALTER";
+    case SqlType::VACUUM:
+        return "VACUUM";
+    case SqlType::UNKNOWN:
+        break;
     }
     return "UNKNOWN";
 }
 
-std::vector<std::string> QuerySqlParser::extractColumns(const std::string& processedSql)
+SqlType SqlTypeFromName(const std::string& name)
 {
-    std::smatch match;
+    for (const SqlType type : {SqlType::SELECT, SqlType::INSERT, SqlType::UPDATE, SqlType::DELETE, SqlType::CREATE, SqlType::DROP, SqlType::ALTER, SqlType::VACUUM})
+    {
+        if (name == SqlTypeName(type))
+        {
+            return type;
+        }
+    }
+    return SqlType::UNKNOWN;
+}
 
-    if (std::regex_search(processedSql, match, std::regex(R"(^SELECT\s+(.*?)\s+FROM\b)")))
+const SqlTableRef* StatementTable(const SqlStatement& statement)
+{
+    if (statement.is<SqlSelectStatement>())
+    {
+        return &statement.as<SqlSelectStatement>().table;
+    }
+    if (statement.is<SqlInsertStatement>())
+    {
+        return &statement.as<SqlInsertStatement>().table;
+    }
+    if (statement.is<SqlUpdateStatement>())
+    {
+        return &statement.as<SqlUpdateStatement>().table;
+    }
+    if (statement.is<SqlDeleteStatement>())
+    {
+        return &statement.as<SqlDeleteStatement>().table;
+    }
+    if (statement.is<SqlCreateTableStatement>())
+    {
+        return &statement.as<SqlCreateTableStatement>().table;
+    }
+    if (statement.is<SqlCreateIndexStatement>())
+    {
+        return &statement.as<SqlCreateIndexStatement>().table;
+    }
+    if (statement.is<SqlAlterTableStatement>())
     {
-        return SplitCommaSeparated(match[1].str());
+        return &statement.as<SqlAlterTableStatement>().table;
     }
+    if (statement.is<SqlVacuumStatement>())
+    {
+        return &statement.as<SqlVacuumStatement>().table;
+    }
+    return nullptr;
+}
+}
 
-    if (std::regex_search(processedSql, match, std::regex(R"(^INSERT\s+INTO\s+\w+(?:\.\w+)?\s*\((.*?)\)\s+VALUES\b)")))
+std::string QuerySqlParser::extractSqlType(const SqlLexer& lexer)
+{
+    const std::vector<SqlToken>& tokens = lexer.getTokens();
+    if (tokens.empty())
     {
-        return SplitCommaSeparated(match[1].str());
+        return "UNKNOWN";
+    }
+
+    switch (tokens.front().keyword)
+    {
+    case SqlKeyword::SELECT:
+    case SqlKeyword::INSERT:
+    case SqlKeyword::UPDATE:
+    case SqlKeyword::DELETE:
+    case SqlKeyword::CREATE:
+    case SqlKeyword::DROP:
+    case SqlKeyword::ALTER:
+    case SqlKeyword::VACUUM:
+        return lexer.sliceUpper(0, 1);
+    default:
+        return "UNKNOWN";
+    }
+}
+
+std::vector<std::string> QuerySqlParser::extractColumns(const SqlLexer& lexer)
+{
+    const std::vector<SqlToken>& tokens = lexer.getTokens();
+    if (tokens.empty())
+    {
+        return {};
+    }
+
+    if (tokens.front().is(SqlKeyword::SELECT))
+    {
+        const std::size_t from = FindTopLevel(tokens, 1, [&](std::size_t index) { return tokens[index].is(SqlKeyword::FROM); });
+        if (from == kNotFound || from == 1)
+        {
+            return {};
+        }
+        return SliceItems(lexer, 1, from);
     }
 
-    if (std::regex_search(processedSql, match, std::regex(R"(^UPDATE\s+\w+(?:\.\w+)?\s+SET\s+(.*?)(?:\s+WHERE\b|$))")))
+    if (tokens.front().is(SqlKeyword::INSERT) && tokens.size() > 1 && tokens[1].is(SqlKeyword::INTO))
     {
+        const std::size_t open = SkipTableName(tokens, 2);
+        if (open == kNotFound || open >= tokens.size() || !tokens[open].isSymbol("("))
+        {
+            return {};
+        }
+        const std::size_t values = FindTopLevel(tokens, open, [&](std::size_t index) { return tokens[index].is(SqlKeyword::VALUES); });
+        if (values == kNotFound || !tokens[values - 1].isSymbol(")"))
+        {
+            return {};
+        }
+        return SliceItems(lexer, open + 1, values - 1);
+    }
+
+    if (tokens.front().is(SqlKeyword::UPDATE))
+    {
+        const std::size_t set = SkipTableName(tokens, 1);
+        if (set == kNotFound || set >= tokens.size() || !tokens[set].is(SqlKeyword::SET))
+        {
+            return {};
+        }
+
+        std::size_t end = FindClause(tokens, set + 1, Clause::WHERE);
+        if (end == kNotFound)
+        {
+            end = tokens.size();
+        }
+
         std::vector<std::string> columns;
-        for (const auto& assignment : SplitCommaSeparated(match[1].str()))
+        for (const auto& [itemBegin, itemEnd] : SplitTopLevelCommas(tokens, set + 1, end))
         {
-            const std::size_t equalsPos = assignment.find('=');
-            if (equalsPos != std::string::npos)
+            for (std::size_t index = itemBegin; index < itemEnd; ++index)
             {
-                columns.push_back(Trim(assignment.substr(0, equalsPos)));
+                if (tokens[index].isSymbol("="))
+                {
+                    columns.push_back(lexer.sliceUpper(itemBegin, index));
+                    break;
+                }
             }
         }
         return columns;
@@ -91,131 +322,164 @@ std::vector<std::string> QuerySqlParser::extractColumns(const std::string& proce
 }
 
 void QuerySqlParser::extractTableAndDatabase(
-    const std::string& processedSql,
+    const SqlLexer& lexer,
     std::string& table,
     std::string& database)
 {
-    std::smatch match;
-    if (std::regex_search(
-            processedSql,
-            match,
-            std::regex(R"((?:FROM|UPDATE|INTO|TABLE)\s+([A-Z0-9_]+(?:\.[A-Z0-9_]+)?))")))
+    const std::vector<SqlToken>& tokens = lexer.getTokens();
+    for (std::size_t index = 0; index + 1 < tokens.size(); ++index)
     {
-        const std::string tableSpec = match[1].str();
-        const std::size_t dotPos = tableSpec.find('.');
-        if (dotPos == std::string::npos)
+        const SqlToken& token = tokens[index];
+        if (!token.is(SqlKeyword::FROM) && !token.is(SqlKeyword::UPDATE) && !token.is(SqlKeyword::INTO) &&
+            !token.is(SqlKeyword::TABLE))
+        {
+            continue;
+        }
+
+        const std::size_t end = SkipTableName(tokens, index + 1);
+        if (end == kNotFound)
         {
-            table = tableSpec;
+            continue;
+        }
+
+        if (end - index == 2)
+        {
+            table = lexer.sliceUpper(index + 1, index + 2);
             database.clear();
         }
         else
         {
-            database = tableSpec.substr(0, dotPos);
-            table = tableSpec.substr(dotPos + 1);
+            database = lexer.sliceUpper(index + 1, index + 2);
+            table = lexer.sliceUpper(index + 3, index + 4);
         }
+        return;
     }
 }
 
-std::string QuerySqlParser::extractWhereClause(const std::string& processedSql)
+std::string QuerySqlParser::extractWhereClause(const SqlLexer& lexer)
 {
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(WHERE\s+(.*?)(GROUP BY|HAVING|ORDER BY|LIMIT|$))")))
-    {
-        return match[1].str();
-    }
-    return "";
+    return ExtractClauseBody(lexer, Clause::WHERE, {Clause::GROUP_BY, Clause::HAVING, Clause::ORDER_BY, Clause::LIMIT});
 }
 
-std::vector<std::string> QuerySqlParser::extractGroupByColumns(const std::string& processedSql)
+std::vector<std::string> QuerySqlParser::extractGroupByColumns(const SqlLexer& lexer)
 {
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(GROUP BY\s+(.*?)(HAVING|ORDER BY|LIMIT|$))")))
+    const std::vector<SqlToken>& tokens = lexer.getTokens();
+    const std::size_t start = FindClause(tokens, 0, Clause::GROUP_BY);
+    if (start == kNotFound)
     {
-        return SplitCommaSeparated(match[1].str());
+        return {};
     }
-    return {};
-}
 
-std::string QuerySqlParser::extractHavingClause(const std::string& processedSql)
-{
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(HAVING\s+(.*?)(ORDER BY|LIMIT|$))")))
+    std::size_t end = tokens.size();
+    for (const Clause terminator : {Clause::HAVING, Clause::ORDER_BY, Clause::LIMIT})
     {
-        return match[1].str();
+        end = std::min(end, FindClause(tokens, start + 2, terminator));
     }
-    return "";
+    return SliceItems(lexer, start + 2, end);
 }
 
-std::string QuerySqlParser::extractOrderByClause(const std::string& processedSql)
+std::string QuerySqlParser::extractHavingClause(const SqlLexer& lexer)
 {
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(ORDER BY\s+(.*?)(LIMIT|$))")))
-    {
-        return match[1].str();
-    }
-    return "";
+    return ExtractClauseBody(lexer, Clause::HAVING, {Clause::ORDER_BY, Clause::LIMIT});
 }
 
-std::string QuerySqlParser::extractLimitClause(const std::string& processedSql)
+std::string QuerySqlParser::extractOrderByClause(const SqlLexer& lexer)
 {
-    std::smatch match;
-    if (std::regex_search(processedSql, match, std::regex(R"(LIMIT\s+(.*?)$)")))
-    {
-        return match[1].str();
-    }
-    return "";
+    return ExtractClauseBody(lexer, Clause::ORDER_BY, {Clause::LIMIT});
 }
 
-std::shared_ptr<SqlParseResult> QuerySqlParser::parse(InputData& input)
+std::string QuerySqlParser::extractLimitClause(const SqlLexer& lexer)
 {
-    const std::string processedSql = preprocessSql(input.getRawData());
-
-    auto result = std::make_shared<SqlParseResultQuery>();
-    result->setRawQuery(processedSql);
+    return ExtractClauseBody(lexer, Clause::LIMIT, {});
+}
 
-    const std::string sqlType = extractSqlType(processedSql);
-    result->setType(sqlType);
-    result->setColumns(extractColumns(processedSql));
+void QuerySqlParser::extractFromTokens(const SqlLexer& lexer, SqlParseResultQuery& result)
+{
+    const std::string sqlType = extractSqlType(lexer);
+    result.setType(sqlType);
+    result.setOperationType(SqlTypeFromName(sqlType));
+    result.setColumns(extractColumns(lexer));
 
     std::string database;
     std::string table;
-    extractTableAndDatabase(processedSql, table, database);
-    result->setDatabase(database);
-    result->setTable(table);
-    result->setWhereClause(extractWhereClause(processedSql));
-    result->setGroupByColumns(extractGroupByColumns(processedSql));
-    result->setHavingClause(extractHavingClause(processedSql));
-    result->setOrderByClause(extractOrderByClause(processedSql));
-    result->setLimitClause(extractLimitClause(processedSql));
+    extractTableAndDatabase(lexer, table, database);
+    result.setDatabase(database);
+    result.setTable(table);
+    result.setWhereClause(extractWhereClause(lexer));
+    result.setGroupByColumns(extractGroupByColumns(lexer));
+    result.setHavingClause(extractHavingClause(lexer));
+    result.setOrderByClause(extractOrderByClause(lexer));
+    result.setLimitClause(extractLimitClause(lexer));
+}
+
+void QuerySqlParser::extractFromStatement(
+    const SqlLexer& lexer,
+    const SqlStatement& statement,
+    const SqlClauseRanges& clauses,
+    SqlParseResultQuery& result)
+{
+    result.setType(SqlTypeName(statement.type));
+    result.setOperationType(statement.type);
 
-    if (sqlType == "SELECT")
+    if (statement.is<SqlSelectStatement>())
+    {
+        result.setColumns(ToUpperCopies(statement.as<SqlSelectStatement>().columns));
+    }
+    else if (statement.is<SqlInsertStatement>())
     {
-        result->setOperationType(SqlType::SELECT);
+        result.setColumns(ToUpperCopies(statement.as<SqlInsertStatement>().columns));
     }
-    else if (sqlType == "INSERT")
+    else if (statement.is<SqlUpdateStatement>())
     {
-        result->setOperationType(SqlType::INSERT);
+        std::vector<std::string> columns;
+        for (const auto& assignment : statement.as<SqlUpdateStatement>().assignments)
+        {
+            columns.push_back(ToUpperCopy(assignment.column));
+        }
+        result.setColumns(columns);
     }
-    else if (sqlType == "UPDATE")
+
+    if (const SqlTableRef* table = StatementTable(statement))
     {
-        result->setOperationType(SqlType::UPDATE);
+        result.setDatabase(ToUpperCopy(table->database));
+        result.setTable(ToUpperCopy(table->table));
     }
-    else if (sqlType == "DELETE")
+    result.setWhereClause(lexer.sliceUpper(clauses.where.begin, clauses.where.end));
+    result.setOrderByClause(lexer.sliceUpper(clauses.orderBy.begin, clauses.orderBy.end));
+    result.setLimitClause(lexer.sliceUpper(clauses.limit.begin, clauses.limit.end));
+}
+
+std::shared_ptr<SqlParseResult> QuerySqlParser::parse(InputData& input)
+{
+    auto result = std::make_shared<SqlParseResultQuery>();
+    std::optional<SqlLexer> tokens;
+    try
     {
-        result->setOperationType(SqlType::DELETE);
+        tokens.emplace(input.getRawData());
     }
-    else if (sqlType == "CREATE")
+    catch (const SqlSyntaxError& error)
     {
-        result->setOperationType(SqlType::CREATE);
+        // Nothing can be recovered from text that does not even tokenize.
+        result->setRawQuery(ToUpperCopy(input.getRawData()));
+        result->setSyntaxError(error.what());
+        return result;
     }
-    else if (sqlType == "DROP")
+    const SqlLexer& lexer = *tokens;
+    result->setRawQuery(lexer.getNormalizedUpperSql());
+
+    // Statements the grammar does not cover, such as GROUP BY or DROP, still
+    // get their type and clauses from token scans.
+    try
     {
-        result->setOperationType(SqlType::DROP);
+        SqlClauseRanges clauses;
+        auto statement = std::make_shared<const SqlStatement>(SqlAstParser().parse(lexer, clauses));
+        extractFromStatement(lexer, *statement, clauses, *result);
+        result->setStatement(std::move(statement));
     }
-    else
+    catch (const SqlSyntaxError& error)
     {
-        result->setOperationType(SqlType::UNKNOWN);
+        result->setSyntaxError(error.what());
+        extractFromTokens(lexer, *result);
     }
-
     return result;
 }
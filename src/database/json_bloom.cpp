@@ -0,0 +1,138 @@
+#include <database/json_bloom.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr char kBloomMagic[8] = {'J', 'D', 'B', 'B', 'L', 'M', '0', '1'};
+constexpr std::size_t kBloomHeaderBytes = sizeof(kBloomMagic) + 2 * sizeof(std::uint64_t);
+
+std::uint64_t HashKey(std::string_view key)
+{
+    // FNV-1a, finished with a murmur3 mix so both 32-bit halves are usable.
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const char ch : key)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+void PutWord(std::string& out, std::uint64_t value)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xFFU);
+    }
+}
+
+std::uint64_t GetWord(const char* in)
+{
+    std::uint64_t value = 0;
+    for (int index = 7; index >= 0; --index)
+    {
+        value = (value << 8) | static_cast<unsigned char>(in[index]);
+    }
+    return value;
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        BloomFilter::BloomFilter(std::size_t keys, double bitsPerKey)
+        {
+            const std::size_t bits = std::max<std::size_t>(64, static_cast<std::size_t>(static_cast<double>(keys) * bitsPerKey));
+            words.assign((bits + 63) / 64, 0);
+            probes = static_cast<std::uint32_t>(std::clamp(std::lround(bitsPerKey * 0.69), 1L, 30L));
+        }
+
+        double BloomFilter::bitsPerKeyFor(double falsePositiveRate)
+        {
+            const double ln2 = std::log(2.0);
+            return -std::log(falsePositiveRate) / (ln2 * ln2);
+        }
+
+        void BloomFilter::add(std::string_view key)
+        {
+            if (words.empty())
+            {
+                return;
+            }
+            const std::uint64_t hash = HashKey(key);
+            const std::uint64_t delta = (hash >> 32) | 1U;
+            std::uint64_t probe = hash & 0xFFFFFFFFU;
+            for (std::uint32_t index = 0; index < probes; ++index, probe += delta)
+            {
+                const std::uint64_t bit = probe % bitCount();
+                words[bit / 64] |= std::uint64_t{1} << (bit % 64);
+            }
+        }
+
+        bool BloomFilter::mayContain(std::string_view key) const
+        {
+            if (words.empty())
+            {
+                return true;
+            }
+            const std::uint64_t hash = HashKey(key);
+            const std::uint64_t delta = (hash >> 32) | 1U;
+            std::uint64_t probe = hash & 0xFFFFFFFFU;
+            for (std::uint32_t index = 0; index < probes; ++index, probe += delta)
+            {
+                const std::uint64_t bit = probe % bitCount();
+                if ((words[bit / 64] >> (bit % 64) & 1U) == 0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string BloomFilter::serialize() const
+        {
+            std::string data(kBloomMagic, sizeof(kBloomMagic));
+            data.reserve(kBloomHeaderBytes + words.size() * 8);
+            PutWord(data, probes);
+            PutWord(data, words.size());
+            for (const std::uint64_t word : words)
+            {
+                PutWord(data, word);
+            }
+            return data;
+        }
+
+        std::optional<BloomFilter> BloomFilter::parse(std::string_view data)
+        {
+            if (data.size() < kBloomHeaderBytes || std::memcmp(data.data(), kBloomMagic, sizeof(kBloomMagic)) != 0)
+            {
+                return std::nullopt;
+            }
+            const std::uint64_t probes = GetWord(data.data() + sizeof(kBloomMagic));
+            const std::uint64_t count = GetWord(data.data() + sizeof(kBloomMagic) + 8);
+            if (probes == 0 || probes > 30 || count > (data.size() - kBloomHeaderBytes) / 8 ||
+                data.size() != kBloomHeaderBytes + count * 8)
+            {
+                return std::nullopt;
+            }
+
+            BloomFilter filter;
+            filter.probes = static_cast<std::uint32_t>(probes);
+            filter.words.resize(static_cast<std::size_t>(count));
+            for (std::size_t index = 0; index < filter.words.size(); ++index)
+            {
+                filter.words[index] = GetWord(data.data() + kBloomHeaderBytes + index * 8);
+            }
+            return filter;
+        }
+    }
+}
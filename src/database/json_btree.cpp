@@ -0,0 +1,482 @@
+#include <database/json_btree.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace
+{
+constexpr std::uint64_t kLastPosition = std::numeric_limits<std::uint64_t>::max();
+
+std::uint64_t ShiftPosition(std::uint64_t position, const std::vector<std::size_t>& deleted)
+{
+    return position - static_cast<std::uint64_t>(std::lower_bound(deleted.begin(), deleted.end(), position) - deleted.begin());
+}
+
+template <typename Value>
+int Order(const Value& left, const Value& right)
+{
+    return left < right ? -1 : (right < left ? 1 : 0);
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        // A point in key order. Bounds are probes rather than keys because their
+        // text need not be in the index; rank puts numbers first, then strings,
+        // then the end of the tree.
+        struct BTreeIndex::Probe
+        {
+            int rank = 0;
+            double value = 0.0;
+            std::string_view text;
+            std::uint64_t position = 0;
+
+            int compareValue(const Probe& other) const
+            {
+                if (rank != other.rank)
+                {
+                    return Order(rank, other.rank);
+                }
+                return rank == 1 ? Order(text, other.text) : Order(value, other.value);
+            }
+
+            bool operator<(const Probe& other) const
+            {
+                const int order = compareValue(other);
+                return order < 0 || (order == 0 && position < other.position);
+            }
+        };
+
+        int CompareBTreeValues(const nlohmann::json& left, const nlohmann::json& right)
+        {
+            if (left.is_string() != right.is_string())
+            {
+                return left.is_string() ? 1 : -1;
+            }
+            if (left.is_string())
+            {
+                return Order(left.get_ref<const std::string&>(), right.get_ref<const std::string&>());
+            }
+            return Order(left.get<double>(), right.get<double>());
+        }
+
+        BTreeIndex::BTreeIndex(std::string indexedColumn, const TableRows& rows) : column(std::move(indexedColumn))
+        {
+            std::vector<BTreeKey> keys;
+            keys.reserve(rows.size());
+            for (std::size_t position = 0; position < rows.size(); ++position)
+            {
+                if (const std::optional<BTreeKey> key = keyFor(rows[position], position, true))
+                {
+                    keys.push_back(*key);
+                }
+            }
+            std::sort(keys.begin(), keys.end(), [this](const BTreeKey& left, const BTreeKey& right) {
+                return probe(left) < probe(right);
+            });
+            entries = keys.size();
+
+            if (keys.empty())
+            {
+                root = newPage(true);
+                return;
+            }
+
+            // Bulk load: pack full leaves left to right, then build each inner
+            // level over the one below it.
+            pages.reserve(keys.size() / kBTreeLeafCapacity + keys.size() / (kBTreeLeafCapacity * kBTreeInnerCapacity) + 2);
+            std::vector<std::uint32_t> level;
+            std::vector<BTreeKey> firstKeys;
+            for (std::size_t start = 0; start < keys.size(); start += kBTreeLeafCapacity)
+            {
+                const std::size_t end = std::min(start + kBTreeLeafCapacity, keys.size());
+                const std::uint32_t id = newPage(true);
+                BTreeLeafPage& leaf = pages[id].leaf;
+                std::copy(keys.begin() + static_cast<std::ptrdiff_t>(start), keys.begin() + static_cast<std::ptrdiff_t>(end), leaf.keys);
+                leaf.header.count = static_cast<std::uint32_t>(end - start);
+                if (!level.empty())
+                {
+                    leaf.header.prev = level.back();
+                    pages[level.back()].header().next = id;
+                }
+                level.push_back(id);
+                firstKeys.push_back(keys[start]);
+            }
+
+            while (level.size() > 1)
+            {
+                std::vector<std::uint32_t> parents;
+                std::vector<BTreeKey> parentFirstKeys;
+                for (std::size_t start = 0; start < level.size(); start += kBTreeInnerCapacity + 1)
+                {
+                    const std::size_t end = std::min(start + kBTreeInnerCapacity + 1, level.size());
+                    const std::uint32_t id = newPage(false);
+                    BTreeInnerPage& inner = pages[id].inner;
+                    for (std::size_t child = start; child < end; ++child)
+                    {
+                        inner.children[child - start] = level[child];
+                        if (child > start)
+                        {
+                            inner.keys[child - start - 1] = firstKeys[child];
+                        }
+                    }
+                    inner.header.count = static_cast<std::uint32_t>(end - start - 1);
+                    parents.push_back(id);
+                    parentFirstKeys.push_back(firstKeys[start]);
+                }
+                level = std::move(parents);
+                firstKeys = std::move(parentFirstKeys);
+            }
+            root = level.front();
+        }
+
+        std::size_t BTreeIndex::getHeight() const
+        {
+            std::size_t height = 1;
+            for (std::uint32_t id = root; !pages[id].header().leaf; id = pages[id].inner.children[0])
+            {
+                ++height;
+            }
+            return height;
+        }
+
+        BTreeIndex::Probe BTreeIndex::probe(const nlohmann::json& value, std::uint64_t position)
+        {
+            if (value.is_string())
+            {
+                return {1, 0.0, value.get_ref<const std::string&>(), position};
+            }
+            return {0, value.get<double>(), {}, position};
+        }
+
+        BTreeIndex::Probe BTreeIndex::probe(const BTreeKey& key) const
+        {
+            if (key.text == kNoBTreeText)
+            {
+                return {0, key.value, {}, key.position};
+            }
+            return {1, 0.0, texts[key.text], key.position};
+        }
+
+        std::uint32_t BTreeIndex::lowerSlot(const BTreeKey* keys, std::uint32_t count, const Probe& key) const
+        {
+            return static_cast<std::uint32_t>(
+                std::lower_bound(keys, keys + count, key, [this](const BTreeKey& entry, const Probe& target) { return probe(entry) < target; }) -
+                keys);
+        }
+
+        std::uint32_t BTreeIndex::upperSlot(const BTreeKey* keys, std::uint32_t count, const Probe& key) const
+        {
+            return static_cast<std::uint32_t>(
+                std::upper_bound(keys, keys + count, key, [this](const Probe& target, const BTreeKey& entry) { return target < probe(entry); }) -
+                keys);
+        }
+
+        std::optional<BTreeKey> BTreeIndex::keyFor(const nlohmann::json& row, std::size_t position, bool intern)
+        {
+            const auto value = row.find(column);
+            if (value == row.end())
+            {
+                return std::nullopt;
+            }
+            if (value->is_number())
+            {
+                return BTreeKey{value->get<double>(), position};
+            }
+            if (!value->is_string())
+            {
+                return std::nullopt;
+            }
+
+            const std::string& text = value->get_ref<const std::string&>();
+            auto found = textIds.find(text);
+            if (found == textIds.end())
+            {
+                if (!intern)
+                {
+                    return std::nullopt;
+                }
+                texts.push_back(text);
+                found = textIds.emplace(texts.back(), static_cast<std::uint32_t>(texts.size() - 1)).first;
+            }
+            return BTreeKey{0.0, position, found->second};
+        }
+
+        std::uint32_t BTreeIndex::newPage(bool leaf)
+        {
+            pages.emplace_back();
+            pages.back().header().leaf = leaf ? 1U : 0U;
+            return static_cast<std::uint32_t>(pages.size() - 1);
+        }
+
+        std::uint32_t BTreeIndex::findLeaf(const Probe& key) const
+        {
+            std::uint32_t id = root;
+            while (!pages[id].header().leaf)
+            {
+                const BTreeInnerPage& inner = pages[id].inner;
+                id = inner.children[upperSlot(inner.keys, inner.header.count, key)];
+            }
+            return id;
+        }
+
+        std::optional<BTreeIndex::Split> BTreeIndex::insertInto(std::uint32_t pageId, const BTreeKey& key)
+        {
+            const Probe target = probe(key);
+            if (pages[pageId].header().leaf)
+            {
+                std::uint32_t count = pages[pageId].leaf.header.count;
+                const std::uint32_t slot = lowerSlot(pages[pageId].leaf.keys, count, target);
+                if (count < kBTreeLeafCapacity)
+                {
+                    BTreeLeafPage& leaf = pages[pageId].leaf;
+                    std::copy_backward(leaf.keys + slot, leaf.keys + count, leaf.keys + count + 1);
+                    leaf.keys[slot] = key;
+                    ++leaf.header.count;
+                    return std::nullopt;
+                }
+
+                const std::uint32_t rightId = newPage(true);
+                BTreeLeafPage& left = pages[pageId].leaf;
+                BTreeLeafPage& right = pages[rightId].leaf;
+                const std::uint32_t half = count / 2;
+                std::copy(left.keys + half, left.keys + count, right.keys);
+                right.header.count = count - half;
+                left.header.count = half;
+                right.header.prev = pageId;
+                right.header.next = left.header.next;
+                if (left.header.next != kNoBTreePage)
+                {
+                    pages[left.header.next].header().prev = rightId;
+                }
+                left.header.next = rightId;
+
+                BTreeLeafPage& target = slot <= half ? left : right;
+                const std::uint32_t targetSlot = slot <= half ? slot : slot - half;
+                count = target.header.count;
+                std::copy_backward(target.keys + targetSlot, target.keys + count, target.keys + count + 1);
+                target.keys[targetSlot] = key;
+                ++target.header.count;
+                return Split{right.keys[0], rightId};
+            }
+
+            const std::uint32_t slot = upperSlot(pages[pageId].inner.keys, pages[pageId].inner.header.count, target);
+            const std::optional<Split> childSplit = insertInto(pages[pageId].inner.children[slot], key);
+            if (!childSplit.has_value())
+            {
+                return std::nullopt;
+            }
+
+            const std::uint32_t count = pages[pageId].inner.header.count;
+            if (count < kBTreeInnerCapacity)
+            {
+                BTreeInnerPage& inner = pages[pageId].inner;
+                std::copy_backward(inner.keys + slot, inner.keys + count, inner.keys + count + 1);
+                std::copy_backward(inner.children + slot + 1, inner.children + count + 1, inner.children + count + 2);
+                inner.keys[slot] = childSplit->separator;
+                inner.children[slot + 1] = childSplit->page;
+                ++inner.header.count;
+                return std::nullopt;
+            }
+
+            std::array<BTreeKey, kBTreeInnerCapacity + 1> keys;
+            std::array<std::uint32_t, kBTreeInnerCapacity + 2> children;
+            {
+                const BTreeInnerPage& inner = pages[pageId].inner;
+                std::copy(inner.keys, inner.keys + slot, keys.begin());
+                keys[slot] = childSplit->separator;
+                std::copy(inner.keys + slot, inner.keys + count, keys.begin() + slot + 1);
+                std::copy(inner.children, inner.children + slot + 1, children.begin());
+                children[slot + 1] = childSplit->page;
+                std::copy(inner.children + slot + 1, inner.children + count + 1, children.begin() + slot + 2);
+            }
+
+            const std::uint32_t rightId = newPage(false);
+            BTreeInnerPage& left = pages[pageId].inner;
+            BTreeInnerPage& right = pages[rightId].inner;
+            const std::size_t middle = keys.size() / 2;
+            std::copy(keys.begin(), keys.begin() + middle, left.keys);
+            std::copy(children.begin(), children.begin() + middle + 1, left.children);
+            left.header.count = static_cast<std::uint32_t>(middle);
+            std::copy(keys.begin() + middle + 1, keys.end(), right.keys);
+            std::copy(children.begin() + middle + 1, children.end(), right.children);
+            right.header.count = static_cast<std::uint32_t>(keys.size() - middle - 1);
+            return Split{keys[middle], rightId};
+        }
+
+        void BTreeIndex::insert(const BTreeKey& key)
+        {
+            const std::optional<Split> split = insertInto(root, key);
+            if (split.has_value())
+            {
+                const std::uint32_t newRoot = newPage(false);
+                BTreeInnerPage& inner = pages[newRoot].inner;
+                inner.children[0] = root;
+                inner.children[1] = split->page;
+                inner.keys[0] = split->separator;
+                inner.header.count = 1;
+                root = newRoot;
+            }
+            ++entries;
+        }
+
+        void BTreeIndex::erase(const BTreeKey& key)
+        {
+            // Leaves are allowed to run empty; scans simply step over them.
+            const Probe target = probe(key);
+            BTreeLeafPage& leaf = pages[findLeaf(target)].leaf;
+            BTreeKey* const end = leaf.keys + leaf.header.count;
+            BTreeKey* const found = leaf.keys + lowerSlot(leaf.keys, leaf.header.count, target);
+            if (found != end && !(target < probe(*found)))
+            {
+                std::copy(found + 1, end, found);
+                --leaf.header.count;
+                --entries;
+            }
+        }
+
+        void BTreeIndex::scan(
+            const std::optional<BTreeBound>& lower,
+            const std::optional<BTreeBound>& upper,
+            bool descending,
+            const std::function<bool(std::size_t)>& visit) const
+        {
+            // A bound on one type keeps the scan within that type, since numbers
+            // and strings never compare as ordered against each other.
+            std::optional<Probe> low;
+            std::optional<Probe> high;
+            const bool lowInclusive = !lower.has_value() || lower->inclusive;
+            const bool highInclusive = !upper.has_value() || upper->inclusive;
+            if (lower.has_value())
+            {
+                low = probe(lower->value, lowInclusive ? 0 : kLastPosition);
+            }
+            if (upper.has_value())
+            {
+                high = probe(upper->value, highInclusive ? kLastPosition : 0);
+            }
+            if (!high.has_value() && low.has_value() && low->rank == 0)
+            {
+                high = Probe{0, std::numeric_limits<double>::infinity(), {}, kLastPosition};
+            }
+            if (!low.has_value() && high.has_value() && high->rank == 1)
+            {
+                low = Probe{1, 0.0, {}, 0};
+            }
+            const auto belowLower = [&](const BTreeKey& key) {
+                const int order = low.has_value() ? probe(key).compareValue(*low) : 1;
+                return order < 0 || (order == 0 && !lowInclusive);
+            };
+            const auto aboveUpper = [&](const BTreeKey& key) {
+                const int order = high.has_value() ? probe(key).compareValue(*high) : -1;
+                return order > 0 || (order == 0 && !highInclusive);
+            };
+
+            if (!descending)
+            {
+                const Probe start = low.value_or(Probe{0, -std::numeric_limits<double>::infinity(), {}, 0});
+                std::uint32_t id = findLeaf(start);
+                const BTreeLeafPage* leaf = &pages[id].leaf;
+                std::uint32_t slot = lowerSlot(leaf->keys, leaf->header.count, start);
+                while (true)
+                {
+                    for (; slot < leaf->header.count; ++slot)
+                    {
+                        if (aboveUpper(leaf->keys[slot]) || !visit(static_cast<std::size_t>(leaf->keys[slot].position)))
+                        {
+                            return;
+                        }
+                    }
+                    id = leaf->header.next;
+                    if (id == kNoBTreePage)
+                    {
+                        return;
+                    }
+                    leaf = &pages[id].leaf;
+                    slot = 0;
+                }
+            }
+
+            // Walking backwards reverses ties too; buffer each run of equal values
+            // so they still come out in table order, as a stable sort would.
+            const Probe end = high.value_or(Probe{2, 0.0, {}, kLastPosition});
+            std::vector<std::size_t> run;
+            BTreeKey runKey;
+            const auto flush = [&]() {
+                for (auto it = run.rbegin(); it != run.rend(); ++it)
+                {
+                    if (!visit(*it))
+                    {
+                        return false;
+                    }
+                }
+                run.clear();
+                return true;
+            };
+
+            std::uint32_t id = findLeaf(end);
+            const BTreeLeafPage* leaf = &pages[id].leaf;
+            std::uint32_t slot = lowerSlot(leaf->keys, leaf->header.count, end);
+            while (true)
+            {
+                for (; slot > 0; --slot)
+                {
+                    const BTreeKey& key = leaf->keys[slot - 1];
+                    if (belowLower(key))
+                    {
+                        flush();
+                        return;
+                    }
+                    // Equal strings share a text id, so ids and values compare runs.
+                    if (!run.empty() && (key.text != runKey.text || key.value != runKey.value) && !flush())
+                    {
+                        return;
+                    }
+                    run.push_back(static_cast<std::size_t>(key.position));
+                    runKey = key;
+                }
+                id = leaf->header.prev;
+                if (id == kNoBTreePage)
+                {
+                    flush();
+                    return;
+                }
+                leaf = &pages[id].leaf;
+                slot = leaf->header.count;
+            }
+        }
+
+        void BTreeIndex::add(const nlohmann::json& row, std::size_t position)
+        {
+            if (const std::optional<BTreeKey> key = keyFor(row, position, true))
+            {
+                insert(*key);
+            }
+        }
+
+        void BTreeIndex::remove(const nlohmann::json& row, std::size_t position)
+        {
+            if (const std::optional<BTreeKey> key = keyFor(row, position, false))
+            {
+                erase(*key);
+            }
+        }
+
+        void BTreeIndex::removePositions(const std::vector<std::size_t>& deleted)
+        {
+            // Shifting is monotonic, so separators shifted the same way as the
+            // leaves still split their children correctly.
+            for (auto& page : pages)
+            {
+                BTreeKey* const keys = page.header().leaf ? page.leaf.keys : page.inner.keys;
+                for (std::uint32_t slot = 0; slot < page.header().count; ++slot)
+                {
+                    keys[slot].position = ShiftPosition(keys[slot].position, deleted);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,913 @@
+#include <database/json_columnar.h>
+
+#include <database/json_driver.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+using sql::jsondb::ColumnType;
+using sql::jsondb::CompareOp;
+
+constexpr std::size_t kTrailerBytes = 2 * sizeof(std::uint64_t) + sizeof(sql::jsondb::kColumnarMagic);
+
+std::size_t BitmapBytes(std::size_t rows)
+{
+    return (rows + 7) / 8;
+}
+
+std::size_t AlignTo8(std::size_t offset)
+{
+    return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+bool TestBit(const char* bitmap, std::size_t index)
+{
+    return (static_cast<unsigned char>(bitmap[index >> 3]) >> (index & 7)) & 1U;
+}
+
+template <typename Value>
+void AppendRaw(std::string& buffer, Value value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename Value>
+Value ReadRaw(const char* source)
+{
+    Value value;
+    std::memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+const char* ColumnTypeName(ColumnType type)
+{
+    switch (type)
+    {
+    case ColumnType::INT64:
+        return "int64";
+    case ColumnType::DOUBLE:
+        return "double";
+    case ColumnType::BOOL:
+        return "bool";
+    case ColumnType::STRING:
+        return "string";
+    case ColumnType::JSON:
+        break;
+    }
+    return "json";
+}
+
+ColumnType ParseColumnType(const std::string& name)
+{
+    for (const ColumnType type : {ColumnType::INT64, ColumnType::DOUBLE, ColumnType::BOOL, ColumnType::STRING})
+    {
+        if (name == ColumnTypeName(type))
+        {
+            return type;
+        }
+    }
+    return ColumnType::JSON;
+}
+
+ColumnType InferColumnType(const sql::jsondb::TableRows& rows, const std::string& column)
+{
+    bool ints = false;
+    bool floats = false;
+    bool bools = false;
+    bool strings = false;
+    for (const auto& row : rows)
+    {
+        const auto value = row.find(column);
+        if (value == row.end() || value->is_null())
+        {
+            continue;
+        }
+        if (value->is_number_integer() &&
+            (!value->is_number_unsigned() || value->get<std::uint64_t>() <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())))
+        {
+            ints = true;
+        }
+        else if (value->is_number_float())
+        {
+            floats = true;
+        }
+        else if (value->is_boolean())
+        {
+            bools = true;
+        }
+        else if (value->is_string())
+        {
+            strings = true;
+        }
+        else
+        {
+            return ColumnType::JSON;
+        }
+    }
+
+    const int kinds = static_cast<int>(ints) + static_cast<int>(floats) + static_cast<int>(bools) + static_cast<int>(strings);
+    if (kinds != 1)
+    {
+        return ColumnType::JSON;
+    }
+    return ints ? ColumnType::INT64 : floats ? ColumnType::DOUBLE : bools ? ColumnType::BOOL : ColumnType::STRING;
+}
+
+// Writes one column of one block and returns its directory entry.
+sql::jsondb::ColumnChunk WriteChunk(
+    std::string& buffer,
+    const sql::jsondb::TableRows& rows,
+    std::size_t begin,
+    std::size_t end,
+    const sql::jsondb::ColumnarColumn& column)
+{
+    buffer.resize(AlignTo8(buffer.size()), '\0');
+    sql::jsondb::ColumnChunk chunk;
+    chunk.offset = buffer.size();
+
+    const std::size_t count = end - begin;
+    std::string present(BitmapBytes(count), '\0');
+    std::string nonNull(BitmapBytes(count), '\0');
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        const auto value = rows[begin + index].find(column.name);
+        if (value == rows[begin + index].end())
+        {
+            ++chunk.nullCount;
+            continue;
+        }
+        present[index >> 3] = static_cast<char>(present[index >> 3] | (1 << (index & 7)));
+        if (value->is_null())
+        {
+            ++chunk.nullCount;
+            continue;
+        }
+        nonNull[index >> 3] = static_cast<char>(nonNull[index >> 3] | (1 << (index & 7)));
+    }
+    buffer += present;
+    buffer += nonNull;
+    buffer.resize(AlignTo8(buffer.size()), '\0');
+
+    const auto valueAt = [&](std::size_t index) -> const nlohmann::json* {
+        const auto value = rows[begin + index].find(column.name);
+        return value == rows[begin + index].end() || value->is_null() ? nullptr : &*value;
+    };
+    const auto track = [&](double number) {
+        chunk.min = chunk.min.has_value() ? std::min(*chunk.min, number) : number;
+        chunk.max = chunk.max.has_value() ? std::max(*chunk.max, number) : number;
+    };
+
+    switch (column.type)
+    {
+    case ColumnType::INT64:
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            const nlohmann::json* value = valueAt(index);
+            const std::int64_t number = value != nullptr ? value->get<std::int64_t>() : 0;
+            if (value != nullptr)
+            {
+                track(static_cast<double>(number));
+            }
+            AppendRaw(buffer, number);
+        }
+        break;
+    case ColumnType::DOUBLE:
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            const nlohmann::json* value = valueAt(index);
+            const double number = value != nullptr ? value->get<double>() : 0.0;
+            if (value != nullptr)
+            {
+                track(number);
+            }
+            AppendRaw(buffer, number);
+        }
+        break;
+    case ColumnType::BOOL:
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            const nlohmann::json* value = valueAt(index);
+            buffer += static_cast<char>(value != nullptr && value->get<bool>() ? 1 : 0);
+        }
+        break;
+    case ColumnType::STRING:
+    case ColumnType::JSON:
+    {
+        std::string blob;
+        std::vector<std::uint32_t> offsets;
+        offsets.reserve(count + 1);
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            offsets.push_back(static_cast<std::uint32_t>(blob.size()));
+            if (const nlohmann::json* value = valueAt(index))
+            {
+                blob += column.type == ColumnType::STRING ? value->get_ref<const std::string&>() : value->dump();
+            }
+            if (blob.size() > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw sql::jsondb::JsonDbException("Columnar block is too large for column: " + column.name);
+            }
+        }
+        offsets.push_back(static_cast<std::uint32_t>(blob.size()));
+        for (const std::uint32_t offset : offsets)
+        {
+            AppendRaw(buffer, offset);
+        }
+        buffer += blob;
+        break;
+    }
+    }
+
+    chunk.length = buffer.size() - chunk.offset;
+    return chunk;
+}
+
+template <typename Value, typename Compare>
+void CompareValues(const char* values, std::size_t rows, Compare compare, std::uint8_t* out)
+{
+    for (std::size_t index = 0; index < rows; ++index)
+    {
+        out[index] = compare(static_cast<double>(ReadRaw<Value>(values + index * sizeof(Value)))) ? 1 : 0;
+    }
+}
+
+template <typename Value>
+void CompareNumericColumn(const char* values, std::size_t rows, CompareOp op, double literal, std::uint8_t* out)
+{
+    switch (op)
+    {
+    case CompareOp::EQ:
+        CompareValues<Value>(values, rows, [literal](double value) { return value == literal; }, out);
+        break;
+    case CompareOp::NE:
+        CompareValues<Value>(values, rows, [literal](double value) { return value != literal; }, out);
+        break;
+    case CompareOp::LT:
+        CompareValues<Value>(values, rows, [literal](double value) { return value < literal; }, out);
+        break;
+    case CompareOp::LE:
+        CompareValues<Value>(values, rows, [literal](double value) { return value <= literal; }, out);
+        break;
+    case CompareOp::GT:
+        CompareValues<Value>(values, rows, [literal](double value) { return value > literal; }, out);
+        break;
+    case CompareOp::GE:
+        CompareValues<Value>(values, rows, [literal](double value) { return value >= literal; }, out);
+        break;
+    }
+}
+
+bool MatchesOrder(int order, CompareOp op)
+{
+    switch (op)
+    {
+    case CompareOp::EQ:
+        return order == 0;
+    case CompareOp::NE:
+        return order != 0;
+    case CompareOp::LT:
+        return order < 0;
+    case CompareOp::LE:
+        return order <= 0;
+    case CompareOp::GT:
+        return order > 0;
+    case CompareOp::GE:
+        return order >= 0;
+    }
+    return false;
+}
+
+// The footer JSON, padded with spaces to at least minBytes, then the trailer.
+std::string EncodeFooter(
+    std::uint64_t rowCount,
+    std::size_t blockRows,
+    const std::vector<sql::jsondb::ColumnarColumn>& columns,
+    const std::vector<sql::jsondb::ColumnarBlock>& blocks,
+    std::uint64_t footerOffset,
+    std::size_t minBytes = 0)
+{
+    nlohmann::json directory = nlohmann::json::array();
+    for (const auto& block : blocks)
+    {
+        nlohmann::json chunks = nlohmann::json::array();
+        for (const auto& chunk : block.chunks)
+        {
+            nlohmann::json entry = {{"offset", chunk.offset}, {"length", chunk.length}, {"nulls", chunk.nullCount}};
+            if (chunk.min.has_value())
+            {
+                entry["min"] = *chunk.min;
+                entry["max"] = *chunk.max;
+            }
+            chunks.push_back(std::move(entry));
+        }
+        directory.push_back({{"rows", block.rows}, {"chunks", std::move(chunks)}});
+    }
+
+    nlohmann::json footer = {{"rows", rowCount}, {"blockRows", blockRows}, {"columns", nlohmann::json::array()}, {"blocks", std::move(directory)}};
+    for (const auto& column : columns)
+    {
+        footer["columns"].push_back({{"name", column.name}, {"type", ColumnTypeName(column.type)}});
+    }
+
+    std::string encoded = footer.dump();
+    if (encoded.size() < minBytes)
+    {
+        encoded.append(minBytes - encoded.size(), ' ');
+    }
+    const std::uint64_t footerLength = encoded.size();
+    AppendRaw(encoded, footerOffset);
+    AppendRaw(encoded, footerLength);
+    encoded.append(sql::jsondb::kColumnarMagic, sizeof(sql::jsondb::kColumnarMagic));
+    return encoded;
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::string SerializeColumnarTable(const TableRows& rows, std::size_t blockRows)
+        {
+            std::vector<ColumnarColumn> columns;
+            std::unordered_map<std::string, std::size_t> seen;
+            for (const auto& row : rows)
+            {
+                if (!row.is_object())
+                {
+                    throw JsonDbException("Columnar tables can only hold JSON objects.");
+                }
+                for (auto it = row.begin(); it != row.end(); ++it)
+                {
+                    if (seen.emplace(it.key(), columns.size()).second)
+                    {
+                        columns.push_back({it.key(), ColumnType::JSON});
+                    }
+                }
+            }
+            for (auto& column : columns)
+            {
+                column.type = InferColumnType(rows, column.name);
+            }
+
+            std::string buffer(kColumnarMagic, sizeof(kColumnarMagic));
+            std::vector<ColumnarBlock> blocks;
+            for (std::size_t begin = 0; begin < rows.size(); begin += blockRows)
+            {
+                const std::size_t end = std::min(rows.size(), begin + blockRows);
+                ColumnarBlock block;
+                block.rows = static_cast<std::uint32_t>(end - begin);
+                for (const auto& column : columns)
+                {
+                    block.chunks.push_back(WriteChunk(buffer, rows, begin, end, column));
+                }
+                blocks.push_back(std::move(block));
+            }
+
+            const std::uint64_t footerOffset = buffer.size();
+            buffer += EncodeFooter(rows.size(), blockRows, columns, blocks, footerOffset);
+            return buffer;
+        }
+
+        bool IsColumnarFile(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            char magic[sizeof(kColumnarMagic)] = {};
+            file.read(magic, sizeof(magic));
+            return file.gcount() == static_cast<std::streamsize>(sizeof(magic)) &&
+                   std::memcmp(magic, kColumnarMagic, sizeof(magic)) == 0;
+        }
+
+        ColumnarTable::ColumnarTable(std::string filePath) : path(std::move(filePath))
+        {
+            const std::vector<FilePatch> patches = LoadPatchJournal(path);
+            // A rewritten footer may reach past the end of the file.
+            std::uint64_t extent = 0;
+            for (const auto& patch : patches)
+            {
+                extent = std::max<std::uint64_t>(extent, patch.offset + patch.bytes.size());
+            }
+#ifndef _WIN32
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                throw JsonDbException("Failed to open table file: " + path);
+            }
+            struct stat info;
+            if (::fstat(fd, &info) != 0)
+            {
+                ::close(fd);
+                throw JsonDbException("Failed to open table file: " + path);
+            }
+            size = static_cast<std::size_t>(info.st_size);
+            if (extent <= size)
+            {
+                // A leftover journal is applied to a private copy of the pages it touches.
+                const int protection = patches.empty() ? PROT_READ : PROT_READ | PROT_WRITE;
+                void* mapped = size > 0 ? ::mmap(nullptr, size, protection, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+                ::close(fd);
+                if (mapped == MAP_FAILED)
+                {
+                    throw JsonDbException("Invalid columnar table file: " + path);
+                }
+                data = static_cast<const char*>(mapped);
+            }
+            else
+            {
+                ::close(fd);
+            }
+#endif
+            if (data == nullptr)
+            {
+                std::ifstream file(path, std::ios::binary);
+                if (!file.is_open())
+                {
+                    throw JsonDbException("Failed to open table file: " + path);
+                }
+                buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                if (buffer.size() < extent)
+                {
+                    buffer.resize(static_cast<std::size_t>(extent), '\0');
+                }
+                data = buffer.data();
+                size = buffer.size();
+            }
+
+            try
+            {
+                for (const auto& patch : patches)
+                {
+                    if (patch.offset > size || patch.bytes.size() > size - patch.offset)
+                    {
+                        throw JsonDbException("Invalid patch journal for table file: " + path);
+                    }
+                    std::memcpy(const_cast<char*>(data) + patch.offset, patch.bytes.data(), patch.bytes.size());
+                }
+                if (size < sizeof(kColumnarMagic) + kTrailerBytes || std::memcmp(data, kColumnarMagic, sizeof(kColumnarMagic)) != 0 ||
+                    std::memcmp(data + size - sizeof(kColumnarMagic), kColumnarMagic, sizeof(kColumnarMagic)) != 0)
+                {
+                    throw JsonDbException("Invalid columnar table file: " + path);
+                }
+
+                footerOffset = ReadRaw<std::uint64_t>(data + size - kTrailerBytes);
+                footerLength = ReadRaw<std::uint64_t>(data + size - kTrailerBytes + sizeof(std::uint64_t));
+                if (footerOffset < sizeof(kColumnarMagic) || footerLength > size || footerOffset + footerLength != size - kTrailerBytes)
+                {
+                    throw JsonDbException("Invalid columnar table file: " + path);
+                }
+
+                const nlohmann::json footer = nlohmann::json::parse(data + footerOffset, data + footerOffset + footerLength);
+                rowCount = footer.at("rows").get<std::uint64_t>();
+                blockRows = footer.at("blockRows").get<std::size_t>();
+                for (const auto& column : footer.at("columns"))
+                {
+                    columns.push_back({column.at("name").get<std::string>(), ParseColumnType(column.at("type").get<std::string>())});
+                }
+                for (const auto& entry : footer.at("blocks"))
+                {
+                    ColumnarBlock block;
+                    block.rows = entry.at("rows").get<std::uint32_t>();
+                    for (const auto& chunkEntry : entry.at("chunks"))
+                    {
+                        ColumnChunk chunk;
+                        chunk.offset = chunkEntry.at("offset").get<std::uint64_t>();
+                        chunk.length = chunkEntry.at("length").get<std::uint64_t>();
+                        chunk.nullCount = chunkEntry.at("nulls").get<std::uint32_t>();
+                        if (chunkEntry.contains("min"))
+                        {
+                            chunk.min = chunkEntry.at("min").get<double>();
+                            chunk.max = chunkEntry.at("max").get<double>();
+                        }
+                        if (chunk.offset + chunk.length > footerOffset || chunk.offset % 8 != 0)
+                        {
+                            throw JsonDbException("Invalid columnar table file: " + path);
+                        }
+                        block.chunks.push_back(chunk);
+                    }
+                    if (block.chunks.size() != columns.size())
+                    {
+                        throw JsonDbException("Invalid columnar table file: " + path);
+                    }
+                    blocks.push_back(std::move(block));
+                }
+                buildZones();
+            }
+            catch (const nlohmann::json::exception&)
+            {
+                unmap();
+                throw JsonDbException("Invalid columnar table file: " + path);
+            }
+            catch (...)
+            {
+                unmap();
+                throw;
+            }
+        }
+
+        ColumnarTable::~ColumnarTable()
+        {
+            unmap();
+        }
+
+        void ColumnarTable::unmap()
+        {
+#ifndef _WIN32
+            if (data != nullptr && data != buffer.data())
+            {
+                ::munmap(const_cast<char*>(data), size);
+            }
+#endif
+            data = nullptr;
+        }
+
+        std::optional<std::size_t> ColumnarTable::findColumn(const std::string& name) const
+        {
+            for (std::size_t index = 0; index < columns.size(); ++index)
+            {
+                if (columns[index].name == name)
+                {
+                    return index;
+                }
+            }
+            return std::nullopt;
+        }
+
+        bool ColumnarTable::isPresent(std::size_t block, std::size_t column, std::size_t offset) const
+        {
+            return TestBit(data + blocks[block].chunks[column].offset, offset);
+        }
+
+        nlohmann::json ColumnarTable::readValue(std::size_t block, std::size_t column, std::size_t offset) const
+        {
+            const std::size_t rows = blocks[block].rows;
+            const char* chunk = data + blocks[block].chunks[column].offset;
+            if (!TestBit(chunk + BitmapBytes(rows), offset))
+            {
+                return nullptr;
+            }
+
+            const char* values = chunk + AlignTo8(2 * BitmapBytes(rows));
+            switch (columns[column].type)
+            {
+            case ColumnType::INT64:
+                return ReadRaw<std::int64_t>(values + offset * sizeof(std::int64_t));
+            case ColumnType::DOUBLE:
+                return ReadRaw<double>(values + offset * sizeof(double));
+            case ColumnType::BOOL:
+                return values[offset] != 0;
+            case ColumnType::STRING:
+            case ColumnType::JSON:
+                break;
+            }
+
+            const std::uint32_t begin = ReadRaw<std::uint32_t>(values + offset * sizeof(std::uint32_t));
+            const std::uint32_t end = ReadRaw<std::uint32_t>(values + (offset + 1) * sizeof(std::uint32_t));
+            const char* blob = values + (rows + 1) * sizeof(std::uint32_t);
+            if (columns[column].type == ColumnType::STRING)
+            {
+                return std::string(blob + begin, blob + end);
+            }
+            return nlohmann::json::parse(blob + begin, blob + end);
+        }
+
+        bool ColumnarTable::evaluateBlock(const PredicateNode& node, std::size_t block, std::vector<std::uint8_t>& selected) const
+        {
+            const std::size_t rows = blocks[block].rows;
+            if (node.kind != PredicateNode::Kind::COMPARE)
+            {
+                if (!evaluateBlock(*node.children.front(), block, selected))
+                {
+                    return false;
+                }
+                if (node.kind == PredicateNode::Kind::NOT)
+                {
+                    for (auto& flag : selected)
+                    {
+                        flag ^= 1;
+                    }
+                    return true;
+                }
+
+                std::vector<std::uint8_t> other(rows);
+                for (std::size_t child = 1; child < node.children.size(); ++child)
+                {
+                    if (!evaluateBlock(*node.children[child], block, other))
+                    {
+                        return false;
+                    }
+                    for (std::size_t index = 0; index < rows; ++index)
+                    {
+                        selected[index] = node.kind == PredicateNode::Kind::AND ? selected[index] & other[index] : selected[index] | other[index];
+                    }
+                }
+                return true;
+            }
+
+            // A missing value makes row evaluation throw, so those blocks keep the
+            // row-at-a-time semantics.
+            const std::optional<std::size_t> column = findColumn(node.column);
+            if (!column.has_value())
+            {
+                return false;
+            }
+            const char* chunk = data + blocks[block].chunks[*column].offset;
+            for (std::size_t index = 0; index < rows; ++index)
+            {
+                if (!TestBit(chunk, index))
+                {
+                    return false;
+                }
+            }
+
+            const ColumnType type = columns[*column].type;
+            const char* nonNull = chunk + BitmapBytes(rows);
+            const char* values = chunk + AlignTo8(2 * BitmapBytes(rows));
+            if (node.literal.is_null())
+            {
+                for (std::size_t index = 0; index < rows; ++index)
+                {
+                    selected[index] = node.op == CompareOp::EQ && !TestBit(nonNull, index) ? 1 : 0;
+                }
+                return true;
+            }
+
+            std::fill(selected.begin(), selected.end(), 0);
+            if (type == ColumnType::JSON)
+            {
+                return false;
+            }
+            if (type == ColumnType::INT64 && node.literal.is_number())
+            {
+                CompareNumericColumn<std::int64_t>(values, rows, node.op, node.numericLiteral, selected.data());
+            }
+            else if (type == ColumnType::DOUBLE && node.literal.is_number())
+            {
+                CompareNumericColumn<double>(values, rows, node.op, node.numericLiteral, selected.data());
+            }
+            else if (type == ColumnType::BOOL && node.literal.is_boolean() && (node.op == CompareOp::EQ || node.op == CompareOp::NE))
+            {
+                const bool literal = node.literal.get<bool>();
+                for (std::size_t index = 0; index < rows; ++index)
+                {
+                    selected[index] = ((values[index] != 0) == literal) == (node.op == CompareOp::EQ) ? 1 : 0;
+                }
+            }
+            else if (type == ColumnType::STRING && node.literal.is_string())
+            {
+                const std::string& literal = node.literal.get_ref<const std::string&>();
+                const char* blob = values + (rows + 1) * sizeof(std::uint32_t);
+                for (std::size_t index = 0; index < rows; ++index)
+                {
+                    const std::uint32_t begin = ReadRaw<std::uint32_t>(values + index * sizeof(std::uint32_t));
+                    const std::uint32_t end = ReadRaw<std::uint32_t>(values + (index + 1) * sizeof(std::uint32_t));
+                    const int order = std::string_view(blob + begin, end - begin).compare(literal);
+                    selected[index] = MatchesOrder(order, node.op) ? 1 : 0;
+                }
+            }
+
+            for (std::size_t index = 0; index < rows; ++index)
+            {
+                selected[index] &= static_cast<std::uint8_t>(TestBit(nonNull, index));
+            }
+            return true;
+        }
+
+        void ColumnarTable::buildZones()
+        {
+            // A chunk's min/max only covers its numbers, so a block's zone keeps
+            // just the numeric columns that no row leaves missing or null.
+            for (const ColumnarBlock& block : blocks)
+            {
+                Zone zone;
+                zone.rows = block.rows;
+                for (std::size_t column = 0; column < columns.size(); ++column)
+                {
+                    const ColumnChunk& chunk = block.chunks[column];
+                    const ColumnType type = columns[column].type;
+                    if ((type == ColumnType::INT64 || type == ColumnType::DOUBLE) && chunk.nullCount == 0 && chunk.min.has_value())
+                    {
+                        ColumnZone& columnZone = zone.columns[columns[column].name];
+                        columnZone.present = block.rows;
+                        columnZone.numbers = block.rows;
+                        columnZone.min = chunk.min;
+                        columnZone.max = chunk.max;
+                    }
+                }
+                zones.push_back(std::move(zone));
+            }
+        }
+
+        ScanStats ColumnarTable::scan(const Predicate& predicate, const std::function<bool(std::size_t)>& visit) const
+        {
+            return scan(predicate, visit, 0, blocks.size());
+        }
+
+        ScanStats ColumnarTable::scan(
+            const Predicate& predicate,
+            const std::function<bool(std::size_t)>& visit,
+            std::size_t firstBlock,
+            std::size_t endBlock) const
+        {
+            const std::vector<std::string> predicateColumns = predicate.getReferencedColumns();
+            std::vector<std::uint8_t> selected;
+            ScanStats stats;
+            std::size_t first = firstBlock * blockRows;
+            for (std::size_t block = firstBlock; block < std::min(endBlock, blocks.size()); first += blocks[block].rows, ++block)
+            {
+                if (!predicate.empty() && !ZoneMayMatch(*predicate.getRoot(), zones[block]))
+                {
+                    ++stats.blocksSkipped;
+                    continue;
+                }
+                ++stats.blocksScanned;
+                selected.assign(blocks[block].rows, 1);
+                const bool vectorized = predicate.empty() || evaluateBlock(*predicate.getRoot(), block, selected);
+                for (std::size_t index = 0; index < selected.size(); ++index)
+                {
+                    const bool matches = vectorized ? selected[index] != 0 : predicate.matches(readRow(first + index, predicateColumns));
+                    if (matches && !visit(first + index))
+                    {
+                        return stats;
+                    }
+                }
+            }
+            return stats;
+        }
+
+        nlohmann::json ColumnarTable::readRow(std::size_t position, const std::vector<std::string>& wanted) const
+        {
+            const std::size_t block = position / blockRows;
+            const std::size_t offset = position % blockRows;
+            nlohmann::json row = nlohmann::json::object();
+            const auto readColumn = [&](std::size_t column) {
+                if (isPresent(block, column, offset))
+                {
+                    row[columns[column].name] = readValue(block, column, offset);
+                }
+            };
+
+            if (wanted.empty())
+            {
+                for (std::size_t column = 0; column < columns.size(); ++column)
+                {
+                    readColumn(column);
+                }
+                return row;
+            }
+            for (const auto& name : wanted)
+            {
+                if (const std::optional<std::size_t> column = findColumn(name))
+                {
+                    readColumn(*column);
+                }
+            }
+            return row;
+        }
+
+        bool ColumnarTable::planUpdate(
+            std::size_t position,
+            const nlohmann::json& before,
+            const nlohmann::json& after,
+            ColumnarUpdatePlan& plan) const
+        {
+            if (!before.is_object() || !after.is_object() || before.size() != after.size() || position >= rowCount)
+            {
+                return false;
+            }
+
+            const std::size_t block = position / blockRows;
+            const std::size_t offset = position % blockRows;
+            const std::size_t rows = blocks[block].rows;
+            for (auto it = after.begin(); it != after.end(); ++it)
+            {
+                const auto previous = before.find(it.key());
+                if (previous == before.end())
+                {
+                    return false;
+                }
+                if (*previous == it.value() && previous->type() == it.value().type())
+                {
+                    continue;
+                }
+
+                const std::optional<std::size_t> column = findColumn(it.key());
+                if (!column.has_value() || previous->is_null() || it.value().is_null())
+                {
+                    return false;
+                }
+                const ColumnChunk& chunk = blocks[block].chunks[*column];
+                const std::uint64_t valueOffset = chunk.offset + AlignTo8(2 * BitmapBytes(rows));
+                // A value past the block's min/max widens it in the plan's copy
+                // of the directory, which finishUpdate writes back.
+                const auto withinRange = [&](double number) {
+                    if (!chunk.min.has_value())
+                    {
+                        return false;
+                    }
+                    if (number >= *chunk.min && number <= *chunk.max)
+                    {
+                        return true;
+                    }
+                    if (plan.blocks.empty())
+                    {
+                        plan.blocks = blocks;
+                    }
+                    ColumnChunk& widened = plan.blocks[block].chunks[*column];
+                    widened.min = std::min(*widened.min, number);
+                    widened.max = std::max(*widened.max, number);
+                    return true;
+                };
+                const nlohmann::json& value = it.value();
+                FilePatch patch;
+                switch (columns[*column].type)
+                {
+                case ColumnType::INT64:
+                {
+                    if (!value.is_number_integer() ||
+                        (value.is_number_unsigned() && value.get<std::uint64_t>() > static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())))
+                    {
+                        return false;
+                    }
+                    const std::int64_t number = value.get<std::int64_t>();
+                    if (!withinRange(static_cast<double>(number)))
+                    {
+                        return false;
+                    }
+                    patch.offset = valueOffset + offset * sizeof(number);
+                    AppendRaw(patch.bytes, number);
+                    break;
+                }
+                case ColumnType::DOUBLE:
+                {
+                    if (!value.is_number_float() || !withinRange(value.get<double>()))
+                    {
+                        return false;
+                    }
+                    patch.offset = valueOffset + offset * sizeof(double);
+                    AppendRaw(patch.bytes, value.get<double>());
+                    break;
+                }
+                case ColumnType::BOOL:
+                    if (!value.is_boolean())
+                    {
+                        return false;
+                    }
+                    patch.offset = valueOffset + offset;
+                    patch.bytes = static_cast<char>(value.get<bool>() ? 1 : 0);
+                    break;
+                case ColumnType::STRING:
+                case ColumnType::JSON:
+                    return false;
+                }
+                plan.patches.push_back(std::move(patch));
+            }
+            return true;
+        }
+
+        std::vector<FilePatch> ColumnarTable::finishUpdate(ColumnarUpdatePlan plan) const
+        {
+            if (!plan.blocks.empty())
+            {
+                // The footer never shrinks, so the new trailer always ends the file.
+                FilePatch footer;
+                footer.offset = footerOffset;
+                footer.bytes = EncodeFooter(rowCount, blockRows, columns, plan.blocks, footerOffset, static_cast<std::size_t>(footerLength));
+                plan.patches.push_back(std::move(footer));
+            }
+            return std::move(plan.patches);
+        }
+
+        TableRows ColumnarTable::readRows() const
+        {
+            TableRows rows(static_cast<std::size_t>(rowCount), nlohmann::json::object());
+            std::size_t first = 0;
+            for (std::size_t block = 0; block < blocks.size(); first += blocks[block].rows, ++block)
+            {
+                for (std::size_t column = 0; column < columns.size(); ++column)
+                {
+                    for (std::size_t offset = 0; offset < blocks[block].rows; ++offset)
+                    {
+                        if (isPresent(block, column, offset))
+                        {
+                            rows[first + offset][columns[column].name] = readValue(block, column, offset);
+                        }
+                    }
+                }
+            }
+            return rows;
+        }
+    }
+}
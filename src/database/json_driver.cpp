@@ -1,12 +1,18 @@
 #include <database/json_driver.h>
 
+#include <core/sql_parser.h>
+#include <database/json_predicate.h>
+#include <database/json_storage.h>
+
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <filesystem>
 #include <fstream>
-#include <iomanip>
+#include <iterator>
 #include <regex>
-#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
@@ -25,17 +31,6 @@ std::string Trim(const std::string& value)
     return value.substr(start, end - start + 1);
 }
 
-std::string ToLowerCopy(const std::string& value)
-{
-    std::string lower = value;
-    std::transform(
-        lower.begin(),
-        lower.end(),
-        lower.begin(),
-        [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
-    return lower;
-}
-
 std::string EscapeSqlString(const std::string& value)
 {
     std::string escaped;
@@ -51,183 +46,202 @@ std::string EscapeSqlString(const std::string& value)
     return escaped;
 }
 
-std::string RemoveTrailingSemicolon(const std::string& sql)
+SqlStatement ParseStatement(const std::string& sql, const std::string& errorPrefix)
 {
-    std::string trimmed = Trim(sql);
-    if (!trimmed.empty() && trimmed.back() == ';')
+    try
     {
-        trimmed.pop_back();
-        trimmed = Trim(trimmed);
+        return SqlAstParser().parse(sql);
+    }
+    catch (const SqlSyntaxError& ex)
+    {
+        throw sql::jsondb::JsonDbException(errorPrefix + sql + " (" + ex.what() + ")");
     }
-    return trimmed;
-}
-
-std::string JsonSchemaFilePath(const std::string& dbPath, const std::string& tableName)
-{
-    fs::path path(dbPath);
-    path /= tableName + ".schema.json";
-    return path.string();
 }
 
-std::vector<std::string> SplitCommaAware(const std::string& input)
+void SortRows(std::vector<nlohmann::json>& rows, const std::vector<SqlOrderItem>& orderBy)
 {
-    std::vector<std::string> items;
-    std::string current;
-    char quoteChar = 0;
-    int parenDepth = 0;
+    if (orderBy.empty())
+    {
+        return;
+    }
 
-    for (const char ch : input)
+    for (const auto& row : rows)
     {
-        if (quoteChar != 0)
+        for (const auto& item : orderBy)
         {
-            current += ch;
-            if (ch == quoteChar)
+            if (!row.contains(item.column))
             {
-                quoteChar = 0;
+                throw sql::jsondb::JsonDbException("Column does not exist in ORDER BY clause: " + item.column);
             }
-            continue;
-        }
-
-        if (ch == '\'' || ch == '"')
-        {
-            quoteChar = ch;
-            current += ch;
-            continue;
-        }
-
-        if (ch == '(')
-        {
-            ++parenDepth;
-        }
-        else if (ch == ')' && parenDepth > 0)
-        {
-            --parenDepth;
         }
+    }
 
-        if (ch == ',' && parenDepth == 0)
-        {
-            items.push_back(Trim(current));
-            current.clear();
-            continue;
-        }
+    std::stable_sort(
+        rows.begin(),
+        rows.end(),
+        [&](const nlohmann::json& left, const nlohmann::json& right) {
+            for (const auto& item : orderBy)
+            {
+                const nlohmann::json& lhs = left.at(item.column);
+                const nlohmann::json& rhs = right.at(item.column);
+                if (lhs < rhs)
+                {
+                    return !item.descending;
+                }
+                if (rhs < lhs)
+                {
+                    return item.descending;
+                }
+            }
+            return false;
+        });
+}
 
-        current += ch;
+void ApplyOffsetAndLimit(std::vector<nlohmann::json>& rows, std::size_t offset, const std::optional<std::size_t>& limit)
+{
+    if (offset >= rows.size())
+    {
+        rows.clear();
+        return;
     }
 
-    if (!Trim(current).empty())
+    rows.erase(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(offset));
+    if (limit.has_value() && *limit < rows.size())
     {
-        items.push_back(Trim(current));
+        rows.resize(*limit);
     }
-
-    return items;
 }
 
-std::vector<std::string> SplitConditions(const std::string& input)
+std::shared_ptr<sql::jsondb::ResultSet> BuildResultSet(const sql::jsondb::QueryPlan& plan, std::vector<nlohmann::json> rows)
 {
-    std::vector<std::string> parts;
-    std::string current;
-    char quoteChar = 0;
-
-    for (std::size_t i = 0; i < input.size(); ++i)
+    ApplyOffsetAndLimit(rows, plan.offset, plan.limit);
+    if (plan.projection.empty())
     {
-        const char ch = input[i];
-        if (quoteChar != 0)
-        {
-            current += ch;
-            if (ch == quoteChar)
-            {
-                quoteChar = 0;
-            }
-            continue;
-        }
-
-        if (ch == '\'' || ch == '"')
-        {
-            quoteChar = ch;
-            current += ch;
-            continue;
-        }
+        return std::make_shared<sql::jsondb::ResultSet>(rows);
+    }
 
-        if (i + 4 <= input.size())
+    std::vector<nlohmann::json> projectedRows;
+    projectedRows.reserve(rows.size());
+    for (auto& row : rows)
+    {
+        nlohmann::json projected = nlohmann::json::object();
+        for (const auto& column : plan.projection)
         {
-            const std::string token = ToLowerCopy(input.substr(i, 4));
-            const bool hasWordBoundaryBefore = (i == 0) || std::isspace(static_cast<unsigned char>(input[i - 1]));
-            const bool hasWordBoundaryAfter =
-                (i + 4 == input.size()) || std::isspace(static_cast<unsigned char>(input[i + 3]));
-            if (token == "and " && hasWordBoundaryBefore && hasWordBoundaryAfter)
+            const auto value = row.find(column);
+            if (value == row.end())
             {
-                parts.push_back(Trim(current));
-                current.clear();
-                i += 3;
-                continue;
+                if (projected.contains(column))
+                {
+                    continue;
+                }
+                throw sql::jsondb::JsonDbException("Column does not exist: " + column);
             }
+            projected[column] = std::move(*value);
+            row.erase(value);
         }
-
-        current += ch;
-    }
-
-    if (!Trim(current).empty())
-    {
-        parts.push_back(Trim(current));
+        projectedRows.push_back(std::move(projected));
     }
 
-    return parts;
+    return std::make_shared<sql::jsondb::ResultSet>(projectedRows, plan.projection);
 }
 
-nlohmann::json ParseScalarValue(const std::string& token)
+sql::jsondb::TableFormat ParseTableEngine(const std::string& engine)
 {
-    const std::string value = Trim(token);
-    if (value.empty())
+    if (engine.empty() || engine == "JSON")
     {
-        return "";
+        return sql::jsondb::TableFormat::JSON;
     }
-
-    if ((value.front() == '\'' && value.back() == '\'') || (value.front() == '"' && value.back() == '"'))
+    if (engine == "COLUMNAR")
     {
-        return value.substr(1, value.size() - 2);
+        return sql::jsondb::TableFormat::COLUMNAR;
     }
-
-    const std::string lower = ToLowerCopy(value);
-    if (lower == "true")
+    if (engine == "NDJSON")
     {
-        return true;
+        return sql::jsondb::TableFormat::NDJSON;
     }
-    if (lower == "false")
+    if (engine == "LSM")
     {
-        return false;
+        return sql::jsondb::TableFormat::LSM;
     }
-    if (lower == "null")
+    if (engine == "PAGED")
     {
-        return nullptr;
+        return sql::jsondb::TableFormat::PAGED;
     }
+    throw sql::jsondb::JsonDbException("Unsupported table engine: " + engine);
+}
 
-    try
+bool EndsLineAt(const std::string& path, std::uint64_t size)
+{
+    if (size == 0)
+    {
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(size - 1));
+    return file.get() == '\n';
+}
+
+// Keeps only the columns a query still needs once a row has passed its filter.
+nlohmann::json KeepColumns(nlohmann::json& row, const std::vector<std::string>& columns)
+{
+    if (columns.empty() || !row.is_object())
+    {
+        return std::move(row);
+    }
+
+    nlohmann::json kept = nlohmann::json::object();
+    for (const auto& column : columns)
     {
-        std::size_t parsed = 0;
-        const long long integerValue = std::stoll(value, &parsed);
-        if (parsed == value.size())
+        const auto value = row.find(column);
+        if (value != row.end())
         {
-            return integerValue;
+            kept[column] = std::move(*value);
         }
     }
-    catch (const std::exception&)
+    return kept;
+}
+
+nlohmann::json CopyColumns(const nlohmann::json& row, const std::vector<std::string>& columns)
+{
+    if (columns.empty() || !row.is_object())
     {
+        return row;
     }
 
-    try
+    nlohmann::json kept = nlohmann::json::object();
+    for (const auto& column : columns)
     {
-        std::size_t parsed = 0;
-        const double floatingValue = std::stod(value, &parsed);
-        if (parsed == value.size())
+        const auto value = row.find(column);
+        if (value != row.end())
         {
-            return floatingValue;
+            kept[column] = *value;
         }
     }
-    catch (const std::exception&)
+    return kept;
+}
+
+constexpr std::size_t kParallelScanMinRows = 16384;
+
+// Runs scanRange over each range on the pool. Every range collects into its own
+// vector and the vectors are joined in range order, so results keep table order.
+template <typename RangeScan>
+std::vector<nlohmann::json> CollectInParallel(sql::jsondb::ThreadPool& pool, std::size_t ranges, RangeScan&& scanRange)
+{
+    std::vector<std::vector<nlohmann::json>> parts(ranges);
+    pool.run(ranges, [&](std::size_t range) { scanRange(range, parts[range]); });
+
+    std::size_t total = 0;
+    for (const auto& part : parts)
+    {
+        total += part.size();
+    }
+    std::vector<nlohmann::json> rows;
+    rows.reserve(total);
+    for (auto& part : parts)
     {
+        rows.insert(rows.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
     }
-
-    return value;
+    return rows;
 }
 
 sql::jsondb::DataType DetectJsonType(const nlohmann::json& value)
@@ -258,51 +272,238 @@ sql::jsondb::DataType DetectJsonType(const nlohmann::json& value)
     return DataType::UNKOWN;
 }
 
-bool CompareValues(const nlohmann::json& left, const std::string& op, const nlohmann::json& right)
+// Visits candidate row positions in table order and returns the access path
+// that produced them; plans fall back to a full scan when the index is absent.
+template <typename Visitor>
+sql::jsondb::AccessPath ScanCandidates(
+    const sql::jsondb::ScanPlan& plan,
+    const sql::jsondb::TableRows& rows,
+    const sql::jsondb::TableIndexes* indexes,
+    Visitor&& visit)
 {
-    if (left.is_number() && right.is_number())
+    using sql::jsondb::AccessPath;
+
+    const auto visitAll = [&](const std::vector<std::size_t>& positions) {
+        for (const std::size_t position : positions)
+        {
+            if (!visit(position))
+            {
+                return;
+            }
+        }
+    };
+
+    if (plan.accessPath == AccessPath::PRIMARY_KEY && indexes != nullptr)
+    {
+        if (const sql::jsondb::PrimaryKeyIndex* index = indexes->getPrimaryKey())
+        {
+            const std::optional<std::string> key = index->keyOf(plan.indexKey);
+            const std::optional<std::size_t> position = key.has_value() ? index->lookup(*key) : std::nullopt;
+            if (position.has_value())
+            {
+                visit(*position);
+            }
+            return AccessPath::PRIMARY_KEY;
+        }
+    }
+
+    if (plan.accessPath == AccessPath::HASH_INDEX && indexes != nullptr)
     {
-        const double lhs = left.get<double>();
-        const double rhs = right.get<double>();
-        if (op == "=")
+        if (const sql::jsondb::HashIndex* index = indexes->find(plan.indexColumn))
         {
-            return lhs == rhs;
+            if (const std::vector<std::size_t>* positions = index->lookup(plan.indexKey))
+            {
+                visitAll(*positions);
+            }
+            return AccessPath::HASH_INDEX;
         }
-        if (op == "!=")
+    }
+
+    if (plan.accessPath == AccessPath::BTREE_RANGE && indexes != nullptr &&
+        (plan.lowerBound.has_value() || plan.upperBound.has_value()))
+    {
+        if (const sql::jsondb::BTreeIndex* index = indexes->findOrdered(plan.indexColumn))
         {
-            return lhs != rhs;
+            std::vector<std::size_t> positions;
+            index->scan(plan.lowerBound, plan.upperBound, false, [&](std::size_t position) {
+                positions.push_back(position);
+                return true;
+            });
+            std::sort(positions.begin(), positions.end());
+            visitAll(positions);
+            return AccessPath::BTREE_RANGE;
         }
-        if (op == ">")
+    }
+
+    for (std::size_t position = 0; position < rows.size(); ++position)
+    {
+        if (!visit(position))
         {
-            return lhs > rhs;
+            break;
         }
-        if (op == "<")
+    }
+    return AccessPath::FULL_SCAN;
+}
+
+// Mutations evaluated without the connection's indexes (WAL group commits)
+// build a throwaway key map instead.
+const sql::jsondb::PrimaryKeyIndex& ResolvePrimaryKey(
+    const std::vector<std::string>& primaryKey,
+    const sql::jsondb::TableRows& rows,
+    const sql::jsondb::TableIndexes* indexes,
+    std::optional<sql::jsondb::PrimaryKeyIndex>& scratch)
+{
+    const sql::jsondb::PrimaryKeyIndex* index = indexes != nullptr ? indexes->getPrimaryKey() : nullptr;
+    if (index != nullptr && index->getColumns() == primaryKey)
+    {
+        return *index;
+    }
+    return scratch.emplace(primaryKey, rows);
+}
+
+std::string RequirePrimaryKey(const sql::jsondb::PrimaryKeyIndex& index, const nlohmann::json& row)
+{
+    if (std::optional<std::string> key = index.keyOf(row))
+    {
+        return std::move(*key);
+    }
+    for (const auto& column : index.getColumns())
+    {
+        if (!row.contains(column) || row.at(column).is_null())
         {
-            return lhs < rhs;
+            throw sql::jsondb::JsonDbException("Primary key column cannot be null: " + column);
         }
-        if (op == ">=")
+    }
+    throw sql::jsondb::JsonDbException("Primary key is incomplete.");
+}
+
+[[noreturn]] void ThrowDuplicateKey(const sql::jsondb::PrimaryKeyIndex& index, const nlohmann::json& row)
+{
+    std::string entry;
+    for (const auto& column : index.getColumns())
+    {
+        const nlohmann::json& value = row.at(column);
+        entry += entry.empty() ? "" : "-";
+        entry += value.is_string() ? value.get<std::string>() : value.dump();
+    }
+    throw sql::jsondb::JsonDbException("Duplicate entry '" + entry + "' for key 'PRIMARY'");
+}
+
+void CheckNewPrimaryKeys(
+    const std::vector<std::string>& primaryKey,
+    const sql::jsondb::TableRows& tableData,
+    const sql::jsondb::TableIndexes* indexes,
+    const sql::jsondb::TableRows& rows)
+{
+    if (primaryKey.empty())
+    {
+        return;
+    }
+
+    std::optional<sql::jsondb::PrimaryKeyIndex> scratch;
+    const sql::jsondb::PrimaryKeyIndex& index = ResolvePrimaryKey(primaryKey, tableData, indexes, scratch);
+    std::unordered_set<std::string> batch;
+    for (const auto& row : rows)
+    {
+        const std::string key = RequirePrimaryKey(index, row);
+        if (index.lookup(key).has_value() || !batch.insert(key).second)
         {
-            return lhs >= rhs;
+            ThrowDuplicateKey(index, row);
         }
-        if (op == "<=")
+    }
+}
+
+// Point lookups through the tree, so inserts never materialize the table.
+void CheckNewLsmKeys(const std::vector<std::string>& primaryKey, sql::jsondb::LsmTree& lsm, const sql::jsondb::TableRows& rows)
+{
+    const sql::jsondb::PrimaryKeyIndex index(primaryKey, {});
+    std::unordered_set<std::string> batch;
+    for (const auto& row : rows)
+    {
+        const std::string key = RequirePrimaryKey(index, row);
+        if (!batch.insert(key).second || lsm.get(key).has_value())
         {
-            return lhs <= rhs;
+            ThrowDuplicateKey(index, row);
         }
     }
+}
 
-    if ((left.is_boolean() && right.is_boolean()) || (left.is_string() && right.is_string()) || (left.is_null() && right.is_null()))
+// Checked against the key map sidecar, so inserts into NDJSON tables never
+// load the rows already there.
+void CheckNewMappedKeys(const sql::jsondb::KeyMap& keyMap, const sql::jsondb::TableRows& rows)
+{
+    const sql::jsondb::PrimaryKeyIndex index(keyMap.columns, {});
+    std::unordered_set<std::string> batch;
+    for (const auto& row : rows)
     {
-        if (op == "=")
+        const std::string key = RequirePrimaryKey(index, row);
+        if (!batch.insert(key).second || keyMap.positions.count(key) != 0)
         {
-            return left == right;
+            ThrowDuplicateKey(index, row);
         }
-        if (op == "!=")
+    }
+}
+
+// Updated rows may take over keys from each other but not from rows the
+// statement leaves alone.
+void CheckUpdatedPrimaryKeys(
+    const std::vector<std::string>& primaryKey,
+    const sql::jsondb::TableRows& tableData,
+    const sql::jsondb::TableIndexes* indexes,
+    const sql::jsondb::TableChange& change)
+{
+    std::optional<sql::jsondb::PrimaryKeyIndex> scratch;
+    const sql::jsondb::PrimaryKeyIndex& index = ResolvePrimaryKey(primaryKey, tableData, indexes, scratch);
+    const std::unordered_set<std::size_t> moving(change.positions.begin(), change.positions.end());
+    std::unordered_set<std::string> batch;
+    for (const auto& row : change.rows)
+    {
+        const std::string key = RequirePrimaryKey(index, row);
+        const std::optional<std::size_t> owner = index.lookup(key);
+        if ((owner.has_value() && moving.count(*owner) == 0) || !batch.insert(key).second)
         {
-            return left != right;
+            ThrowDuplicateKey(index, row);
         }
     }
+}
+
+// REPLACE semantics: rows whose key exists overwrite that row in place, the
+// rest are appended, and later rows in the statement win over earlier ones.
+sql::jsondb::TableChange BuildUpsertChange(
+    const std::string& table,
+    const std::vector<std::string>& primaryKey,
+    const sql::jsondb::TableRows& tableData,
+    const sql::jsondb::TableIndexes* indexes,
+    const sql::jsondb::TableRows& rows)
+{
+    std::optional<sql::jsondb::PrimaryKeyIndex> scratch;
+    const sql::jsondb::PrimaryKeyIndex& index = ResolvePrimaryKey(primaryKey, tableData, indexes, scratch);
 
-    return false;
+    sql::jsondb::TableChange change{sql::jsondb::TableChange::Kind::UPSERT, table, {}, {}};
+    sql::jsondb::TableRows appended;
+    std::unordered_map<std::string, std::pair<bool, std::size_t>> slots;
+    for (const auto& row : rows)
+    {
+        std::string key = RequirePrimaryKey(index, row);
+        const auto slot = slots.find(key);
+        if (slot != slots.end())
+        {
+            (slot->second.first ? appended : change.rows)[slot->second.second] = row;
+        }
+        else if (const std::optional<std::size_t> position = index.lookup(key))
+        {
+            change.positions.push_back(*position);
+            slots.emplace(std::move(key), std::make_pair(false, change.rows.size()));
+            change.rows.push_back(row);
+        }
+        else
+        {
+            slots.emplace(std::move(key), std::make_pair(true, appended.size()));
+            appended.push_back(row);
+        }
+    }
+    change.rows.insert(change.rows.end(), std::make_move_iterator(appended.begin()), std::make_move_iterator(appended.end()));
+    return change;
 }
 }
 
@@ -332,6 +533,8 @@ namespace sql
             {
                 throw JsonDbException("Database path is not a directory: " + dbPath);
             }
+
+            wal = WriteAheadLog::open(dbPath);
         }
 
         Connection::~Connection() noexcept
@@ -341,6 +544,10 @@ namespace sql
 
         void Connection::close() noexcept
         {
+            transaction = Transaction();
+            wal.reset();
+            lsmTrees.clear();
+            pagedTables.clear();
             closed = true;
         }
 
@@ -354,12 +561,60 @@ namespace sql
             return std::make_shared<PreparedStatement>(shared_from_this(), sql);
         }
 
+        void Connection::setAutoCommit(bool enabled)
+        {
+            if (enabled && !autoCommit)
+            {
+                commit();
+            }
+            autoCommit = enabled;
+        }
+
         void Connection::commit()
         {
+            if (transaction.empty())
+            {
+                return;
+            }
+
+            Transaction committing = std::move(transaction);
+            transaction = Transaction();
+            for (const auto& [table, rows] : committing.tables)
+            {
+                indexCache.erase(table);
+            }
+            if (wal == nullptr)
+            {
+                throw JsonDbException("Connection is closed.");
+            }
+            wal->commit(committing);
         }
 
         void Connection::rollback()
         {
+            for (const auto& [table, rows] : transaction.tables)
+            {
+                indexCache.erase(table);
+            }
+            transaction = Transaction();
+        }
+
+        void Connection::checkpoint()
+        {
+            if (wal != nullptr)
+            {
+                wal->checkpoint();
+            }
+        }
+
+        WalStats Connection::getWalStats() const
+        {
+            return wal != nullptr ? wal->getStats() : WalStats{};
+        }
+
+        std::string Connection::getWalFilePath() const
+        {
+            return (fs::path(dbPath) / "jsondb.wal").string();
         }
 
         bool Connection::authenticate(std::string user, std::string passwd)
@@ -386,492 +641,1530 @@ namespace sql
                 throw JsonDbException("Table does not exist: " + tableName);
             }
 
-            const std::string schemaPath = JsonSchemaFilePath(dbPath, tableName);
-            if (fs::exists(schemaPath))
+            if (const std::optional<TableSchema> schema = getTableSchema(tableName))
             {
-                std::ifstream schemaFile(schemaPath);
-                if (!schemaFile.is_open())
-                {
-                    throw JsonDbException("Failed to open schema file: " + schemaPath);
-                }
-
-                nlohmann::json schemaJson;
-                schemaFile >> schemaJson;
-                return schemaJson.get<std::vector<std::string>>();
+                return schema->columns;
             }
 
-            const std::vector<nlohmann::json> rows = getTableData(tableName);
-            if (rows.empty())
+            const std::shared_ptr<const TableRows> rows = getTableSnapshot(tableName);
+            if (rows->empty())
             {
                 return {};
             }
 
             std::vector<std::string> columns;
-            for (auto it = rows.front().begin(); it != rows.front().end(); ++it)
+            for (auto it = rows->front().begin(); it != rows->front().end(); ++it)
             {
                 columns.push_back(it.key());
             }
             return columns;
         }
 
-        std::string Connection::getTableFilePath(const std::string& tableName) const
-        {
-            fs::path path(dbPath);
-            path /= tableName + ".json";
-            return path.string();
-        }
-
-        std::vector<nlohmann::json> Connection::getTableData(const std::string& tableName) const
+        std::optional<TableSchema> Connection::getTableSchema(const std::string& tableName) const
         {
-            const std::string tablePath = getTableFilePath(tableName);
-            if (!fs::exists(tablePath))
+            const std::string schemaPath = SchemaFilePath(dbPath, tableName);
+            const std::optional<FileStamp> stamp = StatFile(schemaPath);
+            SchemaCache& cached = schemas[tableName];
+            if (!stamp.has_value())
             {
-                throw JsonDbException("Table does not exist: " + tableName);
+                cached = SchemaCache{};
             }
-
-            std::ifstream file(tablePath);
-            if (!file.is_open())
+            else if (cached.stamp != stamp)
             {
-                throw JsonDbException("Failed to open table file: " + tablePath);
+                cached.schema = ReadTableSchema(schemaPath);
+                cached.stamp = stamp;
             }
+            return cached.schema;
+        }
 
-            nlohmann::json tableData;
-            file >> tableData;
-            if (!tableData.is_array())
-            {
-                throw JsonDbException("Invalid table format for table: " + tableName);
-            }
+        std::vector<std::string> Connection::getPrimaryKey(const std::string& tableName) const
+        {
+            const std::optional<TableSchema> schema = getTableSchema(tableName);
+            return schema.has_value() ? schema->primaryKey : std::vector<std::string>{};
+        }
+
+        std::string Connection::getTableFilePath(const std::string& tableName) const
+        {
+            return TableFilePath(dbPath, tableName);
+        }
 
-            return tableData.get<std::vector<nlohmann::json>>();
+        std::vector<nlohmann::json> Connection::getTableData(const std::string& tableName) const
+        {
+            return *getTableSnapshot(tableName);
         }
 
-        std::shared_ptr<ResultSet> Statement::executeQuery(const std::string& sql)
+        std::string Connection::getDeltaFilePath(const std::string& tableName) const
         {
-            const std::string normalized = RemoveTrailingSemicolon(sql);
-            std::smatch match;
-            const std::regex selectPattern(
-                R"(^SELECT\s+(.*?)\s+FROM\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)(?:\s+WHERE\s+(.+))?$)",
-                std::regex::icase);
-            if (!std::regex_match(normalized, match, selectPattern))
-            {
-                throw JsonDbException("Invalid SELECT statement: " + sql);
-            }
+            return DeltaFilePath(dbPath, tableName);
+        }
 
-            const std::string tableName = extractTableName(match[2].str());
-            const std::string whereClause = match[3].matched ? Trim(match[3].str()) : "";
-            std::vector<std::string> selectedColumns = SplitCommaAware(match[1].str());
-            if (selectedColumns.empty())
+        std::shared_ptr<const TableRows> Connection::getTableSnapshot(const std::string& tableName) const
+        {
+            const auto staged = transaction.tables.find(tableName);
+            if (staged != transaction.tables.end())
             {
-                throw JsonDbException("SELECT statement must include at least one column.");
+                return staged->second;
             }
-
-            const std::vector<nlohmann::json> tableRows = connection->getTableData(tableName);
-            std::vector<nlohmann::json> filteredRows;
-            for (const auto& row : tableRows)
+            if (wal != nullptr)
             {
-                if (whereClause.empty() || evaluateCondition(row, whereClause))
+                if (auto committed = wal->getCommittedTable(tableName))
                 {
-                    filteredRows.push_back(row);
+                    return committed;
                 }
             }
+            if (const std::shared_ptr<LsmTree> lsm = getLsmTree(tableName))
+            {
+                return lsm->snapshot();
+            }
 
-            if (selectedColumns.size() == 1 && selectedColumns.front() == "*")
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> dataStamp = StatFile(tablePath);
+            if (!dataStamp.has_value())
             {
-                return std::make_shared<ResultSet>(filteredRows);
+                throw JsonDbException("Table does not exist: " + tableName);
             }
 
-            std::vector<nlohmann::json> projectedRows;
-            projectedRows.reserve(filteredRows.size());
-            for (const auto& row : filteredRows)
+            const std::string deltaPath = getDeltaFilePath(tableName);
+            const TableStamp stamp{*dataStamp, StatFile(deltaPath), StatFile(TombstoneFilePath(dbPath, tableName))};
+            if (auto cached = tableCache.lookup(tablePath, stamp))
+            {
+                return cached;
+            }
+            if (wal != nullptr)
             {
-                nlohmann::json projected = nlohmann::json::object();
-                for (const auto& column : selectedColumns)
+                if (auto checkpointed = wal->getCheckpointedTable(tableName, stamp))
                 {
-                    if (!row.contains(column))
-                    {
-                        throw JsonDbException("Column does not exist: " + column);
-                    }
-                    projected[column] = row.at(column);
+                    tableCache.store(tablePath, CachedTable{stamp, checkpointed, 0});
+                    return checkpointed;
                 }
-                projectedRows.push_back(std::move(projected));
             }
 
-            return std::make_shared<ResultSet>(projectedRows, selectedColumns);
-        }
-
-        size_t Statement::executeUpdate(const std::string& sql)
-        {
-            const std::string normalized = RemoveTrailingSemicolon(sql);
-            std::smatch match;
-
-            const std::regex insertPattern(
-                R"(^INSERT\s+INTO\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)\s*\((.*?)\)\s+VALUES\s+(.+)$)",
-                std::regex::icase);
-            if (std::regex_match(normalized, match, insertPattern))
+            TableRows rows;
+            std::uint64_t deltaOffset = 0;
+            const std::optional<CachedTable> previous = tableCache.peek(tablePath);
+            const bool deltaOnlyGrew =
+                previous.has_value() && previous->stamp.data == stamp.data && previous->stamp.tombstones == stamp.tombstones &&
+                (!previous->stamp.delta.has_value() ||
+                 (stamp.delta.has_value() && previous->stamp.delta->inode == stamp.delta->inode &&
+                  previous->deltaOffset <= stamp.delta->size));
+            // NDJSON tables grow in place; rows past the old end are all that is new
+            // when the file was only appended to.
+            const bool tableOnlyGrew =
+                previous.has_value() && !stamp.delta.has_value() && !previous->stamp.delta.has_value() &&
+                previous->stamp.tombstones == stamp.tombstones &&
+                previous->stamp.data.inode == stamp.data.inode && previous->stamp.data.size < stamp.data.size &&
+                EndsLineAt(tablePath, previous->stamp.data.size) && DetectTableFormat(tablePath) == TableFormat::NDJSON;
+            if (deltaOnlyGrew)
             {
-                return executeInsertWithColumns(extractTableName(match[1].str()), match[2].str(), match[3].str());
+                rows = *previous->rows;
+                deltaOffset = previous->stamp.delta.has_value() ? previous->deltaOffset : 0;
             }
-
-            const std::regex insertWithoutColumnsPattern(
-                R"(^INSERT\s+INTO\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)\s+VALUES\s+(.+)$)",
-                std::regex::icase);
-            if (std::regex_match(normalized, match, insertWithoutColumnsPattern))
+            else if (tableOnlyGrew)
             {
-                return executeInsertWithoutColumns(extractTableName(match[1].str()), match[2].str());
+                rows = *previous->rows;
+                ReadJsonLines(tablePath, previous->stamp.data.size, rows);
             }
-
-            const std::regex updatePattern(
-                R"(^UPDATE\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)\s+SET\s+(.+?)(?:\s+WHERE\s+(.+))?$)",
-                std::regex::icase);
-            if (std::regex_match(normalized, match, updatePattern))
+            else
             {
-                return executeUpdateImpl(
-                    extractTableName(match[1].str()),
-                    match[2].str(),
-                    match[3].matched ? Trim(match[3].str()) : "");
+                rows = ReadTableFile(tablePath, getScanPool());
             }
 
-            const std::regex deletePattern(
-                R"(^DELETE\s+FROM\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)(?:\s+WHERE\s+(.+))?$)",
-                std::regex::icase);
-            if (std::regex_match(normalized, match, deletePattern))
+            if (stamp.delta.has_value())
             {
-                return executeDeleteImpl(
-                    extractTableName(match[1].str()),
-                    match[2].matched ? Trim(match[2].str()) : "");
+                deltaOffset = ReadJsonLines(deltaPath, deltaOffset, rows);
             }
-
-            throw JsonDbException("Invalid mutation statement: " + sql);
-        }
-
-        bool Statement::executeCreate(const std::string& sql)
-        {
-            const std::string normalized = RemoveTrailingSemicolon(sql);
-            std::smatch match;
-            const std::regex createTablePattern(
-                R"(^CREATE\s+TABLE\s+([A-Za-z0-9_]+(?:\.[A-Za-z0-9_]+)?)\s*\((.*)\)$)",
-                std::regex::icase);
-            if (!std::regex_match(normalized, match, createTablePattern))
+            // Grown snapshots were filtered when first read, and only rows read
+            // before the tombstones were written can be dead.
+            if (stamp.tombstones.has_value() && !deltaOnlyGrew && !tableOnlyGrew)
             {
-                throw JsonDbException("Invalid CREATE TABLE statement: " + sql);
+                LoadTombstones(dbPath, tableName).removeDeadRows(rows);
             }
 
-            const std::string tableName = extractTableName(match[1].str());
-            const std::string tablePath = connection->getTableFilePath(tableName);
-            if (fs::exists(tablePath))
+            // Not const, so deleteTableRows may reuse the rows once it holds the
+            // last reference.
+            std::shared_ptr<const TableRows> snapshot = std::make_shared<TableRows>(std::move(rows));
+            tableCache.store(tablePath, CachedTable{stamp, snapshot, deltaOffset});
+            if (deltaOnlyGrew || tableOnlyGrew)
             {
-                return false;
+                extendTableIndexes(tableName, *previous->rows, snapshot);
             }
+            return snapshot;
+        }
 
-            std::vector<std::string> columns;
-            for (const auto& definition : SplitCommaAware(match[2].str()))
+        std::shared_ptr<const TableRows> Connection::updateTableSnapshot(const std::string& tableName, TableRows rows)
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> dataStamp = StatFile(tablePath);
+            if (!dataStamp.has_value())
             {
-                std::stringstream line(definition);
-                std::string columnName;
-                line >> columnName;
-                if (!columnName.empty())
-                {
-                    columns.push_back(columnName);
-                }
+                tableCache.invalidate(tablePath);
+                return nullptr;
             }
 
-            std::ofstream tableFile(tablePath);
-            tableFile << "[]";
-
-            std::ofstream schemaFile(JsonSchemaFilePath(connection->getDbPath(), tableName));
-            schemaFile << std::setw(2) << nlohmann::json(columns);
+            const TableStamp stamp{*dataStamp, StatFile(getDeltaFilePath(tableName)), StatFile(TombstoneFilePath(dbPath, tableName))};
+            const std::uint64_t deltaOffset = stamp.delta.has_value() ? stamp.delta->size : 0;
+            std::shared_ptr<const TableRows> snapshot = std::make_shared<TableRows>(std::move(rows));
+            tableCache.store(tablePath, CachedTable{stamp, snapshot, deltaOffset});
+            return snapshot;
+        }
 
-            return true;
+        bool Connection::hasUnwrittenChanges(const std::string& tableName) const
+        {
+            return transaction.tables.count(tableName) != 0 || (wal != nullptr && wal->getCommittedTable(tableName) != nullptr);
         }
 
-        bool Statement::execute(const std::string& sql)
+        bool Connection::shouldStreamTable(const std::string& tableName) const
         {
-            const std::string trimmedSql = Trim(sql);
-            if (trimmedSql.empty())
+            // An LSM tree keeps its merged rows in memory for every reader anyway.
+            if (hasUnwrittenChanges(tableName) || getLsmTree(tableName) != nullptr)
             {
-                throw JsonDbException("SQL statement is empty.");
+                return false;
             }
 
-            std::string operation = ToLowerCopy(trimmedSql.substr(0, std::min<std::size_t>(trimmedSql.size(), 6)));
-            if (operation.rfind("select", 0) == 0)
+            // Anything that fits the cache is better loaded once and reused.
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> dataStamp = StatFile(tablePath);
+            if (!dataStamp.has_value() || dataStamp->size <= tableCache.getBudget())
             {
-                return executeQuery(sql) != nullptr;
+                return false;
             }
-            if (operation.rfind("create", 0) == 0)
+
+            const TableStamp stamp{*dataStamp, StatFile(getDeltaFilePath(tableName)), StatFile(TombstoneFilePath(dbPath, tableName))};
+            const std::optional<CachedTable> cached = tableCache.peek(tablePath);
+            if (cached.has_value() && cached->stamp == stamp)
             {
-                return executeCreate(sql);
+                return false;
             }
-            return executeUpdate(sql) > 0;
+            return wal == nullptr || wal->getCheckpointedTable(tableName, stamp) == nullptr;
         }
 
-        std::map<std::string, std::string> Statement::parseSetClause(const std::string& setClause)
+        bool Connection::hasCachedSnapshot(const std::string& tableName) const
         {
-            std::map<std::string, std::string> updates;
-            for (const auto& assignment : SplitCommaAware(setClause))
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> dataStamp = StatFile(tablePath);
+            const std::optional<CachedTable> cached = tableCache.peek(tablePath);
+            return dataStamp.has_value() && cached.has_value() &&
+                   cached->stamp == TableStamp{*dataStamp, StatFile(getDeltaFilePath(tableName)), StatFile(TombstoneFilePath(dbPath, tableName))};
+        }
+
+        bool Connection::streamTable(
+            const std::string& tableName,
+            const RowVisitor& visit,
+            const std::vector<std::string>& columns,
+            const Predicate& predicate,
+            ScanStats* stats) const
+        {
+            bool completed = true;
+            const Tombstones tombstones = LoadTombstones(dbPath, tableName);
+            std::uint64_t rowId = 0;
+            const auto visitLive = [&](nlohmann::json& row) { return tombstones.isDead(rowId++) || visit(row); };
+            const auto visitUntilStopped = [&](nlohmann::json& row) {
+                completed = visitLive(row);
+                return completed;
+            };
+            const std::string tablePath = getTableFilePath(tableName);
+            const TableFormat format = DetectTableFormat(tablePath);
+            if (const std::shared_ptr<LsmTree> lsm = format == TableFormat::LSM ? getLsmTree(tableName) : nullptr)
             {
-                const std::size_t equalsPos = assignment.find('=');
-                if (equalsPos == std::string::npos)
+                // The manifest holds no rows; the tree's merged view does.
+                for (const auto& row : *lsm->snapshot())
                 {
-                    throw JsonDbException("Invalid SET assignment: " + assignment);
+                    nlohmann::json copy = CopyColumns(row, columns);
+                    if (!visit(copy))
+                    {
+                        return false;
+                    }
                 }
-
-                const std::string column = trim(assignment.substr(0, equalsPos));
-                const std::string value = trim(assignment.substr(equalsPos + 1));
-                updates[column] = value;
+                return true;
             }
-            return updates;
-        }
-
-        std::vector<std::string> Statement::parseList(const std::string& list)
-        {
-            std::string normalized = trim(list);
-            if (!normalized.empty() && normalized.front() == '(' && normalized.back() == ')')
+            if (format == TableFormat::COLUMNAR)
             {
-                normalized = normalized.substr(1, normalized.size() - 2);
+                const ColumnarTable table(tablePath);
+                for (std::size_t position = 0; position < table.getRowCount(); ++position)
+                {
+                    if (tombstones.isDead(position))
+                    {
+                        continue;
+                    }
+                    nlohmann::json row = table.readRow(position, columns);
+                    if (!visit(row))
+                    {
+                        return false;
+                    }
+                }
+                rowId = table.getRowCount();
+            }
+            else if (const std::optional<ZoneMap> zoneMap =
+                         (format == TableFormat::JSON || format == TableFormat::NDJSON) && !predicate.empty() ? LoadZoneMap(dbPath, tableName)
+                                                                                                              : std::nullopt)
+            {
+                ScanStats blocks;
+                for (const Zone& zone : zoneMap->zones)
+                {
+                    if (!ZoneMayMatch(*predicate.getRoot(), zone))
+                    {
+                        rowId += zone.rows;
+                        ++blocks.blocksSkipped;
+                        continue;
+                    }
+                    ++blocks.blocksScanned;
+                    if (format == TableFormat::NDJSON)
+                    {
+                        StreamJsonLines(tablePath, zone.begin, visitUntilStopped, columns, zone.end);
+                    }
+                    else
+                    {
+                        completed = StreamJsonArrayRows(tablePath, zone.begin, zone.end, visitLive, columns);
+                    }
+                    if (!completed)
+                    {
+                        break;
+                    }
+                }
+                // NDJSON rows appended since the map was written are not covered.
+                if (completed && format == TableFormat::NDJSON)
+                {
+                    StreamJsonLines(tablePath, zoneMap->end, visitUntilStopped, columns);
+                }
+                if (stats != nullptr)
+                {
+                    *stats = blocks;
+                }
+            }
+            else if (format == TableFormat::NDJSON)
+            {
+                StreamJsonLines(tablePath, 0, visitUntilStopped, columns);
+            }
+            else if (format == TableFormat::PAGED)
+            {
+                completed = getPagedTable(tableName)->scan(visitLive, columns);
+            }
+            else
+            {
+                completed = StreamJsonArrayFile(tablePath, visitLive, columns);
+            }
+
+            const std::string deltaPath = getDeltaFilePath(tableName);
+            if (completed && StatFile(deltaPath).has_value())
+            {
+                StreamJsonLines(deltaPath, 0, visitUntilStopped, columns);
             }
-            return SplitCommaAware(normalized);
+            return completed;
         }
 
-        nlohmann::json Statement::createRowFromValues(
-            const std::vector<std::string>& colNames,
-            const std::vector<std::string>& colValues)
+        std::shared_ptr<const ColumnarTable> Connection::getColumnarTable(const std::string& tableName) const
         {
-            if (colNames.size() != colValues.size())
+            if (hasUnwrittenChanges(tableName) || StatFile(TombstoneFilePath(dbPath, tableName)).has_value())
             {
-                throw JsonDbException(
-                    "Column-value count mismatch. columns=" + std::to_string(colNames.size()) +
-                    ", values=" + std::to_string(colValues.size()));
+                return nullptr;
             }
 
-            nlohmann::json row = nlohmann::json::object();
-            for (std::size_t index = 0; index < colNames.size(); ++index)
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            if (!stamp.has_value())
             {
-                row[colNames[index]] = parseValue(colValues[index]);
+                return nullptr;
             }
-            return row;
+
+            ColumnarCache& cached = columnarTables[tableName];
+            if (cached.stamp != stamp)
+            {
+                cached.table = IsColumnarFile(tablePath) ? std::make_shared<const ColumnarTable>(tablePath) : nullptr;
+                cached.stamp = stamp;
+            }
+            return cached.table;
         }
 
-        nlohmann::json Statement::readTableData(const std::string& tablePath)
+        void Connection::convertTable(const std::string& tableName, TableFormat format)
         {
-            std::ifstream file(tablePath);
-            if (!file.is_open())
+            if (transaction.tables.count(tableName) != 0)
             {
-                throw JsonDbException("Failed to open table file: " + tablePath);
+                throw JsonDbException("Cannot convert a table with uncommitted changes: " + tableName);
             }
 
-            nlohmann::json tableData;
-            file >> tableData;
-            if (!tableData.is_array())
+            const std::unique_lock<std::mutex> lock = lockForDirectWrite(tableName);
+            rewriteTable(tableName, format);
+        }
+
+        void Connection::setBloomColumns(const std::string& tableName, const std::vector<std::string>& columns, double falsePositiveRate)
+        {
+            if (!(falsePositiveRate > 0.0 && falsePositiveRate < 1.0))
+            {
+                throw JsonDbException("Bloom filter false positive rate must be between 0 and 1.");
+            }
+            if (transaction.tables.count(tableName) != 0)
+            {
+                throw JsonDbException("Cannot change a table with uncommitted changes: " + tableName);
+            }
+
+            const std::unique_lock<std::mutex> lock = lockForDirectWrite(tableName);
+            const std::string schemaPath = SchemaFilePath(dbPath, tableName);
+            TableSchema schema = ReadTableSchema(schemaPath);
+            for (const auto& column : columns)
             {
-                throw JsonDbException("Table data must be a JSON array: " + tablePath);
+                if (std::find(schema.columns.begin(), schema.columns.end(), column) == schema.columns.end())
+                {
+                    throw JsonDbException("Bloom filter column does not exist: " + column);
+                }
             }
-            return tableData;
+            schema.bloomColumns = columns;
+            schema.bloomFalsePositiveRate = falsePositiveRate;
+            WriteTableSchema(schemaPath, schema, syncMode != SyncMode::NONE);
+            rewriteTable(tableName, DetectTableFormat(getTableFilePath(tableName)));
         }
 
-        void Statement::writeTableData(const std::string& tablePath, const nlohmann::json& tableData)
+        void Connection::rewriteTable(const std::string& tableName, TableFormat format)
         {
-            std::ofstream outFile(tablePath, std::ios::trunc);
-            if (!outFile.is_open())
+            const std::shared_ptr<const TableRows> snapshot = getTableSnapshot(tableName);
+            WriteTableFile(dbPath, tableName, *snapshot, format, syncMode, tableLayout);
+
+            std::error_code error;
+            if (fs::remove(getDeltaFilePath(tableName), error) && syncMode != SyncMode::NONE)
             {
-                throw JsonDbException("Failed to write table file: " + tablePath);
+                SyncDirectory(dbPath);
             }
-            outFile << std::setw(2) << tableData;
+            extendTableIndexes(tableName, *snapshot, updateTableSnapshot(tableName, *snapshot));
         }
 
-        bool Statement::evaluateCondition(const nlohmann::json& row, const std::string& condition)
+        std::uint64_t Connection::vacuumTable(const std::string& tableName)
         {
-            for (const auto& clause : SplitConditions(condition))
+            if (transaction.tables.count(tableName) != 0)
+            {
+                throw JsonDbException("Cannot vacuum a table with uncommitted changes: " + tableName);
+            }
+
+            const std::unique_lock<std::mutex> lock = lockForDirectWrite(tableName);
+            if (const std::shared_ptr<LsmTree> lsm = getLsmTree(tableName))
+            {
+                lsm->compact();
+                return 0;
+            }
+            const std::string tablePath = getTableFilePath(tableName);
+            if (!StatFile(TombstoneFilePath(dbPath, tableName)).has_value() && !StatFile(getDeltaFilePath(tableName)).has_value())
             {
-                std::smatch match;
-                const std::regex conditionPattern(R"(^([A-Za-z0-9_]+)\s*(=|!=|>=|<=|>|<)\s*(.+)$)");
-                if (!std::regex_match(clause, match, conditionPattern))
+                return 0;
+            }
+            const std::uint64_t deadRows = LoadTombstones(dbPath, tableName).deadRows;
+            rewriteTable(tableName, DetectTableFormat(tablePath));
+            return deadRows;
+        }
+
+        std::shared_ptr<const TableRows> Connection::applyToSnapshot(
+            const std::string& tableName,
+            std::shared_ptr<const TableRows> snapshot,
+            const TableChange& change)
+        {
+            std::shared_ptr<TableIndexes> indexes = takeTableIndexes(tableName, *snapshot);
+            if (indexes != nullptr)
+            {
+                indexes->apply(*snapshot, change);
+            }
+
+            // Once the cache lets go, this is usually the last reference and the
+            // rows can be edited in place rather than copied.
+            tableCache.invalidate(getTableFilePath(tableName));
+            TableRows rows = snapshot.use_count() == 1 ? std::move(const_cast<TableRows&>(*snapshot)) : *snapshot;
+            snapshot.reset();
+            ApplyTableChange(rows, change);
+
+            std::shared_ptr<const TableRows> after = updateTableSnapshot(tableName, std::move(rows));
+            if (indexes != nullptr && after != nullptr)
+            {
+                indexCache[tableName] = IndexedSnapshot{after, std::move(indexes)};
+            }
+            return after;
+        }
+
+        std::shared_ptr<LsmTree> Connection::getLsmTree(const std::string& tableName) const
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            LsmCache& cached = lsmTrees[tableName];
+            if (cached.stamp != stamp)
+            {
+                cached.tree = stamp.has_value() && IsLsmManifest(tablePath) ? LsmTree::open(tablePath) : nullptr;
+                cached.stamp = stamp;
+                if (cached.tree != nullptr)
                 {
-                    throw JsonDbException("Unsupported WHERE clause: " + clause);
+                    cached.tree->setMemtableBytes(lsmMemtableBytes);
                 }
+            }
+            return cached.tree;
+        }
 
-                const std::string column = match[1].str();
-                const std::string op = match[2].str();
-                const nlohmann::json expectedValue = parseValue(match[3].str());
+        void Connection::applyLsmChange(
+            const std::string& tableName,
+            LsmTree& lsm,
+            std::shared_ptr<const TableRows> snapshot,
+            const TableChange& change)
+        {
+            if (snapshot == nullptr)
+            {
+                snapshot = lsm.peekSnapshot();
+            }
 
-                if (!row.contains(column))
+            // Rows are kept in key order, so the indexes only carry over when no
+            // row lands between others: keyless tables, deletes, and updates that
+            // leave every key alone.
+            std::shared_ptr<TableIndexes> indexes = snapshot != nullptr ? takeTableIndexes(tableName, *snapshot) : nullptr;
+            if (indexes != nullptr && indexes->getPrimaryKey() != nullptr)
+            {
+                const PrimaryKeyIndex& primaryKey = *indexes->getPrimaryKey();
+                bool keysStay = change.kind == TableChange::Kind::DELETE || change.kind == TableChange::Kind::UPDATE;
+                for (std::size_t index = 0; keysStay && change.kind == TableChange::Kind::UPDATE && index < change.positions.size(); ++index)
+                {
+                    keysStay = primaryKey.keyOf((*snapshot)[change.positions[index]]) == primaryKey.keyOf(change.rows[index]);
+                }
+                if (!keysStay)
                 {
-                    throw JsonDbException("Column does not exist in WHERE clause: " + column);
+                    indexes.reset();
                 }
+            }
+            if (indexes != nullptr)
+            {
+                indexes->apply(*snapshot, change);
+            }
 
-                if (!CompareValues(row.at(column), op, expectedValue))
+            snapshot.reset();
+            lsm.apply(change, syncMode != SyncMode::NONE);
+            const std::shared_ptr<const TableRows> after = lsm.peekSnapshot();
+            if (indexes != nullptr && after != nullptr)
+            {
+                indexCache[tableName] = IndexedSnapshot{after, std::move(indexes)};
+            }
+        }
+
+        std::shared_ptr<PagedTable> Connection::getPagedTable(const std::string& tableName) const
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            PagedCache& cached = pagedTables[tableName];
+            if (cached.stamp != stamp)
+            {
+                cached.table.reset();
+                cached.table = stamp.has_value() && IsPagedFile(tablePath) ? std::make_shared<PagedTable>(tablePath, bufferPool) : nullptr;
+                cached.stamp = stamp;
+            }
+            return cached.table;
+        }
+
+        std::shared_ptr<KeyMap> Connection::getKeyMap(const std::string& tableName) const
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::vector<std::string> primaryKey = getPrimaryKey(tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            if (primaryKey.empty() || !stamp.has_value() || hasUnwrittenChanges(tableName) ||
+                StatFile(getDeltaFilePath(tableName)).has_value() || StatFile(TombstoneFilePath(dbPath, tableName)).has_value() ||
+                DetectTableFormat(tablePath) != TableFormat::NDJSON)
+            {
+                keyMaps.erase(tableName);
+                return nullptr;
+            }
+
+            std::shared_ptr<KeyMap>& cached = keyMaps[tableName];
+            if (cached == nullptr || cached->stamp != *stamp || cached->columns != primaryKey)
+            {
+                cached = std::make_shared<KeyMap>(LoadKeyMap(dbPath, tableName, primaryKey));
+            }
+            return cached;
+        }
+
+        bool Connection::writePagedRows(const std::string& tableName, std::shared_ptr<const TableRows>& snapshot, const TableChange& change)
+        {
+            const std::shared_ptr<PagedTable> paged = getPagedTable(tableName);
+            if (paged == nullptr || hasUnwrittenChanges(tableName) || StatFile(getDeltaFilePath(tableName)).has_value() ||
+                StatFile(TombstoneFilePath(dbPath, tableName)).has_value())
+            {
+                return false;
+            }
+
+            // Inserts carry the cached rows over when they are still current.
+            const std::string tablePath = getTableFilePath(tableName);
+            std::shared_ptr<const TableRows> before = snapshot;
+            if (before == nullptr)
+            {
+                const std::optional<CachedTable> cached = tableCache.peek(tablePath);
+                if (cached.has_value() && cached->stamp == TableStamp{*pagedTables[tableName].stamp, std::nullopt, std::nullopt})
                 {
-                    return false;
+                    before = cached->rows;
                 }
             }
+            if (!paged->apply(change, syncMode != SyncMode::NONE))
+            {
+                return false;
+            }
 
+            pagedTables[tableName].stamp = StatFile(tablePath);
+            snapshot.reset();
+            if (before != nullptr)
+            {
+                applyToSnapshot(tableName, std::move(before), change);
+            }
+            else
+            {
+                tableCache.invalidate(tablePath);
+            }
             return true;
         }
 
-        std::vector<std::string> Statement::splitValueGroups(const std::string& valuesStr)
+        void Connection::setLsmMemtableBytes(std::uint64_t bytes)
         {
-            std::vector<std::string> groups;
-            std::string current;
-            char quoteChar = 0;
-            int parenDepth = 0;
+            lsmMemtableBytes = bytes;
+            for (const auto& [table, cached] : lsmTrees)
+            {
+                if (cached.tree != nullptr)
+                {
+                    cached.tree->setMemtableBytes(bytes);
+                }
+            }
+        }
+
+        bool Connection::patchTableRows(const std::string& tableName, std::shared_ptr<const TableRows>& snapshot, const TableChange& change)
+        {
+            const TableRows& before = *snapshot;
+            const std::string tablePath = getTableFilePath(tableName);
+            if (change.kind != TableChange::Kind::UPDATE || hasUnwrittenChanges(tableName) ||
+                StatFile(getDeltaFilePath(tableName)).has_value() || StatFile(TombstoneFilePath(dbPath, tableName)).has_value() ||
+                DetectTableFormat(tablePath) != TableFormat::COLUMNAR)
+            {
+                return false;
+            }
 
-            for (const char ch : valuesStr)
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            const std::shared_ptr<const ColumnarTable> table = getColumnarTable(tableName);
+            if (!stamp.has_value() || table == nullptr || table->getRowCount() != before.size())
+            {
+                return false;
+            }
+            ColumnarUpdatePlan plan;
+            for (std::size_t index = 0; index < change.positions.size(); ++index)
             {
-                if (quoteChar == 0 && parenDepth == 0 && (std::isspace(static_cast<unsigned char>(ch)) || ch == ','))
+                const std::size_t position = change.positions[index];
+                if (!table->planUpdate(position, before[position], change.rows[index], plan))
                 {
-                    continue;
+                    return false;
+                }
+            }
+            PatchFileInPlace(tablePath, stamp->inode, table->finishUpdate(std::move(plan)), syncMode != SyncMode::NONE);
+            applyToSnapshot(tableName, std::move(snapshot), change);
+            return true;
+        }
+
+        std::shared_ptr<const TableRows> Connection::deleteTableRows(
+            const std::string& tableName,
+            std::shared_ptr<const TableRows> snapshot,
+            const TableChange& change)
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            const std::optional<FileStamp> dataStamp = StatFile(tablePath);
+            if (!dataStamp.has_value())
+            {
+                throw JsonDbException("Table does not exist: " + tableName);
+            }
+
+            Tombstones tombstones = LoadTombstones(dbPath, tableName);
+            tombstones.inode = dataStamp->inode;
+            tombstones.markLiveRows(change.positions);
+            WriteTombstones(dbPath, tableName, tombstones, syncMode != SyncMode::NONE);
+
+            std::shared_ptr<const TableRows> after = applyToSnapshot(tableName, std::move(snapshot), change);
+            const std::uint64_t totalRows = (after != nullptr ? after->size() : 0) + tombstones.deadRows;
+            if (static_cast<double>(tombstones.deadRows) > tombstoneCompactionRatio * static_cast<double>(totalRows))
+            {
+                rewriteTable(tableName, DetectTableFormat(tablePath));
+                return getTableSnapshot(tableName);
+            }
+            return after;
+        }
+
+        std::optional<TableRows> Connection::readRowRange(
+            const std::string& tableName,
+            std::size_t first,
+            std::size_t count,
+            const std::vector<std::string>& columns) const
+        {
+            const std::string tablePath = getTableFilePath(tableName);
+            if (hasUnwrittenChanges(tableName) || StatFile(getDeltaFilePath(tableName)).has_value() ||
+                StatFile(TombstoneFilePath(dbPath, tableName)).has_value() || DetectTableFormat(tablePath) != TableFormat::NDJSON)
+            {
+                return std::nullopt;
+            }
+
+            const auto [begin, end] = FindRowRange(dbPath, tableName, first, count);
+            TableRows rows;
+            StreamJsonLines(
+                tablePath,
+                begin,
+                [&](nlohmann::json& row) {
+                    rows.push_back(std::move(row));
+                    return true;
+                },
+                columns,
+                end);
+            return rows;
+        }
+
+        void Connection::setScanThreads(std::size_t threads)
+        {
+            const std::size_t resolved = ResolveThreadCount(threads);
+            if (resolved != scanThreads)
+            {
+                scanThreads = resolved;
+                scanPool.reset();
+            }
+        }
+
+        ThreadPool* Connection::getScanPool() const
+        {
+            if (scanThreads <= 1)
+            {
+                return nullptr;
+            }
+            if (scanPool == nullptr)
+            {
+                scanPool = std::make_shared<ThreadPool>(scanThreads);
+            }
+            return scanPool.get();
+        }
+
+        std::string Connection::getIndexFilePath(const std::string& tableName) const
+        {
+            return IndexFilePath(dbPath, tableName);
+        }
+
+        std::vector<IndexDefinition> Connection::getIndexDefinitions(const std::string& tableName) const
+        {
+            const std::string indexPath = getIndexFilePath(tableName);
+            const std::optional<FileStamp> stamp = StatFile(indexPath);
+            IndexDefinitionCache& cached = indexDefinitions[tableName];
+            if (cached.stamp != stamp)
+            {
+                cached.definitions = stamp.has_value() ? ReadIndexDefinitions(indexPath) : std::vector<IndexDefinition>{};
+                cached.stamp = stamp;
+            }
+            return cached.definitions;
+        }
+
+        std::shared_ptr<const TableIndexes> Connection::getTableIndexes(
+            const std::string& tableName,
+            const std::shared_ptr<const TableRows>& rows) const
+        {
+            const std::vector<IndexDefinition> definitions = getIndexDefinitions(tableName);
+            const std::vector<std::string> primaryKey = getPrimaryKey(tableName);
+            if (rows == nullptr || (definitions.empty() && primaryKey.empty()))
+            {
+                indexCache.erase(tableName);
+                return nullptr;
+            }
+
+            const auto memo = indexCache.find(tableName);
+            if (memo != indexCache.end() && memo->second.rows.lock() == rows &&
+                memo->second.indexes->hasDefinitions(definitions, primaryKey))
+            {
+                return memo->second.indexes;
+            }
+
+            auto indexes = std::make_shared<TableIndexes>(definitions, primaryKey, *rows);
+            indexCache[tableName] = IndexedSnapshot{rows, indexes};
+            return indexes;
+        }
+
+        std::shared_ptr<TableIndexes> Connection::takeTableIndexes(const std::string& tableName, const TableRows& before) const
+        {
+            const auto memo = indexCache.find(tableName);
+            if (memo == indexCache.end())
+            {
+                return nullptr;
+            }
+            if (memo->second.rows.lock().get() != &before)
+            {
+                indexCache.erase(memo);
+                return nullptr;
+            }
+
+            std::shared_ptr<TableIndexes> indexes = std::move(memo->second.indexes);
+            indexCache.erase(memo);
+            if (indexes.use_count() > 1)
+            {
+                // A reader still holds the old entries; leave them alone.
+                indexes = std::make_shared<TableIndexes>(*indexes);
+            }
+            return indexes;
+        }
+
+        void Connection::deriveTableIndexes(
+            const std::string& tableName,
+            const TableRows& before,
+            const std::shared_ptr<const TableRows>& after,
+            const TableChange& change)
+        {
+            std::shared_ptr<TableIndexes> indexes = takeTableIndexes(tableName, before);
+            if (indexes != nullptr && after != nullptr)
+            {
+                indexes->apply(before, change);
+                indexCache[tableName] = IndexedSnapshot{after, std::move(indexes)};
+            }
+        }
+
+        void Connection::extendTableIndexes(
+            const std::string& tableName,
+            const TableRows& before,
+            const std::shared_ptr<const TableRows>& after) const
+        {
+            std::shared_ptr<TableIndexes> indexes = takeTableIndexes(tableName, before);
+            if (indexes != nullptr && after != nullptr)
+            {
+                indexes->extend(*after, before.size());
+                indexCache[tableName] = IndexedSnapshot{after, std::move(indexes)};
+            }
+        }
+
+        size_t Connection::stageMutation(const std::string& tableName, const TableMutation& mutation)
+        {
+            if (wal == nullptr)
+            {
+                throw JsonDbException("Connection is closed.");
+            }
+
+            auto staged = transaction.tables.find(tableName);
+            const std::uint64_t baseVersion = staged == transaction.tables.end() ? wal->getTableVersion(tableName) : 0;
+            std::shared_ptr<const TableRows> current =
+                staged != transaction.tables.end() ? staged->second : getTableSnapshot(tableName);
+
+            TableChange change;
+            {
+                const std::shared_ptr<const TableIndexes> indexes = getTableIndexes(tableName, current);
+                change = mutation(*current, indexes.get());
+            }
+            if (CountAffectedRows(change) == 0)
+            {
+                return 0;
+            }
+            if (staged == transaction.tables.end())
+            {
+                transaction.baseVersions[tableName] = baseVersion;
+                staged = transaction.tables.emplace(tableName, std::make_shared<TableRows>(*current)).first;
+            }
+            deriveTableIndexes(tableName, *current, staged->second, change);
+            current.reset();
+
+            const size_t affectedRows = CountAffectedRows(change);
+            ApplyTableChange(*staged->second, change);
+            transaction.changes.push_back(std::move(change));
+            return affectedRows;
+        }
+
+        size_t Connection::commitMutation(const std::string& tableName, const TableMutation& mutation)
+        {
+            if (wal == nullptr)
+            {
+                throw JsonDbException("Connection is closed.");
+            }
+            return wal->apply(tableName, mutation, [this](const std::string& name) { return getTableSnapshot(name); });
+        }
+
+        std::unique_lock<std::mutex> Connection::lockForDirectWrite(const std::string& tableName)
+        {
+            if (wal == nullptr)
+            {
+                throw JsonDbException("Connection is closed.");
+            }
+            return wal->lockForDirectWrite(tableName);
+        }
+
+        std::shared_ptr<ResultSet> Statement::executeQuery(const std::string& sql)
+        {
+            const SqlStatement statement = ParseStatement(sql, "Invalid SELECT statement: ");
+            if (statement.type != SqlType::SELECT)
+            {
+                throw JsonDbException("Invalid SELECT statement: " + sql);
+            }
+            return executeQuery(statement.as<SqlSelectStatement>());
+        }
+
+        std::shared_ptr<ResultSet> Statement::executeQuery(const SqlSelectStatement& select)
+        {
+            const QueryPlan plan = Planner(connection).planSelect(select);
+            std::vector<nlohmann::json> filteredRows;
+            lastScanStats = ScanStats();
+
+            // An unfiltered page of an NDJSON table is read straight from the byte
+            // range its row offsets give, whatever the offset.
+            if (plan.scan.accessPath == AccessPath::FULL_SCAN && plan.scan.predicate.empty() && plan.orderBy.empty() &&
+                plan.limit.has_value())
+            {
+                if (std::optional<TableRows> page = connection->readRowRange(plan.scan.table, plan.offset, *plan.limit, plan.projection))
+                {
+                    QueryPlan pagePlan = plan;
+                    pagePlan.offset = 0;
+                    lastAccessPath = AccessPath::FULL_SCAN;
+                    return BuildResultSet(pagePlan, std::move(*page));
                 }
+            }
 
-                if (quoteChar != 0)
+            // Key lookups on LSM tables probe the memtable and runs instead of
+            // loading every row.
+            if (plan.scan.accessPath == AccessPath::PRIMARY_KEY && !connection->hasUnwrittenChanges(plan.scan.table))
+            {
+                if (const std::shared_ptr<LsmTree> lsm = connection->getLsmTree(plan.scan.table))
                 {
-                    current += ch;
-                    if (ch == quoteChar)
+                    const PrimaryKeyIndex index(connection->getPrimaryKey(plan.scan.table), {});
+                    if (const std::optional<std::string> key = index.keyOf(plan.scan.indexKey))
                     {
-                        quoteChar = 0;
+                        std::optional<nlohmann::json> row = lsm->get(*key);
+                        if (row.has_value() && plan.scan.predicate.matches(*row))
+                        {
+                            filteredRows.push_back(std::move(*row));
+                        }
                     }
-                    continue;
+                    lastAccessPath = AccessPath::PRIMARY_KEY;
+                    return BuildResultSet(plan, std::move(filteredRows));
                 }
+            }
 
-                if (ch == '\'' || ch == '"')
+            // Key lookups on NDJSON tables read the one row the key map points at,
+            // unless the rows are cached with their indexes already.
+            if (plan.scan.accessPath == AccessPath::PRIMARY_KEY && !connection->hasCachedSnapshot(plan.scan.table))
+            {
+                if (const std::shared_ptr<const KeyMap> keyMap = connection->getKeyMap(plan.scan.table))
                 {
-                    quoteChar = ch;
-                    current += ch;
-                    continue;
+                    const PrimaryKeyIndex index(keyMap->columns, {});
+                    const std::optional<std::string> key = index.keyOf(plan.scan.indexKey);
+                    const auto entry = key.has_value() ? keyMap->positions.find(*key) : keyMap->positions.end();
+                    if (entry != keyMap->positions.end())
+                    {
+                        std::optional<TableRows> rows = connection->readRowRange(plan.scan.table, entry->second, 1);
+                        if (rows.has_value() && rows->size() == 1 && plan.scan.predicate.matches(rows->front()))
+                        {
+                            filteredRows.push_back(std::move(rows->front()));
+                        }
+                    }
+                    lastAccessPath = AccessPath::PRIMARY_KEY;
+                    return BuildResultSet(plan, std::move(filteredRows));
                 }
+            }
 
-                if (ch == '(')
+            std::vector<std::string> keptColumns = plan.projection;
+            const auto addColumn = [](std::vector<std::string>& columns, const std::string& column) {
+                if (!columns.empty() && std::find(columns.begin(), columns.end(), column) == columns.end())
                 {
-                    ++parenDepth;
+                    columns.push_back(column);
                 }
-                else if (ch == ')' && parenDepth > 0)
+            };
+            for (const auto& item : plan.orderBy)
+            {
+                addColumn(keptColumns, item.column);
+            }
+
+            // Columnar tables are filtered over their typed vectors and tables too
+            // large for the cache are parsed one row at a time, so only the
+            // qualifying rows, cut down to the columns still needed, stay in memory.
+            const std::shared_ptr<const ColumnarTable> columnar =
+                plan.scan.accessPath == AccessPath::FULL_SCAN ? connection->getColumnarTable(plan.scan.table) : nullptr;
+            if (columnar != nullptr || (plan.scan.accessPath == AccessPath::FULL_SCAN && connection->shouldStreamTable(plan.scan.table)))
+            {
+                const bool stopEarly = plan.orderBy.empty() && plan.limit.has_value();
+                // Fields nobody reads are skipped by the parser instead of built.
+                std::vector<std::string> readColumns = keptColumns;
+                for (const auto& column : plan.scan.predicate.getReferencedColumns())
                 {
-                    --parenDepth;
+                    addColumn(readColumns, column);
                 }
 
-                current += ch;
-                if (parenDepth == 0 && ch == ')')
+                const auto wantsMore = [&]() { return !stopEarly || filteredRows.size() < plan.offset + *plan.limit; };
+                const RowVisitor keep = [&](nlohmann::json& row) {
+                    if (plan.scan.predicate.matches(row))
+                    {
+                        filteredRows.push_back(KeepColumns(row, keptColumns));
+                    }
+                    return wantsMore();
+                };
+                ThreadPool* pool = stopEarly ? nullptr : connection->getScanPool();
+                if (columnar != nullptr)
+                {
+                    bool more = true;
+                    if (pool != nullptr && columnar->getBlocks().size() > 1)
+                    {
+                        std::atomic<std::uint64_t> scanned{0};
+                        std::atomic<std::uint64_t> skipped{0};
+                        filteredRows = CollectInParallel(*pool, columnar->getBlocks().size(), [&](std::size_t block, TableRows& part) {
+                            const auto collectRow = [&](std::size_t position) {
+                                part.push_back(columnar->readRow(position, keptColumns));
+                                return true;
+                            };
+                            const ScanStats blocks = columnar->scan(plan.scan.predicate, collectRow, block, block + 1);
+                            scanned += blocks.blocksScanned;
+                            skipped += blocks.blocksSkipped;
+                        });
+                        lastScanStats.blocksScanned = scanned;
+                        lastScanStats.blocksSkipped = skipped;
+                    }
+                    else
+                    {
+                        lastScanStats = columnar->scan(plan.scan.predicate, [&](std::size_t position) {
+                            filteredRows.push_back(columnar->readRow(position, keptColumns));
+                            more = wantsMore();
+                            return more;
+                        });
+                    }
+                    const std::string deltaPath = connection->getDeltaFilePath(plan.scan.table);
+                    if (more && StatFile(deltaPath).has_value())
+                    {
+                        StreamJsonLines(deltaPath, 0, keep, readColumns);
+                    }
+                }
+                else
                 {
-                    groups.push_back(trim(current));
-                    current.clear();
+                    connection->streamTable(plan.scan.table, keep, readColumns, plan.scan.predicate, &lastScanStats);
                 }
+                lastAccessPath = AccessPath::FULL_SCAN;
+                SortRows(filteredRows, plan.orderBy);
+                return BuildResultSet(plan, std::move(filteredRows));
             }
 
-            return groups;
+            const std::shared_ptr<const TableRows> tableRows = connection->getTableSnapshot(plan.scan.table);
+            const std::shared_ptr<const TableIndexes> indexes = plan.scan.accessPath != AccessPath::FULL_SCAN
+                                                                    ? connection->getTableIndexes(plan.scan.table, tableRows)
+                                                                    : nullptr;
+
+            // An ordered index can only stand in for the sort when it holds every row.
+            const BTreeIndex* orderedIndex = plan.orderedByIndex && indexes != nullptr ? indexes->findOrdered(plan.scan.indexColumn) : nullptr;
+            if (orderedIndex != nullptr && orderedIndex->size() != tableRows->size())
+            {
+                orderedIndex = nullptr;
+            }
+
+            const bool stopEarly = (plan.orderBy.empty() || orderedIndex != nullptr) && plan.limit.has_value();
+            const std::size_t wantedRows = stopEarly ? plan.offset + *plan.limit : 0;
+            const auto collect = [&](std::size_t position) {
+                if (stopEarly && filteredRows.size() >= wantedRows)
+                {
+                    return false;
+                }
+                if (plan.scan.predicate.matches((*tableRows)[position]))
+                {
+                    filteredRows.push_back((*tableRows)[position]);
+                }
+                return true;
+            };
+
+            ThreadPool* pool = stopEarly || plan.scan.accessPath != AccessPath::FULL_SCAN ? nullptr : connection->getScanPool();
+            if (pool != nullptr && tableRows->size() >= kParallelScanMinRows)
+            {
+                const std::size_t ranges = std::min(pool->size() * 4, tableRows->size() / kParallelScanMinRows);
+                filteredRows = CollectInParallel(*pool, ranges, [&](std::size_t range, TableRows& part) {
+                    const std::size_t end = tableRows->size() * (range + 1) / ranges;
+                    for (std::size_t position = tableRows->size() * range / ranges; position < end; ++position)
+                    {
+                        if (plan.scan.predicate.matches((*tableRows)[position]))
+                        {
+                            part.push_back(CopyColumns((*tableRows)[position], keptColumns));
+                        }
+                    }
+                });
+                lastAccessPath = AccessPath::FULL_SCAN;
+                SortRows(filteredRows, plan.orderBy);
+            }
+            else if (orderedIndex != nullptr)
+            {
+                orderedIndex->scan(plan.scan.lowerBound, plan.scan.upperBound, plan.orderBy.front().descending, collect);
+                lastAccessPath = AccessPath::BTREE_RANGE;
+            }
+            else
+            {
+                lastAccessPath = ScanCandidates(plan.scan, *tableRows, indexes.get(), collect);
+                SortRows(filteredRows, plan.orderBy);
+            }
+            return BuildResultSet(plan, std::move(filteredRows));
         }
 
-        std::vector<std::string> Statement::splitValueGroup(const std::string& valueGroup)
+        size_t Statement::executeUpdate(const std::string& sql)
         {
-            std::string trimmedGroup = trim(valueGroup);
-            if (!trimmedGroup.empty() && trimmedGroup.front() == '(' && trimmedGroup.back() == ')')
+            const SqlStatement statement = ParseStatement(sql, "Invalid mutation statement: ");
+            if (statement.type != SqlType::INSERT && statement.type != SqlType::UPDATE && statement.type != SqlType::DELETE)
             {
-                trimmedGroup = trimmedGroup.substr(1, trimmedGroup.size() - 2);
+                throw JsonDbException("Invalid mutation statement: " + sql);
             }
-            return SplitCommaAware(trimmedGroup);
+            return executeUpdate(statement);
         }
 
-        nlohmann::json Statement::parseValue(const std::string& valueStr)
+        size_t Statement::executeUpdate(const SqlStatement& statement)
         {
-            return ParseScalarValue(valueStr);
+            switch (statement.type)
+            {
+            case SqlType::INSERT:
+            {
+                const auto& insert = statement.as<SqlInsertStatement>();
+                if (insert.columns.empty())
+                {
+                    return executeInsertWithoutColumns(insert.table.table, insert.rows, insert.replace);
+                }
+                return executeInsertWithColumns(insert.table.table, insert.columns, insert.rows, insert.replace);
+            }
+            case SqlType::UPDATE:
+            {
+                const auto& update = statement.as<SqlUpdateStatement>();
+                return executeUpdateImpl(Planner(connection).planScan(update.table, update.where), update.assignments);
+            }
+            case SqlType::DELETE:
+            {
+                const auto& remove = statement.as<SqlDeleteStatement>();
+                return executeDeleteImpl(Planner(connection).planScan(remove.table, remove.where));
+            }
+            default:
+                throw JsonDbException("Invalid mutation statement.");
+            }
         }
 
-        std::string Statement::trim(const std::string& s)
+        bool Statement::executeCreate(const std::string& sql)
         {
-            return Trim(s);
+            const SqlStatement statement = ParseStatement(sql, "Invalid CREATE TABLE statement: ");
+            if (statement.type != SqlType::CREATE)
+            {
+                throw JsonDbException("Invalid CREATE TABLE statement: " + sql);
+            }
+            if (statement.is<SqlCreateIndexStatement>())
+            {
+                return executeCreateIndex(statement.as<SqlCreateIndexStatement>());
+            }
+            return executeCreate(statement.as<SqlCreateTableStatement>());
         }
 
-        std::vector<std::string> Statement::split(const std::string& s, char delimiter)
+        bool Statement::executeCreate(const SqlCreateTableStatement& create)
         {
-            std::vector<std::string> tokens;
-            std::stringstream stream(s);
-            std::string item;
-            while (std::getline(stream, item, delimiter))
+            const std::string tableName = create.table.table;
+            const std::string tablePath = connection->getTableFilePath(tableName);
+            if (fs::exists(tablePath))
+            {
+                return false;
+            }
+
+            const TableFormat format = ParseTableEngine(create.engine);
+            TableSchema schema;
+            for (const auto& definition : create.columns)
             {
-                tokens.push_back(trim(item));
+                schema.columns.push_back(definition.name);
             }
-            return tokens;
+            for (const auto& column : create.primaryKey)
+            {
+                if (std::find(schema.columns.begin(), schema.columns.end(), column) == schema.columns.end())
+                {
+                    throw JsonDbException("Primary key column does not exist: " + column);
+                }
+                if (std::find(schema.primaryKey.begin(), schema.primaryKey.end(), column) == schema.primaryKey.end())
+                {
+                    schema.primaryKey.push_back(column);
+                }
+            }
+
+            // The schema goes first: LSM tables take their key from it.
+            const SyncMode syncMode = connection->getSyncMode();
+            WriteTableSchema(SchemaFilePath(connection->getDbPath(), tableName), schema, syncMode != SyncMode::NONE);
+            WriteTableFile(connection->getDbPath(), tableName, {}, format, syncMode, connection->getTableLayout());
+
+            std::error_code error;
+            fs::remove(connection->getDeltaFilePath(tableName), error);
+            return true;
         }
 
-        std::string Statement::extractTableName(const std::string& tableSpec)
+        bool Statement::executeCreateIndex(const SqlCreateIndexStatement& create)
         {
-            const std::size_t dotPos = tableSpec.find('.');
-            if (dotPos == std::string::npos)
+            const std::string& tableName = create.table.table;
+            if (!connection->tableExists(tableName))
             {
-                return trim(tableSpec);
+                throw JsonDbException("Table does not exist: " + tableName);
             }
-            return trim(tableSpec.substr(dotPos + 1));
+            if (create.columns.size() != 1)
+            {
+                throw JsonDbException("Only single-column indexes are supported: " + create.name);
+            }
+
+            const std::string& column = create.columns.front();
+            const std::vector<std::string> schemaColumns = connection->getColumnNames(tableName);
+            if (!schemaColumns.empty() && std::find(schemaColumns.begin(), schemaColumns.end(), column) == schemaColumns.end())
+            {
+                throw JsonDbException("Column does not exist in schema: " + column);
+            }
+
+            std::vector<IndexDefinition> definitions = connection->getIndexDefinitions(tableName);
+            for (const auto& definition : definitions)
+            {
+                if (definition.name == create.name)
+                {
+                    return false;
+                }
+            }
+
+            definitions.push_back(
+                {create.name, column, create.method == SqlIndexMethod::BTREE ? IndexType::BTREE : IndexType::HASH});
+            WriteIndexDefinitions(connection->getIndexFilePath(tableName), definitions, connection->getSyncMode() != SyncMode::NONE);
+            return true;
         }
 
-        size_t Statement::executeUpdateImpl(
-            const std::string& table,
-            const std::string& setClause,
-            const std::string& whereClause)
+        bool Statement::executeAlter(const SqlAlterTableStatement& alter)
         {
-            if (!connection->tableExists(table))
+            const std::string& tableName = alter.table.table;
+            if (!connection->tableExists(tableName))
             {
-                throw JsonDbException("Table does not exist: " + table);
+                throw JsonDbException("Table does not exist: " + tableName);
             }
 
-            const std::string tablePath = connection->getTableFilePath(table);
-            nlohmann::json tableData = readTableData(tablePath);
-            const std::map<std::string, std::string> updates = parseSetClause(setClause);
+            const TableFormat format = ParseTableEngine(alter.engine);
+            if (DetectTableFormat(connection->getTableFilePath(tableName)) == format)
+            {
+                return false;
+            }
+            connection->convertTable(tableName, format);
+            return true;
+        }
 
-            size_t affectedRows = 0;
-            for (auto& row : tableData)
+        size_t Statement::executeVacuum(const SqlVacuumStatement& vacuum)
+        {
+            if (!vacuum.table.table.empty())
             {
-                if (whereClause.empty() || evaluateCondition(row, whereClause))
+                if (!connection->tableExists(vacuum.table.table))
                 {
-                    for (const auto& [column, value] : updates)
+                    throw JsonDbException("Table does not exist: " + vacuum.table.table);
+                }
+                return connection->vacuumTable(vacuum.table.table);
+            }
+
+            size_t reclaimed = 0;
+            for (const auto& table : DatabaseMetaData(connection).getTables())
+            {
+                reclaimed += connection->vacuumTable(table);
+            }
+            return reclaimed;
+        }
+
+        bool Statement::execute(const std::string& sql)
+        {
+            if (Trim(sql).empty())
+            {
+                throw JsonDbException("SQL statement is empty.");
+            }
+            return execute(ParseStatement(sql, "Invalid SQL statement: "));
+        }
+
+        bool Statement::execute(const SqlStatement& statement)
+        {
+            switch (statement.type)
+            {
+            case SqlType::SELECT:
+                return executeQuery(statement.as<SqlSelectStatement>()) != nullptr;
+            case SqlType::CREATE:
+                if (statement.is<SqlCreateIndexStatement>())
+                {
+                    return executeCreateIndex(statement.as<SqlCreateIndexStatement>());
+                }
+                return executeCreate(statement.as<SqlCreateTableStatement>());
+            case SqlType::ALTER:
+                return executeAlter(statement.as<SqlAlterTableStatement>());
+            case SqlType::VACUUM:
+                return executeVacuum(statement.as<SqlVacuumStatement>()) > 0;
+            default:
+                return executeUpdate(statement) > 0;
+            }
+        }
+
+        nlohmann::json Statement::createRowFromValues(
+            const std::vector<std::string>& colNames,
+            const std::vector<SqlValue>& colValues)
+        {
+            if (colNames.size() != colValues.size())
+            {
+                throw JsonDbException(
+                    "Column-value count mismatch. columns=" + std::to_string(colNames.size()) +
+                    ", values=" + std::to_string(colValues.size()));
+            }
+
+            nlohmann::json row = nlohmann::json::object();
+            for (std::size_t index = 0; index < colNames.size(); ++index)
+            {
+                row[colNames[index]] = SqlValueToJson(colValues[index]);
+            }
+            return row;
+        }
+
+        TableRows Statement::readTableData(const std::string& table)
+        {
+            return *connection->getTableSnapshot(table);
+        }
+
+        void Statement::appendTableData(const std::string& table, const TableRows& rows)
+        {
+            if (const std::shared_ptr<LsmTree> lsm = connection->getLsmTree(table))
+            {
+                connection->applyLsmChange(table, *lsm, nullptr, TableChange{TableChange::Kind::INSERT, table, {}, rows});
+                return;
+            }
+            std::shared_ptr<const TableRows> noSnapshot;
+            if (connection->writePagedRows(table, noSnapshot, TableChange{TableChange::Kind::INSERT, table, {}, rows}))
+            {
+                return;
+            }
+
+            // NDJSON tables take new rows at the end of the table file itself, so
+            // neither insert mode rewrites the rows already there.
+            if (DetectTableFormat(connection->getTableFilePath(table)) == TableFormat::NDJSON &&
+                !StatFile(connection->getDeltaFilePath(table)).has_value())
+            {
+                AppendTableRows(connection->getDbPath(), table, rows, connection->getSyncMode(), connection->getKeyMap(table).get());
+                return;
+            }
+
+            if (connection->getInsertMode() == InsertMode::REWRITE)
+            {
+                const std::shared_ptr<const TableRows> snapshot = connection->getTableSnapshot(table);
+                TableRows tableData = *snapshot;
+                tableData.insert(tableData.end(), rows.begin(), rows.end());
+                connection->extendTableIndexes(table, *snapshot, writeTableData(table, std::move(tableData)));
+                return;
+            }
+
+            const std::string deltaPath = connection->getDeltaFilePath(table);
+            AppendJsonLines(deltaPath, rows, nullptr, connection->getSyncMode() != SyncMode::NONE);
+
+            const std::optional<FileStamp> dataStamp = StatFile(connection->getTableFilePath(table));
+            const std::optional<FileStamp> deltaStamp = StatFile(deltaPath);
+            if (dataStamp.has_value() && deltaStamp.has_value() &&
+                deltaStamp->size > std::max(dataStamp->size, connection->getDeltaCompactionBytes()))
+            {
+                const std::shared_ptr<const TableRows> snapshot = connection->getTableSnapshot(table);
+                connection->extendTableIndexes(table, *snapshot, writeTableData(table, *snapshot));
+            }
+        }
+
+        std::shared_ptr<const TableRows> Statement::writeTableData(const std::string& table, TableRows tableData)
+        {
+            WriteTableFile(
+                connection->getDbPath(),
+                table,
+                tableData,
+                DetectTableFormat(connection->getTableFilePath(table)),
+                connection->getSyncMode(),
+                connection->getTableLayout());
+
+            std::error_code error;
+            if (fs::remove(connection->getDeltaFilePath(table), error) && connection->getSyncMode() != SyncMode::NONE)
+            {
+                SyncDirectory(connection->getDbPath());
+            }
+            return connection->updateTableSnapshot(table, std::move(tableData));
+        }
+
+        size_t Statement::applyMutation(const std::string& table, const TableMutation& mutation)
+        {
+            if (!connection->getAutoCommit())
+            {
+                return connection->stageMutation(table, mutation);
+            }
+            if (connection->getJournalMode() == JournalMode::WAL)
+            {
+                return connection->commitMutation(table, mutation);
+            }
+
+            const std::unique_lock<std::mutex> lock = connection->lockForDirectWrite(table);
+            std::shared_ptr<const TableRows> snapshot = connection->getTableSnapshot(table);
+            TableChange change;
+            {
+                const std::shared_ptr<const TableIndexes> indexes = connection->getTableIndexes(table, snapshot);
+                change = mutation(*snapshot, indexes.get());
+            }
+            const size_t affectedRows = CountAffectedRows(change);
+            if (affectedRows == 0)
+            {
+                return 0;
+            }
+
+            const std::shared_ptr<LsmTree> lsm = connection->getLsmTree(table);
+            if (lsm != nullptr && !connection->hasUnwrittenChanges(table))
+            {
+                connection->applyLsmChange(table, *lsm, std::move(snapshot), change);
+            }
+            else if (!connection->writePagedRows(table, snapshot, change))
+            {
+                if (change.kind == TableChange::Kind::DELETE && !connection->hasUnwrittenChanges(table))
+                {
+                    connection->deleteTableRows(table, std::move(snapshot), change);
+                }
+                else if (!connection->patchTableRows(table, snapshot, change))
+                {
+                    TableRows tableData = *snapshot;
+                    ApplyTableChange(tableData, change);
+                    connection->deriveTableIndexes(table, *snapshot, writeTableData(table, std::move(tableData)), change);
+                }
+            }
+            return affectedRows;
+        }
+
+        std::optional<size_t> Statement::applyPagedMutation(
+            const ScanPlan& plan,
+            TableChange::Kind kind,
+            const std::map<std::string, nlohmann::json>& updates)
+        {
+            if (!connection->getAutoCommit() || connection->getJournalMode() == JournalMode::WAL)
+            {
+                return std::nullopt;
+            }
+
+            const std::unique_lock<std::mutex> lock = connection->lockForDirectWrite(plan.table);
+            const std::shared_ptr<PagedTable> paged = connection->getPagedTable(plan.table);
+            if (paged == nullptr || connection->hasUnwrittenChanges(plan.table) || connection->hasCachedSnapshot(plan.table) ||
+                StatFile(connection->getDeltaFilePath(plan.table)).has_value() ||
+                StatFile(TombstoneFilePath(connection->getDbPath(), plan.table)).has_value())
+            {
+                return std::nullopt;
+            }
+
+            TableChange change{kind, plan.table, {}, {}};
+            std::size_t position = 0;
+            paged->scan([&](nlohmann::json& row) {
+                if (plan.predicate.matches(row))
+                {
+                    change.positions.push_back(position);
+                    if (kind == TableChange::Kind::UPDATE)
                     {
-                        row[column] = parseValue(value);
+                        for (const auto& [column, value] : updates)
+                        {
+                            row[column] = value;
+                        }
+                        change.rows.push_back(std::move(row));
                     }
-                    ++affectedRows;
                 }
+                ++position;
+                return true;
+            });
+            lastAccessPath = AccessPath::FULL_SCAN;
+            if (change.positions.empty())
+            {
+                return 0;
             }
 
-            writeTableData(tablePath, tableData);
-            return affectedRows;
+            // A row that outgrew its page needs the table rewritten after all.
+            std::shared_ptr<const TableRows> snapshot;
+            if (!connection->writePagedRows(plan.table, snapshot, change))
+            {
+                snapshot = connection->getTableSnapshot(plan.table);
+                TableRows tableData = *snapshot;
+                ApplyTableChange(tableData, change);
+                connection->deriveTableIndexes(plan.table, *snapshot, writeTableData(plan.table, std::move(tableData)), change);
+            }
+            return change.positions.size();
         }
 
-        size_t Statement::executeDeleteImpl(const std::string& table, const std::string& whereClause)
+        size_t Statement::applyInsert(const std::string& table, TableRows rows, bool replace)
         {
-            if (!connection->tableExists(table))
+            const std::vector<std::string> primaryKey = connection->getPrimaryKey(table);
+            if (replace && !primaryKey.empty())
             {
-                throw JsonDbException("Table does not exist: " + table);
+                return applyMutation(table, [&](const TableRows& tableData, const TableIndexes* indexes) {
+                    return BuildUpsertChange(table, primaryKey, tableData, indexes, rows);
+                });
             }
 
-            const std::string tablePath = connection->getTableFilePath(table);
-            nlohmann::json tableData = readTableData(tablePath);
-            nlohmann::json keptRows = nlohmann::json::array();
-            size_t affectedRows = 0;
+            if (!connection->getAutoCommit() || connection->getJournalMode() == JournalMode::WAL)
+            {
+                const TableChange change{TableChange::Kind::INSERT, table, {}, std::move(rows)};
+                return applyMutation(table, [&](const TableRows& tableData, const TableIndexes* indexes) {
+                    CheckNewPrimaryKeys(primaryKey, tableData, indexes, change.rows);
+                    return change;
+                });
+            }
 
-            for (const auto& row : tableData)
+            const std::unique_lock<std::mutex> lock = connection->lockForDirectWrite(table);
+            if (const std::shared_ptr<LsmTree> lsm = primaryKey.empty() ? nullptr : connection->getLsmTree(table))
             {
-                if (whereClause.empty() || evaluateCondition(row, whereClause))
+                CheckNewLsmKeys(primaryKey, *lsm, rows);
+            }
+            else if (const std::shared_ptr<const KeyMap> keyMap =
+                         primaryKey.empty() || connection->hasCachedSnapshot(table) ? nullptr : connection->getKeyMap(table))
+            {
+                CheckNewMappedKeys(*keyMap, rows);
+            }
+            else if (!primaryKey.empty())
+            {
+                const std::shared_ptr<const TableRows> snapshot = connection->getTableSnapshot(table);
+                CheckNewPrimaryKeys(primaryKey, *snapshot, connection->getTableIndexes(table, snapshot).get(), rows);
+            }
+            appendTableData(table, rows);
+            return rows.size();
+        }
+
+        size_t Statement::executeUpdateImpl(const ScanPlan& plan, const std::vector<SqlAssignment>& assignments)
+        {
+            std::map<std::string, nlohmann::json> updates;
+            for (const auto& assignment : assignments)
+            {
+                updates[assignment.column] = SqlValueToJson(assignment.value);
+            }
+
+            const std::vector<std::string> primaryKey = connection->getPrimaryKey(plan.table);
+            const bool movesKeys = std::any_of(primaryKey.begin(), primaryKey.end(), [&](const std::string& column) {
+                return updates.count(column) != 0;
+            });
+            if (!movesKeys)
+            {
+                if (const std::optional<size_t> affected = applyPagedMutation(plan, TableChange::Kind::UPDATE, updates))
                 {
-                    ++affectedRows;
+                    return *affected;
                 }
-                else
+            }
+
+            return applyMutation(plan.table, [&](const TableRows& tableData, const TableIndexes* indexes) {
+                TableChange change{TableChange::Kind::UPDATE, plan.table, {}, {}};
+                lastAccessPath = ScanCandidates(plan, tableData, indexes, [&](std::size_t index) {
+                    if (plan.predicate.matches(tableData[index]))
+                    {
+                        nlohmann::json updated = tableData[index];
+                        for (const auto& [column, value] : updates)
+                        {
+                            updated[column] = value;
+                        }
+                        change.positions.push_back(index);
+                        change.rows.push_back(std::move(updated));
+                    }
+                    return true;
+                });
+                if (movesKeys)
                 {
-                    keptRows.push_back(row);
+                    CheckUpdatedPrimaryKeys(primaryKey, tableData, indexes, change);
                 }
-            }
+                return change;
+            });
+        }
 
-            writeTableData(tablePath, keptRows);
-            return affectedRows;
+        size_t Statement::executeDeleteImpl(const ScanPlan& plan)
+        {
+            if (const std::optional<size_t> affected = applyPagedMutation(plan, TableChange::Kind::DELETE))
+            {
+                return *affected;
+            }
+            return applyMutation(plan.table, [&](const TableRows& tableData, const TableIndexes* indexes) {
+                TableChange change{TableChange::Kind::DELETE, plan.table, {}, {}};
+                lastAccessPath = ScanCandidates(plan, tableData, indexes, [&](std::size_t index) {
+                    if (plan.predicate.matches(tableData[index]))
+                    {
+                        change.positions.push_back(index);
+                    }
+                    return true;
+                });
+                return change;
+            });
         }
 
         size_t Statement::executeInsertWithColumns(
             const std::string& table,
-            const std::string& columns,
-            const std::string& valuesStr)
+            const std::vector<std::string>& columnNames,
+            const std::vector<std::vector<SqlValue>>& rows,
+            bool replace)
         {
             if (!connection->tableExists(table))
             {
                 throw JsonDbException("Table does not exist: " + table);
             }
 
-            const std::vector<std::string> columnNames = SplitCommaAware(columns);
-            const std::vector<std::string> valueGroups = splitValueGroups(valuesStr);
-            if (valueGroups.empty())
+            if (rows.empty())
             {
                 throw JsonDbException("INSERT statement does not include any values.");
             }
@@ -888,22 +2181,20 @@ namespace sql
                 }
             }
 
-            const std::string tablePath = connection->getTableFilePath(table);
-            nlohmann::json tableData = readTableData(tablePath);
-            size_t insertedRows = 0;
-
-            for (const auto& valueGroup : valueGroups)
+            TableRows insertedRows;
+            insertedRows.reserve(rows.size());
+            for (const auto& values : rows)
             {
-                const std::vector<std::string> values = splitValueGroup(valueGroup);
-                tableData.push_back(createRowFromValues(columnNames, values));
-                ++insertedRows;
+                insertedRows.push_back(createRowFromValues(columnNames, values));
             }
 
-            writeTableData(tablePath, tableData);
-            return insertedRows;
+            return applyInsert(table, std::move(insertedRows), replace);
         }
 
-        size_t Statement::executeInsertWithoutColumns(const std::string& table, const std::string& values)
+        size_t Statement::executeInsertWithoutColumns(
+            const std::string& table,
+            const std::vector<std::vector<SqlValue>>& rows,
+            bool replace)
         {
             const std::vector<std::string> columnNames = connection->getColumnNames(table);
             if (columnNames.empty())
@@ -911,24 +2202,19 @@ namespace sql
                 throw JsonDbException("Table schema is empty. INSERT without columns is not supported.");
             }
 
-            const std::vector<std::string> valueGroups = splitValueGroups(values);
-            if (valueGroups.empty())
+            if (rows.empty())
             {
                 throw JsonDbException("INSERT statement does not include any values.");
             }
 
-            const std::string tablePath = connection->getTableFilePath(table);
-            nlohmann::json tableData = readTableData(tablePath);
-            size_t insertedRows = 0;
-            for (const auto& valueGroup : valueGroups)
+            TableRows insertedRows;
+            insertedRows.reserve(rows.size());
+            for (const auto& values : rows)
             {
-                const std::vector<std::string> rowValues = splitValueGroup(valueGroup);
-                tableData.push_back(createRowFromValues(columnNames, rowValues));
-                ++insertedRows;
+                insertedRows.push_back(createRowFromValues(columnNames, values));
             }
 
-            writeTableData(tablePath, tableData);
-            return insertedRows;
+            return applyInsert(table, std::move(insertedRows), replace);
         }
 
         PreparedStatement::PreparedStatement(std::shared_ptr<Connection> conn, const std::string& sql)
@@ -1123,12 +2409,12 @@ namespace sql
                     continue;
                 }
 
-                const std::string stem = entry.path().stem().string();
-                if (stem.size() >= 7 && stem.substr(stem.size() - 7) == ".schema")
+                const fs::path stem = entry.path().stem();
+                if (stem.extension() == ".schema" || stem.extension() == ".indexes")
                 {
                     continue;
                 }
-                tables.push_back(stem);
+                tables.push_back(stem.string());
             }
             return tables;
         }
@@ -0,0 +1,337 @@
+#include <database/json_index.h>
+
+#include <database/json_driver.h>
+#include <database/json_storage.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::string IndexFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".indexes.json")).string();
+        }
+
+        std::vector<IndexDefinition> ReadIndexDefinitions(const std::string& path)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+            {
+                return {};
+            }
+
+            nlohmann::json document;
+            file >> document;
+            std::vector<IndexDefinition> definitions;
+            for (const auto& entry : document)
+            {
+                const IndexType type = entry.value("type", "hash") == "btree" ? IndexType::BTREE : IndexType::HASH;
+                definitions.push_back({entry.at("name").get<std::string>(), entry.at("column").get<std::string>(), type});
+            }
+            return definitions;
+        }
+
+        void WriteIndexDefinitions(const std::string& path, const std::vector<IndexDefinition>& definitions, bool sync)
+        {
+            nlohmann::json document = nlohmann::json::array();
+            for (const auto& definition : definitions)
+            {
+                document.push_back(
+                    {{"name", definition.name},
+                     {"column", definition.column},
+                     {"type", definition.type == IndexType::BTREE ? "btree" : "hash"}});
+            }
+            WriteFileAtomically(path, document.dump(2), sync);
+        }
+
+        std::string IndexKey(const nlohmann::json& value)
+        {
+            // Integers are keyed by their exact value, and floats holding an
+            // integral value the same way so that 1 and 1.0 still match.
+            if (value.is_number_unsigned())
+            {
+                return "n" + std::to_string(value.get<std::uint64_t>());
+            }
+            if (value.is_number_integer())
+            {
+                return "n" + std::to_string(value.get<std::int64_t>());
+            }
+            if (value.is_number())
+            {
+                const double number = value.get<double>();
+                if (number >= -0x1p63 && number < 0x1p63 && std::trunc(number) == number)
+                {
+                    return "n" + std::to_string(static_cast<std::int64_t>(number));
+                }
+                if (number >= 0x1p63 && number < 0x1p64 && std::trunc(number) == number)
+                {
+                    return "n" + std::to_string(static_cast<std::uint64_t>(number));
+                }
+                char buffer[32];
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+                return "n" + std::string(buffer, result.ptr);
+            }
+            if (value.is_string())
+            {
+                return "s" + value.get_ref<const std::string&>();
+            }
+            if (value.is_boolean())
+            {
+                return value.get<bool>() ? "b1" : "b0";
+            }
+            if (value.is_null())
+            {
+                return "z";
+            }
+            return "j" + value.dump();
+        }
+
+        const std::vector<std::size_t>* HashIndex::lookup(const nlohmann::json& value) const
+        {
+            const auto it = buckets.find(IndexKey(value));
+            return it == buckets.end() ? nullptr : &it->second;
+        }
+
+        void HashIndex::add(const nlohmann::json& row, std::size_t position)
+        {
+            const auto value = row.find(definition.column);
+            if (value == row.end())
+            {
+                return;
+            }
+
+            std::vector<std::size_t>& positions = buckets[IndexKey(*value)];
+            if (positions.empty() || positions.back() < position)
+            {
+                positions.push_back(position);
+                return;
+            }
+            positions.insert(std::lower_bound(positions.begin(), positions.end(), position), position);
+        }
+
+        void HashIndex::remove(const nlohmann::json& row, std::size_t position)
+        {
+            const auto value = row.find(definition.column);
+            if (value == row.end())
+            {
+                return;
+            }
+
+            const auto bucket = buckets.find(IndexKey(*value));
+            if (bucket == buckets.end())
+            {
+                return;
+            }
+
+            std::vector<std::size_t>& positions = bucket->second;
+            const auto it = std::lower_bound(positions.begin(), positions.end(), position);
+            if (it != positions.end() && *it == position)
+            {
+                positions.erase(it);
+            }
+            if (positions.empty())
+            {
+                buckets.erase(bucket);
+            }
+        }
+
+        void HashIndex::removePositions(const std::vector<std::size_t>& deleted)
+        {
+            for (auto& [key, positions] : buckets)
+            {
+                for (auto& position : positions)
+                {
+                    position -= static_cast<std::size_t>(std::lower_bound(deleted.begin(), deleted.end(), position) - deleted.begin());
+                }
+            }
+        }
+
+        PrimaryKeyIndex::PrimaryKeyIndex(std::vector<std::string> keyColumns, const TableRows& rows) : columns(std::move(keyColumns))
+        {
+            positions.reserve(rows.size());
+            for (std::size_t position = 0; position < rows.size(); ++position)
+            {
+                add(rows[position], position);
+            }
+        }
+
+        std::optional<std::string> PrimaryKeyIndex::keyOf(const nlohmann::json& row) const
+        {
+            if (columns.size() == 1)
+            {
+                const auto value = row.find(columns.front());
+                if (value == row.end() || value->is_null())
+                {
+                    return std::nullopt;
+                }
+                return IndexKey(*value);
+            }
+
+            std::string key;
+            for (const auto& column : columns)
+            {
+                const auto value = row.find(column);
+                if (value == row.end() || value->is_null())
+                {
+                    return std::nullopt;
+                }
+                const std::string part = IndexKey(*value);
+                key += std::to_string(part.size());
+                key += ':';
+                key += part;
+            }
+            return key;
+        }
+
+        std::optional<std::size_t> PrimaryKeyIndex::lookup(const std::string& key) const
+        {
+            const auto it = positions.find(key);
+            return it == positions.end() ? std::nullopt : std::optional<std::size_t>(it->second);
+        }
+
+        void PrimaryKeyIndex::add(const nlohmann::json& row, std::size_t position)
+        {
+            if (const std::optional<std::string> key = keyOf(row))
+            {
+                positions.emplace(*key, position);
+            }
+        }
+
+        void PrimaryKeyIndex::remove(const nlohmann::json& row, std::size_t position)
+        {
+            if (const std::optional<std::string> key = keyOf(row))
+            {
+                const auto it = positions.find(*key);
+                if (it != positions.end() && it->second == position)
+                {
+                    positions.erase(it);
+                }
+            }
+        }
+
+        void PrimaryKeyIndex::removePositions(const std::vector<std::size_t>& deleted)
+        {
+            for (auto& [key, position] : positions)
+            {
+                position -= static_cast<std::size_t>(std::lower_bound(deleted.begin(), deleted.end(), position) - deleted.begin());
+            }
+        }
+
+        TableIndexes::TableIndexes(const std::vector<IndexDefinition>& defs, const std::vector<std::string>& keyColumns, const TableRows& rows)
+            : definitions(defs), primaryKeyColumns(keyColumns)
+        {
+            if (!primaryKeyColumns.empty())
+            {
+                primaryKey.emplace(primaryKeyColumns, rows);
+            }
+            for (const auto& definition : definitions)
+            {
+                if (definition.type == IndexType::BTREE)
+                {
+                    orderedIndexes.emplace_back(definition.column, rows);
+                    continue;
+                }
+
+                HashIndex index(definition);
+                for (std::size_t position = 0; position < rows.size(); ++position)
+                {
+                    index.add(rows[position], position);
+                }
+                indexes.push_back(std::move(index));
+            }
+        }
+
+        const HashIndex* TableIndexes::find(const std::string& column) const
+        {
+            for (const auto& index : indexes)
+            {
+                if (index.getDefinition().column == column)
+                {
+                    return &index;
+                }
+            }
+            return nullptr;
+        }
+
+        const BTreeIndex* TableIndexes::findOrdered(const std::string& column) const
+        {
+            for (const auto& index : orderedIndexes)
+            {
+                if (index.getColumn() == column)
+                {
+                    return &index;
+                }
+            }
+            return nullptr;
+        }
+
+        void TableIndexes::apply(const TableRows& before, const TableChange& change)
+        {
+            // Updates drop every old entry before adding the new ones so that rows
+            // trading key values never collide in the primary key map.
+            const auto applyTo = [&](auto& index) {
+                switch (change.kind)
+                {
+                case TableChange::Kind::INSERT:
+                    for (std::size_t offset = 0; offset < change.rows.size(); ++offset)
+                    {
+                        index.add(change.rows[offset], before.size() + offset);
+                    }
+                    break;
+                case TableChange::Kind::UPDATE:
+                case TableChange::Kind::UPSERT:
+                    for (const std::size_t position : change.positions)
+                    {
+                        index.remove(before.at(position), position);
+                    }
+                    for (std::size_t offset = 0; offset < change.rows.size(); ++offset)
+                    {
+                        const std::size_t position = offset < change.positions.size()
+                                                         ? change.positions[offset]
+                                                         : before.size() + offset - change.positions.size();
+                        index.add(change.rows[offset], position);
+                    }
+                    break;
+                case TableChange::Kind::DELETE:
+                    for (const std::size_t position : change.positions)
+                    {
+                        index.remove(before.at(position), position);
+                    }
+                    index.removePositions(change.positions);
+                    break;
+                }
+            };
+            if (primaryKey.has_value())
+            {
+                applyTo(*primaryKey);
+            }
+            std::for_each(indexes.begin(), indexes.end(), applyTo);
+            std::for_each(orderedIndexes.begin(), orderedIndexes.end(), applyTo);
+        }
+
+        void TableIndexes::extend(const TableRows& rows, std::size_t from)
+        {
+            const auto extendTo = [&](auto& index) {
+                for (std::size_t position = from; position < rows.size(); ++position)
+                {
+                    index.add(rows[position], position);
+                }
+            };
+            if (primaryKey.has_value())
+            {
+                extendTo(*primaryKey);
+            }
+            std::for_each(indexes.begin(), indexes.end(), extendTo);
+            std::for_each(orderedIndexes.begin(), orderedIndexes.end(), extendTo);
+        }
+    }
+}
@@ -0,0 +1,1025 @@
+#include <database/json_lsm.h>
+
+#include <database/json_driver.h>
+#include <database/json_storage.h>
+#include <database/json_writer.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+using sql::jsondb::LsmRun;
+using sql::jsondb::TableRows;
+
+using RunRecords = std::vector<std::pair<std::string, const nlohmann::json*>>;
+
+constexpr std::uint64_t kBisectBytes = 4096;
+
+std::string RunFilePath(const std::string& directory, std::uint64_t id)
+{
+    return (fs::path(directory) / (std::to_string(id) + ".run")).string();
+}
+
+std::string BloomFilePath(const std::string& runPath)
+{
+    return fs::path(runPath).replace_extension(".bloom").string();
+}
+
+// Fixed-width hex, so insertion order and key order agree.
+std::string EncodeSequence(std::uint64_t sequence)
+{
+    char buffer[16];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), sequence, 16);
+    const std::size_t digits = static_cast<std::size_t>(result.ptr - buffer);
+    return std::string(16 - digits, '0') + std::string(buffer, digits);
+}
+
+std::uint64_t DecodeSequence(const std::string& key)
+{
+    std::uint64_t sequence = 0;
+    std::from_chars(key.data(), key.data() + key.size(), sequence, 16);
+    return sequence;
+}
+
+std::string ReadWholeFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw sql::jsondb::JsonDbException("Failed to open LSM file: " + path);
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::shared_ptr<LsmRun> WriteRunFile(const std::string& directory, std::uint64_t id, const RunRecords& records, bool sync)
+{
+    auto run = std::make_shared<LsmRun>();
+    run->id = id;
+    run->path = RunFilePath(directory, id);
+    run->rows = records.size();
+    run->minKey = records.front().first;
+    run->maxKey = records.back().first;
+    run->bloom = sql::jsondb::BloomFilter(records.size());
+
+    std::string data;
+    for (const auto& [key, row] : records)
+    {
+        run->bloom.add(key);
+        data += "{\"k\":";
+        sql::jsondb::AppendJson(data, nlohmann::json(key));
+        if (row != nullptr)
+        {
+            data += ",\"v\":";
+            sql::jsondb::AppendJson(data, *row);
+        }
+        data += "}\n";
+    }
+    run->bytes = data.size();
+    sql::jsondb::WriteFileAtomically(BloomFilePath(run->path), run->bloom.serialize(), sync);
+    sql::jsondb::WriteFileAtomically(run->path, data, sync);
+    return run;
+}
+
+// Runs are sorted, so bisect on byte offsets down to a few KiB, resyncing on
+// the next newline each time, then read forward until the key is passed.
+std::optional<nlohmann::json> FindRunRecord(const std::string& path, const std::string& key)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw sql::jsondb::JsonDbException("Failed to open LSM file: " + path);
+    }
+    file.seekg(0, std::ios::end);
+    std::uint64_t low = 0;
+    std::uint64_t high = static_cast<std::uint64_t>(file.tellg());
+    std::string line;
+    while (low + kBisectBytes < high)
+    {
+        const std::uint64_t middle = low + (high - low) / 2;
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(middle));
+        std::getline(file, line);
+        const std::uint64_t start = static_cast<std::uint64_t>(file.tellg());
+        if (!std::getline(file, line) || line.empty())
+        {
+            high = middle;
+            continue;
+        }
+        if (nlohmann::json::parse(line).at("k").get_ref<const std::string&>() < key)
+        {
+            low = start;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(low));
+    while (std::getline(file, line) && !line.empty())
+    {
+        nlohmann::json record = nlohmann::json::parse(line);
+        const std::string& recordKey = record.at("k").get_ref<const std::string&>();
+        if (recordKey == key)
+        {
+            return record;
+        }
+        if (recordKey > key)
+        {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+// Keeps the newest record of each key across sources listed oldest first.
+// Keys point into the sources, which must outlive the result.
+std::vector<std::pair<std::string_view, nlohmann::json*>> MergeSources(std::vector<TableRows>& sources)
+{
+    std::vector<std::tuple<std::string_view, std::size_t, nlohmann::json*>> entries;
+    for (std::size_t source = 0; source < sources.size(); ++source)
+    {
+        for (auto& record : sources[source])
+        {
+            entries.emplace_back(record.at("k").get_ref<const std::string&>(), source, &record);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& left, const auto& right) {
+        return std::tie(std::get<0>(left), std::get<1>(left)) < std::tie(std::get<0>(right), std::get<1>(right));
+    });
+
+    std::vector<std::pair<std::string_view, nlohmann::json*>> merged;
+    for (std::size_t index = 0; index < entries.size(); ++index)
+    {
+        if (index + 1 < entries.size() && std::get<0>(entries[index + 1]) == std::get<0>(entries[index]))
+        {
+            continue;
+        }
+        merged.emplace_back(std::get<0>(entries[index]), std::get<2>(entries[index]));
+    }
+    return merged;
+}
+
+bool Overlaps(const LsmRun& run, const std::string& minKey, const std::string& maxKey)
+{
+    return !(run.maxKey < minKey || maxKey < run.minKey);
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::string LsmDirectoryPath(const std::string& tablePath)
+        {
+            return fs::path(tablePath).replace_extension(".lsm").string();
+        }
+
+        bool IsLsmManifest(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            char magic[sizeof(kLsmMagic)] = {};
+            file.read(magic, sizeof(magic));
+            return file.gcount() == static_cast<std::streamsize>(sizeof(magic)) && std::memcmp(magic, kLsmMagic, sizeof(magic)) == 0;
+        }
+
+        LsmRun::~LsmRun()
+        {
+            if (obsolete)
+            {
+                std::error_code error;
+                fs::remove(path, error);
+                fs::remove(BloomFilePath(path), error);
+            }
+        }
+
+        std::shared_ptr<LsmTree> LsmTree::open(const std::string& tablePath)
+        {
+            static std::mutex registryMutex;
+            static std::map<std::string, std::weak_ptr<LsmTree>> registry;
+
+            std::error_code error;
+            const fs::path canonical = fs::weakly_canonical(tablePath, error);
+            const std::string key = error ? tablePath : canonical.string();
+
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (auto it = registry.begin(); it != registry.end();)
+            {
+                it = it->second.expired() ? registry.erase(it) : std::next(it);
+            }
+
+            std::weak_ptr<LsmTree>& slot = registry[key];
+            if (auto existing = slot.lock())
+            {
+                return existing;
+            }
+
+            std::shared_ptr<LsmTree> tree(new LsmTree(key));
+            tree->compactor = std::thread(&LsmTree::compactionLoop, tree.get());
+            slot = tree;
+            return tree;
+        }
+
+        void LsmTree::retire(const std::string& tablePath)
+        {
+            const std::shared_ptr<LsmTree> tree = open(tablePath);
+            {
+                std::lock_guard<std::mutex> lock(tree->mutex);
+                ++tree->epoch;
+                for (auto& level : tree->levels)
+                {
+                    for (auto& run : level)
+                    {
+                        run->obsolete = true;
+                    }
+                }
+                tree->levels.clear();
+                tree->memtable.clear();
+                tree->view.reset();
+                tree->viewKeys.clear();
+                tree->manifestStamp.reset();
+                tree->logStamp.reset();
+            }
+            std::error_code error;
+            fs::remove_all(tree->directory, error);
+        }
+
+        LsmTree::LsmTree(std::string path) : tablePath(std::move(path)), directory(LsmDirectoryPath(tablePath)) {}
+
+        LsmTree::~LsmTree()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            compactor.join();
+        }
+
+        void LsmTree::setMemtableBytes(std::uint64_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            memtableBudget = std::max<std::uint64_t>(1, bytes);
+        }
+
+        std::string LsmTree::logPath() const
+        {
+            return (fs::path(directory) / (std::to_string(logId) + ".log")).string();
+        }
+
+        std::string LsmTree::keyOf(const nlohmann::json& row)
+        {
+            if (!keyIndex.has_value())
+            {
+                return EncodeSequence(nextSeq++);
+            }
+            std::optional<std::string> key = keyIndex->keyOf(row);
+            if (!key.has_value())
+            {
+                throw JsonDbException("Primary key is incomplete.");
+            }
+            return std::move(*key);
+        }
+
+        void LsmTree::refresh()
+        {
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            if (!stamp.has_value())
+            {
+                throw JsonDbException("Failed to open table file: " + tablePath);
+            }
+            if (stamp != manifestStamp || StatFile(logPath()) != logStamp)
+            {
+                load();
+            }
+        }
+
+        void LsmTree::load()
+        {
+            const std::string text = ReadWholeFile(tablePath);
+            nlohmann::json manifest;
+            if (text.size() > sizeof(kLsmMagic) && std::memcmp(text.data(), kLsmMagic, sizeof(kLsmMagic)) == 0)
+            {
+                manifest = nlohmann::json::parse(text.begin() + sizeof(kLsmMagic), text.end(), nullptr, false);
+            }
+            if (!manifest.is_object())
+            {
+                throw JsonDbException("Invalid LSM table file: " + tablePath);
+            }
+
+            const bool firstLoad = !manifestStamp.has_value();
+            ++epoch;
+            levels.clear();
+            memtable.clear();
+            view.reset();
+            viewKeys.clear();
+
+            try
+            {
+                keyColumns = manifest.at("key").get<std::vector<std::string>>();
+                keyIndex.reset();
+                if (!keyColumns.empty())
+                {
+                    keyIndex.emplace(keyColumns, TableRows{});
+                }
+                nextSeq = manifest.at("nextSeq").get<std::uint64_t>();
+                nextRunId = manifest.at("nextRun").get<std::uint64_t>();
+                logId = manifest.at("log").get<std::uint64_t>();
+                for (const auto& level : manifest.at("levels"))
+                {
+                    levels.emplace_back();
+                    for (const auto& entry : level)
+                    {
+                        auto run = std::make_shared<LsmRun>();
+                        run->id = entry.at("id").get<std::uint64_t>();
+                        run->rows = entry.at("rows").get<std::uint64_t>();
+                        run->bytes = entry.at("bytes").get<std::uint64_t>();
+                        run->minKey = entry.at("min").get<std::string>();
+                        run->maxKey = entry.at("max").get<std::string>();
+                        run->path = RunFilePath(directory, run->id);
+                        if (std::optional<BloomFilter> bloom = BloomFilter::parse(ReadWholeFile(BloomFilePath(run->path))))
+                        {
+                            run->bloom = std::move(*bloom);
+                        }
+                        levels.back().push_back(std::move(run));
+                    }
+                }
+            }
+            catch (const nlohmann::json::exception&)
+            {
+                throw JsonDbException("Invalid LSM table file: " + tablePath);
+            }
+            if (levels.empty())
+            {
+                levels.emplace_back();
+            }
+
+            TableRows records;
+            if (StatFile(logPath()).has_value())
+            {
+                ReadJsonLines(logPath(), 0, records);
+            }
+            for (auto& record : records)
+            {
+                const std::string& key = record.at("k").get_ref<const std::string&>();
+                if (!keyIndex.has_value())
+                {
+                    nextSeq = std::max(nextSeq, DecodeSequence(key) + 1);
+                }
+                const auto value = record.find("v");
+                memtable[key] = value != record.end() ? std::optional<nlohmann::json>(std::move(*value)) : std::nullopt;
+            }
+
+            // Files no manifest names are left by merges or flushes cut short.
+            if (firstLoad)
+            {
+                std::set<std::string> live{fs::path(logPath()).filename().string()};
+                for (const auto& level : levels)
+                {
+                    for (const auto& run : level)
+                    {
+                        live.insert(fs::path(run->path).filename().string());
+                        live.insert(fs::path(BloomFilePath(run->path)).filename().string());
+                    }
+                }
+                std::error_code error;
+                for (const auto& entry : fs::directory_iterator(directory, error))
+                {
+                    if (live.count(entry.path().filename().string()) == 0)
+                    {
+                        fs::remove(entry.path(), error);
+                    }
+                }
+            }
+
+            manifestStamp = StatFile(tablePath);
+            logStamp = StatFile(logPath());
+        }
+
+        void LsmTree::writeManifest(bool sync)
+        {
+            nlohmann::json manifest = {
+                {"key", keyColumns}, {"nextSeq", nextSeq}, {"nextRun", nextRunId}, {"log", logId}, {"levels", nlohmann::json::array()}};
+            for (const auto& level : levels)
+            {
+                nlohmann::json runs = nlohmann::json::array();
+                for (const auto& run : level)
+                {
+                    runs.push_back({{"id", run->id}, {"rows", run->rows}, {"bytes", run->bytes}, {"min", run->minKey}, {"max", run->maxKey}});
+                }
+                manifest["levels"].push_back(std::move(runs));
+            }
+            WriteFileAtomically(tablePath, std::string(kLsmMagic, sizeof(kLsmMagic)) + "\n" + manifest.dump() + "\n", sync);
+            manifestStamp = StatFile(tablePath);
+        }
+
+        void LsmTree::flushMemtable()
+        {
+            if (memtable.empty())
+            {
+                return;
+            }
+
+            RunRecords records;
+            records.reserve(memtable.size());
+            for (const auto& [key, value] : memtable)
+            {
+                records.emplace_back(key, value.has_value() ? &*value : nullptr);
+            }
+            levels.front().push_back(WriteRunFile(directory, nextRunId++, records, syncWrites));
+
+            const std::string oldLog = logPath();
+            ++logId;
+            writeManifest(syncWrites);
+            std::error_code error;
+            fs::remove(oldLog, error);
+            logStamp.reset();
+            memtable.clear();
+            ++stats.flushes;
+            wakeup.notify_all();
+        }
+
+        void LsmTree::reset(const TableRows& rows, const std::vector<std::string>& primaryKey, bool sync)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (IsLsmManifest(tablePath))
+            {
+                refresh();
+            }
+            ++epoch;
+            fs::create_directories(directory);
+
+            keyColumns = primaryKey;
+            keyIndex.reset();
+            if (!keyColumns.empty())
+            {
+                keyIndex.emplace(keyColumns, TableRows{});
+            }
+            nextSeq = 0;
+
+            std::vector<std::pair<std::string, const nlohmann::json*>> keyed;
+            keyed.reserve(rows.size());
+            for (const auto& row : rows)
+            {
+                keyed.emplace_back(keyOf(row), &row);
+            }
+            std::stable_sort(keyed.begin(), keyed.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+            RunRecords records;
+            records.reserve(keyed.size());
+            for (std::size_t index = 0; index < keyed.size(); ++index)
+            {
+                if (index + 1 == keyed.size() || keyed[index + 1].first != keyed[index].first)
+                {
+                    records.push_back(std::move(keyed[index]));
+                }
+            }
+
+            // The old runs stay on disk until the new manifest no longer names them.
+            const auto retired = std::exchange(levels, std::vector<std::vector<std::shared_ptr<LsmRun>>>(2));
+            if (!records.empty())
+            {
+                levels[1].push_back(WriteRunFile(directory, nextRunId++, records, sync));
+            }
+
+            const std::string oldLog = logPath();
+            ++logId;
+            memtable.clear();
+            syncWrites = sync;
+            writeManifest(sync);
+            std::error_code error;
+            fs::remove(oldLog, error);
+            logStamp.reset();
+            for (const auto& level : retired)
+            {
+                for (const auto& run : level)
+                {
+                    run->obsolete = true;
+                }
+            }
+
+            TableRows sorted;
+            sorted.reserve(records.size());
+            viewKeys.clear();
+            viewKeys.reserve(records.size());
+            for (const auto& [key, row] : records)
+            {
+                sorted.push_back(*row);
+                viewKeys.push_back(key);
+            }
+            view = std::make_shared<TableRows>(std::move(sorted));
+        }
+
+        std::shared_ptr<const TableRows> LsmTree::snapshot()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refresh();
+            if (view == nullptr)
+            {
+                buildView();
+            }
+            return view;
+        }
+
+        std::shared_ptr<const TableRows> LsmTree::peekSnapshot()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refresh();
+            return view;
+        }
+
+        void LsmTree::buildView()
+        {
+            std::vector<TableRows> sources;
+            for (std::size_t level = levels.size(); level-- > 1;)
+            {
+                for (const auto& run : levels[level])
+                {
+                    sources.emplace_back();
+                    ReadJsonLines(run->path, 0, sources.back());
+                }
+            }
+            for (const auto& run : levels.front())
+            {
+                sources.emplace_back();
+                ReadJsonLines(run->path, 0, sources.back());
+            }
+            sources.emplace_back();
+            for (const auto& [key, value] : memtable)
+            {
+                sources.back().push_back({{"k", key}});
+                if (value.has_value())
+                {
+                    sources.back().back()["v"] = *value;
+                }
+            }
+
+            TableRows rows;
+            viewKeys.clear();
+            for (const auto& [key, record] : MergeSources(sources))
+            {
+                const auto value = record->find("v");
+                if (value != record->end())
+                {
+                    viewKeys.emplace_back(key);
+                    rows.push_back(std::move(*value));
+                }
+            }
+            view = std::make_shared<TableRows>(std::move(rows));
+        }
+
+        void LsmTree::applyToView(const Memtable& edits)
+        {
+            // The caller dropped its snapshot, so unless a reader still holds
+            // one the rows are edited where they are.
+            TableRows rows = view.use_count() == 1 ? std::move(const_cast<TableRows&>(*view)) : *view;
+            view.reset();
+
+            constexpr std::size_t kPointEdits = 64;
+            if (edits.size() <= kPointEdits)
+            {
+                for (const auto& [key, value] : edits)
+                {
+                    const auto it = std::lower_bound(viewKeys.begin(), viewKeys.end(), key);
+                    const auto position = static_cast<std::ptrdiff_t>(it - viewKeys.begin());
+                    const bool found = it != viewKeys.end() && *it == key;
+                    if (value.has_value() && found)
+                    {
+                        rows[static_cast<std::size_t>(position)] = *value;
+                    }
+                    else if (value.has_value())
+                    {
+                        viewKeys.insert(it, key);
+                        rows.insert(rows.begin() + position, *value);
+                    }
+                    else if (found)
+                    {
+                        viewKeys.erase(it);
+                        rows.erase(rows.begin() + position);
+                    }
+                }
+                view = std::make_shared<TableRows>(std::move(rows));
+                return;
+            }
+
+            TableRows merged;
+            std::vector<std::string> mergedKeys;
+            merged.reserve(rows.size() + edits.size());
+            mergedKeys.reserve(rows.size() + edits.size());
+            std::size_t index = 0;
+            for (const auto& [key, value] : edits)
+            {
+                for (; index < viewKeys.size() && viewKeys[index] < key; ++index)
+                {
+                    mergedKeys.push_back(std::move(viewKeys[index]));
+                    merged.push_back(std::move(rows[index]));
+                }
+                if (index < viewKeys.size() && viewKeys[index] == key)
+                {
+                    ++index;
+                }
+                if (value.has_value())
+                {
+                    mergedKeys.push_back(key);
+                    merged.push_back(*value);
+                }
+            }
+            for (; index < viewKeys.size(); ++index)
+            {
+                mergedKeys.push_back(std::move(viewKeys[index]));
+                merged.push_back(std::move(rows[index]));
+            }
+            viewKeys = std::move(mergedKeys);
+            view = std::make_shared<TableRows>(std::move(merged));
+        }
+
+        void LsmTree::apply(const TableChange& change, bool sync)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refresh();
+            syncWrites = sync;
+            if (change.kind != TableChange::Kind::INSERT && view == nullptr)
+            {
+                buildView();
+            }
+
+            // Moved keys are deleted unless another row of the statement moves
+            // into them, whichever order the rows come in.
+            Memtable edits;
+            switch (change.kind)
+            {
+            case TableChange::Kind::INSERT:
+                for (const auto& row : change.rows)
+                {
+                    edits[keyOf(row)] = row;
+                }
+                break;
+            case TableChange::Kind::UPDATE:
+            case TableChange::Kind::UPSERT:
+                for (std::size_t index = 0; index < change.rows.size(); ++index)
+                {
+                    if (index >= change.positions.size())
+                    {
+                        edits[keyOf(change.rows[index])] = change.rows[index];
+                        continue;
+                    }
+                    const std::string& oldKey = viewKeys.at(change.positions[index]);
+                    std::string newKey = keyIndex.has_value() ? keyOf(change.rows[index]) : oldKey;
+                    if (newKey != oldKey)
+                    {
+                        edits.emplace(oldKey, std::nullopt);
+                    }
+                    edits[std::move(newKey)] = change.rows[index];
+                }
+                break;
+            case TableChange::Kind::DELETE:
+                for (const std::size_t position : change.positions)
+                {
+                    edits[viewKeys.at(position)] = std::nullopt;
+                }
+                break;
+            }
+            if (edits.empty())
+            {
+                return;
+            }
+
+            TableRows records;
+            records.reserve(edits.size());
+            for (const auto& [key, value] : edits)
+            {
+                records.push_back({{"k", key}});
+                if (value.has_value())
+                {
+                    records.back()["v"] = *value;
+                }
+            }
+            fs::create_directories(directory);
+            AppendJsonLines(logPath(), records, nullptr, sync);
+            logStamp = StatFile(logPath());
+
+            for (const auto& [key, value] : edits)
+            {
+                memtable[key] = value;
+            }
+            if (view != nullptr)
+            {
+                applyToView(edits);
+            }
+            if (logStamp.has_value() && logStamp->size > memtableBudget)
+            {
+                flushMemtable();
+            }
+        }
+
+        std::optional<nlohmann::json> LsmTree::get(const std::string& key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refresh();
+            ++stats.lookups;
+            if (view != nullptr)
+            {
+                const auto it = std::lower_bound(viewKeys.begin(), viewKeys.end(), key);
+                if (it == viewKeys.end() || *it != key)
+                {
+                    return std::nullopt;
+                }
+                return (*view)[static_cast<std::size_t>(it - viewKeys.begin())];
+            }
+
+            const auto cached = memtable.find(key);
+            if (cached != memtable.end())
+            {
+                return cached->second;
+            }
+
+            const auto probe = [&](const LsmRun& run) -> std::optional<std::optional<nlohmann::json>> {
+                if (key < run.minKey || run.maxKey < key)
+                {
+                    return std::nullopt;
+                }
+                if (!run.bloom.mayContain(key))
+                {
+                    ++stats.bloomSkips;
+                    return std::nullopt;
+                }
+                ++stats.runReads;
+                std::optional<nlohmann::json> record = FindRunRecord(run.path, key);
+                if (!record.has_value())
+                {
+                    return std::nullopt;
+                }
+                const auto value = record->find("v");
+                return value != record->end() ? std::optional<nlohmann::json>(std::move(*value)) : std::nullopt;
+            };
+            for (auto run = levels.front().rbegin(); run != levels.front().rend(); ++run)
+            {
+                if (auto found = probe(**run))
+                {
+                    return std::move(*found);
+                }
+            }
+            for (std::size_t level = 1; level < levels.size(); ++level)
+            {
+                for (const auto& run : levels[level])
+                {
+                    if (auto found = probe(*run))
+                    {
+                        return std::move(*found);
+                    }
+                }
+            }
+            return std::nullopt;
+        }
+
+        bool LsmTree::compactionDue() const
+        {
+            if (levels.empty() || !manifestStamp.has_value())
+            {
+                return false;
+            }
+            if (levels.front().size() >= kLevel0Runs)
+            {
+                return true;
+            }
+            std::uint64_t budget = memtableBudget;
+            for (std::size_t level = 1; level < levels.size(); ++level)
+            {
+                budget *= kLevelFanout;
+                std::uint64_t bytes = 0;
+                for (const auto& run : levels[level])
+                {
+                    bytes += run->bytes;
+                }
+                if (bytes > budget)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool LsmTree::compactOnce(std::unique_lock<std::mutex>& lock)
+        {
+            if (!compactionDue())
+            {
+                return false;
+            }
+
+            // Level 0 runs overlap, so all of them go down at once; deeper levels
+            // push their first run into the runs of the next level it overlaps.
+            std::size_t source = 0;
+            std::vector<std::shared_ptr<LsmRun>> upper;
+            if (levels.front().size() >= kLevel0Runs)
+            {
+                upper = levels.front();
+            }
+            else
+            {
+                std::uint64_t budget = memtableBudget;
+                for (source = 1; source < levels.size(); ++source)
+                {
+                    budget *= kLevelFanout;
+                    std::uint64_t bytes = 0;
+                    for (const auto& run : levels[source])
+                    {
+                        bytes += run->bytes;
+                    }
+                    if (bytes > budget)
+                    {
+                        break;
+                    }
+                }
+                upper = {levels[source].front()};
+            }
+            const std::size_t target = source + 1;
+            if (levels.size() <= target)
+            {
+                levels.resize(target + 1);
+            }
+
+            std::string minKey = upper.front()->minKey;
+            std::string maxKey = upper.front()->maxKey;
+            for (const auto& run : upper)
+            {
+                minKey = std::min(minKey, run->minKey);
+                maxKey = std::max(maxKey, run->maxKey);
+            }
+            std::vector<std::shared_ptr<LsmRun>> inputs;
+            for (const auto& run : levels[target])
+            {
+                if (Overlaps(*run, minKey, maxKey))
+                {
+                    inputs.push_back(run);
+                }
+            }
+            inputs.insert(inputs.end(), upper.begin(), upper.end());
+
+            bool bottom = true;
+            for (std::size_t level = target + 1; level < levels.size(); ++level)
+            {
+                bottom = bottom && levels[level].empty();
+            }
+            std::uint64_t inputBytes = 0;
+            std::uint64_t inputRows = 0;
+            for (const auto& run : inputs)
+            {
+                inputBytes += run->bytes;
+                inputRows += run->rows;
+            }
+            const std::uint64_t runBytes = memtableBudget;
+            const std::uint64_t firstId = nextRunId;
+            nextRunId += inputBytes / runBytes + 2;
+            const std::uint64_t endId = nextRunId;
+            const std::uint64_t startEpoch = epoch;
+            const bool sync = syncWrites;
+
+            std::vector<std::shared_ptr<LsmRun>> outputs;
+            lock.unlock();
+            try
+            {
+                std::vector<TableRows> sources(inputs.size());
+                for (std::size_t index = 0; index < inputs.size(); ++index)
+                {
+                    ReadJsonLines(inputs[index]->path, 0, sources[index]);
+                }
+
+                const std::uint64_t bytesPerRow = std::max<std::uint64_t>(1, inputBytes / std::max<std::uint64_t>(1, inputRows));
+                RunRecords records;
+                for (const auto& [key, record] : MergeSources(sources))
+                {
+                    const auto value = record->find("v");
+                    if (value == record->end() && bottom)
+                    {
+                        continue;
+                    }
+                    records.emplace_back(std::string(key), value != record->end() ? &*value : nullptr);
+                    if (records.size() * bytesPerRow >= runBytes && firstId + outputs.size() + 1 < endId)
+                    {
+                        outputs.push_back(WriteRunFile(directory, firstId + outputs.size(), records, sync));
+                        records.clear();
+                    }
+                }
+                if (!records.empty())
+                {
+                    outputs.push_back(WriteRunFile(directory, firstId + outputs.size(), records, sync));
+                }
+            }
+            catch (...)
+            {
+                for (auto& run : outputs)
+                {
+                    run->obsolete = true;
+                }
+                lock.lock();
+                throw;
+            }
+            lock.lock();
+
+            if (epoch != startEpoch)
+            {
+                for (auto& run : outputs)
+                {
+                    run->obsolete = true;
+                }
+                return true;
+            }
+            for (auto& run : inputs)
+            {
+                run->obsolete = true;
+            }
+            for (const std::size_t level : {source, target})
+            {
+                auto& runs = levels[level];
+                runs.erase(
+                    std::remove_if(runs.begin(), runs.end(), [](const std::shared_ptr<LsmRun>& run) { return run->obsolete; }),
+                    runs.end());
+            }
+            levels[target].insert(levels[target].end(), outputs.begin(), outputs.end());
+            std::sort(levels[target].begin(), levels[target].end(), [](const auto& left, const auto& right) {
+                return left->minKey < right->minKey;
+            });
+            while (levels.size() > 2 && levels.back().empty())
+            {
+                levels.pop_back();
+            }
+            writeManifest(syncWrites);
+            ++stats.compactions;
+            return true;
+        }
+
+        void LsmTree::compactionLoop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                wakeup.wait(lock, [this]() { return stopping || (!compacting && compactionDue()); });
+                if (stopping)
+                {
+                    return;
+                }
+                compacting = true;
+                try
+                {
+                    compactOnce(lock);
+                    compacting = false;
+                }
+                catch (...)
+                {
+                    // Inputs stay where they are; try again after a pause.
+                    compacting = false;
+                    wakeup.notify_all();
+                    wakeup.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping; });
+                    continue;
+                }
+                wakeup.notify_all();
+            }
+        }
+
+        void LsmTree::compact()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return !compacting; });
+            refresh();
+            compacting = true;
+            try
+            {
+                while (compactOnce(lock))
+                {
+                }
+            }
+            catch (...)
+            {
+                compacting = false;
+                wakeup.notify_all();
+                throw;
+            }
+            compacting = false;
+            wakeup.notify_all();
+        }
+
+        LsmStats LsmTree::getStats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            LsmStats result = stats;
+            result.memtableRows = memtable.size();
+            for (const auto& level : levels)
+            {
+                result.runsPerLevel.push_back(level.size());
+            }
+            return result;
+        }
+    }
+}
@@ -0,0 +1,622 @@
+#include <database/json_pager.h>
+
+#include <database/json_driver.h>
+#include <database/json_writer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace
+{
+constexpr std::size_t kPageHeaderBytes = 8;
+constexpr std::size_t kSlotBytes = 4;
+constexpr std::size_t kFileHeaderBytes = sizeof(sql::jsondb::kPagedMagic) + 4 + 8 + 8;
+
+std::uint64_t GetLittle(const char* in, std::size_t bytes)
+{
+    std::uint64_t value = 0;
+    for (std::size_t index = bytes; index-- > 0;)
+    {
+        value = (value << 8) | static_cast<unsigned char>(in[index]);
+    }
+    return value;
+}
+
+void PutLittle(char* out, std::size_t bytes, std::uint64_t value)
+{
+    for (std::size_t index = 0; index < bytes; ++index)
+    {
+        out[index] = static_cast<char>((value >> (index * 8)) & 0xFFU);
+    }
+}
+
+bool ValidPageBytes(std::uint64_t pageBytes)
+{
+    return pageBytes == 4096 || pageBytes == 8192 || pageBytes == 16384;
+}
+
+// Data page: slot count, live rows and the start of the record heap as 16-bit
+// words, then {offset, length} slots; length 0 is an emptied slot. Bytes is
+// const for pages only read.
+template <typename Bytes>
+struct SlottedPage
+{
+    Bytes& data;
+
+    std::size_t slotCount() const { return GetLittle(data.data(), 2); }
+    std::size_t liveRows() const { return GetLittle(data.data() + 2, 2); }
+    std::size_t heapStart() const { return GetLittle(data.data() + 4, 2); }
+    std::size_t slotOffset(std::size_t slot) const { return GetLittle(data.data() + kPageHeaderBytes + slot * kSlotBytes, 2); }
+    std::size_t slotLength(std::size_t slot) const { return GetLittle(data.data() + kPageHeaderBytes + slot * kSlotBytes + 2, 2); }
+    std::size_t freeBytes() const { return heapStart() - kPageHeaderBytes - slotCount() * kSlotBytes; }
+    std::string_view record(std::size_t slot) const { return std::string_view(data).substr(slotOffset(slot), slotLength(slot)); }
+
+    void setCounts(std::size_t slots, std::size_t live, std::size_t heap)
+    {
+        PutLittle(data.data(), 2, slots);
+        PutLittle(data.data() + 2, 2, live);
+        PutLittle(data.data() + 4, 2, heap);
+    }
+
+    void setSlot(std::size_t slot, std::size_t offset, std::size_t length)
+    {
+        PutLittle(data.data() + kPageHeaderBytes + slot * kSlotBytes, 2, offset);
+        PutLittle(data.data() + kPageHeaderBytes + slot * kSlotBytes + 2, 2, length);
+    }
+
+    void clear()
+    {
+        std::fill(data.begin(), data.end(), '\0');
+        setCounts(0, 0, data.size());
+    }
+
+    // The slot holding the live row at ordinal, counting emptied slots out.
+    std::size_t liveSlot(std::size_t ordinal) const
+    {
+        for (std::size_t slot = 0; slot < slotCount(); ++slot)
+        {
+            if (slotLength(slot) != 0 && ordinal-- == 0)
+            {
+                return slot;
+            }
+        }
+        throw sql::jsondb::JsonDbException("Paged table directory does not match its pages.");
+    }
+
+    bool append(std::string_view text)
+    {
+        if (freeBytes() < text.size() + kSlotBytes)
+        {
+            return false;
+        }
+        const std::size_t offset = heapStart() - text.size();
+        std::memcpy(data.data() + offset, text.data(), text.size());
+        setSlot(slotCount(), offset, text.size());
+        setCounts(slotCount() + 1, liveRows() + 1, offset);
+        return true;
+    }
+
+    // Lays the live records out again without holes or emptied slots, with the
+    // one at slot replaced when given.
+    bool rebuild(std::optional<std::pair<std::size_t, std::string_view>> replacement = std::nullopt)
+    {
+        std::vector<std::string> records;
+        std::size_t bytes = kPageHeaderBytes;
+        for (std::size_t slot = 0; slot < slotCount(); ++slot)
+        {
+            if (slotLength(slot) == 0)
+            {
+                continue;
+            }
+            records.emplace_back(replacement.has_value() && replacement->first == slot ? replacement->second : record(slot));
+            bytes += records.back().size() + kSlotBytes;
+        }
+        if (bytes > data.size())
+        {
+            return false;
+        }
+        clear();
+        for (const auto& text : records)
+        {
+            append(text);
+        }
+        return true;
+    }
+
+    bool replace(std::size_t slot, std::string_view text)
+    {
+        if (text.size() <= slotLength(slot))
+        {
+            std::memcpy(data.data() + slotOffset(slot), text.data(), text.size());
+            setSlot(slot, slotOffset(slot), text.size());
+            return true;
+        }
+        if (freeBytes() >= text.size())
+        {
+            const std::size_t offset = heapStart() - text.size();
+            std::memcpy(data.data() + offset, text.data(), text.size());
+            setSlot(slot, offset, text.size());
+            setCounts(slotCount(), liveRows(), offset);
+            return true;
+        }
+        return rebuild(std::make_pair(slot, text));
+    }
+
+    void erase(std::size_t slot)
+    {
+        setSlot(slot, 0, 0);
+        setCounts(slotCount(), liveRows() - 1, heapStart());
+    }
+};
+
+std::string EncodeRecord(const nlohmann::json& row, std::size_t pageBytes)
+{
+    std::string record;
+    sql::jsondb::AppendJson(record, row);
+    if (record.size() + kPageHeaderBytes + kSlotBytes > pageBytes)
+    {
+        throw sql::jsondb::JsonDbException("Row does not fit in a " + std::to_string(pageBytes) + "-byte page.");
+    }
+    return record;
+}
+
+void WriteFileHeader(std::string& page, std::uint32_t pageBytes, std::uint64_t pageCount, std::uint64_t rowCount)
+{
+    std::memcpy(page.data(), sql::jsondb::kPagedMagic, sizeof(sql::jsondb::kPagedMagic));
+    PutLittle(page.data() + 8, 4, pageBytes);
+    PutLittle(page.data() + 12, 8, pageCount);
+    PutLittle(page.data() + 20, 8, rowCount);
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        bool IsPagedFile(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            char magic[sizeof(kPagedMagic)] = {};
+            file.read(magic, sizeof(magic));
+            return file.gcount() == static_cast<std::streamsize>(sizeof(magic)) && std::memcmp(magic, kPagedMagic, sizeof(magic)) == 0;
+        }
+
+        std::string SerializePagedTable(const TableRows& rows, std::uint32_t pageBytes)
+        {
+            if (!ValidPageBytes(pageBytes))
+            {
+                throw JsonDbException("Unsupported page size: " + std::to_string(pageBytes));
+            }
+
+            std::string data(pageBytes, '\0');
+            std::string page(pageBytes, '\0');
+            SlottedPage<std::string> slotted{page};
+            slotted.clear();
+            for (const auto& row : rows)
+            {
+                const std::string record = EncodeRecord(row, pageBytes);
+                if (!slotted.append(record))
+                {
+                    data += page;
+                    slotted.clear();
+                    slotted.append(record);
+                }
+            }
+            if (slotted.slotCount() > 0)
+            {
+                data += page;
+            }
+            WriteFileHeader(data, pageBytes, data.size() / pageBytes, rows.size());
+            return data;
+        }
+
+        BufferPool::PageRef::PageRef(PageRef&& other) noexcept
+            : pool(std::exchange(other.pool, nullptr)), frame(std::exchange(other.frame, nullptr))
+        {
+        }
+
+        BufferPool::PageRef& BufferPool::PageRef::operator=(PageRef&& other) noexcept
+        {
+            if (this != &other)
+            {
+                this->~PageRef();
+                pool = std::exchange(other.pool, nullptr);
+                frame = std::exchange(other.frame, nullptr);
+            }
+            return *this;
+        }
+
+        BufferPool::PageRef::~PageRef()
+        {
+            if (frame != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                --frame->pins;
+                frame = nullptr;
+            }
+        }
+
+        std::string& BufferPool::PageRef::mutableData()
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            frame->dirty = true;
+            return frame->data;
+        }
+
+        BufferPool::BufferPool(std::size_t pages) : capacity(std::max<std::size_t>(1, pages)) {}
+
+        void BufferPool::setCapacity(std::size_t pages)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacity = std::max<std::size_t>(1, pages);
+            trim();
+        }
+
+        BufferPool::Frame* BufferPool::victim()
+        {
+            // Two sweeps: the first may only clear reference bits.
+            for (std::size_t step = 0; step < frames.size() * 2; ++step)
+            {
+                Frame& frame = *frames[hand];
+                hand = (hand + 1) % frames.size();
+                if (frame.pins > 0 || frame.dirty)
+                {
+                    continue;
+                }
+                if (frame.referenced)
+                {
+                    frame.referenced = false;
+                    continue;
+                }
+                return &frame;
+            }
+            return nullptr;
+        }
+
+        void BufferPool::trim()
+        {
+            for (std::size_t index = frames.size(); index-- > 0 && frames.size() > capacity;)
+            {
+                Frame& frame = *frames[index];
+                if (frame.pins > 0 || frame.dirty)
+                {
+                    continue;
+                }
+                const auto it = resident.find({frame.file, frame.page});
+                if (it != resident.end() && it->second == &frame)
+                {
+                    resident.erase(it);
+                }
+                frames.erase(frames.begin() + static_cast<std::ptrdiff_t>(index));
+                ++stats.evictions;
+            }
+            hand = frames.empty() ? 0 : hand % frames.size();
+        }
+
+        BufferPool::PageRef BufferPool::fetch(
+            std::uint64_t file,
+            std::uint64_t page,
+            std::size_t pageBytes,
+            const std::function<void(std::string&)>& load)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = resident.find({file, page});
+            if (it != resident.end())
+            {
+                ++stats.hits;
+                ++it->second->pins;
+                it->second->referenced = true;
+                return PageRef(this, it->second);
+            }
+
+            ++stats.misses;
+            Frame* frame = frames.size() < capacity ? nullptr : victim();
+            if (frame != nullptr)
+            {
+                const auto previous = resident.find({frame->file, frame->page});
+                if (previous != resident.end() && previous->second == frame)
+                {
+                    resident.erase(previous);
+                }
+                ++stats.evictions;
+            }
+            else
+            {
+                frames.push_back(std::make_unique<Frame>());
+                frame = frames.back().get();
+            }
+
+            frame->file = 0;
+            frame->data.assign(pageBytes, '\0');
+            load(frame->data);
+            frame->file = file;
+            frame->page = page;
+            frame->pins = 1;
+            frame->dirty = false;
+            frame->referenced = true;
+            resident[{file, page}] = frame;
+            return PageRef(this, frame);
+        }
+
+        std::vector<std::pair<std::uint64_t, std::string>> BufferPool::takeDirty(std::uint64_t file)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::pair<std::uint64_t, std::string>> pages;
+            for (auto& frame : frames)
+            {
+                if (frame->file == file && frame->dirty)
+                {
+                    pages.emplace_back(frame->page, frame->data);
+                    frame->dirty = false;
+                }
+            }
+            std::sort(pages.begin(), pages.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+            trim();
+            return pages;
+        }
+
+        void BufferPool::discard(std::uint64_t file)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::size_t index = frames.size(); index-- > 0;)
+            {
+                Frame& frame = *frames[index];
+                if (frame.file != file)
+                {
+                    continue;
+                }
+                resident.erase({frame.file, frame.page});
+                frame.file = 0;
+                frame.dirty = false;
+                if (frame.pins == 0)
+                {
+                    frames.erase(frames.begin() + static_cast<std::ptrdiff_t>(index));
+                }
+            }
+            hand = frames.empty() ? 0 : hand % frames.size();
+        }
+
+        BufferPoolStats BufferPool::getStats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            BufferPoolStats result = stats;
+            result.residentPages = resident.size();
+            result.capacityPages = capacity;
+            return result;
+        }
+
+        PagedTable::PagedTable(std::string filePath, BufferPool& bufferPool)
+            : path(std::move(filePath)), fileId([]() {
+                  static std::atomic<std::uint64_t> nextId{1};
+                  return nextId++;
+              }()),
+              pool(bufferPool)
+        {
+            const std::optional<FileStamp> stamp = StatFile(path);
+            file.open(path, std::ios::binary);
+            if (!stamp.has_value() || !file.is_open())
+            {
+                throw JsonDbException("Failed to open table file: " + path);
+            }
+            inode = stamp->inode;
+            // A journal left by a crash is applied to pages as they are read.
+            journal = LoadPatchJournal(path);
+
+            char header[kFileHeaderBytes];
+            readBytes(0, header, sizeof(header));
+            if (std::memcmp(header, kPagedMagic, sizeof(kPagedMagic)) != 0 || !ValidPageBytes(GetLittle(header + 8, 4)))
+            {
+                throw JsonDbException("Invalid paged table file: " + path);
+            }
+            pageBytes = static_cast<std::uint32_t>(GetLittle(header + 8, 4));
+            pageCount = GetLittle(header + 12, 8);
+            rowCount = GetLittle(header + 20, 8);
+            if (pageCount == 0)
+            {
+                throw JsonDbException("Invalid paged table file: " + path);
+            }
+        }
+
+        PagedTable::~PagedTable()
+        {
+            pool.discard(fileId);
+        }
+
+        void PagedTable::readBytes(std::uint64_t offset, char* out, std::size_t length)
+        {
+            std::lock_guard<std::mutex> lock(fileMutex);
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(offset));
+            if (!file.read(out, static_cast<std::streamsize>(length)))
+            {
+                throw JsonDbException("Paged table file is truncated: " + path);
+            }
+            for (const auto& patch : journal)
+            {
+                const std::uint64_t begin = std::max(offset, patch.offset);
+                const std::uint64_t end = std::min(offset + length, patch.offset + patch.bytes.size());
+                if (begin < end)
+                {
+                    std::memcpy(out + (begin - offset), patch.bytes.data() + (begin - patch.offset), end - begin);
+                }
+            }
+        }
+
+        BufferPool::PageRef PagedTable::fetchPage(std::uint64_t page)
+        {
+            return pool.fetch(fileId, page, pageBytes, [&](std::string& data) {
+                if (page < pageCount)
+                {
+                    readBytes(page * pageBytes, data.data(), data.size());
+                }
+                else
+                {
+                    SlottedPage<std::string>{data}.clear();
+                }
+            });
+        }
+
+        void PagedTable::loadDirectory()
+        {
+            if (directory.has_value())
+            {
+                return;
+            }
+            std::vector<std::uint64_t> rows;
+            rows.reserve(pageCount - 1);
+            char header[kPageHeaderBytes];
+            for (std::uint64_t page = 1; page < pageCount; ++page)
+            {
+                readBytes(page * pageBytes, header, sizeof(header));
+                rows.push_back(GetLittle(header + 2, 2));
+            }
+            directory = std::move(rows);
+        }
+
+        bool PagedTable::scan(const RowVisitor& visit, const std::vector<std::string>& columns)
+        {
+            for (std::uint64_t page = 1; page < pageCount; ++page)
+            {
+                const BufferPool::PageRef ref = fetchPage(page);
+                const SlottedPage<const std::string> slotted{ref.data()};
+                for (std::size_t slot = 0; slot < slotted.slotCount(); ++slot)
+                {
+                    if (slotted.slotLength(slot) != 0 && !VisitJsonRow(slotted.record(slot), path, visit, columns))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        TableRows PagedTable::readRows()
+        {
+            TableRows rows;
+            rows.reserve(rowCount);
+            scan([&rows](nlohmann::json& row) {
+                rows.push_back(std::move(row));
+                return true;
+            });
+            return rows;
+        }
+
+        bool PagedTable::applyChange(const TableChange& change)
+        {
+            loadDirectory();
+            std::vector<std::uint64_t>& live = *directory;
+
+            // Positions are resolved against the pages as they were, before any
+            // row moves.
+            std::vector<std::uint64_t> firstRow(live.size() + 1, 0);
+            for (std::size_t page = 0; page < live.size(); ++page)
+            {
+                firstRow[page + 1] = firstRow[page] + live[page];
+            }
+            const auto locate = [&](std::size_t position) {
+                if (position >= firstRow.back())
+                {
+                    throw JsonDbException("Change references a missing row in table: " + change.table);
+                }
+                const std::size_t index = static_cast<std::size_t>(std::upper_bound(firstRow.begin(), firstRow.end(), position) - firstRow.begin()) - 1;
+                return std::make_pair(index, static_cast<std::size_t>(position - firstRow[index]));
+            };
+
+            if (change.kind == TableChange::Kind::DELETE)
+            {
+                std::vector<std::pair<std::size_t, std::size_t>> slots;
+                for (const std::size_t position : change.positions)
+                {
+                    const auto [index, ordinal] = locate(position);
+                    BufferPool::PageRef ref = fetchPage(index + 1);
+                    slots.emplace_back(index, SlottedPage<const std::string>{ref.data()}.liveSlot(ordinal));
+                }
+                for (const auto& [index, slot] : slots)
+                {
+                    BufferPool::PageRef ref = fetchPage(index + 1);
+                    SlottedPage<std::string>{ref.mutableData()}.erase(slot);
+                    --live[index];
+                    --rowCount;
+                }
+            }
+            else if (change.kind != TableChange::Kind::INSERT)
+            {
+                for (std::size_t index = 0; index < change.positions.size(); ++index)
+                {
+                    const auto [page, ordinal] = locate(change.positions[index]);
+                    BufferPool::PageRef ref = fetchPage(page + 1);
+                    SlottedPage<std::string> slotted{ref.mutableData()};
+                    if (!slotted.replace(slotted.liveSlot(ordinal), EncodeRecord(change.rows[index], pageBytes)))
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            const std::size_t firstNew = change.kind == TableChange::Kind::INSERT ? 0 : change.positions.size();
+            for (std::size_t index = firstNew; change.kind != TableChange::Kind::DELETE && index < change.rows.size(); ++index)
+            {
+                const std::string record = EncodeRecord(change.rows[index], pageBytes);
+                bool placed = false;
+                if (pageCount > 1)
+                {
+                    BufferPool::PageRef ref = fetchPage(pageCount - 1);
+                    SlottedPage<std::string> slotted{ref.mutableData()};
+                    placed = slotted.append(record) || (slotted.rebuild() && slotted.append(record));
+                    live.back() += placed ? 1 : 0;
+                }
+                if (!placed)
+                {
+                    BufferPool::PageRef ref = fetchPage(pageCount);
+                    SlottedPage<std::string>{ref.mutableData()}.append(record);
+                    live.push_back(1);
+                    ++pageCount;
+                }
+                ++rowCount;
+            }
+
+            BufferPool::PageRef header = fetchPage(0);
+            WriteFileHeader(header.mutableData(), pageBytes, pageCount, rowCount);
+            return true;
+        }
+
+        bool PagedTable::apply(const TableChange& change, bool sync)
+        {
+            const std::uint64_t oldPageCount = pageCount;
+            const std::uint64_t oldRowCount = rowCount;
+            const auto rollback = [&]() {
+                pool.discard(fileId);
+                pageCount = oldPageCount;
+                rowCount = oldRowCount;
+                directory.reset();
+            };
+            bool applied = false;
+            try
+            {
+                applied = applyChange(change);
+            }
+            catch (...)
+            {
+                rollback();
+                throw;
+            }
+            if (!applied)
+            {
+                rollback();
+                return false;
+            }
+
+            std::vector<FilePatch> patches;
+            for (auto& [page, data] : pool.takeDirty(fileId))
+            {
+                patches.push_back(FilePatch{page * pageBytes, std::move(data)});
+            }
+            PatchFileInPlace(path, inode, std::move(patches), sync);
+            journal.clear();
+            return true;
+        }
+    }
+}
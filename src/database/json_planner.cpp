@@ -0,0 +1,215 @@
+#include <database/json_planner.h>
+
+#include <database/json_driver.h>
+
+#include <algorithm>
+
+namespace
+{
+bool HasIndex(
+    const std::vector<sql::jsondb::IndexDefinition>& indexes,
+    const std::string& column,
+    sql::jsondb::IndexType type)
+{
+    return std::any_of(indexes.begin(), indexes.end(), [&](const sql::jsondb::IndexDefinition& index) {
+        return index.column == column && index.type == type;
+    });
+}
+
+const SqlExpression* FindIndexedEquality(const SqlExpression& expression, const std::vector<sql::jsondb::IndexDefinition>& indexes)
+{
+    if (expression.kind == SqlExpression::Kind::COMPARE)
+    {
+        const bool indexed = HasIndex(indexes, expression.column, sql::jsondb::IndexType::HASH);
+        return indexed && expression.op == SqlCompareOp::EQ ? &expression : nullptr;
+    }
+
+    if (expression.kind == SqlExpression::Kind::AND)
+    {
+        for (const auto& child : expression.children)
+        {
+            if (const SqlExpression* match = FindIndexedEquality(*child, indexes))
+            {
+                return match;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Returns {column: literal} when the AND chain pins every primary key column
+// with an equality.
+std::optional<nlohmann::json> FindPrimaryKeyEquality(const SqlExpression& where, const std::vector<std::string>& primaryKey)
+{
+    nlohmann::json key = nlohmann::json::object();
+    std::vector<const SqlExpression*> pending{&where};
+    while (!pending.empty())
+    {
+        const SqlExpression* expression = pending.back();
+        pending.pop_back();
+        if (expression->kind == SqlExpression::Kind::AND)
+        {
+            for (const auto& child : expression->children)
+            {
+                pending.push_back(child.get());
+            }
+        }
+        else if (expression->kind == SqlExpression::Kind::COMPARE && expression->op == SqlCompareOp::EQ &&
+                 std::find(primaryKey.begin(), primaryKey.end(), expression->column) != primaryKey.end())
+        {
+            key[expression->column] = sql::jsondb::SqlValueToJson(expression->value);
+        }
+    }
+
+    if (primaryKey.empty() || key.size() != primaryKey.size())
+    {
+        return std::nullopt;
+    }
+    return key;
+}
+
+void TightenLower(std::optional<sql::jsondb::BTreeBound>& bound, const nlohmann::json& value, bool inclusive)
+{
+    const int order = bound.has_value() ? sql::jsondb::CompareBTreeValues(value, bound->value) : 1;
+    if (order > 0 || (order == 0 && !inclusive))
+    {
+        bound = sql::jsondb::BTreeBound{value, inclusive};
+    }
+}
+
+void TightenUpper(std::optional<sql::jsondb::BTreeBound>& bound, const nlohmann::json& value, bool inclusive)
+{
+    const int order = bound.has_value() ? sql::jsondb::CompareBTreeValues(value, bound->value) : -1;
+    if (order < 0 || (order == 0 && !inclusive))
+    {
+        bound = sql::jsondb::BTreeBound{value, inclusive};
+    }
+}
+
+// Folds every numeric or string comparison on column that sits under the
+// top-level AND chain into one [lower, upper] range, in the index's order.
+void CollectRange(const SqlExpression& expression, const std::string& column, sql::jsondb::ScanPlan& plan)
+{
+    if (expression.kind == SqlExpression::Kind::AND)
+    {
+        for (const auto& child : expression.children)
+        {
+            CollectRange(*child, column, plan);
+        }
+        return;
+    }
+
+    const SqlValue::Kind kind = expression.value.kind;
+    if (expression.kind != SqlExpression::Kind::COMPARE || expression.column != column ||
+        (kind != SqlValue::Kind::INTEGER && kind != SqlValue::Kind::FLOAT && kind != SqlValue::Kind::STRING))
+    {
+        return;
+    }
+
+    const nlohmann::json value = sql::jsondb::SqlValueToJson(expression.value);
+    switch (expression.op)
+    {
+    case SqlCompareOp::EQ:
+        TightenLower(plan.lowerBound, value, true);
+        TightenUpper(plan.upperBound, value, true);
+        break;
+    case SqlCompareOp::GT:
+    case SqlCompareOp::GE:
+        TightenLower(plan.lowerBound, value, expression.op == SqlCompareOp::GE);
+        break;
+    case SqlCompareOp::LT:
+    case SqlCompareOp::LE:
+        TightenUpper(plan.upperBound, value, expression.op == SqlCompareOp::LE);
+        break;
+    case SqlCompareOp::NE:
+        break;
+    }
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        ScanPlan Planner::planScan(const SqlTableRef& table, const SqlExpressionPtr& where) const
+        {
+            if (!connection->tableExists(table.table))
+            {
+                throw JsonDbException("Table does not exist: " + table.table);
+            }
+
+            ScanPlan plan;
+            plan.table = table.table;
+            plan.predicate = Predicate::compile(where);
+            if (where == nullptr)
+            {
+                return plan;
+            }
+
+            if (std::optional<nlohmann::json> key = FindPrimaryKeyEquality(*where, connection->getPrimaryKey(table.table)))
+            {
+                plan.accessPath = AccessPath::PRIMARY_KEY;
+                plan.indexColumn = connection->getPrimaryKey(table.table).front();
+                plan.indexKey = std::move(*key);
+                return plan;
+            }
+
+            const std::vector<IndexDefinition> indexes = connection->getIndexDefinitions(table.table);
+            if (const SqlExpression* equality = FindIndexedEquality(*where, indexes))
+            {
+                plan.accessPath = AccessPath::HASH_INDEX;
+                plan.indexColumn = equality->column;
+                plan.indexKey = SqlValueToJson(equality->value);
+                return plan;
+            }
+
+            for (const auto& index : indexes)
+            {
+                if (index.type != IndexType::BTREE)
+                {
+                    continue;
+                }
+                CollectRange(*where, index.column, plan);
+                if (plan.lowerBound.has_value() || plan.upperBound.has_value())
+                {
+                    plan.accessPath = AccessPath::BTREE_RANGE;
+                    plan.indexColumn = index.column;
+                    break;
+                }
+            }
+            return plan;
+        }
+
+        QueryPlan Planner::planSelect(const SqlSelectStatement& select) const
+        {
+            if (select.columns.empty())
+            {
+                throw JsonDbException("SELECT statement must include at least one column.");
+            }
+
+            QueryPlan plan;
+            plan.scan = planScan(select.table, select.where);
+            if (!select.selectsAllColumns())
+            {
+                plan.projection = select.columns;
+            }
+            plan.orderBy = select.orderBy;
+            plan.limit = select.limit;
+            plan.offset = select.offset;
+
+            if (plan.orderBy.size() == 1)
+            {
+                const std::string& column = plan.orderBy.front().column;
+                const bool scanCompatible = plan.scan.accessPath == AccessPath::FULL_SCAN ||
+                                            (plan.scan.accessPath == AccessPath::BTREE_RANGE && plan.scan.indexColumn == column);
+                if (scanCompatible && HasIndex(connection->getIndexDefinitions(plan.scan.table), column, IndexType::BTREE))
+                {
+                    plan.scan.accessPath = AccessPath::BTREE_RANGE;
+                    plan.scan.indexColumn = column;
+                    plan.orderedByIndex = true;
+                }
+            }
+            return plan;
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#include <database/json_predicate.h>
+
+#include <core/sql_parser.h>
+#include <database/json_driver.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+std::unique_ptr<sql::jsondb::PredicateNode> CompileNode(const SqlExpression& expression)
+{
+    using sql::jsondb::PredicateNode;
+
+    auto node = std::make_unique<PredicateNode>();
+    switch (expression.kind)
+    {
+    case SqlExpression::Kind::AND:
+        node->kind = PredicateNode::Kind::AND;
+        break;
+    case SqlExpression::Kind::OR:
+        node->kind = PredicateNode::Kind::OR;
+        break;
+    case SqlExpression::Kind::NOT:
+        node->kind = PredicateNode::Kind::NOT;
+        break;
+    case SqlExpression::Kind::COMPARE:
+        node->kind = PredicateNode::Kind::COMPARE;
+        node->column = expression.column;
+        node->op = expression.op;
+        node->literal = sql::jsondb::SqlValueToJson(expression.value);
+        if (node->literal.is_number())
+        {
+            node->numericLiteral = node->literal.get<double>();
+        }
+        return node;
+    }
+
+    for (const auto& child : expression.children)
+    {
+        node->children.push_back(CompileNode(*child));
+    }
+    return node;
+}
+
+// Both sides integers: compared exactly, since ids above 2^53 do not survive
+// a trip through double.
+int CompareIntegers(const nlohmann::json& lhs, const nlohmann::json& rhs)
+{
+    const bool lhsNegative = !lhs.is_number_unsigned() && lhs.get<std::int64_t>() < 0;
+    const bool rhsNegative = !rhs.is_number_unsigned() && rhs.get<std::int64_t>() < 0;
+    if (lhsNegative != rhsNegative)
+    {
+        return lhsNegative ? -1 : 1;
+    }
+    if (lhsNegative)
+    {
+        const std::int64_t left = lhs.get<std::int64_t>();
+        const std::int64_t right = rhs.get<std::int64_t>();
+        return left < right ? -1 : (left > right ? 1 : 0);
+    }
+    const std::uint64_t left = lhs.get<std::uint64_t>();
+    const std::uint64_t right = rhs.get<std::uint64_t>();
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+bool CompareNumbers(double lhs, sql::jsondb::CompareOp op, double rhs)
+{
+    using sql::jsondb::CompareOp;
+
+    switch (op)
+    {
+    case CompareOp::EQ:
+        return lhs == rhs;
+    case CompareOp::NE:
+        return lhs != rhs;
+    case CompareOp::LT:
+        return lhs < rhs;
+    case CompareOp::LE:
+        return lhs <= rhs;
+    case CompareOp::GT:
+        return lhs > rhs;
+    case CompareOp::GE:
+        return lhs >= rhs;
+    }
+    return false;
+}
+
+void CollectColumns(const sql::jsondb::PredicateNode& node, std::vector<std::string>& columns)
+{
+    if (node.kind == sql::jsondb::PredicateNode::Kind::COMPARE)
+    {
+        if (std::find(columns.begin(), columns.end(), node.column) == columns.end())
+        {
+            columns.push_back(node.column);
+        }
+        return;
+    }
+
+    for (const auto& child : node.children)
+    {
+        CollectColumns(*child, columns);
+    }
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        nlohmann::json SqlValueToJson(const SqlValue& value)
+        {
+            switch (value.kind)
+            {
+            case SqlValue::Kind::BOOLEAN:
+                return value.boolValue;
+            case SqlValue::Kind::INTEGER:
+                return value.intValue;
+            case SqlValue::Kind::FLOAT:
+                return value.floatValue;
+            case SqlValue::Kind::STRING:
+                return value.stringValue;
+            case SqlValue::Kind::NULL_VALUE:
+                break;
+            }
+            return nullptr;
+        }
+
+        bool CompareJsonValues(const nlohmann::json& left, CompareOp op, const nlohmann::json& right)
+        {
+            if (left.is_number_integer() && right.is_number_integer())
+            {
+                return CompareNumbers(CompareIntegers(left, right), op, 0);
+            }
+            if (left.is_number() && right.is_number())
+            {
+                return CompareNumbers(left.get<double>(), op, right.get<double>());
+            }
+
+            if (left.is_string() && right.is_string())
+            {
+                const int order = left.get_ref<const std::string&>().compare(right.get_ref<const std::string&>());
+                return CompareNumbers(order, op, 0);
+            }
+
+            if ((left.is_boolean() && right.is_boolean()) || (left.is_null() && right.is_null()))
+            {
+                if (op == CompareOp::EQ)
+                {
+                    return left == right;
+                }
+                if (op == CompareOp::NE)
+                {
+                    return left != right;
+                }
+            }
+
+            return false;
+        }
+
+        Predicate Predicate::compile(const std::string& whereClause)
+        {
+            if (whereClause.find_first_not_of(" \t\r\n") == std::string::npos)
+            {
+                return Predicate();
+            }
+
+            try
+            {
+                return compile(SqlAstParser().parseExpression(whereClause));
+            }
+            catch (const SqlSyntaxError& ex)
+            {
+                throw JsonDbException("Unsupported WHERE clause: " + whereClause + " (" + ex.what() + ")");
+            }
+        }
+
+        Predicate Predicate::compile(const SqlExpressionPtr& expression)
+        {
+            if (expression == nullptr)
+            {
+                return Predicate();
+            }
+            return Predicate(CompileNode(*expression));
+        }
+
+        bool Predicate::evaluate(const PredicateNode& node, const nlohmann::json& row)
+        {
+            switch (node.kind)
+            {
+            case PredicateNode::Kind::AND:
+                for (const auto& child : node.children)
+                {
+                    if (!evaluate(*child, row))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            case PredicateNode::Kind::OR:
+                for (const auto& child : node.children)
+                {
+                    if (evaluate(*child, row))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            case PredicateNode::Kind::NOT:
+                return !evaluate(*node.children.front(), row);
+            case PredicateNode::Kind::COMPARE:
+                break;
+            }
+
+            const auto it = row.find(node.column);
+            if (it == row.end())
+            {
+                throw JsonDbException("Column does not exist in WHERE clause: " + node.column);
+            }
+
+            if (it->is_number() && node.literal.is_number() && !(it->is_number_integer() && node.literal.is_number_integer()))
+            {
+                return CompareNumbers(it->get<double>(), node.op, node.numericLiteral);
+            }
+            return CompareJsonValues(*it, node.op, node.literal);
+        }
+
+        std::vector<std::string> Predicate::getReferencedColumns() const
+        {
+            std::vector<std::string> columns;
+            if (root != nullptr)
+            {
+                CollectColumns(*root, columns);
+            }
+            return columns;
+        }
+    }
+}
@@ -0,0 +1,729 @@
+#include <database/json_simd_parser.h>
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSONDB_HAS_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define JSONDB_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+using sql::jsondb::JsonKernel;
+
+constexpr std::size_t kBlockBytes = 64;
+constexpr std::size_t kBlocksPerRefill = 64;
+constexpr std::size_t kMaxDepth = 512;
+constexpr std::uint64_t kOddBits = 0xAAAAAAAAAAAAAAAAULL;
+
+struct BlockMasks
+{
+    std::uint64_t quote = 0;
+    std::uint64_t backslash = 0;
+    std::uint64_t op = 0;
+    std::uint64_t whitespace = 0;
+};
+
+using Classifier = void (*)(const char* block, BlockMasks& masks);
+
+bool IsWhitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+bool IsOperator(char ch)
+{
+    return ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',';
+}
+
+void ClassifyScalar(const char* block, BlockMasks& masks)
+{
+    masks = BlockMasks{};
+    for (std::size_t index = 0; index < kBlockBytes; ++index)
+    {
+        const std::uint64_t bit = 1ULL << index;
+        const char ch = block[index];
+        if (ch == '"')
+        {
+            masks.quote |= bit;
+        }
+        else if (ch == '\\')
+        {
+            masks.backslash |= bit;
+        }
+        else if (IsOperator(ch))
+        {
+            masks.op |= bit;
+        }
+        else if (IsWhitespace(ch))
+        {
+            masks.whitespace |= bit;
+        }
+    }
+}
+
+#ifdef JSONDB_HAS_SSE2
+std::uint64_t EqualSse2(__m128i chunk, char ch)
+{
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(ch))));
+}
+
+void ClassifySse2(const char* block, BlockMasks& masks)
+{
+    masks = BlockMasks{};
+    for (std::size_t lane = 0; lane < kBlockBytes / 16; ++lane)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + lane * 16));
+        // '[' and ']' differ from '{' and '}' only in bit 5.
+        const __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        const unsigned shift = static_cast<unsigned>(lane * 16);
+        masks.quote |= EqualSse2(chunk, '"') << shift;
+        masks.backslash |= EqualSse2(chunk, '\\') << shift;
+        masks.op |= (EqualSse2(folded, '{') | EqualSse2(folded, '}') | EqualSse2(chunk, ':') | EqualSse2(chunk, ',')) << shift;
+        masks.whitespace |=
+            (EqualSse2(chunk, ' ') | EqualSse2(chunk, '\t') | EqualSse2(chunk, '\n') | EqualSse2(chunk, '\r')) << shift;
+    }
+}
+#endif
+
+#ifdef JSONDB_HAS_AVX2
+__attribute__((target("avx2"))) std::uint64_t EqualAvx2(__m256i chunk, char ch)
+{
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(ch))));
+}
+
+__attribute__((target("avx2"))) void ClassifyAvx2(const char* block, BlockMasks& masks)
+{
+    masks = BlockMasks{};
+    for (std::size_t lane = 0; lane < kBlockBytes / 32; ++lane)
+    {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + lane * 32));
+        const __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        const unsigned shift = static_cast<unsigned>(lane * 32);
+        masks.quote |= EqualAvx2(chunk, '"') << shift;
+        masks.backslash |= EqualAvx2(chunk, '\\') << shift;
+        masks.op |= (EqualAvx2(folded, '{') | EqualAvx2(folded, '}') | EqualAvx2(chunk, ':') | EqualAvx2(chunk, ',')) << shift;
+        masks.whitespace |=
+            (EqualAvx2(chunk, ' ') | EqualAvx2(chunk, '\t') | EqualAvx2(chunk, '\n') | EqualAvx2(chunk, '\r')) << shift;
+    }
+}
+#endif
+
+Classifier ClassifierFor(JsonKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef JSONDB_HAS_AVX2
+    case JsonKernel::AVX2:
+        return ClassifyAvx2;
+#endif
+#ifdef JSONDB_HAS_SSE2
+    case JsonKernel::SSE2:
+        return ClassifySse2;
+#endif
+    default:
+        return ClassifyScalar;
+    }
+}
+
+std::uint64_t PrefixXor(std::uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+int CountTrailingZeros(std::uint64_t bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Stage one. Produces, in order, the position of every operator outside a
+// string, every opening quote and the first byte of every other scalar,
+// indexing a batch of blocks at a time so memory stays bounded on large files.
+class StructuralScanner
+{
+private:
+    const char* data;
+    std::size_t size;
+    Classifier classify;
+    std::size_t nextBlock = 0;
+    std::uint64_t nextIsEscaped = 0;
+    std::uint64_t inStringCarry = 0;
+    std::uint64_t scalarCarry = 0;
+    std::vector<std::size_t> positions;
+    std::size_t cursor = 0;
+
+    void indexBlock()
+    {
+        BlockMasks masks;
+        if (size - nextBlock >= kBlockBytes)
+        {
+            classify(data + nextBlock, masks);
+        }
+        else
+        {
+            char padded[kBlockBytes];
+            std::memset(padded, ' ', sizeof(padded));
+            std::memcpy(padded, data + nextBlock, size - nextBlock);
+            classify(padded, masks);
+        }
+
+        // A character is escaped when an odd run of backslashes precedes it:
+        // subtracting each run from the odd bits flips the parity of runs that
+        // start on odd positions, leaving exactly the escaped bytes set.
+        const std::uint64_t potentialEscape = masks.backslash & ~nextIsEscaped;
+        const std::uint64_t escapeAndTerminal = (((potentialEscape << 1) | kOddBits) - potentialEscape) ^ kOddBits;
+        const std::uint64_t escaped = escapeAndTerminal ^ (masks.backslash | nextIsEscaped);
+        nextIsEscaped = (escapeAndTerminal & masks.backslash) >> 63;
+
+        // Bits from each opening quote up to, but excluding, its closing quote.
+        const std::uint64_t quotes = masks.quote & ~escaped;
+        const std::uint64_t inString = PrefixXor(quotes) ^ inStringCarry;
+        inStringCarry = static_cast<std::uint64_t>(static_cast<std::int64_t>(inString) >> 63);
+
+        const std::uint64_t scalar = ~(masks.op | masks.whitespace | masks.quote | inString);
+        const std::uint64_t scalarStarts = scalar & ~((scalar << 1) | scalarCarry);
+        scalarCarry = scalar >> 63;
+
+        std::uint64_t structurals = (masks.op & ~inString) | (quotes & inString) | scalarStarts;
+        if (size - nextBlock < kBlockBytes)
+        {
+            structurals &= (1ULL << (size - nextBlock)) - 1;
+        }
+        while (structurals != 0)
+        {
+            positions.push_back(nextBlock + static_cast<std::size_t>(CountTrailingZeros(structurals)));
+            structurals &= structurals - 1;
+        }
+        nextBlock += kBlockBytes;
+    }
+
+public:
+    StructuralScanner(const char* text, std::size_t length, Classifier classifier) : data(text), size(length), classify(classifier)
+    {
+        positions.reserve(kBlocksPerRefill * 16);
+    }
+
+    bool next(std::size_t& position)
+    {
+        while (cursor == positions.size())
+        {
+            if (nextBlock >= size)
+            {
+                return false;
+            }
+            positions.clear();
+            cursor = 0;
+            for (std::size_t block = 0; block < kBlocksPerRefill && nextBlock < size; ++block)
+            {
+                indexBlock();
+            }
+        }
+        position = positions[cursor++];
+        return true;
+    }
+
+    // True when the last indexed block ended inside a string.
+    bool endsInString() const { return inStringCarry != 0; }
+};
+
+void AppendUtf8(std::string& out, std::uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        out += static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codepoint >> 6));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (codepoint >> 12));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (codepoint >> 18));
+        out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// Stage two. Walks the structural positions, validating the grammar the way
+// nlohmann's lexer and parser do and building the values as it goes.
+class DocumentBuilder
+{
+private:
+    std::string_view text;
+    StructuralScanner scanner;
+    std::size_t pos = 0;
+
+    bool advance() { return scanner.next(pos); }
+
+    bool endsToken(std::size_t index) const
+    {
+        return index >= text.size() || IsWhitespace(text[index]) || IsOperator(text[index]) || text[index] == '"';
+    }
+
+    bool readHex4(std::size_t index, std::uint32_t& value) const
+    {
+        if (index + 4 > text.size())
+        {
+            return false;
+        }
+        value = 0;
+        for (std::size_t offset = 0; offset < 4; ++offset)
+        {
+            const char ch = text[index + offset];
+            value <<= 4;
+            if (ch >= '0' && ch <= '9')
+            {
+                value |= static_cast<std::uint32_t>(ch - '0');
+            }
+            else if (ch >= 'a' && ch <= 'f')
+            {
+                value |= static_cast<std::uint32_t>(ch - 'a' + 10);
+            }
+            else if (ch >= 'A' && ch <= 'F')
+            {
+                value |= static_cast<std::uint32_t>(ch - 'A' + 10);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Length of the well-formed UTF-8 sequence at index, or 0.
+    std::size_t utf8Length(std::size_t index) const
+    {
+        const auto byte = [&](std::size_t offset) {
+            return index + offset < text.size() ? static_cast<unsigned char>(text[index + offset]) : 0U;
+        };
+        const auto in = [](unsigned value, unsigned low, unsigned high) { return value >= low && value <= high; };
+        const unsigned lead = byte(0);
+        if (in(lead, 0xC2, 0xDF))
+        {
+            return in(byte(1), 0x80, 0xBF) ? 2 : 0;
+        }
+        if (in(lead, 0xE0, 0xEF))
+        {
+            const unsigned low = lead == 0xE0 ? 0xA0 : 0x80;
+            const unsigned high = lead == 0xED ? 0x9F : 0xBF;
+            return in(byte(1), low, high) && in(byte(2), 0x80, 0xBF) ? 3 : 0;
+        }
+        if (in(lead, 0xF0, 0xF4))
+        {
+            const unsigned low = lead == 0xF0 ? 0x90 : 0x80;
+            const unsigned high = lead == 0xF4 ? 0x8F : 0xBF;
+            return in(byte(1), low, high) && in(byte(2), 0x80, 0xBF) && in(byte(3), 0x80, 0xBF) ? 4 : 0;
+        }
+        return 0;
+    }
+
+    bool parseString(std::string& out)
+    {
+        std::size_t index = pos + 1;
+        while (true)
+        {
+            const std::size_t runStart = index;
+            while (index < text.size())
+            {
+                const auto ch = static_cast<unsigned char>(text[index]);
+                if (ch < 0x20 || ch >= 0x80 || ch == '"' || ch == '\\')
+                {
+                    break;
+                }
+                ++index;
+            }
+            out.append(text.data() + runStart, index - runStart);
+            if (index >= text.size())
+            {
+                return false;
+            }
+
+            const auto ch = static_cast<unsigned char>(text[index]);
+            if (ch == '"')
+            {
+                return true;
+            }
+            if (ch < 0x20)
+            {
+                return false;
+            }
+            if (ch >= 0x80)
+            {
+                const std::size_t length = utf8Length(index);
+                if (length == 0)
+                {
+                    return false;
+                }
+                out.append(text.data() + index, length);
+                index += length;
+                continue;
+            }
+
+            if (index + 1 >= text.size())
+            {
+                return false;
+            }
+            const char escape = text[index + 1];
+            index += 2;
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += escape;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                std::uint32_t codepoint = 0;
+                if (!readHex4(index, codepoint) || (codepoint >= 0xDC00 && codepoint <= 0xDFFF))
+                {
+                    return false;
+                }
+                index += 4;
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+                {
+                    std::uint32_t low = 0;
+                    if (index + 2 > text.size() || text[index] != '\\' || text[index + 1] != 'u' || !readHex4(index + 2, low) ||
+                        low < 0xDC00 || low > 0xDFFF)
+                    {
+                        return false;
+                    }
+                    index += 6;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, codepoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+
+    bool parseNumber(nlohmann::json& out) const
+    {
+        const auto isDigit = [&](std::size_t index) { return index < text.size() && text[index] >= '0' && text[index] <= '9'; };
+        std::size_t index = pos;
+        const bool negative = text[index] == '-';
+        if (negative)
+        {
+            ++index;
+        }
+        if (!isDigit(index))
+        {
+            return false;
+        }
+        if (text[index] == '0')
+        {
+            ++index;
+        }
+        else
+        {
+            while (isDigit(index))
+            {
+                ++index;
+            }
+        }
+
+        bool isFloat = false;
+        if (index < text.size() && text[index] == '.')
+        {
+            ++index;
+            if (!isDigit(index))
+            {
+                return false;
+            }
+            while (isDigit(index))
+            {
+                ++index;
+            }
+            isFloat = true;
+        }
+        if (index < text.size() && (text[index] == 'e' || text[index] == 'E'))
+        {
+            ++index;
+            if (index < text.size() && (text[index] == '+' || text[index] == '-'))
+            {
+                ++index;
+            }
+            if (!isDigit(index))
+            {
+                return false;
+            }
+            while (isDigit(index))
+            {
+                ++index;
+            }
+            isFloat = true;
+        }
+        if (!endsToken(index))
+        {
+            return false;
+        }
+
+        const char* first = text.data() + pos;
+        const char* last = text.data() + index;
+        // Like nlohmann: non-negative integers are unsigned, negative ones
+        // signed, and integers out of range become doubles.
+        if (!isFloat)
+        {
+            if (negative)
+            {
+                std::int64_t value = 0;
+                const auto result = std::from_chars(first, last, value);
+                if (result.ec == std::errc() && result.ptr == last)
+                {
+                    out = value;
+                    return true;
+                }
+            }
+            else
+            {
+                std::uint64_t value = 0;
+                const auto result = std::from_chars(first, last, value);
+                if (result.ec == std::errc() && result.ptr == last)
+                {
+                    out = value;
+                    return true;
+                }
+            }
+        }
+
+        double value = 0;
+        const auto result = std::from_chars(first, last, value);
+        if (result.ec != std::errc() || result.ptr != last)
+        {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    bool parseLiteral(std::string_view literal) const
+    {
+        return text.compare(pos, literal.size(), literal) == 0 && endsToken(pos + literal.size());
+    }
+
+    bool parseValue(nlohmann::json& out, std::size_t depth)
+    {
+        switch (text[pos])
+        {
+        case '{':
+            return parseObject(out, depth + 1);
+        case '[':
+            return parseArray(out, depth + 1);
+        case '"':
+        {
+            std::string value;
+            if (!parseString(value))
+            {
+                return false;
+            }
+            out = std::move(value);
+            return true;
+        }
+        case 't':
+            out = true;
+            return parseLiteral("true");
+        case 'f':
+            out = false;
+            return parseLiteral("false");
+        case 'n':
+            out = nullptr;
+            return parseLiteral("null");
+        default:
+            return (text[pos] == '-' || (text[pos] >= '0' && text[pos] <= '9')) && parseNumber(out);
+        }
+    }
+
+    bool parseObject(nlohmann::json& out, std::size_t depth)
+    {
+        if (depth > kMaxDepth || !advance())
+        {
+            return false;
+        }
+        out = nlohmann::json::object();
+        auto& object = out.get_ref<nlohmann::json::object_t&>();
+        if (text[pos] == '}')
+        {
+            return true;
+        }
+
+        while (true)
+        {
+            std::string key;
+            if (text[pos] != '"' || !parseString(key) || !advance() || text[pos] != ':' || !advance())
+            {
+                return false;
+            }
+            nlohmann::json value;
+            if (!parseValue(value, depth))
+            {
+                return false;
+            }
+            // Rows written by dump() arrive in key order, so most inserts land at
+            // the end; a repeated key keeps its last value, as in nlohmann.
+            if (object.empty() || object.rbegin()->first < key)
+            {
+                object.emplace_hint(object.end(), std::move(key), std::move(value));
+            }
+            else
+            {
+                object[std::move(key)] = std::move(value);
+            }
+
+            if (!advance())
+            {
+                return false;
+            }
+            if (text[pos] == '}')
+            {
+                return true;
+            }
+            if (text[pos] != ',' || !advance())
+            {
+                return false;
+            }
+        }
+    }
+
+    bool parseArray(nlohmann::json& out, std::size_t depth)
+    {
+        if (depth > kMaxDepth || !advance())
+        {
+            return false;
+        }
+        out = nlohmann::json::array();
+        auto& array = out.get_ref<nlohmann::json::array_t&>();
+        if (text[pos] == ']')
+        {
+            return true;
+        }
+
+        while (true)
+        {
+            array.emplace_back();
+            if (!parseValue(array.back(), depth) || !advance())
+            {
+                return false;
+            }
+            if (text[pos] == ']')
+            {
+                return true;
+            }
+            if (text[pos] != ',' || !advance())
+            {
+                return false;
+            }
+        }
+    }
+
+public:
+    DocumentBuilder(std::string_view source, Classifier classifier)
+        : text(source), scanner(source.data(), source.size(), classifier)
+    {
+    }
+
+    std::optional<nlohmann::json> parse()
+    {
+        nlohmann::json value;
+        std::size_t trailing = 0;
+        if (!advance() || !parseValue(value, 0) || scanner.next(trailing) || scanner.endsInString())
+        {
+            return std::nullopt;
+        }
+        return value;
+    }
+};
+
+bool CpuHasAvx2()
+{
+#if defined(JSONDB_HAS_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        JsonKernel BestJsonKernel()
+        {
+            static const JsonKernel best = AvailableJsonKernels().back();
+            return best;
+        }
+
+        std::vector<JsonKernel> AvailableJsonKernels()
+        {
+            std::vector<JsonKernel> kernels = {JsonKernel::SCALAR};
+#ifdef JSONDB_HAS_SSE2
+            kernels.push_back(JsonKernel::SSE2);
+#endif
+            if (CpuHasAvx2())
+            {
+                kernels.push_back(JsonKernel::AVX2);
+            }
+            return kernels;
+        }
+
+        std::optional<nlohmann::json> FastParseJson(std::string_view text, JsonKernel kernel)
+        {
+            // nlohmann skips a leading UTF-8 byte order mark.
+            if (text.size() >= 3 && text.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            {
+                text.remove_prefix(3);
+            }
+            return DocumentBuilder(text, ClassifierFor(kernel)).parse();
+        }
+    }
+}
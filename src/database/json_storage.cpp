@@ -0,0 +1,1677 @@
+#include <database/json_storage.h>
+
+#include <database/json_columnar.h>
+#include <database/json_driver.h>
+#include <database/json_index.h>
+#include <database/json_lsm.h>
+#include <database/json_pager.h>
+#include <database/json_simd_parser.h>
+#include <database/json_writer.h>
+#include <database/json_zonemap.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+#ifdef _WIN32
+constexpr int kAppendFlags = _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY;
+constexpr int kTruncateFlags = _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY;
+constexpr int kSyncFlags = _O_WRONLY | _O_BINARY;
+#else
+constexpr int kAppendFlags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+constexpr int kTruncateFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+constexpr int kSyncFlags = O_WRONLY | O_CLOEXEC;
+#endif
+
+constexpr std::size_t kWriteBufferBytes = 4U * 1024U * 1024U;
+
+class FileOutput
+{
+private:
+    std::string path;
+    int fd = -1;
+    bool ok = true;
+
+    void closeFile()
+    {
+#ifdef _WIN32
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+
+public:
+    FileOutput(std::string filePath, int flags) : path(std::move(filePath))
+    {
+#ifdef _WIN32
+        fd = ::_open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+        fd = ::open(path.c_str(), flags, 0644);
+#endif
+        if (fd < 0)
+        {
+            throw sql::jsondb::JsonDbException("Failed to open file for writing: " + path);
+        }
+    }
+
+    ~FileOutput()
+    {
+        if (fd >= 0)
+        {
+            closeFile();
+        }
+    }
+
+    FileOutput(const FileOutput&) = delete;
+    FileOutput& operator=(const FileOutput&) = delete;
+
+    void seek(std::uint64_t offset)
+    {
+#ifdef _WIN32
+        ok = ok && ::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0;
+#else
+        ok = ok && ::lseek(fd, static_cast<off_t>(offset), SEEK_SET) >= 0;
+#endif
+    }
+
+    void write(const char* data, std::size_t size)
+    {
+        std::size_t written = 0;
+        while (ok && written < size)
+        {
+#ifdef _WIN32
+            const unsigned int chunk = static_cast<unsigned int>(std::min<std::size_t>(size - written, 1U << 30));
+            const int result = ::_write(fd, data + written, chunk);
+#else
+            const ssize_t result = ::write(fd, data + written, size - written);
+#endif
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ok = false;
+                break;
+            }
+            written += static_cast<std::size_t>(result);
+        }
+    }
+
+    void finish(bool sync)
+    {
+        if (ok && sync)
+        {
+#ifdef _WIN32
+            ok = ::_commit(fd) == 0;
+#else
+            ok = ::fsync(fd) == 0;
+#endif
+        }
+        closeFile();
+        if (!ok)
+        {
+            throw sql::jsondb::JsonDbException("Failed to write file: " + path);
+        }
+    }
+};
+
+void WriteWithFlags(const std::string& path, int flags, const std::string& data, bool sync)
+{
+    FileOutput output(path, flags);
+    output.write(data.data(), data.size());
+    output.finish(sync);
+}
+
+void SyncFile(const std::string& path)
+{
+    FileOutput(path, kSyncFlags).finish(true);
+}
+
+void ReplaceFile(const std::string& tempPath, const std::string& path, bool sync)
+{
+    std::error_code error;
+    fs::rename(tempPath, path, error);
+    if (error)
+    {
+        fs::remove(tempPath, error);
+        throw sql::jsondb::JsonDbException("Failed to replace file: " + path);
+    }
+
+    if (sync)
+    {
+        sql::jsondb::SyncDirectory(fs::path(path).parent_path().string());
+    }
+}
+
+// Writes a JSON array table. Compact rows are appended to one buffer that is
+// flushed whenever it passes flushBytes, so a full rewrite is a few large
+// writes; pretty rows keep the indented layout of the original files. With
+// offsets, it also records where each compact row starts and the last ends.
+void EmitTableRows(
+    const sql::jsondb::TableRows& rows,
+    sql::jsondb::JsonLayout layout,
+    std::string& buffer,
+    std::size_t flushBytes,
+    const std::function<void()>& flush,
+    sql::jsondb::RowOffsets* offsets = nullptr)
+{
+    if (rows.empty())
+    {
+        buffer += "[]";
+        return;
+    }
+
+    std::uint64_t flushed = 0;
+    buffer += '[';
+    for (std::size_t index = 0; index < rows.size(); ++index)
+    {
+        if (layout == sql::jsondb::JsonLayout::COMPACT)
+        {
+            buffer += index == 0 ? "\n" : ",\n";
+            if (offsets != nullptr)
+            {
+                offsets->starts.push_back(flushed + buffer.size());
+            }
+            sql::jsondb::AppendJson(buffer, rows[index]);
+            if (offsets != nullptr)
+            {
+                offsets->end = flushed + buffer.size();
+            }
+        }
+        else
+        {
+            buffer += index == 0 ? "\n  " : ",\n  ";
+            const std::string row = rows[index].dump(2);
+            for (const char ch : row)
+            {
+                buffer += ch;
+                if (ch == '\n')
+                {
+                    buffer += "  ";
+                }
+            }
+        }
+        if (buffer.size() >= flushBytes)
+        {
+            flushed += buffer.size();
+            flush();
+        }
+    }
+    buffer += "\n]";
+}
+
+void DropTornTail(const std::string& path)
+{
+    std::error_code error;
+    const std::uintmax_t size = fs::file_size(path, error);
+    if (error || size == 0)
+    {
+        return;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::uintmax_t end = size;
+    char buffer[4096];
+    while (end > 0)
+    {
+        const std::uintmax_t chunk = std::min<std::uintmax_t>(sizeof(buffer), end);
+        file.seekg(static_cast<std::streamoff>(end - chunk));
+        file.read(buffer, static_cast<std::streamsize>(chunk));
+        for (std::uintmax_t index = chunk; index > 0; --index)
+        {
+            if (buffer[index - 1] == '\n')
+            {
+                const std::uintmax_t keep = end - chunk + index;
+                if (keep != size)
+                {
+                    file.close();
+                    fs::resize_file(path, keep);
+                }
+                return;
+            }
+        }
+        end -= chunk;
+    }
+
+    file.close();
+    fs::resize_file(path, 0);
+}
+
+constexpr char kRowOffsetsMagic[8] = {'J', 'D', 'B', 'O', 'F', 'F', '0', '1'};
+constexpr std::size_t kRowOffsetsHeaderSize = sizeof(kRowOffsetsMagic) + 4 * sizeof(std::uint64_t);
+
+constexpr char kKeyMapMagic[8] = {'J', 'D', 'B', 'K', 'E', 'Y', 'S', '1'};
+// The stamp, the row count and the length of the key columns that follow.
+constexpr std::size_t kKeyMapHeaderSize = sizeof(kKeyMapMagic) + 5 * sizeof(std::uint64_t);
+
+constexpr char kTombstonesMagic[8] = {'J', 'D', 'B', 'T', 'O', 'M', 'B', '1'};
+constexpr std::size_t kTombstonesHeaderSize = sizeof(kTombstonesMagic) + 2 * sizeof(std::uint64_t);
+constexpr char kPatchJournalMagic[8] = {'J', 'D', 'B', 'P', 'T', 'C', 'H', '1'};
+constexpr std::size_t kPatchJournalHeaderSize = sizeof(kPatchJournalMagic) + 2 * sizeof(std::uint64_t);
+
+void PutU64(std::string& out, std::uint64_t value)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+std::uint64_t GetU64(const char* in)
+{
+    std::uint64_t value = 0;
+    for (int index = 7; index >= 0; --index)
+    {
+        value = (value << 8) | static_cast<unsigned char>(in[index]);
+    }
+    return value;
+}
+
+std::string EncodeRowOffsetsHeader(const sql::jsondb::FileStamp& stamp, std::uint64_t end)
+{
+    std::string header(kRowOffsetsMagic, sizeof(kRowOffsetsMagic));
+    PutU64(header, static_cast<std::uint64_t>(stamp.mtimeNs));
+    PutU64(header, stamp.size);
+    PutU64(header, stamp.inode);
+    PutU64(header, end);
+    return header;
+}
+
+bool DecodeRowOffsetsHeader(const char* header, sql::jsondb::FileStamp& stamp, std::uint64_t& end)
+{
+    if (!std::equal(kRowOffsetsMagic, kRowOffsetsMagic + sizeof(kRowOffsetsMagic), header))
+    {
+        return false;
+    }
+    const char* fields = header + sizeof(kRowOffsetsMagic);
+    stamp.mtimeNs = static_cast<std::int64_t>(GetU64(fields));
+    stamp.size = GetU64(fields + 8);
+    stamp.inode = GetU64(fields + 16);
+    end = GetU64(fields + 24);
+    return true;
+}
+
+std::string EncodeKeyMapHeader(const sql::jsondb::KeyMap& keyMap, std::uint64_t columnsLength)
+{
+    std::string header(kKeyMapMagic, sizeof(kKeyMapMagic));
+    PutU64(header, static_cast<std::uint64_t>(keyMap.stamp.mtimeNs));
+    PutU64(header, keyMap.stamp.size);
+    PutU64(header, keyMap.stamp.inode);
+    PutU64(header, keyMap.rows);
+    PutU64(header, columnsLength);
+    return header;
+}
+
+bool DecodeKeyMapHeader(const char* header, sql::jsondb::KeyMap& keyMap, std::uint64_t& columnsLength)
+{
+    if (!std::equal(kKeyMapMagic, kKeyMapMagic + sizeof(kKeyMapMagic), header))
+    {
+        return false;
+    }
+    const char* fields = header + sizeof(kKeyMapMagic);
+    keyMap.stamp.mtimeNs = static_cast<std::int64_t>(GetU64(fields));
+    keyMap.stamp.size = GetU64(fields + 8);
+    keyMap.stamp.inode = GetU64(fields + 16);
+    keyMap.rows = GetU64(fields + 24);
+    columnsLength = GetU64(fields + 32);
+    return true;
+}
+
+void PutKeyEntry(std::string& out, const std::string& key, std::uint64_t position)
+{
+    PutU64(out, position);
+    PutU64(out, key.size());
+    out += key;
+}
+
+// Extends the key map sidecar, and keyMap, with rows appended to a file that
+// had stamp before and now has after; either one describing another version
+// of the file is left alone.
+void ExtendKeyMap(
+    const std::string& path,
+    const sql::jsondb::FileStamp& before,
+    const sql::jsondb::FileStamp& after,
+    const sql::jsondb::TableRows& rows,
+    sql::jsondb::KeyMap* keyMap,
+    bool sync)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    char header[kKeyMapHeaderSize];
+    sql::jsondb::KeyMap recorded;
+    std::uint64_t columnsLength = 0;
+    std::string columnsText;
+    bool current = file.read(header, sizeof(header)) && DecodeKeyMapHeader(header, recorded, columnsLength) && recorded.stamp == before;
+    if (current)
+    {
+        columnsText.resize(columnsLength);
+        current = static_cast<bool>(file.read(columnsText.data(), static_cast<std::streamsize>(columnsText.size())));
+    }
+    const nlohmann::json columns = current ? nlohmann::json::parse(columnsText, nullptr, false) : nlohmann::json();
+    current = current && columns.is_array() && !columns.empty();
+    const bool extendMap = keyMap != nullptr && keyMap->stamp == before;
+    if (!current && !extendMap)
+    {
+        return;
+    }
+
+    const sql::jsondb::PrimaryKeyIndex index(extendMap ? keyMap->columns : columns.get<std::vector<std::string>>(), {});
+    const std::uint64_t base = extendMap ? keyMap->rows : recorded.rows;
+    std::string tail;
+    for (std::size_t row = 0; row < rows.size(); ++row)
+    {
+        if (const std::optional<std::string> key = index.keyOf(rows[row]))
+        {
+            PutKeyEntry(tail, *key, base + row);
+            if (extendMap)
+            {
+                keyMap->positions.emplace(*key, base + row);
+            }
+        }
+    }
+    if (extendMap)
+    {
+        keyMap->stamp = after;
+        keyMap->rows += rows.size();
+    }
+    if (!current || recorded.rows != base)
+    {
+        return;
+    }
+
+    file.seekp(0, std::ios::end);
+    file.write(tail.data(), static_cast<std::streamsize>(tail.size()));
+    recorded.stamp = after;
+    recorded.rows += rows.size();
+    const std::string updated = EncodeKeyMapHeader(recorded, columnsLength);
+    file.seekp(0);
+    file.write(updated.data(), static_cast<std::streamsize>(updated.size()));
+    file.close();
+    if (sync && file)
+    {
+        SyncFile(path);
+    }
+}
+
+// Finds the start of every non-empty line; an unterminated last line is a torn
+// append and is not counted.
+sql::jsondb::RowOffsets ScanRowOffsets(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw sql::jsondb::JsonDbException("Failed to open table file: " + path);
+    }
+
+    sql::jsondb::RowOffsets offsets;
+    std::uint64_t position = 0;
+    std::uint64_t lineStart = 0;
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+    {
+        const std::size_t count = static_cast<std::size_t>(file.gcount());
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            if (buffer[index] == '\n')
+            {
+                const std::uint64_t lineEnd = position + index;
+                if (lineEnd > lineStart)
+                {
+                    offsets.starts.push_back(lineStart);
+                }
+                lineStart = lineEnd + 1;
+            }
+        }
+        position += count;
+    }
+    offsets.end = lineStart;
+    return offsets;
+}
+
+constexpr std::uintmax_t kParallelParseMinBytes = 1U << 20;
+// Whole-table reads pass through each page once, so a few frames suffice.
+constexpr std::size_t kPagedReadPages = 8;
+
+bool IsJsonSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+// Byte range of each top-level element of a JSON array, split at the commas
+// outside strings and nested values. Returns nothing when the text is not one
+// array; the elements themselves are validated when they are parsed.
+std::optional<std::vector<std::pair<std::size_t, std::size_t>>> FindArrayElements(const std::string& text)
+{
+    const std::size_t size = text.size();
+    std::size_t pos = 0;
+    while (pos < size && IsJsonSpace(text[pos]))
+    {
+        ++pos;
+    }
+    if (pos == size || text[pos] != '[')
+    {
+        return std::nullopt;
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> elements;
+    std::size_t start = std::string::npos;
+    std::size_t depth = 0;
+    for (++pos; pos < size; ++pos)
+    {
+        const char ch = text[pos];
+        if (IsJsonSpace(ch))
+        {
+            continue;
+        }
+        if (start == std::string::npos && ch != ',' && ch != ']')
+        {
+            start = pos;
+        }
+
+        switch (ch)
+        {
+        case '"':
+            // A quote ends the string unless an odd run of backslashes precedes it.
+            while (true)
+            {
+                const char* quote = static_cast<const char*>(std::memchr(text.data() + pos + 1, '"', size - pos - 1));
+                if (quote == nullptr)
+                {
+                    return std::nullopt;
+                }
+                pos = static_cast<std::size_t>(quote - text.data());
+                std::size_t backslashes = 0;
+                while (text[pos - 1 - backslashes] == '\\')
+                {
+                    ++backslashes;
+                }
+                if (backslashes % 2 == 0)
+                {
+                    break;
+                }
+            }
+            break;
+        case '[':
+        case '{':
+            ++depth;
+            break;
+        case ']':
+        case '}':
+            if (depth > 0)
+            {
+                --depth;
+                break;
+            }
+            if (ch != ']' || (start == std::string::npos && !elements.empty()))
+            {
+                return std::nullopt;
+            }
+            if (start != std::string::npos)
+            {
+                elements.emplace_back(start, pos);
+            }
+            while (++pos < size)
+            {
+                if (!IsJsonSpace(text[pos]))
+                {
+                    return std::nullopt;
+                }
+            }
+            return elements;
+        case ',':
+            if (depth == 0)
+            {
+                if (start == std::string::npos)
+                {
+                    return std::nullopt;
+                }
+                elements.emplace_back(start, pos);
+                start = std::string::npos;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string ReadFileText(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw sql::jsondb::JsonDbException("Failed to open table file: " + path);
+    }
+
+    std::error_code error;
+    std::string text(static_cast<std::size_t>(fs::file_size(path, error)), '\0');
+    file.read(text.data(), static_cast<std::streamsize>(text.size()));
+    text.resize(static_cast<std::size_t>(file.gcount()));
+    return text;
+}
+
+// The fast parser declines anything nlohmann would reject, so nlohmann only
+// runs to report the error, or for the few inputs the fast path leaves to it.
+nlohmann::json ParseJsonText(std::string_view text)
+{
+    std::optional<nlohmann::json> value = sql::jsondb::FastParseJson(text);
+    return value.has_value() ? std::move(*value) : nlohmann::json::parse(text.begin(), text.end());
+}
+
+// Whole table files fall back to stream extraction, which has always ignored
+// anything after the first value.
+nlohmann::json ParseTableText(const std::string& text)
+{
+    if (std::optional<nlohmann::json> value = sql::jsondb::FastParseJson(text))
+    {
+        return std::move(*value);
+    }
+    std::istringstream stream(text);
+    nlohmann::json value;
+    stream >> value;
+    return value;
+}
+
+sql::jsondb::TableRows JoinParts(std::vector<sql::jsondb::TableRows>& parts)
+{
+    std::size_t total = 0;
+    for (const auto& part : parts)
+    {
+        total += part.size();
+    }
+    sql::jsondb::TableRows rows;
+    rows.reserve(total);
+    for (auto& part : parts)
+    {
+        rows.insert(rows.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }
+    return rows;
+}
+
+// Builds each row on its own and hands it to the visitor, so only one row is
+// materialized at a time. Rows are either the elements of one top-level array
+// or, for line-delimited input, the top-level value itself. When columns are
+// given, other top-level fields are skipped as they are tokenized and never
+// allocated.
+class RowSaxHandler : public nlohmann::json_sax<nlohmann::json>
+{
+private:
+    const std::string& path;
+    const sql::jsondb::RowVisitor& visit;
+    const std::vector<std::string>& columns;
+    bool expectArray = true;
+    bool inArray = false;
+    bool stopped = false;
+    bool skipValue = false;
+    std::size_t skipDepth = 0;
+    nlohmann::json row;
+    std::vector<nlohmann::json*> stack;
+    nlohmann::json* pendingValue = nullptr;
+
+    nlohmann::json* place(nlohmann::json value)
+    {
+        if (stack.empty())
+        {
+            if (expectArray && !inArray)
+            {
+                throw sql::jsondb::JsonDbException("Table data must be a JSON array: " + path);
+            }
+            row = std::move(value);
+            return &row;
+        }
+        nlohmann::json& parent = *stack.back();
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+        *pendingValue = std::move(value);
+        return pendingValue;
+    }
+
+    bool emit()
+    {
+        stopped = !visit(row);
+        return !stopped;
+    }
+
+    bool skipping()
+    {
+        if (skipDepth > 0)
+        {
+            return true;
+        }
+        if (skipValue)
+        {
+            skipValue = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool scalar(nlohmann::json value)
+    {
+        place(std::move(value));
+        return stack.empty() ? emit() : true;
+    }
+
+    bool startContainer(nlohmann::json value)
+    {
+        if (skipDepth > 0 || skipValue)
+        {
+            skipValue = false;
+            ++skipDepth;
+            return true;
+        }
+        stack.push_back(place(std::move(value)));
+        return true;
+    }
+
+    bool endContainer()
+    {
+        if (skipDepth > 0)
+        {
+            --skipDepth;
+            return true;
+        }
+        if (stack.empty())
+        {
+            return true;
+        }
+        stack.pop_back();
+        return stack.empty() ? emit() : true;
+    }
+
+public:
+    RowSaxHandler(
+        const std::string& filePath,
+        const sql::jsondb::RowVisitor& visitor,
+        const std::vector<std::string>& wantedColumns,
+        bool rowsInArray)
+        : path(filePath), visit(visitor), columns(wantedColumns), expectArray(rowsInArray)
+    {
+    }
+
+    bool wasStopped() const { return stopped; }
+
+    bool null() override { return skipping() || scalar(nullptr); }
+    bool boolean(bool value) override { return skipping() || scalar(value); }
+    bool number_integer(number_integer_t value) override { return skipping() || scalar(value); }
+    bool number_unsigned(number_unsigned_t value) override { return skipping() || scalar(value); }
+    bool number_float(number_float_t value, const string_t&) override { return skipping() || scalar(value); }
+    bool string(string_t& value) override { return skipping() || scalar(std::move(value)); }
+    bool binary(binary_t& value) override { return skipping() || scalar(nlohmann::json::binary(std::move(value))); }
+
+    bool start_object(std::size_t) override { return startContainer(nlohmann::json::object()); }
+    bool key(string_t& name) override
+    {
+        if (skipDepth > 0)
+        {
+            return true;
+        }
+        if (stack.size() == 1 && !columns.empty() && std::find(columns.begin(), columns.end(), name) == columns.end())
+        {
+            skipValue = true;
+            return true;
+        }
+        pendingValue = &(*stack.back())[name];
+        return true;
+    }
+    bool end_object() override { return endContainer(); }
+
+    bool start_array(std::size_t) override
+    {
+        if (expectArray && !inArray && stack.empty())
+        {
+            inArray = true;
+            return true;
+        }
+        return startContainer(nlohmann::json::array());
+    }
+    bool end_array() override { return endContainer(); }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::json::exception& error) override
+    {
+        throw sql::jsondb::JsonDbException("Failed to parse table file: " + path + ": " + error.what());
+    }
+};
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::string TableFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".json")).string();
+        }
+
+        std::string DeltaFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".delta.ndjson")).string();
+        }
+
+        std::string SchemaFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".schema.json")).string();
+        }
+
+        std::string RowOffsetsFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".offsets")).string();
+        }
+
+        std::string KeyMapFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".keys")).string();
+        }
+
+        std::string TombstoneFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".tombstones")).string();
+        }
+
+        std::string ZoneMapFilePath(const std::string& dbPath, const std::string& tableName)
+        {
+            return (fs::path(dbPath) / (tableName + ".zones")).string();
+        }
+
+        std::string PatchJournalFilePath(const std::string& tablePath)
+        {
+            return fs::path(tablePath).replace_extension(".patch").string();
+        }
+
+        TableSchema ReadTableSchema(const std::string& path)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+            {
+                throw JsonDbException("Failed to open schema file: " + path);
+            }
+
+            nlohmann::json document;
+            file >> document;
+            TableSchema schema;
+            if (document.is_array())
+            {
+                schema.columns = document.get<std::vector<std::string>>();
+                return schema;
+            }
+            schema.columns = document.at("columns").get<std::vector<std::string>>();
+            schema.primaryKey = document.value("primaryKey", std::vector<std::string>{});
+            schema.bloomColumns = document.value("bloomColumns", std::vector<std::string>{});
+            schema.bloomFalsePositiveRate = document.value("bloomFalsePositiveRate", schema.bloomFalsePositiveRate);
+            return schema;
+        }
+
+        void WriteTableSchema(const std::string& path, const TableSchema& schema, bool sync)
+        {
+            nlohmann::json document = {{"columns", schema.columns}, {"primaryKey", schema.primaryKey}};
+            if (!schema.bloomColumns.empty())
+            {
+                document["bloomColumns"] = schema.bloomColumns;
+                document["bloomFalsePositiveRate"] = schema.bloomFalsePositiveRate;
+            }
+            WriteFileAtomically(path, document.dump(2), sync);
+        }
+
+        TableFormat DetectTableFormat(const std::string& path)
+        {
+            if (IsColumnarFile(path))
+            {
+                return TableFormat::COLUMNAR;
+            }
+            if (IsLsmManifest(path))
+            {
+                return TableFormat::LSM;
+            }
+            if (IsPagedFile(path))
+            {
+                return TableFormat::PAGED;
+            }
+
+            std::ifstream file(path, std::ios::binary);
+            char ch = 0;
+            while (file.get(ch))
+            {
+                if (ch == '[')
+                {
+                    return TableFormat::JSON;
+                }
+                if (ch != ' ' && ch != '\t' && ch != '\r' && ch != '\n')
+                {
+                    return TableFormat::NDJSON;
+                }
+            }
+            // An empty file is an NDJSON table with no rows; a missing one reads
+            // as JSON so the open error names the table file.
+            return file.is_open() ? TableFormat::NDJSON : TableFormat::JSON;
+        }
+
+        TableRows ReadTableFile(const std::string& path, ThreadPool* pool)
+        {
+            std::error_code error;
+            const std::uintmax_t size = fs::file_size(path, error);
+            if (error || size < kParallelParseMinBytes || (pool != nullptr && pool->size() < 2))
+            {
+                pool = nullptr;
+            }
+
+            switch (DetectTableFormat(path))
+            {
+            case TableFormat::COLUMNAR:
+                return ColumnarTable(path).readRows();
+            case TableFormat::LSM:
+                return *LsmTree::open(path)->snapshot();
+            case TableFormat::PAGED:
+            {
+                BufferPool pool(kPagedReadPages);
+                return PagedTable(path, pool).readRows();
+            }
+            case TableFormat::NDJSON:
+            {
+                TableRows rows;
+                if (pool == nullptr)
+                {
+                    ReadJsonLines(path, 0, rows);
+                    return rows;
+                }
+
+                // The row offsets sidecar gives exact line boundaries to split on.
+                const fs::path tablePath(path);
+                const RowOffsets offsets = LoadRowOffsets(tablePath.parent_path().string(), tablePath.stem().string());
+                const std::size_t chunks = std::min(pool->size() * 4, std::max<std::size_t>(offsets.starts.size(), 1));
+                std::vector<TableRows> parts(chunks);
+                pool->run(chunks, [&](std::size_t chunk) {
+                    const std::size_t first = offsets.starts.size() * chunk / chunks;
+                    const std::size_t last = offsets.starts.size() * (chunk + 1) / chunks;
+                    if (first == last)
+                    {
+                        return;
+                    }
+                    const std::uint64_t end = last < offsets.starts.size() ? offsets.starts[last] : offsets.end;
+                    TableRows& part = parts[chunk];
+                    part.reserve(last - first);
+                    const auto collect = [&part](nlohmann::json& row) {
+                        part.push_back(std::move(row));
+                        return true;
+                    };
+                    StreamJsonLines(path, offsets.starts[first], collect, {}, end);
+                });
+                return JoinParts(parts);
+            }
+            case TableFormat::JSON:
+                break;
+            }
+            return pool != nullptr ? ReadJsonArrayFileParallel(path, *pool) : ReadJsonArrayFile(path);
+        }
+
+        std::string SerializeTable(const TableRows& rows, TableFormat format, JsonLayout layout)
+        {
+            switch (format)
+            {
+            case TableFormat::COLUMNAR:
+                return SerializeColumnarTable(rows);
+            case TableFormat::PAGED:
+                return SerializePagedTable(rows);
+            case TableFormat::NDJSON:
+            case TableFormat::LSM:
+                return SerializeJsonLines(rows);
+            case TableFormat::JSON:
+                break;
+            }
+            return SerializeTableRows(rows, layout);
+        }
+
+        void WriteTableFile(
+            const std::string& dbPath,
+            const std::string& tableName,
+            const TableRows& rows,
+            TableFormat format,
+            SyncMode syncMode,
+            JsonLayout layout)
+        {
+            const bool sync = syncMode != SyncMode::NONE;
+            const std::string tablePath = TableFilePath(dbPath, tableName);
+            const std::string offsetsPath = RowOffsetsFilePath(dbPath, tableName);
+            const std::string zonesPath = ZoneMapFilePath(dbPath, tableName);
+            const std::string keysPath = KeyMapFilePath(dbPath, tableName);
+            std::error_code error;
+            // The new file may reuse the inode the old zones name.
+            fs::remove(zonesPath, error);
+            // Rows of a table without a schema are keyed by insertion order and
+            // get no Bloom filters.
+            const std::string schemaPath = SchemaFilePath(dbPath, tableName);
+            const TableSchema schema = StatFile(schemaPath).has_value() ? ReadTableSchema(schemaPath) : TableSchema{};
+            if (format == TableFormat::LSM)
+            {
+                LsmTree::open(tablePath)->reset(rows, schema.primaryKey, sync);
+                fs::remove(TombstoneFilePath(dbPath, tableName), error);
+                fs::remove(PatchJournalFilePath(tablePath), error);
+                fs::remove(offsetsPath, error);
+                fs::remove(keysPath, error);
+                return;
+            }
+
+            // The old runs go once the new file has replaced the manifest.
+            const bool wasLsm = IsLsmManifest(tablePath);
+            RowOffsets offsets;
+            if (format == TableFormat::JSON)
+            {
+                const std::string tempPath = tablePath + ".tmp";
+                {
+                    FileOutput output(tempPath, kTruncateFlags);
+                    std::string buffer;
+                    buffer.reserve(kWriteBufferBytes + kWriteBufferBytes / 4);
+                    const auto flush = [&]() {
+                        output.write(buffer.data(), buffer.size());
+                        buffer.clear();
+                    };
+                    EmitTableRows(rows, layout, buffer, kWriteBufferBytes, flush, layout == JsonLayout::COMPACT ? &offsets : nullptr);
+                    flush();
+                    output.finish(sync);
+                }
+                ReplaceFile(tempPath, tablePath, sync);
+            }
+            if (format != TableFormat::NDJSON)
+            {
+                if (format == TableFormat::COLUMNAR || format == TableFormat::PAGED)
+                {
+                    WriteFileAtomically(tablePath, SerializeTable(rows, format), sync);
+                }
+                if (wasLsm)
+                {
+                    LsmTree::retire(tablePath);
+                }
+                fs::remove(TombstoneFilePath(dbPath, tableName), error);
+                fs::remove(PatchJournalFilePath(tablePath), error);
+                fs::remove(offsetsPath, error);
+                fs::remove(keysPath, error);
+                const std::optional<FileStamp> stamp =
+                    format == TableFormat::JSON && layout == JsonLayout::COMPACT ? StatFile(tablePath) : std::nullopt;
+                if (stamp.has_value())
+                {
+                    offsets.stamp = *stamp;
+                    WriteZoneMap(zonesPath, BuildZoneMap(rows, offsets, schema), syncMode == SyncMode::ALWAYS);
+                }
+                return;
+            }
+
+            const std::string data = SerializeJsonLines(rows, 0, &offsets.starts);
+            WriteFileAtomically(tablePath, data, sync);
+            if (wasLsm)
+            {
+                LsmTree::retire(tablePath);
+            }
+            fs::remove(TombstoneFilePath(dbPath, tableName), error);
+            fs::remove(PatchJournalFilePath(tablePath), error);
+            if (const std::optional<FileStamp> stamp = StatFile(tablePath))
+            {
+                offsets.stamp = *stamp;
+                offsets.end = data.size();
+                WriteRowOffsets(offsetsPath, offsets, syncMode == SyncMode::ALWAYS);
+                WriteZoneMap(zonesPath, BuildZoneMap(rows, offsets, schema), syncMode == SyncMode::ALWAYS);
+                if (!schema.primaryKey.empty())
+                {
+                    WriteKeyMap(keysPath, BuildKeyMap(rows, schema.primaryKey, *stamp), syncMode == SyncMode::ALWAYS);
+                }
+            }
+            if (schema.primaryKey.empty())
+            {
+                fs::remove(keysPath, error);
+            }
+        }
+
+        bool Tombstones::isDead(std::uint64_t row) const
+        {
+            const std::uint64_t word = row / 64;
+            return word < bits.size() && (bits[word] >> (row % 64) & 1) != 0;
+        }
+
+        void Tombstones::markLiveRows(const std::vector<std::size_t>& positions)
+        {
+            std::uint64_t liveBefore = 0;
+            std::size_t next = 0;
+            for (std::size_t word = 0; next < positions.size(); ++word)
+            {
+                if (word == bits.size())
+                {
+                    bits.push_back(0);
+                }
+                const std::uint64_t live = ~bits[word];
+                const auto liveCount = static_cast<std::uint64_t>(std::popcount(live));
+                while (next < positions.size() && positions[next] < liveBefore + liveCount)
+                {
+                    std::uint64_t remaining = live;
+                    for (std::uint64_t skip = positions[next] - liveBefore; skip > 0; --skip)
+                    {
+                        remaining &= remaining - 1;
+                    }
+                    bits[word] |= remaining & (~remaining + 1);
+                    ++deadRows;
+                    ++next;
+                }
+                liveBefore += liveCount;
+            }
+        }
+
+        void Tombstones::removeDeadRows(TableRows& rows) const
+        {
+            if (deadRows == 0)
+            {
+                return;
+            }
+            std::size_t kept = 0;
+            for (std::size_t row = 0; row < rows.size(); ++row)
+            {
+                if (isDead(row))
+                {
+                    continue;
+                }
+                if (kept != row)
+                {
+                    rows[kept] = std::move(rows[row]);
+                }
+                ++kept;
+            }
+            rows.erase(rows.begin() + static_cast<std::ptrdiff_t>(kept), rows.end());
+        }
+
+        Tombstones LoadTombstones(const std::string& dbPath, const std::string& tableName)
+        {
+            const std::string path = TombstoneFilePath(dbPath, tableName);
+            const std::optional<FileStamp> tableStamp = StatFile(TableFilePath(dbPath, tableName));
+            if (!tableStamp.has_value() || !StatFile(path).has_value())
+            {
+                return {};
+            }
+
+            const std::string data = ReadFileText(path);
+            if (data.size() < kTombstonesHeaderSize || (data.size() - kTombstonesHeaderSize) % 8 != 0 ||
+                !std::equal(kTombstonesMagic, kTombstonesMagic + sizeof(kTombstonesMagic), data.data()) ||
+                GetU64(data.data() + sizeof(kTombstonesMagic)) != tableStamp->inode)
+            {
+                return {};
+            }
+
+            Tombstones tombstones;
+            tombstones.inode = tableStamp->inode;
+            tombstones.deadRows = GetU64(data.data() + sizeof(kTombstonesMagic) + 8);
+            for (std::size_t offset = kTombstonesHeaderSize; offset < data.size(); offset += 8)
+            {
+                tombstones.bits.push_back(GetU64(data.data() + offset));
+            }
+            return tombstones;
+        }
+
+        void WriteTombstones(const std::string& dbPath, const std::string& tableName, const Tombstones& tombstones, bool sync)
+        {
+            std::string data(kTombstonesMagic, sizeof(kTombstonesMagic));
+            data.reserve(kTombstonesHeaderSize + tombstones.bits.size() * 8);
+            PutU64(data, tombstones.inode);
+            PutU64(data, tombstones.deadRows);
+            for (const std::uint64_t word : tombstones.bits)
+            {
+                PutU64(data, word);
+            }
+            WriteFileAtomically(TombstoneFilePath(dbPath, tableName), data, sync);
+        }
+
+        std::vector<FilePatch> LoadPatchJournal(const std::string& tablePath)
+        {
+            const std::string path = PatchJournalFilePath(tablePath);
+            const std::optional<FileStamp> tableStamp = StatFile(tablePath);
+            if (!tableStamp.has_value() || !StatFile(path).has_value())
+            {
+                return {};
+            }
+
+            const std::string data = ReadFileText(path);
+            if (data.size() < kPatchJournalHeaderSize ||
+                !std::equal(kPatchJournalMagic, kPatchJournalMagic + sizeof(kPatchJournalMagic), data.data()) ||
+                GetU64(data.data() + sizeof(kPatchJournalMagic)) != tableStamp->inode)
+            {
+                return {};
+            }
+
+            std::vector<FilePatch> patches(GetU64(data.data() + sizeof(kPatchJournalMagic) + 8));
+            std::size_t offset = kPatchJournalHeaderSize;
+            for (auto& patch : patches)
+            {
+                if (data.size() - offset < 16 || data.size() - offset - 16 < GetU64(data.data() + offset + 8))
+                {
+                    throw JsonDbException("Invalid patch journal: " + path);
+                }
+                patch.offset = GetU64(data.data() + offset);
+                patch.bytes.assign(data.data() + offset + 16, GetU64(data.data() + offset + 8));
+                offset += 16 + patch.bytes.size();
+            }
+            return patches;
+        }
+
+        void PatchFileInPlace(const std::string& tablePath, std::uint64_t inode, std::vector<FilePatch> patches, bool sync)
+        {
+            // Writing a journal replaces any earlier one, so fold its patches in
+            // first; later patches to the same bytes win.
+            std::vector<FilePatch> pending = LoadPatchJournal(tablePath);
+            pending.insert(pending.end(), std::make_move_iterator(patches.begin()), std::make_move_iterator(patches.end()));
+
+            std::string journal(kPatchJournalMagic, sizeof(kPatchJournalMagic));
+            PutU64(journal, inode);
+            PutU64(journal, pending.size());
+            for (const auto& patch : pending)
+            {
+                PutU64(journal, patch.offset);
+                PutU64(journal, patch.bytes.size());
+                journal += patch.bytes;
+            }
+            const std::string journalPath = PatchJournalFilePath(tablePath);
+            WriteFileAtomically(journalPath, journal, sync);
+
+            FileOutput output(tablePath, kSyncFlags);
+            for (const auto& patch : pending)
+            {
+                output.seek(patch.offset);
+                output.write(patch.bytes.data(), patch.bytes.size());
+            }
+            output.finish(sync);
+            fs::remove(journalPath);
+        }
+
+        RowOffsets LoadRowOffsets(const std::string& dbPath, const std::string& tableName)
+        {
+            const std::string tablePath = TableFilePath(dbPath, tableName);
+            const std::string offsetsPath = RowOffsetsFilePath(dbPath, tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            if (!stamp.has_value())
+            {
+                throw JsonDbException("Failed to open table file: " + tablePath);
+            }
+
+            std::ifstream file(offsetsPath, std::ios::binary);
+            char header[kRowOffsetsHeaderSize];
+            RowOffsets offsets;
+            if (file.read(header, sizeof(header)) && DecodeRowOffsetsHeader(header, offsets.stamp, offsets.end) &&
+                offsets.stamp == *stamp)
+            {
+                const std::string body((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                offsets.starts.reserve(body.size() / 8);
+                bool ordered = body.size() % 8 == 0;
+                for (std::size_t index = 0; ordered && index < body.size(); index += 8)
+                {
+                    const std::uint64_t start = GetU64(body.data() + index);
+                    // Entries left behind by an interrupted append break the order.
+                    ordered = start < offsets.end && (offsets.starts.empty() || start > offsets.starts.back());
+                    offsets.starts.push_back(start);
+                }
+                if (ordered)
+                {
+                    return offsets;
+                }
+            }
+            file.close();
+
+            offsets = ScanRowOffsets(tablePath);
+            offsets.stamp = *stamp;
+            // The sidecar is only a cache, so a table that changed during the scan
+            // or a directory that cannot be written still answers the read.
+            if (StatFile(tablePath) == stamp)
+            {
+                try
+                {
+                    WriteRowOffsets(offsetsPath, offsets);
+                }
+                catch (const JsonDbException&)
+                {
+                }
+            }
+            return offsets;
+        }
+
+        std::pair<std::uint64_t, std::uint64_t> FindRowRange(
+            const std::string& dbPath,
+            const std::string& tableName,
+            std::uint64_t first,
+            std::uint64_t count)
+        {
+            const std::optional<FileStamp> stamp = StatFile(TableFilePath(dbPath, tableName));
+            std::ifstream file(RowOffsetsFilePath(dbPath, tableName), std::ios::binary);
+            char header[kRowOffsetsHeaderSize];
+            FileStamp recorded;
+            std::uint64_t end = 0;
+            if (stamp.has_value() && file.read(header, sizeof(header)) && DecodeRowOffsetsHeader(header, recorded, end) &&
+                recorded == *stamp)
+            {
+                file.seekg(0, std::ios::end);
+                const std::uint64_t rowCount = (static_cast<std::uint64_t>(file.tellg()) - kRowOffsetsHeaderSize) / 8;
+                const auto startOf = [&](std::uint64_t row) {
+                    if (row >= rowCount)
+                    {
+                        return end;
+                    }
+                    char entry[8];
+                    file.seekg(static_cast<std::streamoff>(kRowOffsetsHeaderSize + row * 8));
+                    file.read(entry, sizeof(entry));
+                    return file ? std::min(GetU64(entry), end) : end;
+                };
+                const std::uint64_t begin = startOf(first);
+                return {begin, count > rowCount ? end : std::max(begin, startOf(first + count))};
+            }
+
+            const RowOffsets offsets = LoadRowOffsets(dbPath, tableName);
+            const auto startOf = [&](std::uint64_t row) {
+                return row < offsets.starts.size() ? offsets.starts[static_cast<std::size_t>(row)] : offsets.end;
+            };
+            return {startOf(first), count > offsets.starts.size() ? offsets.end : startOf(first + count)};
+        }
+
+        void WriteRowOffsets(const std::string& path, const RowOffsets& offsets, bool sync)
+        {
+            std::string data = EncodeRowOffsetsHeader(offsets.stamp, offsets.end);
+            data.reserve(data.size() + offsets.starts.size() * 8);
+            for (const std::uint64_t start : offsets.starts)
+            {
+                PutU64(data, start);
+            }
+            WriteFileAtomically(path, data, sync);
+        }
+
+        KeyMap BuildKeyMap(const TableRows& rows, const std::vector<std::string>& columns, const FileStamp& stamp)
+        {
+            const PrimaryKeyIndex index(columns, {});
+            KeyMap keyMap;
+            keyMap.stamp = stamp;
+            keyMap.columns = columns;
+            keyMap.rows = rows.size();
+            keyMap.positions.reserve(rows.size());
+            for (std::size_t row = 0; row < rows.size(); ++row)
+            {
+                if (const std::optional<std::string> key = index.keyOf(rows[row]))
+                {
+                    keyMap.positions.emplace(*key, row);
+                }
+            }
+            return keyMap;
+        }
+
+        KeyMap LoadKeyMap(const std::string& dbPath, const std::string& tableName, const std::vector<std::string>& columns)
+        {
+            const std::string tablePath = TableFilePath(dbPath, tableName);
+            const std::string keysPath = KeyMapFilePath(dbPath, tableName);
+            const std::optional<FileStamp> stamp = StatFile(tablePath);
+            if (!stamp.has_value())
+            {
+                throw JsonDbException("Failed to open table file: " + tablePath);
+            }
+
+            KeyMap keyMap;
+            std::uint64_t columnsLength = 0;
+            const std::string data = StatFile(keysPath).has_value() ? ReadFileText(keysPath) : std::string();
+            if (data.size() >= kKeyMapHeaderSize && DecodeKeyMapHeader(data.data(), keyMap, columnsLength) && keyMap.stamp == *stamp &&
+                columnsLength <= data.size() - kKeyMapHeaderSize &&
+                nlohmann::json::parse(data.substr(kKeyMapHeaderSize, columnsLength), nullptr, false) == nlohmann::json(columns))
+            {
+                keyMap.columns = columns;
+                keyMap.positions.reserve(keyMap.rows);
+                std::size_t offset = kKeyMapHeaderSize + columnsLength;
+                bool complete = true;
+                while (complete && offset < data.size())
+                {
+                    complete = data.size() - offset >= 16 && data.size() - offset - 16 >= GetU64(data.data() + offset + 8);
+                    if (complete)
+                    {
+                        const std::uint64_t position = GetU64(data.data() + offset);
+                        const std::uint64_t length = GetU64(data.data() + offset + 8);
+                        // Entries left behind by an interrupted append point past the rows.
+                        complete = position < keyMap.rows;
+                        keyMap.positions.emplace(data.substr(offset + 16, length), position);
+                        offset += 16 + length;
+                    }
+                }
+                if (complete)
+                {
+                    return keyMap;
+                }
+            }
+
+            // Only the key columns of each row are parsed.
+            const PrimaryKeyIndex index(columns, {});
+            keyMap = KeyMap();
+            keyMap.stamp = *stamp;
+            keyMap.columns = columns;
+            StreamJsonLines(
+                tablePath,
+                0,
+                [&](nlohmann::json& row) {
+                    if (const std::optional<std::string> key = index.keyOf(row))
+                    {
+                        keyMap.positions.emplace(*key, keyMap.rows);
+                    }
+                    ++keyMap.rows;
+                    return true;
+                },
+                columns);
+            // Like row offsets, the sidecar is only a cache.
+            if (StatFile(tablePath) == stamp)
+            {
+                try
+                {
+                    WriteKeyMap(keysPath, keyMap);
+                }
+                catch (const JsonDbException&)
+                {
+                }
+            }
+            return keyMap;
+        }
+
+        void WriteKeyMap(const std::string& path, const KeyMap& keyMap, bool sync)
+        {
+            const std::string columns = nlohmann::json(keyMap.columns).dump();
+            std::string data = EncodeKeyMapHeader(keyMap, columns.size()) + columns;
+            for (const auto& [key, position] : keyMap.positions)
+            {
+                PutKeyEntry(data, key, position);
+            }
+            WriteFileAtomically(path, data, sync);
+        }
+
+        void AppendTableRows(
+            const std::string& dbPath,
+            const std::string& tableName,
+            const TableRows& rows,
+            SyncMode syncMode,
+            KeyMap* keyMap)
+        {
+            if (rows.empty())
+            {
+                return;
+            }
+
+            const std::string tablePath = TableFilePath(dbPath, tableName);
+            const std::string offsetsPath = RowOffsetsFilePath(dbPath, tableName);
+            const std::optional<FileStamp> before = StatFile(tablePath);
+            std::vector<std::uint64_t> starts;
+            const std::uint64_t base = AppendJsonLines(tablePath, rows, &starts, syncMode != SyncMode::NONE);
+            const std::optional<FileStamp> after = StatFile(tablePath);
+            if (!before.has_value() || !after.has_value())
+            {
+                return;
+            }
+            ExtendKeyMap(KeyMapFilePath(dbPath, tableName), *before, *after, rows, keyMap, syncMode == SyncMode::ALWAYS);
+
+            // Extend the sidecar in place when it described the file as it was
+            // before this append; otherwise the next reader rebuilds it.
+            std::fstream file(offsetsPath, std::ios::in | std::ios::out | std::ios::binary);
+            char header[kRowOffsetsHeaderSize];
+            FileStamp stamp;
+            std::uint64_t end = 0;
+            if (!file.read(header, sizeof(header)) || !DecodeRowOffsetsHeader(header, stamp, end) || stamp != *before || end != base)
+            {
+                return;
+            }
+
+            std::string tail;
+            tail.reserve(starts.size() * 8);
+            for (const std::uint64_t start : starts)
+            {
+                PutU64(tail, start);
+            }
+            file.seekp(0, std::ios::end);
+            file.write(tail.data(), static_cast<std::streamsize>(tail.size()));
+            const std::string updated = EncodeRowOffsetsHeader(*after, after->size);
+            file.seekp(0);
+            file.write(updated.data(), static_cast<std::streamsize>(updated.size()));
+            file.close();
+            if (syncMode == SyncMode::ALWAYS && file)
+            {
+                SyncFile(offsetsPath);
+            }
+        }
+
+        TableRows ReadJsonArrayFile(const std::string& path)
+        {
+            nlohmann::json tableData = ParseTableText(ReadFileText(path));
+            if (!tableData.is_array())
+            {
+                throw JsonDbException("Table data must be a JSON array: " + path);
+            }
+            return std::move(tableData.get_ref<nlohmann::json::array_t&>());
+        }
+
+        TableRows ReadJsonArrayFileParallel(const std::string& path, ThreadPool& pool)
+        {
+            const std::string text = ReadFileText(path);
+            const auto elements = FindArrayElements(text);
+            if (!elements.has_value())
+            {
+                return ReadJsonArrayFile(path);
+            }
+
+            const std::size_t chunks = std::min(pool.size() * 4, std::max<std::size_t>(elements->size(), 1));
+            std::vector<TableRows> parts(chunks);
+            pool.run(chunks, [&](std::size_t chunk) {
+                const std::size_t first = elements->size() * chunk / chunks;
+                const std::size_t last = elements->size() * (chunk + 1) / chunks;
+                TableRows& part = parts[chunk];
+                part.reserve(last - first);
+                for (std::size_t index = first; index < last; ++index)
+                {
+                    const auto [begin, end] = (*elements)[index];
+                    part.push_back(ParseJsonText(std::string_view(text).substr(begin, end - begin)));
+                }
+            });
+            return JoinParts(parts);
+        }
+
+        bool StreamJsonArrayFile(const std::string& path, const RowVisitor& visit, const std::vector<std::string>& columns)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+            {
+                throw JsonDbException("Failed to open table file: " + path);
+            }
+
+            RowSaxHandler handler(path, visit, columns, true);
+            nlohmann::json::sax_parse(file, &handler);
+            return !handler.wasStopped();
+        }
+
+        TableRows LoadTableRows(const std::string& dbPath, const std::string& tableName)
+        {
+            TableRows rows = ReadTableFile(TableFilePath(dbPath, tableName));
+            const std::string deltaPath = DeltaFilePath(dbPath, tableName);
+            if (fs::exists(deltaPath))
+            {
+                ReadJsonLines(deltaPath, 0, rows);
+            }
+            LoadTombstones(dbPath, tableName).removeDeadRows(rows);
+            return rows;
+        }
+
+        std::uint64_t ReadJsonLines(const std::string& path, std::uint64_t offset, TableRows& rows)
+        {
+            return StreamJsonLines(path, offset, [&rows](nlohmann::json& row) {
+                rows.push_back(std::move(row));
+                return true;
+            });
+        }
+
+        std::uint64_t StreamJsonLines(
+            const std::string& path,
+            std::uint64_t offset,
+            const RowVisitor& visit,
+            const std::vector<std::string>& columns,
+            std::optional<std::uint64_t> end)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+            {
+                throw JsonDbException("Failed to open row file: " + path);
+            }
+
+            file.seekg(static_cast<std::streamoff>(offset));
+            const RowVisitor visitObject = [&](nlohmann::json& row) {
+                if (!row.is_object())
+                {
+                    throw JsonDbException("Rows must be JSON objects: " + path);
+                }
+                return visit(row);
+            };
+            RowSaxHandler handler(path, visitObject, columns, false);
+            std::string line;
+            // A last line without its newline is a torn append and is left unread.
+            while ((!end.has_value() || offset < *end) && std::getline(file, line) && !file.eof())
+            {
+                offset += line.size() + 1;
+                if (line.empty())
+                {
+                    continue;
+                }
+
+                nlohmann::json::sax_parse(line, &handler);
+                if (handler.wasStopped())
+                {
+                    break;
+                }
+            }
+            return offset;
+        }
+
+        bool VisitJsonRow(std::string_view text, const std::string& path, const RowVisitor& visit, const std::vector<std::string>& columns)
+        {
+            const RowVisitor visitObject = [&](nlohmann::json& row) {
+                if (!row.is_object())
+                {
+                    throw JsonDbException("Rows must be JSON objects: " + path);
+                }
+                return visit(row);
+            };
+            RowSaxHandler handler(path, visitObject, columns, false);
+            nlohmann::json::sax_parse(text, &handler);
+            return !handler.wasStopped();
+        }
+
+        bool StreamJsonArrayRows(
+            const std::string& path,
+            std::uint64_t begin,
+            std::uint64_t end,
+            const RowVisitor& visit,
+            const std::vector<std::string>& columns)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open())
+            {
+                throw JsonDbException("Failed to open table file: " + path);
+            }
+
+            std::string text(static_cast<std::size_t>(end - begin), '\0');
+            file.seekg(static_cast<std::streamoff>(begin));
+            if (!file.read(text.data(), static_cast<std::streamsize>(text.size())))
+            {
+                throw JsonDbException("Failed to read table file: " + path);
+            }
+            for (std::size_t start = 0; start < text.size();)
+            {
+                const std::size_t newline = std::min(text.find('\n', start), text.size());
+                std::string_view line(text.data() + start, newline - start);
+                start = newline + 1;
+                while (!line.empty() && (line.back() == ',' || line.back() == '\r'))
+                {
+                    line.remove_suffix(1);
+                }
+                if (!line.empty() && !VisitJsonRow(line, path, visit, columns))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string SerializeJsonLines(const TableRows& rows, std::uint64_t base, std::vector<std::uint64_t>* starts)
+        {
+            std::string buffer;
+            for (const auto& row : rows)
+            {
+                if (starts != nullptr)
+                {
+                    starts->push_back(base + buffer.size());
+                }
+                AppendJson(buffer, row);
+                buffer += '\n';
+            }
+            return buffer;
+        }
+
+        std::uint64_t AppendJsonLines(const std::string& path, const TableRows& rows, std::vector<std::uint64_t>* starts, bool sync)
+        {
+            DropTornTail(path);
+
+            std::error_code error;
+            const bool existed = fs::exists(path, error);
+            const std::uint64_t base = existed ? fs::file_size(path, error) : 0;
+            AppendToFile(path, SerializeJsonLines(rows, base, starts), sync);
+            if (sync && !existed)
+            {
+                SyncDirectory(fs::path(path).parent_path().string());
+            }
+            return base;
+        }
+
+        std::string SerializeTableRows(const TableRows& rows, JsonLayout layout)
+        {
+            std::string buffer;
+            EmitTableRows(rows, layout, buffer, std::numeric_limits<std::size_t>::max(), {});
+            return buffer;
+        }
+
+        void AppendToFile(const std::string& path, const std::string& data, bool sync)
+        {
+            WriteWithFlags(path, kAppendFlags, data, sync);
+        }
+
+        void WriteFileAtomically(const std::string& path, const std::string& data, bool sync)
+        {
+            const std::string tempPath = path + ".tmp";
+            WriteWithFlags(tempPath, kTruncateFlags, data, sync);
+            ReplaceFile(tempPath, path, sync);
+        }
+
+        void SyncDirectory(const std::string& path)
+        {
+#ifdef _WIN32
+            (void)path;
+#else
+            const int fd = ::open(path.empty() ? "." : path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+#endif
+        }
+    }
+}
@@ -0,0 +1,208 @@
+#include <database/json_table_cache.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::optional<FileStamp> StatFile(const std::string& path)
+        {
+            FileStamp stamp;
+#ifdef _WIN32
+            // _stat64 only has whole-second times and no file index, so a
+            // rewrite within the same second would look unchanged.
+            const HANDLE handle = ::CreateFileA(
+                path.c_str(),
+                0,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS,
+                nullptr);
+            if (handle == INVALID_HANDLE_VALUE)
+            {
+                return std::nullopt;
+            }
+            BY_HANDLE_FILE_INFORMATION info;
+            const BOOL ok = ::GetFileInformationByHandle(handle, &info);
+            ::CloseHandle(handle);
+            if (!ok)
+            {
+                return std::nullopt;
+            }
+            // FILETIME counts 100 ns intervals since 1601.
+            constexpr std::int64_t kUnixEpochTicks = 116444736000000000LL;
+            const std::int64_t ticks =
+                static_cast<std::int64_t>((static_cast<std::uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                                          info.ftLastWriteTime.dwLowDateTime);
+            stamp.mtimeNs = (ticks - kUnixEpochTicks) * 100;
+            stamp.size = (static_cast<std::uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+            stamp.inode = (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+#else
+            struct stat info;
+            if (::stat(path.c_str(), &info) != 0)
+            {
+                return std::nullopt;
+            }
+#ifdef __APPLE__
+            stamp.mtimeNs = static_cast<std::int64_t>(info.st_mtimespec.tv_sec) * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+            stamp.mtimeNs = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+            stamp.size = static_cast<std::uint64_t>(info.st_size);
+            stamp.inode = static_cast<std::uint64_t>(info.st_ino);
+#endif
+            return stamp;
+        }
+
+        std::size_t EstimateJsonBytes(const nlohmann::json& value)
+        {
+            std::size_t bytes = sizeof(nlohmann::json);
+            if (value.is_string())
+            {
+                bytes += value.get_ref<const std::string&>().capacity();
+            }
+            else if (value.is_object())
+            {
+                for (auto it = value.begin(); it != value.end(); ++it)
+                {
+                    bytes += 4 * sizeof(void*) + it.key().capacity() + EstimateJsonBytes(it.value());
+                }
+            }
+            else if (value.is_array())
+            {
+                for (const auto& element : value)
+                {
+                    bytes += EstimateJsonBytes(element);
+                }
+            }
+            return bytes;
+        }
+
+        std::shared_ptr<const TableRows> TableCache::lookup(const std::string& path, const TableStamp& stamp)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = entries.find(path);
+            if (it == entries.end())
+            {
+                ++stats.misses;
+                return nullptr;
+            }
+
+            if (it->second.table.stamp != stamp)
+            {
+                ++stats.misses;
+                return nullptr;
+            }
+
+            lru.splice(lru.begin(), lru, it->second.lruPosition);
+            ++stats.hits;
+            return it->second.table.rows;
+        }
+
+        std::optional<CachedTable> TableCache::peek(const std::string& path) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = entries.find(path);
+            if (it == entries.end())
+            {
+                return std::nullopt;
+            }
+            return it->second.table;
+        }
+
+        void TableCache::store(const std::string& path, CachedTable table)
+        {
+            std::size_t bytes = sizeof(TableRows);
+            for (const auto& row : *table.rows)
+            {
+                bytes += EstimateJsonBytes(row);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto existing = entries.find(path);
+            if (existing != entries.end())
+            {
+                eraseLocked(existing);
+            }
+
+            if (bytes > budgetBytes)
+            {
+                return;
+            }
+
+            lru.push_front(path);
+            entries[path] = Entry{std::move(table), bytes, lru.begin()};
+            usedBytes += bytes;
+            evictLocked();
+        }
+
+        void TableCache::invalidate(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = entries.find(path);
+            if (it != entries.end())
+            {
+                eraseLocked(it);
+            }
+        }
+
+        void TableCache::clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+            lru.clear();
+            usedBytes = 0;
+        }
+
+        void TableCache::setBudget(std::size_t budget)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            budgetBytes = budget;
+            evictLocked();
+        }
+
+        std::size_t TableCache::getBudget() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return budgetBytes;
+        }
+
+        TableCacheStats TableCache::getStats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            TableCacheStats snapshot = stats;
+            snapshot.entries = entries.size();
+            snapshot.bytes = usedBytes;
+            return snapshot;
+        }
+
+        void TableCache::eraseLocked(std::unordered_map<std::string, Entry>::iterator it)
+        {
+            usedBytes -= it->second.bytes;
+            lru.erase(it->second.lruPosition);
+            entries.erase(it);
+        }
+
+        void TableCache::evictLocked()
+        {
+            while (usedBytes > budgetBytes && !lru.empty())
+            {
+                eraseLocked(entries.find(lru.back()));
+                ++stats.evictions;
+            }
+        }
+    }
+}
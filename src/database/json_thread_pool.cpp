@@ -0,0 +1,111 @@
+#include <database/json_thread_pool.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace sql
+{
+    namespace jsondb
+    {
+        std::size_t ResolveThreadCount(std::size_t requested)
+        {
+            if (requested != 0)
+            {
+                return requested;
+            }
+            return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        }
+
+        ThreadPool::ThreadPool(std::size_t threads)
+        {
+            const std::size_t workerCount = ResolveThreadCount(threads) - 1;
+            workers.reserve(workerCount);
+            for (std::size_t index = 0; index < workerCount; ++index)
+            {
+                workers.emplace_back(&ThreadPool::workerLoop, this);
+            }
+        }
+
+        ThreadPool::~ThreadPool()
+        {
+            {
+                const std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        void ThreadPool::run(std::size_t count, const std::function<void(std::size_t)>& work)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            const std::lock_guard<std::mutex> serial(runMutex);
+            std::unique_lock<std::mutex> lock(mutex);
+            task = &work;
+            taskCount = count;
+            nextTask = 0;
+            finishedTasks = 0;
+            failure = nullptr;
+            wake.notify_all();
+
+            drain(lock);
+            done.wait(lock, [this]() { return finishedTasks == taskCount; });
+            task = nullptr;
+            if (failure != nullptr)
+            {
+                std::rethrow_exception(std::exchange(failure, nullptr));
+            }
+        }
+
+        void ThreadPool::drain(std::unique_lock<std::mutex>& lock)
+        {
+            while (task != nullptr && nextTask < taskCount)
+            {
+                const std::size_t index = nextTask++;
+                const std::function<void(std::size_t)>& work = *task;
+                lock.unlock();
+
+                std::exception_ptr error;
+                try
+                {
+                    work(index);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                lock.lock();
+                if (error != nullptr && failure == nullptr)
+                {
+                    failure = error;
+                }
+                if (++finishedTasks == taskCount)
+                {
+                    done.notify_all();
+                }
+            }
+        }
+
+        void ThreadPool::workerLoop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                wake.wait(lock, [this]() { return stopping || (task != nullptr && nextTask < taskCount); });
+                if (stopping)
+                {
+                    return;
+                }
+                drain(lock);
+            }
+        }
+    }
+}
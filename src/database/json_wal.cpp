@@ -0,0 +1,653 @@
+#include <database/json_wal.h>
+
+#include <database/json_driver.h>
+#include <database/json_lsm.h>
+#include <database/json_storage.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+std::string CheckpointFilePath(const std::string& dbPath, const std::string& tableName)
+{
+    return sql::jsondb::TableFilePath(dbPath, tableName) + ".ckpt";
+}
+
+nlohmann::json EncodeChange(const sql::jsondb::TableChange& change, std::uint64_t lsn)
+{
+    using sql::jsondb::TableChange;
+
+    nlohmann::json record = {{"lsn", lsn}, {"table", change.table}};
+    switch (change.kind)
+    {
+    case TableChange::Kind::INSERT:
+        record["op"] = "insert";
+        record["rows"] = change.rows;
+        break;
+    case TableChange::Kind::UPDATE:
+    case TableChange::Kind::UPSERT:
+        record["op"] = change.kind == TableChange::Kind::UPDATE ? "update" : "upsert";
+        record["positions"] = change.positions;
+        record["rows"] = change.rows;
+        break;
+    case TableChange::Kind::DELETE:
+        record["op"] = "delete";
+        record["positions"] = change.positions;
+        break;
+    }
+    return record;
+}
+
+sql::jsondb::TableChange DecodeChange(const nlohmann::json& record)
+{
+    using sql::jsondb::TableChange;
+
+    TableChange change;
+    change.table = record.at("table").get<std::string>();
+    const std::string op = record.at("op").get<std::string>();
+    if (op == "insert")
+    {
+        change.kind = TableChange::Kind::INSERT;
+    }
+    else if (op == "update")
+    {
+        change.kind = TableChange::Kind::UPDATE;
+    }
+    else if (op == "delete")
+    {
+        change.kind = TableChange::Kind::DELETE;
+    }
+    else if (op == "upsert")
+    {
+        change.kind = TableChange::Kind::UPSERT;
+    }
+    else
+    {
+        throw sql::jsondb::JsonDbException("Unknown log record: " + op);
+    }
+
+    if (record.contains("positions"))
+    {
+        change.positions = record.at("positions").get<std::vector<std::size_t>>();
+    }
+    if (record.contains("rows"))
+    {
+        change.rows = record.at("rows").get<sql::jsondb::TableRows>();
+    }
+    return change;
+}
+
+void RenameOrThrow(const std::string& from, const std::string& to)
+{
+    std::error_code error;
+    fs::rename(from, to, error);
+    if (error)
+    {
+        throw sql::jsondb::JsonDbException("Failed to replace file: " + to);
+    }
+}
+
+// Checkpoints hold NDJSON; LSM tables load them as a fresh run instead of
+// having their manifest replaced.
+void InstallCheckpoint(const std::string& dbPath, const std::string& tableName)
+{
+    const std::string checkpointPath = CheckpointFilePath(dbPath, tableName);
+    const std::string tablePath = sql::jsondb::TableFilePath(dbPath, tableName);
+    if (!sql::jsondb::IsLsmManifest(tablePath))
+    {
+        // The checkpoint may reuse the inode the table's zone map names.
+        fs::remove(sql::jsondb::ZoneMapFilePath(dbPath, tableName));
+        RenameOrThrow(checkpointPath, tablePath);
+        return;
+    }
+    sql::jsondb::TableRows rows;
+    sql::jsondb::ReadJsonLines(checkpointPath, 0, rows);
+    sql::jsondb::WriteTableFile(dbPath, tableName, rows, sql::jsondb::TableFormat::LSM, sql::jsondb::SyncMode::COMMIT);
+    fs::remove(checkpointPath);
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        void ApplyTableChange(TableRows& rows, const TableChange& change)
+        {
+            switch (change.kind)
+            {
+            case TableChange::Kind::INSERT:
+                rows.insert(rows.end(), change.rows.begin(), change.rows.end());
+                return;
+            case TableChange::Kind::UPDATE:
+            case TableChange::Kind::UPSERT:
+                for (std::size_t index = 0; index < change.positions.size(); ++index)
+                {
+                    if (change.positions[index] >= rows.size())
+                    {
+                        throw JsonDbException("Log record references a missing row in table: " + change.table);
+                    }
+                    rows[change.positions[index]] = change.rows.at(index);
+                }
+                if (change.kind == TableChange::Kind::UPSERT)
+                {
+                    rows.insert(rows.end(), change.rows.begin() + static_cast<std::ptrdiff_t>(change.positions.size()), change.rows.end());
+                }
+                return;
+            case TableChange::Kind::DELETE:
+            {
+                std::size_t next = 0;
+                std::size_t kept = 0;
+                for (std::size_t index = 0; index < rows.size(); ++index)
+                {
+                    if (next < change.positions.size() && change.positions[next] == index)
+                    {
+                        ++next;
+                        continue;
+                    }
+                    if (kept != index)
+                    {
+                        rows[kept] = std::move(rows[index]);
+                    }
+                    ++kept;
+                }
+                if (next != change.positions.size())
+                {
+                    throw JsonDbException("Log record references a missing row in table: " + change.table);
+                }
+                rows.erase(rows.begin() + static_cast<std::ptrdiff_t>(kept), rows.end());
+                return;
+            }
+            }
+        }
+
+        std::size_t CountAffectedRows(const TableChange& change)
+        {
+            switch (change.kind)
+            {
+            case TableChange::Kind::INSERT:
+                return change.rows.size();
+            case TableChange::Kind::UPSERT:
+                // Counted the way MySQL counts REPLACE: a replaced row is a delete plus an insert.
+                return change.rows.size() + change.positions.size();
+            default:
+                return change.positions.size();
+            }
+        }
+
+        std::shared_ptr<WriteAheadLog> WriteAheadLog::open(const std::string& dbPath)
+        {
+            static std::mutex registryMutex;
+            static std::map<std::string, std::weak_ptr<WriteAheadLog>> registry;
+
+            std::error_code error;
+            const fs::path canonical = fs::weakly_canonical(dbPath, error);
+            const std::string key = error ? dbPath : canonical.string();
+
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (auto it = registry.begin(); it != registry.end();)
+            {
+                it = it->second.expired() ? registry.erase(it) : std::next(it);
+            }
+
+            std::weak_ptr<WriteAheadLog>& slot = registry[key];
+            if (auto existing = slot.lock())
+            {
+                return existing;
+            }
+
+            std::shared_ptr<WriteAheadLog> log(new WriteAheadLog(key));
+            slot = log;
+            return log;
+        }
+
+        WriteAheadLog::WriteAheadLog(std::string path)
+            : dbPath(std::move(path)),
+              logPath((fs::path(dbPath) / "jsondb.wal").string()),
+              markerPath((fs::path(dbPath) / "jsondb.checkpoint").string())
+        {
+            recover();
+            checkpointer = std::thread(&WriteAheadLog::checkpointLoop, this);
+        }
+
+        WriteAheadLog::~WriteAheadLog()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            if (checkpointer.joinable())
+            {
+                checkpointer.join();
+            }
+
+            try
+            {
+                std::lock_guard<std::mutex> writeLock(writeMutex);
+                checkpointTables();
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+
+        void WriteAheadLog::recover()
+        {
+            std::error_code error;
+            if (fs::exists(markerPath))
+            {
+                std::ifstream markerFile(markerPath);
+                nlohmann::json marker;
+                markerFile >> marker;
+                markerFile.close();
+
+                for (const auto& table : marker.at("tables"))
+                {
+                    const std::string tableName = table.get<std::string>();
+                    const std::string checkpointPath = CheckpointFilePath(dbPath, tableName);
+                    if (fs::exists(checkpointPath))
+                    {
+                        InstallCheckpoint(dbPath, tableName);
+                    }
+                    fs::remove(DeltaFilePath(dbPath, tableName), error);
+                }
+                SyncDirectory(dbPath);
+                fs::resize_file(logPath, 0, error);
+                fs::remove(markerPath, error);
+                return;
+            }
+
+            for (const auto& entry : fs::directory_iterator(dbPath, error))
+            {
+                if (entry.path().extension() == ".ckpt" || entry.path().extension() == ".tmp")
+                {
+                    fs::remove(entry.path(), error);
+                }
+            }
+
+            std::ifstream logFile(logPath, std::ios::binary);
+            if (!logFile.is_open())
+            {
+                return;
+            }
+            const std::string content((std::istreambuf_iterator<char>(logFile)), std::istreambuf_iterator<char>());
+            logFile.close();
+
+            std::map<std::string, TableRows> tables;
+            std::vector<TableChange> open;
+            std::uint64_t openLsn = 0;
+            std::size_t lineStart = 0;
+            for (std::size_t newline = content.find('\n'); newline != std::string::npos;
+                 lineStart = newline + 1, newline = content.find('\n', lineStart))
+            {
+                nlohmann::json record = nlohmann::json::parse(content.begin() + lineStart, content.begin() + newline, nullptr, false);
+                if (record.is_discarded() || !record.is_object())
+                {
+                    break;
+                }
+
+                const std::uint64_t lsn = record.value("lsn", std::uint64_t{0});
+                if (lsn != openLsn)
+                {
+                    open.clear();
+                    openLsn = lsn;
+                }
+
+                if (record.value("op", "") != "commit")
+                {
+                    open.push_back(DecodeChange(record));
+                    continue;
+                }
+
+                for (const auto& change : open)
+                {
+                    auto table = tables.find(change.table);
+                    if (table == tables.end())
+                    {
+                        table = tables.emplace(change.table, LoadTableRows(dbPath, change.table)).first;
+                    }
+                    ApplyTableChange(table->second, change);
+                }
+                open.clear();
+                lastLsn = lsn;
+            }
+
+            for (auto& [table, rows] : tables)
+            {
+                pending[table] = std::make_shared<const TableRows>(std::move(rows));
+            }
+            checkpointTables();
+            fs::resize_file(logPath, 0, error);
+        }
+
+        void WriteAheadLog::checkpointTables()
+        {
+            std::map<std::string, std::shared_ptr<const TableRows>> tables;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tables = pending;
+            }
+            if (tables.empty())
+            {
+                return;
+            }
+
+            nlohmann::json names = nlohmann::json::array();
+            for (const auto& [table, rows] : tables)
+            {
+                const TableFormat format = DetectTableFormat(TableFilePath(dbPath, table));
+                WriteFileAtomically(CheckpointFilePath(dbPath, table), SerializeTable(*rows, format), true);
+                names.push_back(table);
+            }
+            WriteFileAtomically(markerPath, nlohmann::json{{"tables", names}}.dump(), true);
+
+            std::error_code error;
+            std::map<std::string, CheckpointedTable> written;
+            for (const auto& [table, rows] : tables)
+            {
+                const std::string tablePath = TableFilePath(dbPath, table);
+                InstallCheckpoint(dbPath, table);
+                fs::remove(DeltaFilePath(dbPath, table), error);
+                fs::remove(TombstoneFilePath(dbPath, table), error);
+                if (const std::optional<FileStamp> stamp = StatFile(tablePath))
+                {
+                    written[table] = CheckpointedTable{*stamp, rows};
+                }
+            }
+            SyncDirectory(dbPath);
+            fs::resize_file(logPath, 0, error);
+            fs::remove(markerPath, error);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.clear();
+            checkpointed = std::move(written);
+            stats.logBytes = 0;
+            ++stats.checkpoints;
+        }
+
+        void WriteAheadLog::checkpointLoop()
+        {
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeup.wait(lock, [this]() { return stopping || !pending.empty(); });
+                    wakeup.wait_for(lock, kCheckpointDelay, [this]() { return stopping || stats.logBytes >= kCheckpointLogBytes; });
+                    if (stopping)
+                    {
+                        return;
+                    }
+                }
+
+                try
+                {
+                    std::lock_guard<std::mutex> writeLock(writeMutex);
+                    checkpointTables();
+                }
+                catch (const std::exception&)
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeup.wait_for(lock, kCheckpointDelay, [this]() { return stopping; });
+                }
+            }
+        }
+
+        std::uint64_t WriteAheadLog::getVersionLocked(const std::string& table) const
+        {
+            const auto it = versions.find(table);
+            return it == versions.end() ? 0 : it->second;
+        }
+
+        std::uint64_t WriteAheadLog::getTableVersion(const std::string& table) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return getVersionLocked(table);
+        }
+
+        std::shared_ptr<const TableRows> WriteAheadLog::getCommittedTable(const std::string& table) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = pending.find(table);
+            return it == pending.end() ? nullptr : it->second;
+        }
+
+        std::shared_ptr<const TableRows> WriteAheadLog::getCheckpointedTable(const std::string& table, const TableStamp& stamp) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = checkpointed.find(table);
+            if (it == checkpointed.end() || stamp.delta.has_value() || stamp.tombstones.has_value() || it->second.stamp != stamp.data)
+            {
+                return nullptr;
+            }
+            return it->second.rows;
+        }
+
+        void WriteAheadLog::commit(Transaction& transaction)
+        {
+            if (transaction.empty())
+            {
+                return;
+            }
+
+            CommitRequest request;
+            request.transaction = &transaction;
+            submit(request);
+        }
+
+        std::size_t WriteAheadLog::apply(const std::string& table, const TableMutation& mutation, const TableLoader& load)
+        {
+            CommitRequest request;
+            request.table = table;
+            request.mutation = &mutation;
+            request.load = &load;
+            submit(request);
+            return request.affectedRows;
+        }
+
+        void WriteAheadLog::submit(CommitRequest& request)
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queue.push_back(&request);
+            while (!request.done)
+            {
+                if (leaderActive)
+                {
+                    groupFinished.wait(lock);
+                    continue;
+                }
+
+                leaderActive = true;
+                const std::vector<CommitRequest*> group(queue.begin(), queue.end());
+                queue.clear();
+                lock.unlock();
+                commitGroup(group);
+                lock.lock();
+                for (CommitRequest* member : group)
+                {
+                    member->done = true;
+                }
+                leaderActive = false;
+                groupFinished.notify_all();
+            }
+
+            if (request.error)
+            {
+                std::rethrow_exception(request.error);
+            }
+        }
+
+        void WriteAheadLog::commitGroup(const std::vector<CommitRequest*>& group)
+        {
+            std::lock_guard<std::mutex> writeLock(writeMutex);
+
+            std::uint64_t lsn = 0;
+            std::map<std::string, std::uint64_t> groupVersions;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lsn = lastLsn;
+                groupVersions = versions;
+            }
+
+            std::map<std::string, std::shared_ptr<TableRows>> working;
+            std::vector<CommitRequest*> committed;
+            std::string buffer;
+            for (CommitRequest* request : group)
+            {
+                try
+                {
+                    std::vector<TableChange> changes;
+                    if (request->transaction != nullptr)
+                    {
+                        Transaction& transaction = *request->transaction;
+                        for (const auto& [table, baseVersion] : transaction.baseVersions)
+                        {
+                            const auto it = groupVersions.find(table);
+                            if ((it == groupVersions.end() ? 0 : it->second) != baseVersion)
+                            {
+                                throw JsonDbException("Transaction conflicts with a concurrent write to table: " + table);
+                            }
+                        }
+                        for (auto& [table, rows] : transaction.tables)
+                        {
+                            working[table] = std::move(rows);
+                        }
+                        changes = std::move(transaction.changes);
+                    }
+                    else
+                    {
+                        auto image = working.find(request->table);
+                        TableChange change;
+                        if (image == working.end())
+                        {
+                            std::shared_ptr<const TableRows> current = getCommittedTable(request->table);
+                            if (current == nullptr)
+                            {
+                                current = (*request->load)(request->table);
+                            }
+                            change = (*request->mutation)(*current, nullptr);
+                            request->affectedRows = CountAffectedRows(change);
+                            if (request->affectedRows == 0)
+                            {
+                                continue;
+                            }
+                            image = working.emplace(request->table, std::make_shared<TableRows>(*current)).first;
+                        }
+                        else
+                        {
+                            change = (*request->mutation)(*image->second, nullptr);
+                            request->affectedRows = CountAffectedRows(change);
+                            if (request->affectedRows == 0)
+                            {
+                                continue;
+                            }
+                        }
+                        ApplyTableChange(*image->second, change);
+                        changes.push_back(std::move(change));
+                    }
+
+                    ++lsn;
+                    for (const auto& change : changes)
+                    {
+                        buffer += EncodeChange(change, lsn).dump();
+                        buffer += '\n';
+                        groupVersions[change.table] = lsn;
+                    }
+                    buffer += nlohmann::json{{"lsn", lsn}, {"op", "commit"}}.dump();
+                    buffer += '\n';
+                    committed.push_back(request);
+                }
+                catch (...)
+                {
+                    request->error = std::current_exception();
+                }
+            }
+
+            if (committed.empty())
+            {
+                return;
+            }
+
+            try
+            {
+                AppendToFile(logPath, buffer, true);
+            }
+            catch (...)
+            {
+                std::error_code error;
+                std::lock_guard<std::mutex> lock(mutex);
+                fs::resize_file(logPath, stats.logBytes, error);
+                for (CommitRequest* request : committed)
+                {
+                    request->error = std::current_exception();
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& [table, rows] : working)
+                {
+                    pending[table] = std::move(rows);
+                    checkpointed.erase(table);
+                }
+                versions = std::move(groupVersions);
+                lastLsn = lsn;
+
+                if (stats.commits == 0)
+                {
+                    firstCommit = std::chrono::steady_clock::now();
+                }
+                stats.commits += committed.size();
+                ++stats.syncs;
+                stats.logBytes += buffer.size();
+                stats.maxGroupSize = std::max(stats.maxGroupSize, committed.size());
+            }
+            wakeup.notify_one();
+        }
+
+        std::unique_lock<std::mutex> WriteAheadLog::lockForDirectWrite(const std::string& table)
+        {
+            std::unique_lock<std::mutex> writeLock(writeMutex);
+            if (getCommittedTable(table) != nullptr)
+            {
+                checkpointTables();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            versions[table] = ++lastLsn;
+            checkpointed.erase(table);
+            return writeLock;
+        }
+
+        void WriteAheadLog::checkpoint()
+        {
+            std::lock_guard<std::mutex> writeLock(writeMutex);
+            checkpointTables();
+        }
+
+        WalStats WriteAheadLog::getStats() const
+        {
+            std::size_t queued = 0;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                queued = queue.size();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            WalStats snapshot = stats;
+            snapshot.queuedCommits = queued;
+            snapshot.pendingTables = pending.size();
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - firstCommit).count();
+            if (stats.commits > 0 && seconds > 0.0)
+            {
+                snapshot.commitsPerSecond = static_cast<double>(stats.commits) / seconds;
+            }
+            return snapshot;
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#include <database/json_writer.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+void AppendEscaped(std::string& out, const std::string& text)
+{
+    out += '"';
+    std::size_t runStart = 0;
+    for (std::size_t index = 0; index < text.size(); ++index)
+    {
+        const auto ch = static_cast<unsigned char>(text[index]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+        {
+            continue;
+        }
+
+        out.append(text, runStart, index - runStart);
+        runStart = index + 1;
+        switch (ch)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += "\\u00";
+            out += kHexDigits[ch >> 4];
+            out += kHexDigits[ch & 0x0F];
+            break;
+        }
+    }
+    out.append(text, runStart, std::string::npos);
+    out += '"';
+}
+
+bool IsAscii(const std::string& text)
+{
+    for (const char ch : text)
+    {
+        if (static_cast<unsigned char>(ch) >= 0x80)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Non-ASCII strings go through dump() so invalid UTF-8 is rejected exactly as
+// before.
+void AppendString(std::string& out, const std::string& text)
+{
+    if (IsAscii(text))
+    {
+        AppendEscaped(out, text);
+    }
+    else
+    {
+        out += nlohmann::json(text).dump();
+    }
+}
+
+template <typename Number>
+void AppendNumber(std::string& out, Number value)
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void AppendDouble(std::string& out, double value)
+{
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+    // Like dump(), keep a marker that the number is a float so it reads back
+    // as one.
+    if (std::memchr(buffer, '.', result.ptr - buffer) == nullptr && std::memchr(buffer, 'e', result.ptr - buffer) == nullptr)
+    {
+        out += ".0";
+    }
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        void AppendJson(std::string& out, const nlohmann::json& value)
+        {
+            switch (value.type())
+            {
+            case nlohmann::json::value_t::object:
+            {
+                out += '{';
+                bool first = true;
+                for (const auto& [key, member] : value.get_ref<const nlohmann::json::object_t&>())
+                {
+                    if (!first)
+                    {
+                        out += ',';
+                    }
+                    first = false;
+                    AppendString(out, key);
+                    out += ':';
+                    AppendJson(out, member);
+                }
+                out += '}';
+                break;
+            }
+            case nlohmann::json::value_t::array:
+            {
+                out += '[';
+                bool first = true;
+                for (const auto& element : value.get_ref<const nlohmann::json::array_t&>())
+                {
+                    if (!first)
+                    {
+                        out += ',';
+                    }
+                    first = false;
+                    AppendJson(out, element);
+                }
+                out += ']';
+                break;
+            }
+            case nlohmann::json::value_t::string:
+            {
+                const auto& text = value.get_ref<const std::string&>();
+                if (IsAscii(text))
+                {
+                    AppendEscaped(out, text);
+                }
+                else
+                {
+                    out += value.dump();
+                }
+                break;
+            }
+            case nlohmann::json::value_t::number_integer:
+                AppendNumber(out, value.get<std::int64_t>());
+                break;
+            case nlohmann::json::value_t::number_unsigned:
+                AppendNumber(out, value.get<std::uint64_t>());
+                break;
+            case nlohmann::json::value_t::number_float:
+                AppendDouble(out, value.get<double>());
+                break;
+            case nlohmann::json::value_t::boolean:
+                out += value.get<bool>() ? "true" : "false";
+                break;
+            case nlohmann::json::value_t::null:
+                out += "null";
+                break;
+            default:
+                out += value.dump();
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,339 @@
+#include <database/json_zonemap.h>
+
+#include <database/json_driver.h>
+#include <database/json_index.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+// A column's zone plus whether a string too long to keep has been seen.
+struct ColumnAccumulator
+{
+    sql::jsondb::ColumnZone zone;
+    bool longText = false;
+};
+
+void Track(ColumnAccumulator& column, const nlohmann::json& value)
+{
+    sql::jsondb::ColumnZone& zone = column.zone;
+    ++zone.present;
+    if (value.is_null())
+    {
+        ++zone.nullCount;
+    }
+    else if (value.is_number())
+    {
+        const double number = value.get<double>();
+        ++zone.numbers;
+        zone.min = zone.min.has_value() ? std::min(*zone.min, number) : number;
+        zone.max = zone.max.has_value() ? std::max(*zone.max, number) : number;
+    }
+    else if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        ++zone.strings;
+        if (text.size() > sql::jsondb::kZoneTextBytes)
+        {
+            column.longText = true;
+        }
+        else if (!column.longText)
+        {
+            zone.minText = zone.minText.has_value() ? std::min(*zone.minText, text) : text;
+            zone.maxText = zone.maxText.has_value() ? std::max(*zone.maxText, text) : text;
+        }
+    }
+}
+
+// Each distinct value is added once, so the filter is sized for those.
+sql::jsondb::BloomFilter BuildBloom(
+    const sql::jsondb::TableRows& rows,
+    std::size_t first,
+    std::size_t last,
+    const std::string& column,
+    double falsePositiveRate)
+{
+    std::vector<std::string> keys;
+    for (std::size_t index = first; index < last; ++index)
+    {
+        const auto value = rows[index].find(column);
+        if (value != rows[index].end() && !value->is_null())
+        {
+            keys.push_back(sql::jsondb::IndexKey(*value));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    sql::jsondb::BloomFilter bloom(keys.size(), sql::jsondb::BloomFilter::bitsPerKeyFor(falsePositiveRate));
+    for (const auto& key : keys)
+    {
+        bloom.add(key);
+    }
+    return bloom;
+}
+
+// Filters go to blooms, the bytes after the JSON line, and the entry points
+// at them.
+nlohmann::json ColumnZoneToJson(const sql::jsondb::ColumnZone& zone, std::string& blooms)
+{
+    nlohmann::json entry = {{"present", zone.present}};
+    if (zone.nullCount != 0)
+    {
+        entry["nulls"] = zone.nullCount;
+    }
+    if (zone.numbers != 0)
+    {
+        entry["numbers"] = zone.numbers;
+        entry["min"] = *zone.min;
+        entry["max"] = *zone.max;
+    }
+    if (zone.strings != 0)
+    {
+        entry["strings"] = zone.strings;
+        if (zone.minText.has_value())
+        {
+            entry["minText"] = *zone.minText;
+            entry["maxText"] = *zone.maxText;
+        }
+    }
+    if (zone.bloom.has_value())
+    {
+        const std::string data = zone.bloom->serialize();
+        entry["bloom"] = {blooms.size(), data.size()};
+        blooms += data;
+    }
+    return entry;
+}
+
+sql::jsondb::ColumnZone ColumnZoneFromJson(const nlohmann::json& entry, std::string_view blooms)
+{
+    sql::jsondb::ColumnZone zone;
+    zone.present = entry.at("present").get<std::uint64_t>();
+    zone.nullCount = entry.value("nulls", std::uint64_t{0});
+    zone.numbers = entry.value("numbers", std::uint64_t{0});
+    if (zone.numbers != 0)
+    {
+        zone.min = entry.at("min").get<double>();
+        zone.max = entry.at("max").get<double>();
+    }
+    zone.strings = entry.value("strings", std::uint64_t{0});
+    if (entry.contains("minText"))
+    {
+        zone.minText = entry.at("minText").get<std::string>();
+        zone.maxText = entry.at("maxText").get<std::string>();
+    }
+    if (entry.contains("bloom"))
+    {
+        const std::uint64_t offset = entry.at("bloom").at(0).get<std::uint64_t>();
+        const std::uint64_t length = entry.at("bloom").at(1).get<std::uint64_t>();
+        if (offset <= blooms.size() && length <= blooms.size() - offset)
+        {
+            zone.bloom = sql::jsondb::BloomFilter::parse(blooms.substr(offset, length));
+        }
+        if (!zone.bloom.has_value())
+        {
+            throw sql::jsondb::JsonDbException("Invalid Bloom filter in zone map.");
+        }
+    }
+    return zone;
+}
+
+bool CompareMayMatch(const sql::jsondb::PredicateNode& node, const sql::jsondb::ColumnZone& zone)
+{
+    using sql::jsondb::CompareOp;
+    if (node.op == CompareOp::EQ && !node.literal.is_null() && zone.bloom.has_value() &&
+        !zone.bloom->mayContain(sql::jsondb::IndexKey(node.literal)))
+    {
+        return false;
+    }
+    if (node.literal.is_number())
+    {
+        if (zone.numbers == 0)
+        {
+            return false;
+        }
+        const double literal = node.numericLiteral;
+        switch (node.op)
+        {
+        case CompareOp::EQ:
+            return *zone.min <= literal && literal <= *zone.max;
+        case CompareOp::NE:
+            return *zone.min != literal || *zone.max != literal;
+        case CompareOp::LT:
+            return *zone.min < literal;
+        case CompareOp::LE:
+            return *zone.min <= literal;
+        case CompareOp::GT:
+            return *zone.max > literal;
+        case CompareOp::GE:
+            return *zone.max >= literal;
+        }
+    }
+    if (node.literal.is_string())
+    {
+        if (zone.strings == 0)
+        {
+            return false;
+        }
+        if (!zone.minText.has_value())
+        {
+            return true;
+        }
+        const std::string& literal = node.literal.get_ref<const std::string&>();
+        switch (node.op)
+        {
+        case CompareOp::EQ:
+            return *zone.minText <= literal && literal <= *zone.maxText;
+        case CompareOp::NE:
+            return *zone.minText != literal || *zone.maxText != literal;
+        case CompareOp::LT:
+            return *zone.minText < literal;
+        case CompareOp::LE:
+            return *zone.minText <= literal;
+        case CompareOp::GT:
+            return *zone.maxText > literal;
+        case CompareOp::GE:
+            return *zone.maxText >= literal;
+        }
+    }
+    if (node.literal.is_null() && node.op == CompareOp::EQ)
+    {
+        return zone.nullCount != 0;
+    }
+    return true;
+}
+}
+
+namespace sql
+{
+    namespace jsondb
+    {
+        ZoneMap BuildZoneMap(const TableRows& rows, const RowOffsets& offsets, const TableSchema& schema, std::size_t blockRows)
+        {
+            ZoneMap zoneMap;
+            zoneMap.inode = offsets.stamp.inode;
+            zoneMap.end = offsets.end;
+            for (std::size_t first = 0; first < rows.size(); first += blockRows)
+            {
+                const std::size_t last = std::min(rows.size(), first + blockRows);
+                std::map<std::string, ColumnAccumulator> columns;
+                for (std::size_t index = first; index < last; ++index)
+                {
+                    for (auto it = rows[index].begin(); it != rows[index].end(); ++it)
+                    {
+                        Track(columns[it.key()], it.value());
+                    }
+                }
+
+                Zone zone;
+                zone.rows = last - first;
+                zone.begin = offsets.starts[first];
+                zone.end = last < rows.size() ? offsets.starts[last] : offsets.end;
+                for (auto& [name, column] : columns)
+                {
+                    if (column.longText)
+                    {
+                        column.zone.minText.reset();
+                        column.zone.maxText.reset();
+                    }
+                    zone.columns.emplace(name, std::move(column.zone));
+                }
+                for (const auto& name : schema.bloomColumns)
+                {
+                    const auto column = zone.columns.find(name);
+                    if (column != zone.columns.end())
+                    {
+                        column->second.bloom = BuildBloom(rows, first, last, name, schema.bloomFalsePositiveRate);
+                    }
+                }
+                zoneMap.zones.push_back(std::move(zone));
+            }
+            return zoneMap;
+        }
+
+        void WriteZoneMap(const std::string& path, const ZoneMap& zoneMap, bool sync)
+        {
+            std::string blooms;
+            nlohmann::json zones = nlohmann::json::array();
+            for (const Zone& zone : zoneMap.zones)
+            {
+                nlohmann::json columns = nlohmann::json::object();
+                for (const auto& [name, column] : zone.columns)
+                {
+                    columns[name] = ColumnZoneToJson(column, blooms);
+                }
+                zones.push_back({{"rows", zone.rows}, {"begin", zone.begin}, {"end", zone.end}, {"columns", std::move(columns)}});
+            }
+            const nlohmann::json document = {{"inode", zoneMap.inode}, {"end", zoneMap.end}, {"zones", std::move(zones)}};
+            WriteFileAtomically(path, document.dump() + "\n" + blooms, sync);
+        }
+
+        std::optional<ZoneMap> LoadZoneMap(const std::string& dbPath, const std::string& tableName)
+        {
+            const std::optional<FileStamp> tableStamp = StatFile(TableFilePath(dbPath, tableName));
+            std::ifstream file(ZoneMapFilePath(dbPath, tableName), std::ios::binary);
+            if (!tableStamp.has_value() || !file.is_open())
+            {
+                return std::nullopt;
+            }
+
+            // The sidecar is derived data, so one that cannot be read is ignored.
+            const std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+            const std::size_t newline = std::min(data.find('\n'), data.size());
+            const std::string_view blooms = std::string_view(data).substr(std::min(newline + 1, data.size()));
+            const nlohmann::json document = nlohmann::json::parse(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(newline), nullptr, false);
+            try
+            {
+                ZoneMap zoneMap;
+                zoneMap.inode = document.at("inode").get<std::uint64_t>();
+                zoneMap.end = document.at("end").get<std::uint64_t>();
+                if (zoneMap.inode != tableStamp->inode || zoneMap.end > tableStamp->size)
+                {
+                    return std::nullopt;
+                }
+                for (const auto& entry : document.at("zones"))
+                {
+                    Zone zone;
+                    zone.rows = entry.at("rows").get<std::uint64_t>();
+                    zone.begin = entry.at("begin").get<std::uint64_t>();
+                    zone.end = entry.at("end").get<std::uint64_t>();
+                    for (const auto& [name, column] : entry.at("columns").items())
+                    {
+                        zone.columns.emplace(name, ColumnZoneFromJson(column, blooms));
+                    }
+                    zoneMap.zones.push_back(std::move(zone));
+                }
+                return zoneMap;
+            }
+            catch (const nlohmann::json::exception&)
+            {
+                return std::nullopt;
+            }
+            catch (const JsonDbException&)
+            {
+                return std::nullopt;
+            }
+        }
+
+        bool ZoneMayMatch(const PredicateNode& node, const Zone& zone)
+        {
+            switch (node.kind)
+            {
+            case PredicateNode::Kind::AND:
+                return std::all_of(node.children.begin(), node.children.end(), [&](const auto& child) { return ZoneMayMatch(*child, zone); });
+            case PredicateNode::Kind::OR:
+                return std::any_of(node.children.begin(), node.children.end(), [&](const auto& child) { return ZoneMayMatch(*child, zone); });
+            case PredicateNode::Kind::NOT:
+                return true;
+            case PredicateNode::Kind::COMPARE:
+                break;
+            }
+
+            const auto column = zone.columns.find(node.column);
+            return column == zone.columns.end() || column->second.present < zone.rows || CompareMayMatch(node, column->second);
+        }
+    }
+}
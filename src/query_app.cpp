@@ -17,6 +17,9 @@ struct CliOptions
     std::string backend;
     std::string dbPath;
     std::string executeSql;
+    std::size_t threads = 1;
+    bool pretty = false;
+    sql::jsondb::SyncMode sync = sql::jsondb::SyncMode::NONE;
 };
 
 std::string Trim(const std::string& value)
@@ -46,8 +49,11 @@ std::string ToLowerCopy(const std::string& value)
 void PrintUsage(std::ostream& stream)
 {
     stream << "Usage:\n"
-           << "  app --backend <json|sqlite> --db <path> --execute \"<sql>\"\n"
-           << "  app --backend <json|sqlite> --db <path>\n";
+           << "  app --backend <json|sqlite> --db <path> [--threads <n>] [--pretty] [--sync <mode>] --execute \"<sql>\"\n"
+           << "  app --backend <json|sqlite> --db <path> [--threads <n>] [--pretty] [--sync <mode>]\n"
+           << "  --threads splits json full scans across n threads; 0 uses every core.\n"
+           << "  --pretty writes json tables indented instead of one row per line.\n"
+           << "  --sync none|commit|always sets when json writes are fsynced; the default is none.\n";
 }
 
 bool ParseArgs(const std::vector<std::string>& args, CliOptions& options, std::ostream& err)
@@ -67,6 +73,41 @@ bool ParseArgs(const std::vector<std::string>& args, CliOptions& options, std::o
         {
             options.executeSql = args[++index];
         }
+        else if (arg == "--threads" && index + 1 < args.size())
+        {
+            const std::string& value = args[++index];
+            if (value.empty() || value.size() > 4 || value.find_first_not_of("0123456789") != std::string::npos)
+            {
+                err << "Invalid thread count: " << value << '\n';
+                return false;
+            }
+            options.threads = static_cast<std::size_t>(std::stoul(value));
+        }
+        else if (arg == "--pretty")
+        {
+            options.pretty = true;
+        }
+        else if (arg == "--sync" && index + 1 < args.size())
+        {
+            const std::string value = ToLowerCopy(args[++index]);
+            if (value == "none")
+            {
+                options.sync = sql::jsondb::SyncMode::NONE;
+            }
+            else if (value == "commit")
+            {
+                options.sync = sql::jsondb::SyncMode::COMMIT;
+            }
+            else if (value == "always")
+            {
+                options.sync = sql::jsondb::SyncMode::ALWAYS;
+            }
+            else
+            {
+                err << "Invalid sync mode: " << args[index] << '\n';
+                return false;
+            }
+        }
         else
         {
             err << "Unknown or incomplete argument: " << arg << '\n';
@@ -99,6 +140,18 @@ SqlType ParseSqlOperation(const std::string& sql)
     return parsed == nullptr ? SqlType::UNKNOWN : parsed->getOperationType();
 }
 
+SqlStatement ParseJsonStatement(const std::string& sql)
+{
+    try
+    {
+        return SqlAstParser().parse(sql);
+    }
+    catch (const SqlSyntaxError& ex)
+    {
+        throw sql::jsondb::JsonDbException(ex.what());
+    }
+}
+
 template <typename Metadata, typename Getter>
 void RenderRows(Metadata metadata, Getter getter, std::ostream& out)
 {
@@ -228,29 +281,44 @@ void RenderResultSet(sql::sqlite::ResultSet& resultSet, std::ostream& out)
 
 int ExecuteJsonSql(const CliOptions& options, const std::string& sql, std::ostream& out)
 {
+    const SqlStatement parsed = ParseJsonStatement(sql);
     auto connection = sql::jsondb::Driver::getInstance().connect(options.dbPath);
+    connection->setScanThreads(options.threads);
+    connection->setTableLayout(options.pretty ? sql::jsondb::JsonLayout::PRETTY : sql::jsondb::JsonLayout::COMPACT);
+    connection->setSyncMode(options.sync);
     auto statement = connection->createStatement();
-    switch (ParseSqlOperation(sql))
+    switch (parsed.type)
     {
     case SqlType::SELECT:
     {
-        auto resultSet = statement->executeQuery(sql);
+        auto resultSet = statement->executeQuery(parsed.as<SqlSelectStatement>());
         RenderResultSet(*resultSet, out);
         return 0;
     }
     case SqlType::CREATE:
-        if (!statement->executeCreate(sql))
+        if (parsed.is<SqlCreateIndexStatement>())
+        {
+            out << (statement->executeCreateIndex(parsed.as<SqlCreateIndexStatement>()) ? "OK\n" : "Index already exists.\n");
+            return 0;
+        }
+        if (!statement->executeCreate(parsed.as<SqlCreateTableStatement>()))
         {
             out << "Table already exists.\n";
             return 0;
         }
         out << "OK\n";
         return 0;
+    case SqlType::ALTER:
+        out << (statement->executeAlter(parsed.as<SqlAlterTableStatement>()) ? "OK\n" : "Table already uses that engine.\n");
+        return 0;
+    case SqlType::VACUUM:
+        out << "Reclaimed rows: " << statement->executeVacuum(parsed.as<SqlVacuumStatement>()) << '\n';
+        return 0;
     case SqlType::INSERT:
     case SqlType::UPDATE:
     case SqlType::DELETE:
     {
-        const size_t affectedRows = statement->executeUpdate(sql);
+        const size_t affectedRows = statement->executeUpdate(parsed);
         out << "Affected rows: " << affectedRows << '\n';
         return 0;
     }
@@ -272,6 +340,8 @@ int ExecuteSqliteSql(const CliOptions& options, const std::string& sql, std::ost
         return 0;
     }
     case SqlType::CREATE:
+    case SqlType::ALTER:
+    case SqlType::VACUUM:
         statement->execute(sql);
         out << "OK\n";
         return 0;
@@ -3,6 +3,8 @@
 #include <query_app.h>
 
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <sstream>
 
 namespace fs = std::filesystem;
@@ -130,6 +132,67 @@ TEST_F(QueryAppTest, ExecuteModeWorksForSqliteBackend)
     }
 }
 
+TEST_F(QueryAppTest, ThreadsFlagIsValidated)
+{
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--threads", "4", "--execute", "CREATE TABLE users (id INT);"}),
+            0);
+    }
+
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--threads", "0", "--execute", "SELECT id FROM users;"}),
+            0);
+    }
+
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--threads", "-2", "--execute", "SELECT id FROM users;"}),
+            1);
+        EXPECT_NE(redirect.stderrText().find("Invalid thread count"), std::string::npos);
+    }
+}
+
+TEST_F(QueryAppTest, PrettyFlagIndentsJsonTables)
+{
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--execute", "CREATE TABLE users (id INT);"}), 0);
+    }
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--pretty", "--execute", "INSERT INTO users (id) VALUES (1);"}),
+            0);
+    }
+
+    std::ifstream tableFile(tempDir / "users.json");
+    const std::string text((std::istreambuf_iterator<char>(tableFile)), std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("\n    \"id\": 1"), std::string::npos);
+}
+
+TEST_F(QueryAppTest, SyncFlagIsValidated)
+{
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--sync", "always", "--execute", "CREATE TABLE users (id INT);"}),
+            0);
+    }
+
+    {
+        StreamRedirector redirect;
+        EXPECT_EQ(
+            RunQueryApp({"--backend", "json", "--db", tempDir.string(), "--sync", "sometimes", "--execute", "SELECT id FROM users;"}),
+            1);
+        EXPECT_NE(redirect.stderrText().find("Invalid sync mode"), std::string::npos);
+    }
+}
+
 TEST_F(QueryAppTest, InvalidSqlReturnsNonZeroAndPrintsError)
 {
     StreamRedirector redirect;
@@ -1,10 +1,20 @@
 #include <gtest/gtest.h>
 
+#include <core/sql_parser.h>
 #include <database/json_driver.h>
+#include <database/json_predicate.h>
+#include <database/json_simd_parser.h>
+#include <database/json_writer.h>
 #include <json.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <limits>
+#include <random>
+#include <thread>
 
 using namespace sql::jsondb;
 namespace fs = std::filesystem;
@@ -134,6 +144,1760 @@ TEST_F(JsonDbBaseTest, ResultSetMetadataMatchesSelectedColumns)
     EXPECT_EQ(metaData->getColumnType(1), DataType::BOOLEAN);
 }
 
+TEST_F(JsonDbBaseTest, WhereClauseCompilesConjunctionsAndTypedLiterals)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+
+    auto result = stmt->executeQuery("SELECT id FROM user WHERE age >= 25 AND is_active = false AND name != 'Alice';");
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 2);
+    EXPECT_FALSE(result->next());
+
+    const Predicate predicate = Predicate::compile("id = 1 AND name = 'Alice'");
+    EXPECT_EQ(predicate.getReferencedColumns(), std::vector<std::string>({"id", "name"}));
+    EXPECT_TRUE(predicate.matches({{"id", 1}, {"name", "Alice"}}));
+    EXPECT_FALSE(predicate.matches({{"id", 1.5}, {"name", "Alice"}}));
+    EXPECT_THROW(Predicate::compile("id ~ 1"), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, SelectSupportsOrPredicatesOrderByAndLimit)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+    stmt->executeUpdate("INSERT INTO user (id, name, age, is_active) VALUES (3, 'Charlie', 19, true);");
+
+    auto ordered = stmt->executeQuery("SELECT id FROM user WHERE age < 20 OR NOT is_active = true ORDER BY age DESC;");
+    ASSERT_TRUE(ordered->next());
+    EXPECT_EQ(ordered->getInt("id"), 2);
+    ASSERT_TRUE(ordered->next());
+    EXPECT_EQ(ordered->getInt("id"), 3);
+    EXPECT_FALSE(ordered->next());
+
+    auto paged = stmt->executeQuery("SELECT name FROM user ORDER BY name LIMIT 1 OFFSET 1;");
+    ASSERT_TRUE(paged->next());
+    EXPECT_EQ(paged->getString("name"), "Bob");
+    EXPECT_FALSE(paged->next());
+
+    SqlSelectStatement select;
+    select.table.table = "user";
+    select.columns = {"*"};
+    select.limit = 2;
+    auto direct = stmt->executeQuery(select);
+    ASSERT_TRUE(direct->next());
+    ASSERT_TRUE(direct->next());
+    EXPECT_FALSE(direct->next());
+}
+
+TEST_F(JsonDbBaseTest, NonReservedKeywordsAndBacktickedNamesWorkAsColumns)
+{
+    auto stmt = conn->createStatement();
+
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE t (id INT, offset INT, status TEXT, `index` INT, `desc` TEXT, `order` INT);"));
+    EXPECT_EQ(conn->getColumnNames("t"), std::vector<std::string>({"id", "offset", "status", "index", "desc", "order"}));
+    EXPECT_EQ(
+        stmt->executeUpdate(
+            "INSERT INTO t (id, offset, status, index, desc, order) VALUES "
+            "(1, 10, 'new', 3, 'b', 2), (2, 20, 'done', 4, 'a', 1);"),
+        2U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE t SET offset = 15, `status` = 'seen' WHERE index = 3 AND order > 1;"), 1U);
+
+    auto result = stmt->executeQuery("SELECT id, offset, status, desc FROM t WHERE offset < 20 ORDER BY order DESC LIMIT 1;");
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 1);
+    EXPECT_EQ(result->getInt("offset"), 15);
+    EXPECT_EQ(result->getString("status"), "seen");
+    EXPECT_EQ(result->getString("desc"), "b");
+    EXPECT_FALSE(result->next());
+
+    auto ordered = stmt->executeQuery("SELECT id FROM t ORDER BY desc;");
+    ASSERT_TRUE(ordered->next());
+    EXPECT_EQ(ordered->getInt("id"), 2);
+
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE kv (`set` INT, `values` TEXT, `limit` INT, `select` INT);"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO kv (set, values, limit, `select`) VALUES (1, 'x', 5, 7);"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE kv SET set = 2, limit = 6 WHERE values = 'x' AND `select` = 7;"), 1U);
+    const std::vector<nlohmann::json> rows = conn->getTableData("kv");
+    ASSERT_EQ(rows.size(), 1U);
+    EXPECT_EQ(rows[0]["set"].get<int>(), 2);
+    EXPECT_EQ(rows[0]["limit"].get<int>(), 6);
+    EXPECT_THROW(stmt->executeQuery("SELECT select FROM kv;"), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, TableCacheServesRepeatedReadsAndRevalidatesOnChange)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+
+    stmt->executeQuery("SELECT id FROM user;");
+    stmt->executeQuery("SELECT id FROM user;");
+    TableCacheStats stats = conn->getTableCacheStats();
+    EXPECT_EQ(stats.misses, 1U);
+    EXPECT_EQ(stats.hits, 1U);
+    EXPECT_EQ(stats.entries, 1U);
+
+    EXPECT_EQ(stmt->executeUpdate("UPDATE user SET age = 40 WHERE id = 1;"), 1U);
+    auto updated = stmt->executeQuery("SELECT age FROM user WHERE id = 1;");
+    ASSERT_TRUE(updated->next());
+    EXPECT_EQ(updated->getInt("age"), 40);
+    EXPECT_EQ(conn->getTableCacheStats().misses, 1U);
+
+    {
+        std::ofstream tableFile(conn->getTableFilePath("user"), std::ios::trunc);
+        tableFile << nlohmann::json::array({{{"id", 9}, {"name", "External"}, {"age", 1}, {"is_active", true}}});
+    }
+    const std::vector<nlohmann::json> rows = conn->getTableData("user");
+    ASSERT_EQ(rows.size(), 1U);
+    EXPECT_EQ(rows[0]["name"].get<std::string>(), "External");
+}
+
+TEST_F(JsonDbBaseTest, TableCacheEvictsLeastRecentlyUsedTablesOverBudget)
+{
+    CreateSeedTable("first");
+    CreateSeedTable("second");
+
+    conn->getTableSnapshot("first");
+    const std::size_t oneTableBytes = conn->getTableCacheStats().bytes;
+    ASSERT_GT(oneTableBytes, 0U);
+
+    conn->setTableCacheBudget(oneTableBytes + oneTableBytes / 2);
+    conn->getTableSnapshot("second");
+    TableCacheStats stats = conn->getTableCacheStats();
+    EXPECT_EQ(stats.entries, 1U);
+    EXPECT_EQ(stats.evictions, 1U);
+
+    conn->getTableSnapshot("second");
+    EXPECT_EQ(conn->getTableCacheStats().hits, 1U);
+
+    conn->setTableCacheBudget(0);
+    EXPECT_EQ(conn->getTableCacheStats().entries, 0U);
+    EXPECT_EQ(conn->getTableData("first").size(), 2U);
+}
+
+TEST_F(JsonDbBaseTest, AppendInsertModeWritesDeltaSegmentMergedOnRead)
+{
+    CreateSeedTable("user");
+    conn->setInsertMode(InsertMode::APPEND);
+    auto stmt = conn->createStatement();
+    const auto baseSize = fs::file_size(conn->getTableFilePath("user"));
+
+    ASSERT_EQ(conn->getTableData("user").size(), 2U);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user (id, name, age, is_active) VALUES (3, 'Charlie', 32, true);"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (4, 'Dana', 28, false), (5, 'Eve', 22, true);"), 2U);
+
+    EXPECT_EQ(fs::file_size(conn->getTableFilePath("user")), baseSize);
+    ASSERT_TRUE(fs::exists(conn->getDeltaFilePath("user")));
+    auto result = stmt->executeQuery("SELECT name FROM user WHERE id >= 3;");
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getString("name"), "Charlie");
+    ASSERT_TRUE(result->next());
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getString("name"), "Eve");
+    EXPECT_FALSE(result->next());
+
+    {
+        std::ofstream torn(conn->getDeltaFilePath("user"), std::ios::app | std::ios::binary);
+        torn << R"({"id": 6, "na)";
+    }
+    EXPECT_EQ(conn->getTableData("user").size(), 5U);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (6, 'Finn', 40, true);"), 1U);
+    EXPECT_EQ(conn->getTableData("user").size(), 6U);
+
+    // Deletes leave the files alone and mark the row dead; VACUUM folds both in.
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE id = 1;"), 1U);
+    EXPECT_TRUE(fs::exists(conn->getDeltaFilePath("user")));
+    EXPECT_TRUE(fs::exists(TombstoneFilePath(tempDbPath, "user")));
+    EXPECT_EQ(conn->getTableData("user").size(), 5U);
+    EXPECT_TRUE(stmt->execute("VACUUM user;"));
+    EXPECT_FALSE(fs::exists(conn->getDeltaFilePath("user")));
+    const std::vector<nlohmann::json> rows = conn->getTableData("user");
+    ASSERT_EQ(rows.size(), 5U);
+    EXPECT_EQ(rows.back()["name"].get<std::string>(), "Finn");
+}
+
+TEST_F(JsonDbBaseTest, AppendInsertModeCompactsLargeDeltaSegments)
+{
+    CreateSeedTable("user");
+    conn->setInsertMode(InsertMode::APPEND);
+    conn->setDeltaCompactionBytes(0);
+    auto stmt = conn->createStatement();
+
+    for (int id = 3; id < 40; ++id)
+    {
+        stmt->executeUpdate("INSERT INTO user VALUES (" + std::to_string(id) + ", 'User', 20, true);");
+        const auto deltaSize = fs::exists(conn->getDeltaFilePath("user")) ? fs::file_size(conn->getDeltaFilePath("user")) : 0;
+        EXPECT_LE(deltaSize, fs::file_size(conn->getTableFilePath("user")));
+    }
+    EXPECT_EQ(conn->getTableData("user").size(), 39U);
+}
+
+TEST_F(JsonDbBaseTest, TransactionCommitSyncsLogOnceAndCheckpointsTables)
+{
+    CreateSeedTable("user");
+    const auto baseSize = fs::file_size(conn->getTableFilePath("user"));
+    auto other = driver->connect(tempDbPath, "test_user", "test_pass");
+    auto stmt = conn->createStatement();
+
+    conn->setAutoCommit(false);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (3, 'Charlie', 32, true), (4, 'Dana', 28, false);"), 2U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE user SET age = 31 WHERE name = 'Bob';"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE id = 1;"), 1U);
+
+    EXPECT_EQ(conn->getTableData("user").size(), 3U);
+    EXPECT_EQ(other->getTableData("user").size(), 2U);
+    EXPECT_EQ(fs::file_size(conn->getTableFilePath("user")), baseSize);
+
+    const WalStats before = conn->getWalStats();
+    conn->commit();
+    const WalStats after = conn->getWalStats();
+    EXPECT_EQ(after.commits, before.commits + 1);
+    EXPECT_EQ(after.syncs, before.syncs + 1);
+
+    const std::vector<nlohmann::json> visible = other->getTableData("user");
+    ASSERT_EQ(visible.size(), 3U);
+    EXPECT_EQ(visible[0]["age"].get<int>(), 31);
+
+    conn->checkpoint();
+    EXPECT_EQ(conn->getWalStats().pendingTables, 0U);
+    EXPECT_EQ(fs::file_size(conn->getWalFilePath()), 0U);
+    std::ifstream tableFile(conn->getTableFilePath("user"));
+    nlohmann::json onDisk;
+    tableFile >> onDisk;
+    ASSERT_EQ(onDisk.size(), 3U);
+    EXPECT_EQ(onDisk[2]["name"].get<std::string>(), "Dana");
+    other->close();
+}
+
+TEST_F(JsonDbBaseTest, RollbackDiscardsStagedChanges)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+
+    conn->setAutoCommit(false);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE id >= 1;"), 2U);
+    auto staged = stmt->executeQuery("SELECT * FROM user;");
+    EXPECT_FALSE(staged->next());
+
+    conn->rollback();
+    EXPECT_EQ(conn->getTableData("user").size(), 2U);
+    EXPECT_EQ(conn->getWalStats().commits, 0U);
+
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (3, 'Charlie', 32, true);"), 1U);
+    conn->setAutoCommit(true);
+    EXPECT_EQ(conn->getWalStats().commits, 1U);
+    EXPECT_EQ(conn->getTableData("user").size(), 3U);
+}
+
+TEST_F(JsonDbBaseTest, ConcurrentTransactionsOnSameTableConflict)
+{
+    CreateSeedTable("user");
+    auto other = driver->connect(tempDbPath, "test_user", "test_pass");
+    conn->setAutoCommit(false);
+    other->setAutoCommit(false);
+
+    conn->createStatement()->executeUpdate("UPDATE user SET age = 50 WHERE id = 1;");
+    other->createStatement()->executeUpdate("UPDATE user SET age = 60 WHERE id = 1;");
+    conn->commit();
+    EXPECT_THROW(other->commit(), JsonDbException);
+
+    const std::vector<nlohmann::json> rows = other->getTableData("user");
+    EXPECT_EQ(rows[0]["age"].get<int>(), 50);
+    other->close();
+}
+
+TEST_F(JsonDbBaseTest, ReconnectReplaysCommittedLogRecordsAndIgnoresTornTail)
+{
+    CreateSeedTable("user");
+    const std::string walPath = conn->getWalFilePath();
+    conn->close();
+
+    {
+        std::ofstream wal(walPath, std::ios::binary);
+        wal << R"({"lsn":1,"op":"insert","table":"user","rows":[{"id":3,"name":"Charlie","age":32,"is_active":true}]})" << '\n'
+            << R"({"lsn":1,"op":"delete","table":"user","positions":[0]})" << '\n'
+            << R"({"lsn":1,"op":"commit"})" << '\n'
+            << R"({"lsn":2,"op":"delete","table":"user","positions":[0]})" << '\n'
+            << R"({"lsn":2,"op":"comm)";
+    }
+
+    conn = driver->connect(tempDbPath, "test_user", "test_pass");
+    EXPECT_EQ(fs::file_size(walPath), 0U);
+    const std::vector<nlohmann::json> rows = conn->getTableData("user");
+    ASSERT_EQ(rows.size(), 2U);
+    EXPECT_EQ(rows[0]["name"].get<std::string>(), "Bob");
+    EXPECT_EQ(rows[1]["name"].get<std::string>(), "Charlie");
+}
+
+TEST_F(JsonDbBaseTest, ConcurrentWalWritersShareGroupCommits)
+{
+    CreateSeedTable("user");
+    constexpr int kThreads = 4;
+    constexpr int kInsertsPerThread = 25;
+
+    // Holding the log's write lock stalls the first leader, so the other
+    // writers' first commits are queued behind it and go out as one group.
+    std::unique_lock<std::mutex> leaderHeld = conn->lockForDirectWrite("user");
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < kThreads; ++thread)
+    {
+        writers.emplace_back([this, thread]() {
+            auto writer = driver->connect(tempDbPath, "test_user", "test_pass");
+            writer->setJournalMode(JournalMode::WAL);
+            auto stmt = writer->createStatement();
+            for (int index = 0; index < kInsertsPerThread; ++index)
+            {
+                const int id = 100 + thread * kInsertsPerThread + index;
+                stmt->executeUpdate("INSERT INTO user VALUES (" + std::to_string(id) + ", 'Writer', 20, true);");
+            }
+            stmt->executeUpdate("UPDATE user SET age = 99 WHERE id = 1;");
+        });
+    }
+    while (conn->getWalStats().queuedCommits < static_cast<std::size_t>(kThreads - 1))
+    {
+        std::this_thread::yield();
+    }
+    leaderHeld.unlock();
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    const WalStats stats = conn->getWalStats();
+    EXPECT_EQ(stats.commits, static_cast<std::uint64_t>(kThreads * (kInsertsPerThread + 1)));
+    EXPECT_LT(stats.syncs, stats.commits);
+    EXPECT_GE(stats.maxGroupSize, static_cast<std::size_t>(kThreads - 1));
+    EXPECT_EQ(stats.queuedCommits, 0U);
+    EXPECT_GT(stats.commitsPerSecond, 0.0);
+
+    conn->checkpoint();
+    const std::vector<nlohmann::json> rows = conn->getTableData("user");
+    ASSERT_EQ(rows.size(), static_cast<std::size_t>(2 + kThreads * kInsertsPerThread));
+    EXPECT_EQ(rows[0]["age"].get<int>(), 99);
+}
+
+TEST_F(JsonDbBaseTest, ConcurrentDirectWritersDoNotLoseRows)
+{
+    CreateSeedTable("user");
+    constexpr int kThreads = 4;
+    constexpr int kInsertsPerThread = 10;
+
+    std::vector<std::thread> writers;
+    for (int thread = 0; thread < kThreads; ++thread)
+    {
+        writers.emplace_back([this, thread]() {
+            auto writer = driver->connect(tempDbPath, "test_user", "test_pass");
+            auto stmt = writer->createStatement();
+            for (int index = 0; index < kInsertsPerThread; ++index)
+            {
+                const int id = 100 + thread * kInsertsPerThread + index;
+                stmt->executeUpdate("INSERT INTO user VALUES (" + std::to_string(id) + ", 'Writer', 20, true);");
+            }
+        });
+    }
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    EXPECT_EQ(conn->getTableData("user").size(), static_cast<std::size_t>(2 + kThreads * kInsertsPerThread));
+}
+
+TEST_F(JsonDbBaseTest, HashIndexServesEqualityLookupsAndTracksMutations)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+    const SqlExpressionPtr byName = SqlAstParser().parseExpression("name = 'Bob' AND age > 18");
+
+    EXPECT_EQ(Planner(conn).planScan({"", "user"}, byName).accessPath, AccessPath::FULL_SCAN);
+    EXPECT_TRUE(stmt->executeCreate("CREATE INDEX idx_user_name ON user (name);"));
+    EXPECT_FALSE(stmt->execute("CREATE INDEX idx_user_name ON user (name);"));
+    EXPECT_TRUE(fs::exists(conn->getIndexFilePath("user")));
+    EXPECT_THROW(stmt->executeCreate("CREATE INDEX idx_missing ON user (email);"), JsonDbException);
+    EXPECT_THROW(stmt->executeCreate("CREATE INDEX idx_pair ON user (name, age);"), JsonDbException);
+    EXPECT_EQ(DatabaseMetaData(conn).getTables(), std::vector<std::string>({"user"}));
+
+    const ScanPlan plan = Planner(conn).planScan({"", "user"}, byName);
+    EXPECT_EQ(plan.accessPath, AccessPath::HASH_INDEX);
+    EXPECT_EQ(plan.indexColumn, "name");
+    EXPECT_EQ(plan.indexKey, "Bob");
+
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (3, 'Bob', 12, true), (4, 'Dana', 28, false);"), 2U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE name = 'Alice';"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE user SET name = 'Bob' WHERE id = 4;"), 1U);
+
+    auto result = stmt->executeQuery("SELECT id FROM user WHERE name = 'Bob' AND age > 18;");
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 2);
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 4);
+    EXPECT_FALSE(result->next());
+
+    // A new connection finds the index through the sidecar and builds it
+    // from the rows on disk.
+    auto other = driver->connect(tempDbPath, "test_user", "test_pass");
+    EXPECT_EQ(Planner(other).planScan({"", "user"}, byName).accessPath, AccessPath::HASH_INDEX);
+    auto otherStmt = other->createStatement();
+    auto reopened = otherStmt->executeQuery("SELECT id, age FROM user WHERE name = 'Bob';");
+    EXPECT_EQ(otherStmt->getLastAccessPath(), AccessPath::HASH_INDEX);
+    for (const auto& [id, age] : std::vector<std::pair<int, int>>{{2, 30}, {3, 12}, {4, 28}})
+    {
+        ASSERT_TRUE(reopened->next());
+        EXPECT_EQ(reopened->getInt("id"), id);
+        EXPECT_EQ(reopened->getInt("age"), age);
+    }
+    EXPECT_FALSE(reopened->next());
+    auto fresh = otherStmt->executeQuery("SELECT id FROM user WHERE name = 'Dana';");
+    EXPECT_EQ(otherStmt->getLastAccessPath(), AccessPath::HASH_INDEX);
+    EXPECT_FALSE(fresh->next());
+    EXPECT_EQ(otherStmt->executeUpdate("UPDATE user SET age = 40 WHERE name = 'Bob';"), 3U);
+    EXPECT_EQ(otherStmt->getLastAccessPath(), AccessPath::HASH_INDEX);
+    other->close();
+
+    conn->setAutoCommit(false);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE id = 2;"), 1U);
+    auto staged = stmt->executeQuery("SELECT id, age FROM user WHERE name = 'Bob';");
+    ASSERT_TRUE(staged->next());
+    EXPECT_EQ(staged->getInt("id"), 3);
+    EXPECT_EQ(staged->getInt("age"), 40);
+    conn->rollback();
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE name = 'Bob';"), 3U);
+    conn->commit();
+    EXPECT_TRUE(conn->getTableData("user").empty());
+}
+
+TEST_F(JsonDbBaseTest, BTreeIndexServesRangesAndOrderedScans)
+{
+    CreateSeedTable("user");
+    auto stmt = conn->createStatement();
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (3, 'Charlie', 30, true), (4, 'Dana', 18, false), (5, 'Eve', 41, true);"), 3U);
+    EXPECT_TRUE(stmt->executeCreate("CREATE INDEX idx_user_age ON user (age) USING BTREE;"));
+
+    const ScanPlan range = Planner(conn).planScan({"", "user"}, SqlAstParser().parseExpression("age >= 20 AND age < 41 AND is_active = false"));
+    EXPECT_EQ(range.accessPath, AccessPath::BTREE_RANGE);
+    ASSERT_TRUE(range.lowerBound.has_value() && range.upperBound.has_value());
+    EXPECT_DOUBLE_EQ(range.lowerBound->value.get<double>(), 20.0);
+    EXPECT_FALSE(range.upperBound->inclusive);
+    EXPECT_EQ(Planner(conn).planScan({"", "user"}, SqlAstParser().parseExpression("name = 'Bob'")).accessPath, AccessPath::FULL_SCAN);
+
+    auto result = stmt->executeQuery("SELECT id FROM user WHERE age > 20 AND age <= 30;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 1);
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 2);
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 3);
+    EXPECT_FALSE(result->next());
+
+    auto ordered = stmt->executeQuery("SELECT id FROM user ORDER BY age DESC LIMIT 3;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    for (const int expected : {5, 2, 3})
+    {
+        ASSERT_TRUE(ordered->next());
+        EXPECT_EQ(ordered->getInt("id"), expected);
+    }
+    EXPECT_FALSE(ordered->next());
+
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM user WHERE age < 26;"), 2U);
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE user SET age = 19 WHERE id = 5;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO user VALUES (6, 'Finn', 'unknown', true);"), 1U);
+
+    auto remaining = stmt->executeQuery("SELECT id FROM user WHERE age < 35 ORDER BY age;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    for (const int expected : {5, 2, 3})
+    {
+        ASSERT_TRUE(remaining->next());
+        EXPECT_EQ(remaining->getInt("id"), expected);
+    }
+    EXPECT_FALSE(remaining->next());
+
+    auto mixed = stmt->executeQuery("SELECT id FROM user ORDER BY age LIMIT 1 OFFSET 3;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    ASSERT_TRUE(mixed->next());
+    EXPECT_EQ(mixed->getInt("id"), 6);
+}
+
+TEST_F(JsonDbBaseTest, BTreeIndexServesIsoDatetimeRanges)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE events (id INT, created_at TEXT);"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO events VALUES (1, '2024-03-05T10:00:00Z'), (2, '2023-12-31T23:59:59Z'), "
+                                  "(3, '2024-01-01T00:00:00Z'), (4, '2024-01-01T00:00:00Z'), (5, '2023-06-01T08:30:00Z');"),
+              5U);
+    EXPECT_TRUE(stmt->executeCreate("CREATE INDEX idx_events_created ON events (created_at) USING BTREE;"));
+
+    const ScanPlan range = Planner(conn).planScan(
+        {"", "events"}, SqlAstParser().parseExpression("created_at >= '2024-01-01' AND created_at < '2024-02-01'"));
+    EXPECT_EQ(range.accessPath, AccessPath::BTREE_RANGE);
+    ASSERT_TRUE(range.lowerBound.has_value() && range.upperBound.has_value());
+    EXPECT_EQ(range.lowerBound->value, "2024-01-01");
+    EXPECT_FALSE(range.upperBound->inclusive);
+
+    auto result = stmt->executeQuery("SELECT id FROM events WHERE created_at >= '2024-01-01' ORDER BY created_at;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    for (const int expected : {3, 4, 1})
+    {
+        ASSERT_TRUE(result->next());
+        EXPECT_EQ(result->getInt("id"), expected);
+    }
+    EXPECT_FALSE(result->next());
+
+    auto latest = stmt->executeQuery("SELECT id FROM events WHERE created_at < '2024-01-01' ORDER BY created_at DESC LIMIT 1;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    ASSERT_TRUE(latest->next());
+    EXPECT_EQ(latest->getInt("id"), 2);
+    EXPECT_FALSE(latest->next());
+
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM events WHERE created_at < '2024-01-01';"), 2U);
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO events VALUES (6, '2024-01-15T12:00:00Z');"), 1U);
+
+    auto january = stmt->executeQuery(
+        "SELECT id FROM events WHERE created_at >= '2024-01-01' AND created_at < '2024-02-01' ORDER BY created_at DESC;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::BTREE_RANGE);
+    for (const int expected : {6, 3, 4})
+    {
+        ASSERT_TRUE(january->next());
+        EXPECT_EQ(january->getInt("id"), expected);
+    }
+    EXPECT_FALSE(january->next());
+}
+
+TEST(BTreeIndexTest, MatchesSortedReferenceThroughSplitsAndDeletes)
+{
+    TableRows rows;
+    for (int index = 0; index < 53000; ++index)
+    {
+        rows.push_back({{"v", (index * 7919) % 1000}});
+    }
+    BTreeIndex index("v", rows);
+    EXPECT_EQ(index.size(), rows.size());
+    EXPECT_EQ(index.getHeight(), 3U);
+
+    std::vector<int> values;
+    for (const auto& row : rows)
+    {
+        values.push_back(row["v"].get<int>());
+    }
+    for (int step = 0; step < 6000; ++step)
+    {
+        const int value = (step * 104729) % 1000;
+        index.add({{"v", value}}, values.size());
+        values.push_back(value);
+    }
+    std::vector<std::size_t> deleted;
+    for (std::size_t position = 0; position < values.size(); position += 5)
+    {
+        index.remove({{"v", values[position]}}, position);
+        deleted.push_back(position);
+    }
+    index.removePositions(deleted);
+    std::vector<int> kept;
+    for (std::size_t position = 0; position < values.size(); ++position)
+    {
+        if (position % 5 != 0)
+        {
+            kept.push_back(values[position]);
+        }
+    }
+    ASSERT_EQ(index.size(), kept.size());
+
+    const auto expectRange = [&](std::optional<BTreeBound> lower, std::optional<BTreeBound> upper, bool descending) {
+        std::vector<std::pair<int, std::size_t>> expected;
+        for (std::size_t position = 0; position < kept.size(); ++position)
+        {
+            const double value = kept[position];
+            const bool aboveLower = !lower || value > lower->value.get<double>() || (lower->inclusive && value == lower->value.get<double>());
+            const bool belowUpper = !upper || value < upper->value.get<double>() || (upper->inclusive && value == upper->value.get<double>());
+            if (aboveLower && belowUpper)
+            {
+                expected.emplace_back(descending ? -kept[position] : kept[position], position);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<std::size_t> actual;
+        index.scan(lower, upper, descending, [&](std::size_t position) {
+            actual.push_back(position);
+            return true;
+        });
+        ASSERT_EQ(actual.size(), expected.size());
+        for (std::size_t offset = 0; offset < actual.size(); ++offset)
+        {
+            ASSERT_EQ(actual[offset], expected[offset].second);
+        }
+    };
+
+    expectRange(std::nullopt, std::nullopt, false);
+    expectRange(std::nullopt, std::nullopt, true);
+    expectRange(BTreeBound{250, true}, BTreeBound{260, false}, false);
+    expectRange(BTreeBound{250, false}, BTreeBound{260, true}, true);
+    expectRange(BTreeBound{999, true}, std::nullopt, false);
+    expectRange(std::nullopt, BTreeBound{0, true}, true);
+    expectRange(BTreeBound{500, false}, BTreeBound{500, false}, false);
+}
+
+TEST_F(JsonDbBaseTest, PrimaryKeyRejectsDuplicatesAndServesKeyLookups)
+{
+    CreateSeedTable("user");
+    EXPECT_TRUE(conn->getPrimaryKey("user").empty());
+
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE account (id INT PRIMARY KEY, name TEXT, balance INT);"));
+    EXPECT_EQ(conn->getPrimaryKey("account"), std::vector<std::string>({"id"}));
+    EXPECT_EQ(conn->getColumnNames("account"), std::vector<std::string>({"id", "name", "balance"}));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO account VALUES (1, 'Ann', 10), (2, 'Ben', 20), (3, 'Cid', 30);"), 3U);
+
+    try
+    {
+        stmt->executeUpdate("INSERT INTO account VALUES (4, 'Dee', 40), (2, 'Bob', 0);");
+        FAIL() << "duplicate key accepted";
+    }
+    catch (const JsonDbException& ex)
+    {
+        EXPECT_STREQ(ex.what(), "Duplicate entry '2' for key 'PRIMARY'");
+    }
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO account VALUES (5, 'Eve', 1), (5, 'Eva', 2);"), JsonDbException);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO account (name, balance) VALUES ('Nobody', 0);"), JsonDbException);
+    EXPECT_EQ(conn->getTableData("account").size(), 3U);
+
+    EXPECT_EQ(Planner(conn).planScan({"", "account"}, SqlAstParser().parseExpression("id = 2 AND balance > 0")).accessPath, AccessPath::PRIMARY_KEY);
+    auto byKey = stmt->executeQuery("SELECT name FROM account WHERE id = 2;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::PRIMARY_KEY);
+    ASSERT_TRUE(byKey->next());
+    EXPECT_EQ(byKey->getString("name"), "Ben");
+    EXPECT_FALSE(byKey->next());
+
+    EXPECT_THROW(stmt->executeUpdate("UPDATE account SET id = 3 WHERE id = 1;"), JsonDbException);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE account SET id = 10 WHERE id = 1;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM account WHERE id = 2;"), 1U);
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::PRIMARY_KEY);
+    EXPECT_FALSE(stmt->executeQuery("SELECT * FROM account WHERE id = 1;")->next());
+    auto shifted = stmt->executeQuery("SELECT name FROM account WHERE id = 3;");
+    ASSERT_TRUE(shifted->next());
+    EXPECT_EQ(shifted->getString("name"), "Cid");
+
+    EXPECT_EQ(stmt->executeUpdate("REPLACE INTO account VALUES (3, 'Cat', 35), (11, 'Kim', 1), (11, 'Kit', 2);"), 3U);
+    const std::vector<nlohmann::json> rows = conn->getTableData("account");
+    ASSERT_EQ(rows.size(), 3U);
+    EXPECT_EQ(rows[1]["name"].get<std::string>(), "Cat");
+    EXPECT_EQ(rows[2]["name"].get<std::string>(), "Kit");
+
+    conn->setInsertMode(InsertMode::APPEND);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO account VALUES (12, 'Lee', 0);"), 1U);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO account VALUES (12, 'Lou', 0);"), JsonDbException);
+
+    conn->setJournalMode(JournalMode::WAL);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO account VALUES (10, 'Ann', 0);"), JsonDbException);
+    conn->setAutoCommit(false);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO account VALUES (13, 'Max', 0);"), 1U);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO account VALUES (13, 'Mia', 0);"), JsonDbException);
+    conn->commit();
+    EXPECT_EQ(conn->getTableData("account").size(), 5U);
+
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE kv (bucket INT, name TEXT, value INT, PRIMARY KEY (bucket, name));"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO kv VALUES (1, 'a', 1), (1, 'b', 2), (2, 'a', 3);"), 3U);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO kv VALUES (1, 'b', 4);"), JsonDbException);
+    auto composite = stmt->executeQuery("SELECT value FROM kv WHERE name = 'a' AND bucket = 2;");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::PRIMARY_KEY);
+    ASSERT_TRUE(composite->next());
+    EXPECT_EQ(composite->getInt("value"), 3);
+    EXPECT_THROW(stmt->executeCreate("CREATE TABLE bad (id INT, PRIMARY KEY (missing));"), JsonDbException);
+    // Integer keys past 2^53 share a double but stay distinct keys.
+    EXPECT_EQ(IndexKey(1), IndexKey(1.0));
+    EXPECT_EQ(IndexKey(9007199254740992.0), IndexKey(9007199254740992));
+    EXPECT_NE(IndexKey(9007199254740992), IndexKey(9007199254740993));
+    EXPECT_NE(IndexKey(18446744073709551615ULL), IndexKey(18446744073709551614ULL));
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE big (id BIGINT PRIMARY KEY, ref BIGINT, tag TEXT);"));
+    ASSERT_TRUE(stmt->execute("CREATE INDEX idx_ref ON big (ref);"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO big VALUES (9007199254740992, 9007199254740992, 'a');"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO big VALUES (9007199254740993, 9007199254740993, 'b');"), 1U);
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO big VALUES (9007199254740993, 0, 'c');"), JsonDbException);
+    for (const std::string column : {"id", "ref"})
+    {
+        auto big = stmt->executeQuery("SELECT tag FROM big WHERE " + column + " = 9007199254740993;");
+        EXPECT_EQ(stmt->getLastAccessPath(), column == "id" ? AccessPath::PRIMARY_KEY : AccessPath::HASH_INDEX);
+        ASSERT_TRUE(big->next());
+        EXPECT_EQ(big->getString("tag"), "b");
+        EXPECT_FALSE(big->next());
+    }
+    auto scanned = stmt->executeQuery("SELECT tag FROM big WHERE tag <> 'x' AND id < 9007199254740993;");
+    ASSERT_TRUE(scanned->next());
+    EXPECT_EQ(scanned->getString("tag"), "a");
+    EXPECT_FALSE(scanned->next());
+}
+
+TEST_F(JsonDbBaseTest, StreamingScanFiltersTablesLargerThanTheCache)
+{
+    const std::string tablePath = conn->getTableFilePath("user");
+    std::ofstream tableFile(tablePath);
+    tableFile << R"([{"id": 1, "tags": ["a", {"deep": [1, 2]}], "name": "Alice", "age": 25},
+                    {"id": 2, "name": "Bob", "age": 30, "tags": []},
+                    {"id": 3, "name": "Carol", "age": 41, "tags": [null, 1.5]}])";
+    tableFile.close();
+    conn->setInsertMode(InsertMode::APPEND);
+    auto stmt = conn->createStatement();
+    ASSERT_EQ(stmt->executeUpdate("INSERT INTO user (id, name, age) VALUES (4, 'Dana', 35), (5, 'Eve', 22);"), 2U);
+
+    const auto collect = [&](const std::string& sql) {
+        std::vector<std::string> names;
+        auto result = stmt->executeQuery(sql);
+        while (result->next())
+        {
+            names.push_back(result->getString("name"));
+        }
+        return names;
+    };
+    const std::vector<std::string> queries = {
+        "SELECT name FROM user WHERE age > 24;",
+        "SELECT name FROM user WHERE age > 24 ORDER BY age DESC LIMIT 2 OFFSET 1;",
+        "SELECT name FROM user LIMIT 2;",
+        "SELECT * FROM user WHERE id = 1;"};
+    std::vector<std::vector<std::string>> cached;
+    for (const auto& query : queries)
+    {
+        cached.push_back(collect(query));
+    }
+
+    conn->setTableCacheBudget(0);
+    EXPECT_TRUE(conn->shouldStreamTable("user"));
+    for (std::size_t index = 0; index < queries.size(); ++index)
+    {
+        EXPECT_EQ(collect(queries[index]), cached[index]) << queries[index];
+    }
+    EXPECT_EQ(collect(queries[1]), (std::vector<std::string>{"Dana", "Bob"}));
+    EXPECT_EQ(conn->getTableCacheStats().entries, 0U);
+
+    TableRows streamed;
+    EXPECT_TRUE(conn->streamTable("user", [&](nlohmann::json& row) {
+        streamed.push_back(std::move(row));
+        return true;
+    }));
+    EXPECT_EQ(streamed, conn->getTableData("user"));
+
+    TableRows narrow;
+    conn->streamTable(
+        "user",
+        [&](nlohmann::json& row) {
+            narrow.push_back(std::move(row));
+            return true;
+        },
+        {"name", "id"});
+    ASSERT_EQ(narrow.size(), 5U);
+    EXPECT_EQ(narrow.front(), (nlohmann::json{{"id", 1}, {"name", "Alice"}}));
+    EXPECT_EQ(narrow.back(), (nlohmann::json{{"id", 5}, {"name", "Eve"}}));
+    EXPECT_THROW(stmt->executeQuery("SELECT missing FROM user WHERE id = 1;"), JsonDbException);
+
+    // LSM tables read their merged rows from the tree, never the manifest.
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE kv (id INT PRIMARY KEY, name TEXT) ENGINE = LSM;"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO kv VALUES (2, 'Bo'), (1, 'Al'), (3, 'Cy');"), 3U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM kv WHERE id = 2;"), 1U);
+    EXPECT_FALSE(conn->shouldStreamTable("kv"));
+    EXPECT_EQ(collect("SELECT name FROM kv WHERE id > 0;"), (std::vector<std::string>{"Al", "Cy"}));
+    EXPECT_EQ(collect("SELECT name FROM kv LIMIT 1;"), (std::vector<std::string>{"Al"}));
+    TableRows lsmRows;
+    EXPECT_TRUE(conn->streamTable(
+        "kv",
+        [&](nlohmann::json& row) {
+            lsmRows.push_back(std::move(row));
+            return true;
+        },
+        {"name"}));
+    EXPECT_EQ(lsmRows, (TableRows{{{"name", "Al"}}, {{"name", "Cy"}}}));
+
+    std::ofstream brokenFile(tablePath);
+    brokenFile << R"([{"id": 1, "name": "Alice"}, {"id": )";
+    brokenFile.close();
+    EXPECT_THROW(stmt->executeQuery("SELECT name FROM user;"), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, ColumnarTablesMatchJsonTablesThroughTheSameApi)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE col (id INT PRIMARY KEY, name VARCHAR(20), score FLOAT, ok BOOLEAN, misc TEXT) ENGINE = COLUMNAR;"));
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE doc (id INT PRIMARY KEY, name VARCHAR(20), score FLOAT, ok BOOLEAN, misc TEXT);"));
+    EXPECT_EQ(DetectTableFormat(conn->getTableFilePath("col")), TableFormat::COLUMNAR);
+    EXPECT_EQ(DetectTableFormat(conn->getTableFilePath("doc")), TableFormat::JSON);
+    EXPECT_THROW(stmt->executeCreate("CREATE TABLE bad (id INT) ENGINE = ROCKS;"), JsonDbException);
+
+    for (const std::string table : {"col", "doc"})
+    {
+        stmt->executeUpdate(
+            "INSERT INTO " + table + " VALUES (1, 'Alice', 2.5, true, 'x'), (2, 'Bob', NULL, false, 7), (3, NULL, -1.0, true, NULL);");
+        stmt->executeUpdate("INSERT INTO " + table + " (id, name) VALUES (4, 'Dana');");
+        stmt->executeUpdate("UPDATE " + table + " SET score = 9.0 WHERE id = 2;");
+        stmt->executeUpdate("DELETE FROM " + table + " WHERE id = 1;");
+    }
+    EXPECT_EQ(DetectTableFormat(conn->getTableFilePath("col")), TableFormat::COLUMNAR);
+    EXPECT_EQ(conn->getTableData("col"), conn->getTableData("doc"));
+
+    const auto ids = [&](const std::string& table, const std::string& where) {
+        std::vector<int> result;
+        auto rows = stmt->executeQuery("SELECT id FROM " + table + " WHERE " + where + ";");
+        while (rows->next())
+        {
+            result.push_back(rows->getInt("id"));
+        }
+        return result;
+    };
+    for (const std::string where :
+         {"id >= 2", "id < 4 AND score > 0", "id = 4 OR NOT ok = true", "name = 'Dana'", "name != 'Dana' AND id < 4", "name = NULL", "id < 4 AND misc = 7"})
+    {
+        EXPECT_EQ(ids("col", where), ids("doc", where)) << where;
+    }
+    EXPECT_EQ(ids("col", "id > 2"), (std::vector<int>{3, 4}));
+    EXPECT_THROW(ids("col", "ok = true"), JsonDbException);
+    EXPECT_THROW(ids("col", "nope = 1"), JsonDbException);
+
+    auto ordered = stmt->executeQuery("SELECT name FROM col WHERE id > 1 ORDER BY id DESC LIMIT 1;");
+    ASSERT_TRUE(ordered->next());
+    EXPECT_EQ(ordered->getString("name"), "Dana");
+    EXPECT_FALSE(ordered->next());
+
+    Statement alter(conn);
+    EXPECT_TRUE(alter.execute("ALTER TABLE doc ENGINE = COLUMNAR;"));
+    EXPECT_FALSE(alter.execute("ALTER TABLE doc ENGINE = COLUMNAR;"));
+    EXPECT_EQ(DetectTableFormat(conn->getTableFilePath("doc")), TableFormat::COLUMNAR);
+    EXPECT_EQ(conn->getTableData("doc"), conn->getTableData("col"));
+    conn->convertTable("col", TableFormat::JSON);
+    EXPECT_EQ(DetectTableFormat(conn->getTableFilePath("col")), TableFormat::JSON);
+    EXPECT_EQ(conn->getTableData("col"), conn->getTableData("doc"));
+    EXPECT_THROW(alter.execute("ALTER TABLE missing ENGINE = JSON;"), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, NdjsonTablesAppendInPlaceAndSeekByRowOffsets)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE events (id INT PRIMARY KEY, kind VARCHAR(20)) ENGINE = NDJSON;"));
+    const std::string tablePath = conn->getTableFilePath("events");
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::NDJSON);
+    EXPECT_TRUE(conn->getTableData("events").empty());
+
+    stmt->executeUpdate("INSERT INTO events VALUES (1, 'a'), (2, 'b'), (3, 'c');");
+    const std::uintmax_t firstSize = std::filesystem::file_size(tablePath);
+    conn->setInsertMode(InsertMode::APPEND);
+    stmt->executeUpdate("INSERT INTO events VALUES (4, 'd'), (5, 'e');");
+    EXPECT_FALSE(std::filesystem::exists(conn->getDeltaFilePath("events")));
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO events VALUES (5, 'dup');"), JsonDbException);
+
+    std::ifstream lines(tablePath);
+    std::string first;
+    std::getline(lines, first);
+    EXPECT_EQ(nlohmann::json::parse(first), (nlohmann::json{{"id", 1}, {"kind", "a"}}));
+    EXPECT_GT(std::filesystem::file_size(tablePath), firstSize);
+
+    const auto kinds = [&](const std::string& sql) {
+        std::vector<std::string> result;
+        auto rows = stmt->executeQuery(sql);
+        while (rows->next())
+        {
+            result.push_back(rows->getString("kind"));
+        }
+        return result;
+    };
+    EXPECT_EQ(kinds("SELECT kind FROM events LIMIT 2 OFFSET 2;"), (std::vector<std::string>{"c", "d"}));
+    EXPECT_EQ(kinds("SELECT * FROM events LIMIT 10 OFFSET 3;"), (std::vector<std::string>{"d", "e"}));
+    EXPECT_TRUE(kinds("SELECT kind FROM events LIMIT 2 OFFSET 9;").empty());
+
+    // The sidecar is rebuilt when it is missing or describes an older file.
+    const std::string offsetsPath = RowOffsetsFilePath(tempDbPath, "events");
+    ASSERT_TRUE(std::filesystem::exists(offsetsPath));
+    EXPECT_EQ(LoadRowOffsets(tempDbPath, "events").starts.size(), 5U);
+    std::filesystem::remove(offsetsPath);
+    EXPECT_EQ(kinds("SELECT kind FROM events LIMIT 1 OFFSET 4;"), (std::vector<std::string>{"e"}));
+    std::ofstream(tablePath, std::ios::app) << "{\"id\": 6, \"kind\": \"f\"}\n{\"id\": 7, \"ki";
+    EXPECT_EQ(kinds("SELECT kind FROM events LIMIT 3 OFFSET 4;"), (std::vector<std::string>{"e", "f"}));
+    EXPECT_EQ(LoadRowOffsets(tempDbPath, "events").starts.size(), 6U);
+
+    stmt->executeUpdate("INSERT INTO events VALUES (7, 'g');");
+    stmt->executeUpdate("UPDATE events SET kind = 'z' WHERE id = 2;");
+    stmt->executeUpdate("DELETE FROM events WHERE id = 1;");
+    EXPECT_EQ(kinds("SELECT kind FROM events WHERE id < 4;"), (std::vector<std::string>{"z", "c"}));
+    EXPECT_EQ(kinds("SELECT kind FROM events LIMIT 2 OFFSET 4;"), (std::vector<std::string>{"f", "g"}));
+    EXPECT_EQ(LoadRowOffsets(tempDbPath, "events").starts.size(), 7U);
+
+    Statement alter(conn);
+    const TableRows before = conn->getTableData("events");
+    EXPECT_TRUE(alter.execute("ALTER TABLE events ENGINE = JSON;"));
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::JSON);
+    EXPECT_FALSE(std::filesystem::exists(offsetsPath));
+    EXPECT_TRUE(alter.execute("ALTER TABLE events ENGINE = NDJSON;"));
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::NDJSON);
+    EXPECT_EQ(conn->getTableData("events"), before);
+}
+
+TEST_F(JsonDbBaseTest, NdjsonKeyMapServesKeysWithoutLoadingTheTable)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE kv (id INT PRIMARY KEY, value TEXT) ENGINE = NDJSON;"));
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO kv VALUES (1, 'a'), (2, 'b'), (3, 'c');"), 3U);
+    const std::string tablePath = conn->getTableFilePath("kv");
+    const std::string keysPath = KeyMapFilePath(tempDbPath, "kv");
+    ASSERT_TRUE(std::filesystem::exists(keysPath));
+
+    auto fresh = driver->connect(tempDbPath, "test_user", "test_pass");
+    auto freshStmt = fresh->createStatement();
+    const auto valueOf = [&](int id) {
+        auto rows = freshStmt->executeQuery("SELECT value FROM kv WHERE id = " + std::to_string(id) + ";");
+        EXPECT_EQ(freshStmt->getLastAccessPath(), AccessPath::PRIMARY_KEY);
+        return rows->next() ? rows->getString("value") : std::string("<none>");
+    };
+    EXPECT_EQ(valueOf(2), "b");
+    EXPECT_EQ(valueOf(9), "<none>");
+    EXPECT_EQ(freshStmt->executeUpdate("INSERT INTO kv VALUES (4, 'd');"), 1U);
+    EXPECT_THROW(freshStmt->executeUpdate("INSERT INTO kv VALUES (2, 'dup');"), JsonDbException);
+    EXPECT_THROW(freshStmt->executeUpdate("INSERT INTO kv VALUES (5, 'e'), (5, 'f');"), JsonDbException);
+    EXPECT_EQ(valueOf(4), "d");
+    EXPECT_EQ(fresh->getTableCacheStats().misses, 0U);
+    EXPECT_EQ(LoadKeyMap(tempDbPath, "kv", {"id"}).rows, 4U);
+
+    // A sidecar that is missing or describes an older file is rebuilt.
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO kv VALUES (4, 'x');"), JsonDbException);
+    std::ofstream(tablePath, std::ios::app) << "{\"id\": 5, \"value\": \"e\"}\n";
+    EXPECT_THROW(freshStmt->executeUpdate("INSERT INTO kv VALUES (5, 'x');"), JsonDbException);
+    std::filesystem::remove(keysPath);
+    std::ofstream(tablePath, std::ios::app) << "{\"id\": 6, \"value\": \"f\"}\n";
+    EXPECT_EQ(valueOf(6), "f");
+    EXPECT_TRUE(std::filesystem::exists(keysPath));
+
+    EXPECT_EQ(stmt->executeUpdate("UPDATE kv SET value = 'z' WHERE id = 1;"), 1U);
+    EXPECT_EQ(valueOf(1), "z");
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM kv WHERE id = 2;"), 1U);
+    EXPECT_EQ(valueOf(2), "<none>");
+    EXPECT_EQ(valueOf(3), "c");
+    conn->vacuumTable("kv");
+    EXPECT_EQ(valueOf(5), "e");
+    EXPECT_EQ(LoadKeyMap(tempDbPath, "kv", {"id"}).positions.at(IndexKey(5)), 3U);
+
+    conn->convertTable("kv", TableFormat::JSON);
+    EXPECT_FALSE(std::filesystem::exists(keysPath));
+    EXPECT_EQ(valueOf(3), "c");
+}
+
+TEST_F(JsonDbBaseTest, ParallelScansMatchSequentialScansInOrder)
+{
+    TableRows rows;
+    for (int index = 0; index < 40000; ++index)
+    {
+        rows.push_back({{"id", index}, {"bucket", index % 7}, {"name", "user" + std::to_string(index)}});
+    }
+    WriteFileAtomically(conn->getTableFilePath("big"), SerializeTableRows(rows), false);
+    WriteFileAtomically(conn->getTableFilePath("bigcol"), SerializeColumnarTable(rows, 4096), false);
+
+    auto stmt = conn->createStatement();
+    const auto run = [&](const std::string& sql) {
+        std::vector<std::pair<int, std::string>> result;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            result.emplace_back(resultSet->getInt("id"), resultSet->getString("name"));
+        }
+        return result;
+    };
+
+    for (const std::string table : {"big", "bigcol"})
+    {
+        for (const std::string tail :
+             {" WHERE bucket = 3;", " WHERE bucket > 4 ORDER BY name DESC LIMIT 20 OFFSET 5;", " WHERE id >= 39990 OR id < 3;", ";"})
+        {
+            const std::string sql = "SELECT id, name FROM " + table + tail;
+            conn->setScanThreads(1);
+            const auto sequential = run(sql);
+            conn->setScanThreads(4);
+            EXPECT_EQ(run(sql), sequential) << sql;
+            EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::FULL_SCAN);
+        }
+    }
+    EXPECT_EQ(run("SELECT id, name FROM big WHERE bucket = 3;").size(), 5714U);
+    EXPECT_THROW(run("SELECT id, missing FROM big WHERE bucket = 3;"), JsonDbException);
+    conn->setScanThreads(0);
+    EXPECT_GE(conn->getScanThreads(), 1U);
+}
+
+TEST_F(JsonDbBaseTest, ParallelTableLoadsKeepRowOrder)
+{
+    TableRows rows;
+    for (int index = 0; index < 30000; ++index)
+    {
+        nlohmann::json row = {{"id", index}, {"text", "a \\\"quoted\\\" [value], {" + std::to_string(index) + "}\\"}};
+        if (index % 5 == 0)
+        {
+            row["nested"] = {{"list", {1, "x,y", nlohmann::json::object()}}, {"empty", nlohmann::json::array()}};
+        }
+        rows.push_back(std::move(row));
+    }
+    WriteFileAtomically(conn->getTableFilePath("wide"), SerializeTableRows(rows), false);
+    WriteTableFile(tempDbPath, "lines", rows, TableFormat::NDJSON, SyncMode::NONE);
+
+    conn->setScanThreads(4);
+    EXPECT_EQ(conn->getTableData("wide"), rows);
+    EXPECT_EQ(conn->getTableData("lines"), rows);
+
+    ThreadPool pool(3);
+    EXPECT_EQ(ReadJsonArrayFileParallel(conn->getTableFilePath("wide"), pool), rows);
+    for (const std::string broken : {"[{\"id\": 1},]", "[{\"id\": 1} {\"id\": 2}]", "{\"id\": 1}", "[{\"id\": \"1}]"})
+    {
+        std::ofstream(conn->getTableFilePath("bad")) << broken;
+        EXPECT_ANY_THROW(ReadJsonArrayFileParallel(conn->getTableFilePath("bad"), pool)) << broken;
+    }
+    std::ofstream(conn->getTableFilePath("bad")) << " [ ] ";
+    EXPECT_TRUE(ReadJsonArrayFileParallel(conn->getTableFilePath("bad"), pool).empty());
+}
+
+TEST(ThreadPoolTest, RunsEveryTaskAndRethrowsFailures)
+{
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4U);
+
+    std::vector<int> hits(100, 0);
+    pool.run(hits.size(), [&](std::size_t task) { ++hits[task]; });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 100);
+
+    EXPECT_THROW(
+        pool.run(10, [](std::size_t task) {
+            if (task == 7)
+            {
+                throw JsonDbException("task failed");
+            }
+        }),
+        JsonDbException);
+    pool.run(3, [&](std::size_t task) { ++hits[task]; });
+    EXPECT_EQ(hits[0], 2);
+}
+
+namespace
+{
+bool SameJson(const nlohmann::json& left, const nlohmann::json& right)
+{
+    if (left.type() != right.type() || left != right)
+    {
+        return false;
+    }
+    if (left.is_object())
+    {
+        for (auto it = left.begin(); it != left.end(); ++it)
+        {
+            if (!SameJson(it.value(), right.at(it.key())))
+            {
+                return false;
+            }
+        }
+    }
+    if (left.is_array())
+    {
+        for (std::size_t index = 0; index < left.size(); ++index)
+        {
+            if (!SameJson(left[index], right[index]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The fast parser must build exactly what nlohmann builds, and must decline
+// everything nlohmann rejects.
+void ExpectParsesLikeNlohmann(const std::string& text, JsonKernel kernel)
+{
+    const std::optional<nlohmann::json> fast = FastParseJson(text, kernel);
+    nlohmann::json expected;
+    bool valid = true;
+    try
+    {
+        expected = nlohmann::json::parse(text);
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        valid = false;
+    }
+    ASSERT_EQ(fast.has_value(), valid) << "kernel " << static_cast<int>(kernel) << ": " << text;
+    if (valid)
+    {
+        EXPECT_TRUE(SameJson(*fast, expected)) << "kernel " << static_cast<int>(kernel) << ": " << text;
+    }
+}
+}
+
+TEST(SimdJsonParserTest, MatchesNlohmannOnFixturesAndEdgeCases)
+{
+    std::vector<std::string> documents;
+    for (const std::string directory : {"testdb", "examples/jsondb"})
+    {
+        for (const auto& entry : fs::directory_iterator(fs::path(MYSQLCLIENT_SOURCE_DIR) / directory))
+        {
+            if (entry.path().extension() == ".json")
+            {
+                std::ifstream file(entry.path(), std::ios::binary);
+                documents.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+        }
+    }
+    ASSERT_GE(documents.size(), 3U);
+
+    for (const std::string text :
+         {"[]", " {} ", "\"x\"", "3", "null", "\xEF\xBB\xBF[1]", "{\"a\":1,\"a\":2}", "{\"b\":1,\"a\":[true,false,null]}",
+          "[\"\\ud83d\\ude00\", \"\\u0000\", \"\\/\\b\\f\\n\\r\\t\", \"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\"]",
+          "[-0, 0, -1, 18446744073709551615, 18446744073709551616, -9223372036854775808, -9223372036854775809, 1.5e-3, 1E+2, 2.0]",
+          "", "   ", "[1,]", "[01]", "[1.]", "[.5]", "[-]", "[1e]", "[+1]", "{\"a\" 1}", "{\"a\":1,}", "{1:2}", "[\"\\x\"]",
+          "[\"\\ud800\"]", "[\"\\udc00\"]", "[\"\\ud800\\u0041\"]", "[\"a\x01\"]", "[\"\xC0\xAF\"]", "[\"\xED\xA0\x80\"]",
+          "[\"\xF4\x90\x80\x80\"]", "tru", "truex", "[1 2]", "[\"a\"\"b\"]", "[1e400]", "{\"a\":1}}", "[[]", "\"open",
+          "[1]x", "[1]\f", "\\\"a\\\"", "[true\"x\"]"})
+    {
+        documents.push_back(text);
+    }
+
+    // Random documents stress escapes and strings that straddle 64-byte blocks;
+    // single-byte mutations of them stress the validation.
+    std::mt19937 random(17);
+    const std::string alphabet = "ab\\\"\\\\ ,:{}[]\x01\xC3\xA9";
+    const auto randomString = [&]() {
+        std::string value;
+        const std::size_t length = random() % 90;
+        for (std::size_t index = 0; index < length; ++index)
+        {
+            value += alphabet[random() % alphabet.size()];
+        }
+        return nlohmann::json(value).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    };
+    for (int round = 0; round < 300; ++round)
+    {
+        std::string text = "[";
+        for (int row = 0; row < 4; ++row)
+        {
+            text += (row == 0 ? "{" : ",\n {") + randomString() + ": " + randomString() + ", \"n\": " +
+                    std::to_string(static_cast<int>(random() % 2000) - 1000) + ", \"x\": [1.25e" + std::to_string(random() % 20) +
+                    ", " + (random() % 2 == 0 ? "true" : "null") + "]}";
+        }
+        text += "]";
+        documents.push_back(text);
+
+        const std::string mutations = "\"\\,:{}[] a0-e.\n\x01\xC3";
+        text[random() % text.size()] = mutations[random() % mutations.size()];
+        documents.push_back(text);
+    }
+
+    for (const JsonKernel kernel : AvailableJsonKernels())
+    {
+        for (const auto& text : documents)
+        {
+            ExpectParsesLikeNlohmann(text, kernel);
+        }
+    }
+}
+
+TEST_F(JsonDbBaseTest, CompactTableWriterMatchesDumpAndPrettyLayoutIsOptional)
+{
+    const std::vector<nlohmann::json> values = {
+        nullptr, true, false, 0, -7, std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::uint64_t>::max(),
+        1.0, -0.5, 1e20, 1.5e-7, 0.1, std::numeric_limits<double>::infinity(), "plain", "q\"b\\s/\n\t\x01\x1f",
+        "caf\xC3\xA9", nlohmann::json::array({1, "x", nlohmann::json::object()}),
+        nlohmann::json{{"b", 1}, {"a", {{"nested", nlohmann::json::array()}}}}};
+    for (const auto& value : values)
+    {
+        std::string text;
+        AppendJson(text, value);
+        if (!value.is_number_float())
+        {
+            EXPECT_EQ(text, value.dump());
+        }
+        const nlohmann::json reread = nlohmann::json::parse(text);
+        if (value.is_number_float() && !std::isfinite(value.get<double>()))
+        {
+            EXPECT_TRUE(reread.is_null()) << text;
+        }
+        else
+        {
+            EXPECT_EQ(reread, value) << text;
+            EXPECT_EQ(reread.is_number_float(), value.is_number_float()) << text;
+        }
+    }
+    std::string invalid;
+    EXPECT_THROW(AppendJson(invalid, nlohmann::json("\xC3")), nlohmann::json::type_error);
+
+    CreateSeedTable("users");
+    auto stmt = conn->createStatement();
+    stmt->executeUpdate("INSERT INTO users (id, name, age, is_active) VALUES (10, 'Carol', 2.5, true);");
+    const auto rows = conn->getTableData("users");
+
+    std::ifstream compactFile(conn->getTableFilePath("users"), std::ios::binary);
+    const std::string compact((std::istreambuf_iterator<char>(compactFile)), std::istreambuf_iterator<char>());
+    compactFile.close();
+    EXPECT_EQ(compact.find("  "), std::string::npos);
+    EXPECT_EQ(std::count(compact.begin(), compact.end(), '\n'), static_cast<std::ptrdiff_t>(rows.size() + 1));
+
+    conn->setTableLayout(JsonLayout::PRETTY);
+    stmt->executeUpdate("UPDATE users SET age = 3 WHERE id = 10;");
+    std::ifstream prettyFile(conn->getTableFilePath("users"), std::ios::binary);
+    const std::string pretty((std::istreambuf_iterator<char>(prettyFile)), std::istreambuf_iterator<char>());
+    prettyFile.close();
+    EXPECT_NE(pretty.find("\n    \"age\""), std::string::npos);
+
+    conn->setTableCacheBudget(0);
+    const auto reread = conn->getTableData("users");
+    ASSERT_EQ(reread.size(), rows.size());
+    EXPECT_EQ(reread.back()["name"], "Carol");
+    EXPECT_EQ(reread.back()["age"], 3);
+}
+
+TEST_F(JsonDbBaseTest, TableRewritesAreAtomicForConcurrentReaders)
+{
+    std::vector<nlohmann::json> rows;
+    for (int id = 0; id < 2000; ++id)
+    {
+        rows.push_back({{"id", id}, {"name", "user" + std::to_string(id)}, {"age", id % 90}, {"is_active", true}});
+    }
+    WriteTableFile(tempDbPath, "users", rows, TableFormat::JSON, SyncMode::NONE);
+    WriteTableSchema(SchemaFilePath(tempDbPath, "users"), {.columns = {"id", "name", "age", "is_active"}});
+
+    std::atomic<bool> writing{true};
+    std::atomic<int> reads{0};
+    std::atomic<int> torn{0};
+    std::thread reader([&]() {
+        while (writing || reads == 0)
+        {
+            std::ifstream file(conn->getTableFilePath("users"), std::ios::binary);
+            const nlohmann::json table = nlohmann::json::parse(file, nullptr, false);
+            if (table.is_discarded() || table.size() != rows.size())
+            {
+                ++torn;
+            }
+            ++reads;
+        }
+    });
+
+    auto stmt = conn->createStatement();
+    for (const SyncMode mode : {SyncMode::NONE, SyncMode::COMMIT, SyncMode::ALWAYS})
+    {
+        conn->setSyncMode(mode);
+        for (int round = 0; round < 5; ++round)
+        {
+            stmt->executeUpdate("UPDATE users SET age = " + std::to_string(round) + " WHERE id < 1000;");
+        }
+    }
+    writing = false;
+    reader.join();
+
+    EXPECT_GT(reads.load(), 0);
+    EXPECT_EQ(torn.load(), 0);
+    EXPECT_FALSE(fs::exists(conn->getTableFilePath("users") + ".tmp"));
+
+    conn->setSyncMode(SyncMode::ALWAYS);
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE lines (id INT) ENGINE = NDJSON;"));
+    stmt->executeUpdate("INSERT INTO lines (id) VALUES (1), (2);");
+    EXPECT_TRUE(stmt->executeCreate("CREATE INDEX lines_id ON lines (id);"));
+    EXPECT_EQ(conn->getTableData("lines").size(), 2U);
+    EXPECT_EQ(LoadRowOffsets(tempDbPath, "lines").starts.size(), 2U);
+}
+
+TEST_F(JsonDbBaseTest, DeletesWriteTombstonesUntilVacuumed)
+{
+    std::vector<nlohmann::json> rows;
+    for (int id = 0; id < 20; ++id)
+    {
+        rows.push_back({{"id", id}, {"name", "user" + std::to_string(id)}, {"age", id}, {"is_active", true}});
+    }
+    WriteTableFile(tempDbPath, "users", rows, TableFormat::JSON, SyncMode::NONE);
+    WriteTableSchema(SchemaFilePath(tempDbPath, "users"), {.columns = {"id", "name", "age", "is_active"}});
+    conn->setTombstoneCompactionRatio(0.5);
+    const std::string tablePath = conn->getTableFilePath("users");
+    const std::string tombstonesPath = TombstoneFilePath(tempDbPath, "users");
+    const auto tableSize = fs::file_size(tablePath);
+
+    auto stmt = conn->createStatement();
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM users WHERE id < 3;"), 3U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM users WHERE id = 10;"), 1U);
+    EXPECT_EQ(fs::file_size(tablePath), tableSize);
+    ASSERT_TRUE(fs::exists(tombstonesPath));
+    EXPECT_EQ(LoadTombstones(tempDbPath, "users").deadRows, 4U);
+
+    const auto ids = [&](const std::string& sql) {
+        std::vector<int> result;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            result.push_back(resultSet->getInt("id"));
+        }
+        return result;
+    };
+    const std::vector<int> expected{3, 4, 5, 6, 7, 8, 9, 11};
+    EXPECT_EQ(ids("SELECT id FROM users WHERE id < 12;"), expected);
+    conn->setTableCacheBudget(0);
+    EXPECT_EQ(ids("SELECT id FROM users WHERE id < 12;"), expected);
+    EXPECT_EQ(conn->getTableData("users").size(), 16U);
+
+    // Any rewrite drops the rows it skipped, so the sidecar starts over.
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO users VALUES (20, 'late', 1, true);"), 1U);
+    EXPECT_FALSE(fs::exists(tombstonesPath));
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM users WHERE id = 20 OR id = 11;"), 2U);
+    EXPECT_EQ(LoadTombstones(tempDbPath, "users").deadRows, 2U);
+    EXPECT_EQ(ids("SELECT id FROM users WHERE id > 8;"), (std::vector<int>{9, 12, 13, 14, 15, 16, 17, 18, 19}));
+
+    EXPECT_EQ(stmt->executeVacuum(SqlVacuumStatement{{.database = {}, .table = "users"}}), 2U);
+    EXPECT_FALSE(fs::exists(tombstonesPath));
+    EXPECT_LT(fs::file_size(tablePath), tableSize);
+    EXPECT_EQ(conn->getTableData("users").size(), 15U);
+    EXPECT_EQ(stmt->executeVacuum(SqlVacuumStatement{}), 0U);
+
+    // Crossing the ratio compacts in place of the delete that crossed it.
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM users WHERE id < 9;"), 6U);
+    EXPECT_TRUE(fs::exists(tombstonesPath));
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM users WHERE id < 14;"), 3U);
+    EXPECT_FALSE(fs::exists(tombstonesPath));
+    EXPECT_EQ(ids("SELECT id FROM users;"), (std::vector<int>{14, 15, 16, 17, 18, 19}));
+    EXPECT_THROW(stmt->execute("VACUUM missing;"), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, ColumnarUpdatesPatchFixedWidthValuesInPlace)
+{
+    TableRows rows;
+    for (int id = 0; id < 100; ++id)
+    {
+        rows.push_back({{"id", id}, {"hits", id * 10}, {"score", 0.5 * id}, {"is_active", true}, {"name", "row"}});
+    }
+    WriteTableFile(tempDbPath, "stats", rows, TableFormat::COLUMNAR, SyncMode::NONE);
+    WriteTableSchema(SchemaFilePath(tempDbPath, "stats"), {.columns = {"id", "hits", "score", "is_active", "name"}});
+    const std::string tablePath = conn->getTableFilePath("stats");
+    const auto inode = [&]() { return StatFile(tablePath)->inode; };
+    const std::uint64_t original = inode();
+
+    auto stmt = conn->createStatement();
+    conn->setSyncMode(SyncMode::COMMIT);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET hits = 42 WHERE id = 7;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET score = 1.25, is_active = false WHERE id > 97;"), 2U);
+    EXPECT_EQ(inode(), original);
+    EXPECT_FALSE(fs::exists(PatchJournalFilePath(tablePath)));
+
+    rows[7]["hits"] = 42;
+    for (const int id : {98, 99})
+    {
+        rows[id]["score"] = 1.25;
+        rows[id]["is_active"] = false;
+    }
+    EXPECT_EQ(conn->getTableData("stats"), rows);
+    EXPECT_EQ(ColumnarTable(tablePath).readRows(), rows);
+    auto result = stmt->executeQuery("SELECT id FROM stats WHERE hits = 42;");
+    ASSERT_TRUE(result->next());
+    EXPECT_EQ(result->getInt("id"), 7);
+    EXPECT_FALSE(result->next());
+
+    // Values past a block's min/max widen it by rewriting only the footer.
+    const auto fileSize = fs::file_size(tablePath);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET hits = 5000 WHERE id = 1;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET hits = -3, score = 99.5 WHERE id = 5;"), 1U);
+    EXPECT_EQ(inode(), original);
+    EXPECT_GE(fs::file_size(tablePath), fileSize);
+    rows[1]["hits"] = 5000;
+    rows[5]["hits"] = -3;
+    rows[5]["score"] = 99.5;
+    {
+        const ColumnarTable table(tablePath);
+        EXPECT_EQ(table.readRows(), rows);
+        const auto column = std::find_if(table.getColumns().begin(), table.getColumns().end(), [](const ColumnarColumn& entry) {
+            return entry.name == "hits";
+        });
+        ASSERT_NE(column, table.getColumns().end());
+        const ColumnChunk& hits = table.getBlocks()[0].chunks[static_cast<std::size_t>(column - table.getColumns().begin())];
+        EXPECT_EQ(hits.min, std::optional<double>(-3.0));
+        EXPECT_EQ(hits.max, std::optional<double>(5000.0));
+    }
+    auto widened = stmt->executeQuery("SELECT id FROM stats WHERE hits > 4000 OR score > 99;");
+    ASSERT_TRUE(widened->next());
+    EXPECT_EQ(widened->getInt("id"), 1);
+    ASSERT_TRUE(widened->next());
+    EXPECT_EQ(widened->getInt("id"), 5);
+    EXPECT_FALSE(widened->next());
+
+    // Nulls and strings still rewrite.
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET name = 'other' WHERE id = 2;"), 1U);
+    EXPECT_NE(inode(), original);
+    rows[2]["name"] = "other";
+    EXPECT_EQ(ColumnarTable(tablePath).readRows(), rows);
+
+    // A journal left by a crash between logging and patching is applied by
+    // readers, even where its footer reaches past the end of the file, and
+    // folded into the file by the next patch.
+    ColumnarUpdatePlan plan;
+    ASSERT_TRUE(ColumnarTable(tablePath).planUpdate(3, rows[3], {{"id", 3}, {"hits", 123456}, {"score", 1.5}, {"is_active", true}, {"name", "row"}}, plan));
+    const std::vector<FilePatch> patches = ColumnarTable(tablePath).finishUpdate(std::move(plan));
+    ASSERT_EQ(patches.size(), 2U);
+    EXPECT_GT(patches[1].offset + patches[1].bytes.size(), fs::file_size(tablePath));
+    std::string journal = "JDBPTCH1";
+    const auto putU64 = [&](std::uint64_t value) {
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            journal += static_cast<char>((value >> shift) & 0xff);
+        }
+    };
+    putU64(inode());
+    putU64(patches.size());
+    for (const auto& patch : patches)
+    {
+        putU64(patch.offset);
+        putU64(patch.bytes.size());
+        journal += patch.bytes;
+    }
+    std::ofstream(PatchJournalFilePath(tablePath), std::ios::binary) << journal;
+    rows[3]["hits"] = 123456;
+    EXPECT_EQ(ColumnarTable(tablePath).readRows(), rows);
+
+    EXPECT_EQ(stmt->executeUpdate("UPDATE stats SET hits = 80 WHERE id = 4;"), 1U);
+    EXPECT_FALSE(fs::exists(PatchJournalFilePath(tablePath)));
+    rows[4]["hits"] = 80;
+    EXPECT_EQ(ColumnarTable(tablePath).readRows(), rows);
+}
+
+TEST_F(JsonDbBaseTest, LsmTablesFlushRunsCompactAndServeKeyLookups)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE kv (id INT PRIMARY KEY, val VARCHAR(20)) ENGINE = LSM;"));
+    const std::string tablePath = conn->getTableFilePath("kv");
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::LSM);
+    conn->setLsmMemtableBytes(256);
+
+    for (int step = 0; step < 60; ++step)
+    {
+        const std::string id = std::to_string((step * 37) % 60 * 2);
+        EXPECT_EQ(stmt->executeUpdate("INSERT INTO kv VALUES (" + id + ", 'v" + id + "');"), 1U);
+    }
+    EXPECT_THROW(stmt->executeUpdate("INSERT INTO kv VALUES (42, 'again');"), JsonDbException);
+    std::shared_ptr<LsmTree> lsm = conn->getLsmTree("kv");
+    ASSERT_NE(lsm, nullptr);
+    EXPECT_GT(lsm->getStats().flushes, 2U);
+
+    const auto value = [&](int id) {
+        auto resultSet = stmt->executeQuery("SELECT val FROM kv WHERE id = " + std::to_string(id) + ";");
+        return resultSet->next() ? resultSet->getString("val") : std::string();
+    };
+    EXPECT_EQ(value(42), "v42");
+    EXPECT_EQ(stmt->getLastAccessPath(), AccessPath::PRIMARY_KEY);
+    EXPECT_EQ(value(118), "v118");
+    // Odd keys fall inside every run's range, so only the filters rule them out.
+    const LsmStats before = lsm->getStats();
+    for (int id = 1; id < 100; id += 2)
+    {
+        EXPECT_EQ(value(id), "");
+    }
+    const LsmStats after = lsm->getStats();
+    EXPECT_GT(after.bloomSkips, before.bloomSkips);
+    EXPECT_LT(after.runReads - before.runReads, 10U);
+
+    const auto ids = [&](const std::string& sql) {
+        std::vector<int> result;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            result.push_back(resultSet->getInt("id"));
+        }
+        return result;
+    };
+    EXPECT_EQ(stmt->executeUpdate("UPDATE kv SET val = 'low' WHERE id < 10;"), 5U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM kv WHERE id >= 100;"), 10U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE kv SET id = 1 WHERE id = 0;"), 1U);
+    EXPECT_THROW(stmt->executeUpdate("UPDATE kv SET id = 4 WHERE id = 2;"), JsonDbException);
+    std::vector<int> expected{1};
+    for (int id = 2; id < 100; id += 2)
+    {
+        expected.push_back(id);
+    }
+    EXPECT_EQ(ids("SELECT id FROM kv ORDER BY id;"), expected);
+    EXPECT_EQ(value(1), "low");
+    EXPECT_EQ(value(0), "");
+
+    stmt->execute("VACUUM kv;");
+    EXPECT_GT(lsm->getStats().compactions, 0U);
+    EXPECT_LT(lsm->getStats().runsPerLevel.front(), LsmTree::kLevel0Runs);
+
+    // A fresh tree rebuilds the same table from the manifest, runs and log.
+    lsm.reset();
+    conn->close();
+    conn = driver->connect(tempDbPath, "test_user", "test_pass");
+    stmt = conn->createStatement();
+    EXPECT_EQ(ids("SELECT id FROM kv ORDER BY id;"), expected);
+    EXPECT_EQ(value(98), "v98");
+    EXPECT_EQ(stmt->executeUpdate("REPLACE INTO kv VALUES (98, 'replaced'), (200, 'new');"), 3U);
+    EXPECT_EQ(value(98), "replaced");
+    EXPECT_EQ(value(200), "new");
+
+    Statement alter(conn);
+    const TableRows rows = conn->getTableData("kv");
+    EXPECT_TRUE(alter.execute("ALTER TABLE kv ENGINE = JSON;"));
+    EXPECT_FALSE(fs::exists(LsmDirectoryPath(tablePath)));
+    EXPECT_EQ(conn->getTableData("kv"), rows);
+    EXPECT_TRUE(alter.execute("ALTER TABLE kv ENGINE = LSM;"));
+    EXPECT_EQ(conn->getTableData("kv"), rows);
+
+    // Without a primary key, rows keep the order they were inserted in.
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE events (id INT, kind VARCHAR(20)) ENGINE = LSM;"));
+    for (const int id : {3, 1, 2, 1})
+    {
+        stmt->executeUpdate("INSERT INTO events VALUES (" + std::to_string(id) + ", 'e');");
+    }
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM events WHERE id = 2;"), 1U);
+    EXPECT_EQ(ids("SELECT id FROM events;"), (std::vector<int>{3, 1, 1}));
+}
+
+TEST_F(JsonDbBaseTest, PagedTablesWriteOnlyTouchedPagesThroughTheBufferPool)
+{
+    auto stmt = conn->createStatement();
+    ASSERT_TRUE(stmt->executeCreate("CREATE TABLE docs (id INT PRIMARY KEY, body TEXT) ENGINE = PAGED;"));
+    const std::string tablePath = conn->getTableFilePath("docs");
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::PAGED);
+    const std::string body(1000, 'x');
+    for (int id = 0; id < 40; ++id)
+    {
+        EXPECT_EQ(stmt->executeUpdate("INSERT INTO docs VALUES (" + std::to_string(id) + ", '" + body + "');"), 1U);
+    }
+    std::shared_ptr<PagedTable> paged = conn->getPagedTable("docs");
+    ASSERT_NE(paged, nullptr);
+    EXPECT_EQ(paged->getRowCount(), 40U);
+    EXPECT_GT(paged->getPageCount(), 5U);
+
+    const auto ids = [&](const std::string& sql) {
+        std::vector<int> result;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            result.push_back(resultSet->getInt("id"));
+        }
+        return result;
+    };
+    // Scans stream through a pool far smaller than the table.
+    conn->setTableCacheBudget(0);
+    conn->setBufferPoolPages(4);
+    const BufferPoolStats before = conn->getBufferPoolStats();
+    EXPECT_EQ(ids("SELECT id FROM docs WHERE id >= 38;"), (std::vector<int>{38, 39}));
+    const BufferPoolStats after = conn->getBufferPoolStats();
+    EXPECT_GT(after.misses, before.misses);
+    EXPECT_GT(after.evictions, before.evictions);
+    EXPECT_LE(after.residentPages, 4U);
+
+    // Mutations find their rows by the same page-at-a-time scan, so the
+    // table is never loaded whole.
+    const std::uint64_t inode = StatFile(tablePath)->inode;
+    const TableCacheStats cacheBefore = conn->getTableCacheStats();
+    EXPECT_EQ(stmt->executeUpdate("UPDATE docs SET body = 'short' WHERE id = 5;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM docs WHERE id >= 30 AND id < 35;"), 5U);
+    EXPECT_EQ(stmt->executeUpdate("UPDATE docs SET body = '" + std::string(1500, 'y') + "' WHERE id = 6;"), 1U);
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM docs WHERE id = 99;"), 0U);
+    EXPECT_EQ(conn->getTableCacheStats().misses, cacheBefore.misses);
+    EXPECT_LE(conn->getBufferPoolStats().residentPages, 4U);
+    EXPECT_EQ(StatFile(tablePath)->inode, inode);
+    EXPECT_EQ(paged->getRowCount(), 35U);
+
+    std::vector<int> expected;
+    for (int id = 0; id < 40; ++id)
+    {
+        if (id < 30 || id >= 35)
+        {
+            expected.push_back(id);
+        }
+    }
+    paged.reset();
+    conn->close();
+    conn = driver->connect(tempDbPath, "test_user", "test_pass");
+    stmt = conn->createStatement();
+    EXPECT_EQ(ids("SELECT id FROM docs;"), expected);
+    auto resultSet = stmt->executeQuery("SELECT body FROM docs WHERE id = 5;");
+    ASSERT_TRUE(resultSet->next());
+    EXPECT_EQ(resultSet->getString("body"), "short");
+    resultSet = stmt->executeQuery("SELECT body FROM docs WHERE id = 6;");
+    ASSERT_TRUE(resultSet->next());
+    EXPECT_EQ(resultSet->getString("body"), std::string(1500, 'y'));
+    EXPECT_THROW(stmt->executeUpdate("UPDATE docs SET body = '" + std::string(9000, 'z') + "' WHERE id = 7;"), JsonDbException);
+    EXPECT_EQ(ids("SELECT id FROM docs;"), expected);
+
+    Statement alter(conn);
+    const TableRows rows = conn->getTableData("docs");
+    EXPECT_TRUE(alter.execute("ALTER TABLE docs ENGINE = JSON;"));
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::JSON);
+    EXPECT_TRUE(alter.execute("ALTER TABLE docs ENGINE = PAGED;"));
+    EXPECT_EQ(DetectTableFormat(tablePath), TableFormat::PAGED);
+    EXPECT_EQ(conn->getTableData("docs"), rows);
+    EXPECT_THROW(SerializePagedTable({{{"body", std::string(9000, 'z')}}}, 4096), JsonDbException);
+}
+
+TEST_F(JsonDbBaseTest, ZoneMapsSkipBlocksThatCannotMatch)
+{
+    const std::size_t rowCount = 3 * kZoneBlockRows + 10;
+    TableRows rows;
+    for (std::size_t id = 0; id < rowCount; ++id)
+    {
+        rows.push_back({{"id", id}, {"day", "d" + std::to_string(10000 + id / 100)}, {"note", id % 2 == 0 ? nlohmann::json(nullptr) : nlohmann::json("x")}});
+    }
+    WriteTableFile(tempDbPath, "events", rows, TableFormat::JSON, SyncMode::NONE);
+    const std::string zonesPath = ZoneMapFilePath(tempDbPath, "events");
+    ASSERT_TRUE(fs::exists(zonesPath));
+    const std::optional<ZoneMap> zoneMap = LoadZoneMap(tempDbPath, "events");
+    ASSERT_TRUE(zoneMap.has_value());
+    ASSERT_EQ(zoneMap->zones.size(), 4U);
+    EXPECT_EQ(zoneMap->zones[1].columns.at("id").min, static_cast<double>(kZoneBlockRows));
+    EXPECT_EQ(zoneMap->zones[1].columns.at("note").nullCount, kZoneBlockRows / 2);
+
+    conn->setTableCacheBudget(0);
+    auto stmt = conn->createStatement();
+    const auto ids = [&](const std::string& sql) {
+        std::vector<int> result;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            result.push_back(resultSet->getInt("id"));
+        }
+        return result;
+    };
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id >= 5000 AND id < 5003;"), (std::vector<int>{5000, 5001, 5002}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 3U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksScanned, 1U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE day = 'd10050' AND id > 5096;"), (std::vector<int>{5097, 5098, 5099}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 3U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id = 7 OR id = 12297;"), (std::vector<int>{7, 12297}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 2U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id = 'seven';").size(), 0U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 4U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE NOT id > 1;"), (std::vector<int>{0, 1}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 0U);
+
+    // Tombstones leave the file, and so its zones, in place.
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM events WHERE id = 5001;"), 1U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id >= 5000 AND id < 5003;"), (std::vector<int>{5000, 5002}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 3U);
+
+    // NDJSON rows appended after the zones were written are always read.
+    conn->convertTable("events", TableFormat::NDJSON);
+    EXPECT_EQ(stmt->executeUpdate("INSERT INTO events (id, day, note) VALUES (50000, 'd99999', 'late');"), 1U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id > 20000;"), (std::vector<int>{50000}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 4U);
+
+    conn->convertTable("events", TableFormat::PAGED);
+    EXPECT_FALSE(fs::exists(zonesPath));
+    conn->convertTable("events", TableFormat::COLUMNAR);
+    const std::string columnar = SerializeColumnarTable(conn->getTableData("events"), kZoneBlockRows);
+    std::ofstream(conn->getTableFilePath("events"), std::ios::binary) << columnar;
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id < 3;"), (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 3U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksScanned, 1U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id >= 3 LIMIT 2;"), (std::vector<int>{3, 4}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 0U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksScanned, 1U);
+    EXPECT_EQ(ids("SELECT id FROM events WHERE id > 20000;"), (std::vector<int>{50000}));
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 3U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksScanned, 1U);
+}
+
+TEST_F(JsonDbBaseTest, BloomFilterColumnsRuleOutEqualityProbesPerBlock)
+{
+    const std::size_t rowCount = 3 * kZoneBlockRows + 10;
+    TableRows rows;
+    for (std::size_t id = 0; id < rowCount; ++id)
+    {
+        rows.push_back({{"id", id}, {"email", "user" + std::to_string(id * 7919 % rowCount) + "@example.com"}});
+    }
+    WriteTableSchema(SchemaFilePath(tempDbPath, "people"), {.columns = {"id", "email"}});
+    WriteTableFile(tempDbPath, "people", rows, TableFormat::JSON, SyncMode::NONE);
+    conn->setTableCacheBudget(0);
+    auto stmt = conn->createStatement();
+    const auto count = [&](const std::string& sql) {
+        std::size_t result = 0;
+        auto resultSet = stmt->executeQuery(sql);
+        while (resultSet->next())
+        {
+            ++result;
+        }
+        return result;
+    };
+
+    // Every block's email range spans the probe, so only a filter can skip it.
+    const std::string missing = "SELECT id FROM people WHERE email = 'user5@example.org';";
+    EXPECT_EQ(count(missing), 0U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 0U);
+
+    EXPECT_THROW(conn->setBloomColumns("people", {"email"}, 1.5), JsonDbException);
+    EXPECT_THROW(conn->setBloomColumns("people", {"phone"}), JsonDbException);
+    conn->setBloomColumns("people", {"email"}, 0.001);
+    const TableSchema schema = ReadTableSchema(SchemaFilePath(tempDbPath, "people"));
+    EXPECT_EQ(schema.bloomColumns, (std::vector<std::string>{"email"}));
+    EXPECT_DOUBLE_EQ(schema.bloomFalsePositiveRate, 0.001);
+    EXPECT_EQ(count(missing), 0U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 4U);
+    EXPECT_EQ(count("SELECT id FROM people WHERE email = 'user5@example.com';"), 1U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksScanned, 1U);
+
+    // Compaction rewrites the table, and the filters with it.
+    EXPECT_EQ(stmt->executeUpdate("DELETE FROM people WHERE email = 'user5@example.com';"), 1U);
+    EXPECT_EQ(stmt->executeVacuum(SqlVacuumStatement{{.database = {}, .table = "people"}}), 1U);
+    const std::optional<ZoneMap> zoneMap = LoadZoneMap(tempDbPath, "people");
+    ASSERT_TRUE(zoneMap.has_value());
+    EXPECT_TRUE(zoneMap->zones.front().columns.at("email").bloom.has_value());
+    EXPECT_FALSE(zoneMap->zones.front().columns.at("id").bloom.has_value());
+    EXPECT_EQ(count("SELECT id FROM people WHERE email = 'user5@example.com';"), 0U);
+    EXPECT_EQ(stmt->getLastScanStats().blocksSkipped, 4U);
+}
+
+TEST(ColumnarTableTest, RoundTripsRowsAndFiltersBlockwise)
+{
+    TableRows rows;
+    for (int index = 0; index < 10; ++index)
+    {
+        nlohmann::json row = {{"id", index}, {"value", index * 1.5}, {"tag", index % 2 == 0 ? "even" : "odd"}};
+        if (index % 3 == 0)
+        {
+            row["extra"] = nlohmann::json::array({index});
+        }
+        if (index == 7)
+        {
+            row["value"] = nullptr;
+        }
+        rows.push_back(std::move(row));
+    }
+
+    const std::string path = "test_columnar_table.bin";
+    std::ofstream(path, std::ios::binary) << SerializeColumnarTable(rows, 4);
+    {
+        const ColumnarTable table(path);
+        EXPECT_EQ(table.getRowCount(), rows.size());
+        ASSERT_EQ(table.getBlocks().size(), 3U);
+        EXPECT_EQ(table.readRows(), rows);
+        EXPECT_EQ(table.readRow(3, {"extra", "id"}), (nlohmann::json{{"id", 3}, {"extra", {3}}}));
+
+        const auto value = std::find_if(table.getColumns().begin(), table.getColumns().end(), [](const ColumnarColumn& column) {
+            return column.name == "value";
+        });
+        ASSERT_NE(value, table.getColumns().end());
+        EXPECT_EQ(value->type, ColumnType::DOUBLE);
+        const ColumnChunk& chunk = table.getBlocks()[1].chunks[static_cast<std::size_t>(value - table.getColumns().begin())];
+        EXPECT_EQ(chunk.nullCount, 1U);
+        EXPECT_DOUBLE_EQ(*chunk.min, 6.0);
+        EXPECT_DOUBLE_EQ(*chunk.max, 9.0);
+
+        for (const std::string where : {"value >= 6 AND tag = 'even'", "NOT value < 3", "value = NULL OR id = 1", "tag != 'odd'"})
+        {
+            const Predicate predicate = Predicate::compile(where);
+            std::vector<std::size_t> expected;
+            for (std::size_t position = 0; position < rows.size(); ++position)
+            {
+                if (predicate.matches(rows[position]))
+                {
+                    expected.push_back(position);
+                }
+            }
+            std::vector<std::size_t> actual;
+            table.scan(predicate, [&](std::size_t position) {
+                actual.push_back(position);
+                return true;
+            });
+            EXPECT_EQ(actual, expected) << where;
+        }
+        EXPECT_THROW(table.scan(Predicate::compile("extra = 1"), [](std::size_t) { return true; }), JsonDbException);
+    }
+    fs::remove(path);
+
+    std::ofstream(path, std::ios::binary) << "[]";
+    EXPECT_FALSE(IsColumnarFile(path));
+    EXPECT_THROW(ColumnarTable{path}, JsonDbException);
+    fs::remove(path);
+}
+
 TEST_F(JsonDbBaseTest, InvalidSqlAndMissingColumnsThrow)
 {
     CreateSeedTable("user");
@@ -142,6 +1906,8 @@ TEST_F(JsonDbBaseTest, InvalidSqlAndMissingColumnsThrow)
     EXPECT_THROW(stmt->executeQuery("SELECT missing FROM user;"), JsonDbException);
     EXPECT_THROW(stmt->executeUpdate("UPSERT INTO user VALUES (1);"), JsonDbException);
     EXPECT_THROW(stmt->executeQuery("SELECT * FROM user WHERE missing = 1;"), JsonDbException);
+    EXPECT_THROW(stmt->executeQuery("SELECT id FROM user ORDER BY missing;"), JsonDbException);
+    EXPECT_THROW(stmt->executeQuery("SELECT id FROM ghost;"), JsonDbException);
 }
 
 int main(int argc, char** argv)
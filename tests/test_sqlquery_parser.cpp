@@ -86,6 +86,209 @@ TEST_F(SqlParserTest, HandlesCommentsWhitespaceAndUnknownSql)
     EXPECT_EQ(invalid->getOperationType(), SqlType::UNKNOWN);
 }
 
+TEST_F(SqlParserTest, ExtractsClausesOutsideQuotedText)
+{
+    auto result = Parse(
+        "SELECT dept, count FROM staff WHERE note = 'where -- limit' AND id > 3 "
+        "GROUP BY dept, team HAVING count > 1 ORDER BY dept DESC LIMIT 5;");
+
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->getWhereClause(), "NOTE = 'WHERE -- LIMIT' AND ID > 3");
+    EXPECT_EQ(result->getGroupByColumns(), std::vector<std::string>({"DEPT", "TEAM"}));
+    EXPECT_EQ(result->getHavingClause(), "COUNT > 1");
+    EXPECT_EQ(result->getOrderByClause(), "DEPT DESC");
+    EXPECT_EQ(result->getLimitClause(), "5");
+}
+
+TEST_F(SqlParserTest, HandlesMultiMegabyteStatements)
+{
+    std::string sql = "INSERT INTO logs (id, message) VALUES ";
+    for (int index = 0; index < 100000; ++index)
+    {
+        if (index > 0)
+        {
+            sql += ", ";
+        }
+        sql += "(" + std::to_string(index) + ", 'message body /* not a comment */ " + std::to_string(index) + "')";
+    }
+    sql += ";";
+
+    auto result = Parse(sql);
+
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->getOperationType(), SqlType::INSERT);
+    EXPECT_EQ(result->getTable(), "LOGS");
+    EXPECT_EQ(result->getColumns(), std::vector<std::string>({"ID", "MESSAGE"}));
+}
+
+TEST(SqlAstParserTest, BuildsTypedSelectStatement)
+{
+    const SqlStatement statement = SqlAstParser().parse(
+        "SELECT id, name FROM app.users WHERE (age >= 18 OR vip = true) AND NOT name = 'O''Neil' "
+        "ORDER BY age DESC, id LIMIT 10 OFFSET 20;");
+
+    ASSERT_EQ(statement.type, SqlType::SELECT);
+    const auto& select = statement.as<SqlSelectStatement>();
+    EXPECT_EQ(select.table.database, "app");
+    EXPECT_EQ(select.table.table, "users");
+    EXPECT_EQ(select.columns, std::vector<std::string>({"id", "name"}));
+    ASSERT_NE(select.where, nullptr);
+    EXPECT_EQ(select.where->kind, SqlExpression::Kind::AND);
+    ASSERT_EQ(select.where->children.size(), 2U);
+    EXPECT_EQ(select.where->children[0]->kind, SqlExpression::Kind::OR);
+    EXPECT_EQ(select.where->children[1]->kind, SqlExpression::Kind::NOT);
+    EXPECT_EQ(select.where->children[1]->children[0]->value.stringValue, "O'Neil");
+    ASSERT_EQ(select.orderBy.size(), 2U);
+    EXPECT_TRUE(select.orderBy[0].descending);
+    EXPECT_FALSE(select.orderBy[1].descending);
+    EXPECT_EQ(select.limit, std::optional<std::size_t>(10));
+    EXPECT_EQ(select.offset, 20U);
+}
+
+TEST(SqlAstParserTest, BuildsMutationAndCreateStatements)
+{
+    const SqlAstParser parser;
+
+    const auto insert = parser.parse("INSERT INTO t (a, b) VALUES (1, -2.5), (null, 'x');").as<SqlInsertStatement>();
+    EXPECT_EQ(insert.columns, std::vector<std::string>({"a", "b"}));
+    ASSERT_EQ(insert.rows.size(), 2U);
+    EXPECT_EQ(insert.rows[0][0].kind, SqlValue::Kind::INTEGER);
+    EXPECT_EQ(insert.rows[0][1].kind, SqlValue::Kind::FLOAT);
+    EXPECT_DOUBLE_EQ(insert.rows[0][1].floatValue, -2.5);
+    EXPECT_EQ(insert.rows[1][0].kind, SqlValue::Kind::NULL_VALUE);
+
+    EXPECT_FALSE(insert.replace);
+    const SqlStatement replace = parser.parse("REPLACE INTO t VALUES (1, 'x');");
+    EXPECT_EQ(replace.type, SqlType::INSERT);
+    EXPECT_TRUE(replace.as<SqlInsertStatement>().replace);
+
+    const auto update = parser.parse("UPDATE t SET a = 1, b = 'y' WHERE a != 2").as<SqlUpdateStatement>();
+    ASSERT_EQ(update.assignments.size(), 2U);
+    EXPECT_EQ(update.assignments[1].column, "b");
+    EXPECT_EQ(update.where->op, SqlCompareOp::NE);
+
+    const auto create =
+        parser.parse("CREATE TABLE t (id INT PRIMARY KEY, name VARCHAR(20) NOT NULL, PRIMARY KEY (name));")
+            .as<SqlCreateTableStatement>();
+    ASSERT_EQ(create.columns.size(), 2U);
+    EXPECT_TRUE(create.columns[0].primaryKey);
+    EXPECT_EQ(create.columns[1].typeName, "VARCHAR");
+    EXPECT_EQ(create.primaryKey, std::vector<std::string>({"id", "name"}));
+    EXPECT_TRUE(create.engine.empty());
+    EXPECT_EQ(parser.parse("CREATE TABLE t (id INT) ENGINE=columnar;").as<SqlCreateTableStatement>().engine, "COLUMNAR");
+
+    const SqlStatement alter = parser.parse("ALTER TABLE t ENGINE = Json;");
+    EXPECT_EQ(alter.type, SqlType::ALTER);
+    EXPECT_EQ(alter.as<SqlAlterTableStatement>().table.table, "t");
+    EXPECT_EQ(alter.as<SqlAlterTableStatement>().engine, "JSON");
+    EXPECT_THROW(parser.parse("ALTER TABLE t ADD COLUMN x INT;"), SqlSyntaxError);
+
+    const SqlStatement vacuum = parser.parse("VACUUM t;");
+    EXPECT_EQ(vacuum.type, SqlType::VACUUM);
+    EXPECT_EQ(vacuum.as<SqlVacuumStatement>().table.table, "t");
+    EXPECT_TRUE(parser.parse("vacuum").as<SqlVacuumStatement>().table.table.empty());
+    EXPECT_THROW(parser.parse("VACUUM t u;"), SqlSyntaxError);
+
+    const SqlStatement index = parser.parse("CREATE INDEX idx_name ON t (name);");
+    EXPECT_EQ(index.type, SqlType::CREATE);
+    ASSERT_TRUE(index.is<SqlCreateIndexStatement>());
+    EXPECT_EQ(index.as<SqlCreateIndexStatement>().name, "idx_name");
+    EXPECT_EQ(index.as<SqlCreateIndexStatement>().table.table, "t");
+    EXPECT_EQ(index.as<SqlCreateIndexStatement>().columns, std::vector<std::string>({"name"}));
+    EXPECT_EQ(index.as<SqlCreateIndexStatement>().method, SqlIndexMethod::HASH);
+    EXPECT_EQ(parser.parse("CREATE INDEX idx_age ON t (age) using btree").as<SqlCreateIndexStatement>().method, SqlIndexMethod::BTREE);
+    EXPECT_THROW(parser.parse("CREATE INDEX idx_name (name);"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("CREATE INDEX idx_age ON t (age) USING RTREE;"), SqlSyntaxError);
+
+    EXPECT_THROW(parser.parse("SELECT FROM t;"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("UPSERT INTO t VALUES (1);"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("DELETE FROM t WHERE a = 1 extra"), SqlSyntaxError);
+}
+
+TEST_F(SqlParserTest, AttachesAstToParseResult)
+{
+    auto result = Parse("DELETE FROM logs WHERE id = 7;");
+
+    ASSERT_NE(result, nullptr);
+    ASSERT_NE(result->getStatement(), nullptr);
+    EXPECT_EQ(result->getStatement()->type, SqlType::DELETE);
+    EXPECT_EQ(result->getStatement()->as<SqlDeleteStatement>().table.table, "logs");
+    EXPECT_EQ(result->getWhereClause(), "ID = 7");
+    EXPECT_TRUE(result->getSyntaxError().empty());
+
+    auto select = Parse("select id from app.users where (age >= 18 or vip = true) order by age desc limit 10 offset 20");
+    ASSERT_NE(select->getStatement(), nullptr);
+    EXPECT_EQ(select->getDatabase(), "APP");
+    EXPECT_EQ(select->getTable(), "USERS");
+    EXPECT_EQ(select->getWhereClause(), "(AGE >= 18 OR VIP = TRUE)");
+    EXPECT_EQ(select->getOrderByClause(), "AGE DESC");
+    EXPECT_EQ(select->getLimitClause(), "10 OFFSET 20");
+
+    auto replace = Parse("REPLACE INTO logs VALUES (1, 'x');");
+    EXPECT_EQ(replace->getOperationType(), SqlType::INSERT);
+    EXPECT_EQ(replace->getType(), "INSERT");
+
+    auto grouped = Parse("SELECT dept FROM staff GROUP BY dept;");
+    EXPECT_EQ(grouped->getStatement(), nullptr);
+    EXPECT_FALSE(grouped->getSyntaxError().empty());
+    EXPECT_EQ(grouped->getGroupByColumns(), std::vector<std::string>({"DEPT"}));
+}
+
+TEST(SqlAstParserTest, RejectsUnterminatedQuotes)
+{
+    const SqlAstParser parser;
+    EXPECT_THROW(parser.parse("SELECT * FROM t WHERE name = 'abc"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("SELECT * FROM t WHERE name = \"abc"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("SELECT `name FROM t"), SqlSyntaxError);
+    EXPECT_THROW(parser.parse("SELECT * FROM t WHERE name = 'it''"), SqlSyntaxError);
+    EXPECT_THROW(SqlLexer("'"), SqlSyntaxError);
+    EXPECT_EQ(parser.parse("SELECT * FROM t WHERE name = 'it'''").as<SqlSelectStatement>().where->value.stringValue, "it'");
+}
+
+TEST(SqlAstParserTest, RejectsMalformedNumericLiterals)
+{
+    const SqlAstParser parser;
+    for (const char* literal : {"1.2.3", "1e", "1e+", "12e3e4", "12abc", "1..2"})
+    {
+        EXPECT_THROW(parser.parse(std::string("SELECT * FROM t WHERE id = ") + literal), SqlSyntaxError) << literal;
+        EXPECT_THROW(parser.parse(std::string("INSERT INTO t VALUES (") + literal + ")"), SqlSyntaxError) << literal;
+    }
+
+    const SqlValue scientific = parser.parse("SELECT * FROM t WHERE id = 1.5e3").as<SqlSelectStatement>().where->value;
+    EXPECT_EQ(scientific.kind, SqlValue::Kind::FLOAT);
+    EXPECT_DOUBLE_EQ(scientific.floatValue, 1500.0);
+    const SqlValue negative = parser.parse("SELECT * FROM t WHERE id = -42").as<SqlSelectStatement>().where->value;
+    EXPECT_EQ(negative.kind, SqlValue::Kind::INTEGER);
+    EXPECT_EQ(negative.intValue, -42);
+    EXPECT_EQ(parser.parse("SELECT * FROM t WHERE id = 9223372036854775808").as<SqlSelectStatement>().where->value.kind,
+              SqlValue::Kind::FLOAT);
+}
+
+TEST_F(SqlParserTest, RecordsUnterminatedQuotesAsSyntaxErrors)
+{
+    auto result = Parse("SELECT * FROM t WHERE name = 'abc");
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->getStatement(), nullptr);
+    EXPECT_EQ(result->getOperationType(), SqlType::UNKNOWN);
+    EXPECT_NE(result->getSyntaxError().find("Unterminated"), std::string::npos);
+}
+
+TEST(SqlLexerTest, RecognizesKeywordsCaseInsensitively)
+{
+    EXPECT_EQ(LookupSqlKeyword("select"), SqlKeyword::SELECT);
+    EXPECT_EQ(LookupSqlKeyword("Where"), SqlKeyword::WHERE);
+    EXPECT_EQ(LookupSqlKeyword("users"), SqlKeyword::NONE);
+    EXPECT_EQ(LookupSqlKeyword("selection"), SqlKeyword::NONE);
+
+    const SqlLexer lexer("select a,b from t where x <> 'it''s';");
+    const auto& tokens = lexer.getTokens();
+    ASSERT_EQ(tokens.size(), 10U);
+    EXPECT_EQ(tokens[8].text, "<>");
+    EXPECT_EQ(tokens[9].type, SqlTokenType::STRING);
+    EXPECT_EQ(tokens[9].text, "'it''s'");
+    EXPECT_EQ(lexer.getNormalizedSql(), "select a,b from t where x <> 'it''s'");
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);